@@ -77,6 +77,7 @@ test "$RPM_BUILD_ROOT" = "/" || rm -rf "$RPM_BUILD_ROOT"
 /usr/lib/emailrelay/init/emailrelay
 /usr/lib/systemd/system/emailrelay.service
 /usr/sbin/emailrelay
+/usr/sbin/emailrelay-export
 /usr/sbin/emailrelay-passwd
 %attr(2755, root, daemon) /usr/sbin/emailrelay-submit
 %docdir /usr/share/doc/emailrelay
@@ -125,6 +126,7 @@ test "$RPM_BUILD_ROOT" = "/" || rm -rf "$RPM_BUILD_ROOT"
 %doc /usr/share/doc/emailrelay/windows.txt
 %dir /usr/share/emailrelay
 /usr/share/emailrelay/emailrelay-icon.png
+/usr/share/man/man1/emailrelay-export.1.gz
 /usr/share/man/man1/emailrelay-passwd.1.gz
 /usr/share/man/man1/emailrelay-submit.1.gz
 /usr/share/man/man1/emailrelay.1.gz
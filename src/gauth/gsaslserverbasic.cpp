@@ -316,10 +316,11 @@ std::string GAuth::SaslServerBasicImp::apply( const std::string & response , boo
 	return next_challenge ;
 }
 
-bool GAuth::SaslServerBasicImp::trusted( const G::StringArray & address_wildcards , const std::string & address_display ) const
+bool GAuth::SaslServerBasicImp::trusted( const G::StringArray & , const std::string & address_display ) const
 {
-	return std::any_of( address_wildcards.cbegin() , address_wildcards.cend() ,
-		[&](const std::string &wca){return trustedCore(wca,address_display);} ) ;
+	// the secrets file does a longest-prefix match in its address
+	// tree so there is no need to try each of the address wildcards
+	return trustedCore( address_display , address_display ) ;
 }
 
 bool GAuth::SaslServerBasicImp::trustedCore( const std::string & address_wildcard , const std::string & address_display ) const
@@ -32,12 +32,12 @@
 #include "glog.h"
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
 GAuth::SecretsFile::SecretsFile( const G::Path & path , bool auto_reread , const std::string & debug_name ) :
 	m_path(path) ,
 	m_auto(auto_reread) ,
 	m_debug_name(debug_name) ,
-	m_file_time(0) ,
 	m_check_time(G::SystemTime::now())
 {
 	m_valid = !path.str().empty() ;
@@ -75,12 +75,21 @@ void GAuth::SecretsFile::reread( int )
 		if( !now.sameSecond(m_check_time) ) // at most once a second
 		{
 			m_check_time = now ;
-			G::SystemTime t = readFileTime( m_path ) ;
-			G_DEBUG( "GAuth::SecretsFile::reread: current file time " << t << ": saved file time " << m_file_time ) ;
-			if( t != m_file_time )
+			FileState state = readFileState( m_path ) ;
+			G_DEBUG( "GAuth::SecretsFile::reread: current file time " << state.m_mtime_s << "." << state.m_mtime_us
+				<< ": saved file time " << m_file_state.m_mtime_s << "." << m_file_state.m_mtime_us ) ;
+			if( state != m_file_state )
 			{
 				G_LOG_S( "GAuth::Secrets: re-reading secrets file: " << m_path ) ;
-				read( m_path ) ;
+				try
+				{
+					read( m_path ) ;
+				}
+				catch( std::exception & e ) // eg. cannot open
+				{
+					// keep the old contents and try again on the next check
+					G_WARNING( "GAuth::SecretsFile::reread: " << e.what() ) ;
+				}
 			}
 		}
 	}
@@ -88,15 +97,43 @@ void GAuth::SecretsFile::reread( int )
 
 void GAuth::SecretsFile::read( const G::Path & path )
 {
-	m_file_time = readFileTime( path ) ;
-	m_contents = readContents( path ) ;
-	showDiagnostics( m_contents , path , m_debug_name , false ) ;
+	FileState state = readFileState( path ) ;
+	Contents contents = readContents( path ) ; // build the new contents off to the side...
+	showDiagnostics( contents , path , m_debug_name , false ) ;
+	m_contents = std::move( contents ) ; // ...and swap them in
+	m_file_state = state ;
 }
 
-G::SystemTime GAuth::SecretsFile::readFileTime( const G::Path & path )
+GAuth::SecretsFile::FileState GAuth::SecretsFile::readFileState( const G::Path & path )
 {
-	G::Root claim_root ;
-	return G::File::time( path ) ;
+	G::File::Stat s ;
+	{
+		G::Root claim_root ;
+		s = G::File::stat( path ) ;
+	}
+	FileState state ;
+	if( s.error == 0 )
+	{
+		state.m_mtime_s = s.mtime_s ;
+		state.m_mtime_us = s.mtime_us ;
+		state.m_size = s.size ;
+		state.m_inode = s.inode ;
+	}
+	return state ;
+}
+
+bool GAuth::SecretsFile::FileState::operator==( const FileState & other ) const noexcept
+{
+	return
+		m_mtime_s == other.m_mtime_s &&
+		m_mtime_us == other.m_mtime_us &&
+		m_size == other.m_size &&
+		m_inode == other.m_inode ;
+}
+
+bool GAuth::SecretsFile::FileState::operator!=( const FileState & other ) const noexcept
+{
+	return !(*this == other) ;
 }
 
 GAuth::SecretsFile::Contents GAuth::SecretsFile::readContents( const G::Path & path )
@@ -148,9 +185,33 @@ GAuth::SecretsFile::Contents GAuth::SecretsFile::readContents( std::istream & fi
 				addError( contents , line_number , "too few fields"_sv ) ;
 		}
 	}
+	compileTrust( contents ) ;
 	return contents ;
 }
 
+void GAuth::SecretsFile::compileTrust( Contents & contents )
+{
+	// compile the trust address ranges into a prefix tree, in file order
+	// so that the earlier of any equivalent ranges wins, and keep the
+	// original strings in the map for exact matching -- anything else
+	// that looks like a cidr range, eg. with host bits set, is warned
+	// about since it will never match
+	TrustList list ;
+	list.reserve( contents.m_trust_map.size() ) ;
+	for( const auto & item : contents.m_trust_map )
+		list.push_back( &item ) ;
+	std::sort( list.begin() , list.end() ,
+		[](const TrustMap::value_type * a,const TrustMap::value_type * b){return a->second.second < b->second.second;} ) ;
+
+	for( const auto * item : list )
+	{
+		if( contents.m_trust_tree.add( item->first , contents.m_trust_list.size() ) )
+			contents.m_trust_list.push_back( item ) ;
+		else if( item->first.find('/') != std::string::npos && item->first.at(0U) != '/' )
+			addWarning( contents , static_cast<unsigned int>(item->second.second) , "invalid server trust address range"_sv , item->first ) ;
+	}
+}
+
 void GAuth::SecretsFile::processLine( Contents & contents , unsigned int line_number ,
 	std::string_view side , std::string_view type_in , std::string_view id ,
 	std::string_view secret , std::string_view selector )
@@ -360,11 +421,26 @@ std::pair<std::string,std::string> GAuth::SecretsFile::serverTrust( const std::s
 
 	reread() ;
 
+	const TrustMap::value_type * entry = nullptr ;
 	auto p = m_contents.m_trust_map.find( address_range ) ;
 	if( p != m_contents.m_trust_map.end() )
 	{
-		result.first = (*p).second.first ;
-		result.second = lineContext( (*p).second.second ) ;
+		entry = &(*p) ;
+	}
+	else
+	{
+		std::size_t i = m_contents.m_trust_tree.find( std::string_view(address_range) ) ;
+		if( i != GNet::AddressTree::npos )
+			entry = m_contents.m_trust_list.at( i ) ;
+		G_DEBUG( "GAuth::SecretsFile::serverTrust: [" << address_range << "]: "
+			<< (entry?entry->first:std::string("no matching trust range")) ) ;
+	}
+	if( entry )
+	{
+		result.first = entry->second.first ;
+		result.second = lineContext( entry->second.second ) ;
+		if( entry->first != address_range )
+			result.second.append(" [",2U).append(entry->first).append(1U,']') ;
 	}
 	return result ;
 }
@@ -24,6 +24,8 @@
 #include "gdef.h"
 #include "gpath.h"
 #include "gdatetime.h"
+#include "gfile.h"
+#include "gaddresstree.h"
 #include "gstringview.h"
 #include "gsecret.h"
 #include "gexception.h"
@@ -31,6 +33,7 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <iostream>
 #include <utility>
 #include <tuple>
@@ -44,6 +47,16 @@ namespace GAuth
 /// A class to read authentication secrets from file, used by GAuth::Secrets.
 /// Updates to the file are detected automatically.
 ///
+/// Secrets are held in hash maps and the server trust address ranges
+/// are compiled into a GNet::AddressTree so that trust lookups are a
+/// longest-prefix match rather than a search through all the address
+/// wildcards.
+///
+/// When auto-rereading, the file's modification time, size and inode
+/// number are checked at most once a second and any new contents are
+/// read in full before being swapped in. If the file cannot be read
+/// then the previous contents are retained.
+///
 class GAuth::SecretsFile
 {
 public:
@@ -88,27 +101,46 @@ public:
 	std::pair<std::string,std::string> serverTrust( const std::string & address_range ) const ;
 		///< Returns a non-empty trustee name if the server trusts remote
 		///< clients in the given address range, together with context
-		///< information.
+		///< information. If the address range is a simple IP address
+		///< then the most specific matching trust range is used.
 
 	std::string path() const ;
 		///< Returns the file path, as supplied to the ctor.
 
 private:
-	using MapOfSecrets = std::map<std::string,Secret> ;
-	using MapOfInt = std::map<std::string,unsigned int> ;
+	using MapOfSecrets = std::unordered_map<std::string,Secret> ;
+	using MapOfInt = std::unordered_map<std::string,unsigned int> ;
 	using SetOfStrings = std::set<std::string> ;
 	using Diagnostic = std::tuple<bool,unsigned long,std::string> ; // is-error,line-number,text
 	using Diagnostics = std::vector<Diagnostic> ;
-	using TrustMap = std::map<std::string,std::pair<std::string,int>> ;
+	using TrustMap = std::unordered_map<std::string,std::pair<std::string,int>> ;
+	using TrustList = std::vector<const TrustMap::value_type*> ;
 	struct Contents
 	{
+		Contents() = default ;
+		~Contents() = default ;
+		Contents( const Contents & ) = delete ; // trust list points into trust map
+		Contents( Contents && ) = default ;
+		Contents & operator=( const Contents & ) = delete ;
+		Contents & operator=( Contents && ) = default ;
 		MapOfSecrets m_map ;
 		SetOfStrings m_server_types ; // server
 		MapOfInt m_selectors ; // client -- zero integer if only an empty id
 		TrustMap m_trust_map ;
+		TrustList m_trust_list ;
+		GNet::AddressTree m_trust_tree ; // values index into m_trust_list
 		Diagnostics m_diagnostics ;
 		std::size_t m_errors {0U} ;
 	} ;
+	struct FileState
+	{
+		std::time_t m_mtime_s {0} ;
+		unsigned int m_mtime_us {0U} ;
+		unsigned long long m_size {0U} ;
+		unsigned long long m_inode {0U} ;
+		bool operator==( const FileState & other ) const noexcept ;
+		bool operator!=( const FileState & other ) const noexcept ;
+	} ;
 
 private:
 	void read( const G::Path & ) ;
@@ -117,6 +149,7 @@ private:
 	bool containsClientSecretImp( std::string_view , bool ) const ;
 	static Contents readContents( const G::Path & ) ;
 	static Contents readContents( std::istream & ) ;
+	static void compileTrust( Contents & ) ;
 	static void processLine( Contents & ,
 		unsigned int , std::string_view side , std::string_view , std::string_view ,
 		std::string_view , std::string_view ) ;
@@ -128,7 +161,7 @@ private:
 	static std::string serverKey( const std::string & , const std::string & ) ;
 	static std::string serverKey( std::string_view , std::string_view ) ;
 	static std::string clientKey( std::string_view , std::string_view ) ;
-	static G::SystemTime readFileTime( const G::Path & ) ;
+	static FileState readFileState( const G::Path & ) ;
 	static std::string lineContext( unsigned int ) ;
 
 private:
@@ -137,7 +170,7 @@ private:
 	std::string m_debug_name ;
 	bool m_valid ;
 	Contents m_contents ;
-	G::SystemTime m_file_time ;
+	FileState m_file_state ;
 	G::SystemTime m_check_time ;
 } ;
 
@@ -0,0 +1,306 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gdkimfilter.cpp
+///
+
+#include "gdef.h"
+#include "gdkimfilter.h"
+#include "gstr.h"
+#include "gstringtoken.h"
+#include "gbase64.h"
+#include "groot.h"
+#include "gfile.h"
+#include "gdatetime.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <map>
+
+namespace GFilters
+{
+	namespace DkimFilterImp
+	{
+		GSsl::Library & library()
+		{
+			GSsl::Library * p = GSsl::Library::instance() ;
+			if( p == nullptr || !p->enabled() )
+				throw DkimFilter::Error( "no tls library" ) ;
+			return *p ;
+		}
+		bool wsp( char c ) noexcept
+		{
+			return c == ' ' || c == '\t' ;
+		}
+		void appendCollapsed( std::string & out , std::string_view in )
+		{
+			// appends with runs of whitespace reduced to a single space
+			bool space = false ;
+			for( char c : in )
+			{
+				if( c == '\r' || c == '\n' )
+					continue ; // unfold
+				if( wsp(c) )
+				{
+					space = true ;
+				}
+				else
+				{
+					if( space ) out.append( 1U , ' ' ) ;
+					out.append( 1U , c ) ;
+					space = false ;
+				}
+			}
+		}
+		constexpr std::size_t header_limit = 1000U ;
+	}
+}
+
+GFilters::DkimFilter::DkimFilter( GNet::EventState es , GStore::FileStore & store ,
+	Filter::Type filter_type , const Filter::Config & , const std::string & spec ) :
+		SimpleFilterBase(es,filter_type,"dkim:") ,
+		m_store(store)
+{
+	G::StringArray fields = split( spec ) ;
+	if( fields.size() < 3U )
+		throw Error( "invalid specification" , G::Str::printable(spec) ) ;
+	m_domain = fields[0] ;
+	m_selector = fields[1] ;
+	m_key_file = fields[2] ;
+
+	std::string_view names = fields.size() > 3U ? std::string_view(fields[3]) :
+		"from:to:cc:subject:date:message-id:reply-to:in-reply-to:references:"
+		"mime-version:content-type:content-transfer-encoding"_sv ;
+	for( G::StringTokenView t( names , ":" ) ; t ; ++t )
+		m_header_names.push_back( G::Str::lower(G::Str::trimmedView(t(),std::string_view(" \t",2U))) ) ;
+	if( std::find( m_header_names.begin() , m_header_names.end() , "from" ) == m_header_names.end() )
+		m_header_names.insert( m_header_names.begin() , "from" ) ; // RFC-6376 5.4
+}
+
+void GFilters::DkimFilter::load( const std::string & spec )
+{
+	G::StringArray fields = split( spec ) ;
+	if( fields.empty() )
+		throw Error( "invalid specification" , G::Str::printable(spec) ) ;
+	signer( fields[2] ) ;
+}
+
+G::StringArray GFilters::DkimFilter::split( const std::string & spec )
+{
+	G::StringArray fields ;
+	std::string_view spec_sv( spec ) ;
+	for( G::StringTokenView t( spec_sv , ";" ) ; t ; ++t )
+		fields.push_back( G::sv_to_string(t()) ) ;
+	if( fields.size() < 3U || fields.size() > 4U )
+		fields.clear() ;
+	return fields ;
+}
+
+GSmtp::Filter::Result GFilters::DkimFilter::run( const GStore::MessageId & message_id ,
+	bool & , GStore::FileStore::State )
+{
+	std::string e = process( m_store.contentPath(message_id) ) ;
+	if( !e.empty() )
+		throw Error( e ) ;
+	return Result::ok ;
+}
+
+std::string GFilters::DkimFilter::process( const G::Path & path_in ) const
+{
+	namespace imp = DkimFilterImp ;
+	std::ifstream in ;
+	{
+		G::Root claim_root ;
+		G::File::open( in , path_in ) ;
+	}
+	if( !in.good() )
+		return "open error" ;
+
+	// read the header fields, unfolding continuation lines
+	std::vector<Header> headers ;
+	bool have_body = false ;
+	std::string line ;
+	while( std::getline( in , line ) )
+	{
+		if( !line.empty() && line.back() == '\r' )
+			line.pop_back() ;
+		if( line.empty() )
+		{
+			have_body = true ;
+			break ;
+		}
+		else if( imp::wsp(line[0]) && !headers.empty() )
+			headers.back().second.append("\r\n",2U).append( line ) ;
+		else if( line.find(':') == std::string::npos || headers.size() >= imp::header_limit )
+			return "format error" ;
+		else
+			headers.emplace_back( G::Str::lower(G::Str::trimmedView(G::Str::headView(line,":"),std::string_view(" \t",2U))) , line ) ;
+	}
+	if( !have_body )
+		return "format error" ; // eg. no empty line
+
+	// hash the canonicalised body, deferring empty lines so that
+	// any trailing ones are ignored
+	GSsl::Digester body_digester = imp::library().digester( "SHA256" ) ;
+	std::size_t empty_lines = 0U ;
+	while( std::getline( in , line ) )
+	{
+		if( !line.empty() && line.back() == '\r' )
+			line.pop_back() ;
+		std::string body_line = canonicalBodyLine( line ) ;
+		if( body_line.empty() )
+		{
+			empty_lines++ ;
+		}
+		else
+		{
+			for( ; empty_lines ; empty_lines-- )
+				body_digester.add( "\r\n" ) ;
+			body_line.append( "\r\n" , 2U ) ;
+			body_digester.add( body_line ) ;
+		}
+	}
+	if( !in.eof() )
+		return "read error" ;
+
+	std::string header = signature( headers , body_digester.value() ) ;
+	if( header.empty() )
+		return "no from header" ;
+
+	// prepend the new header
+	G::Path path_out = path_in.str().append(".tmp") ;
+	std::ofstream out ;
+	{
+		G::Root claim_root ;
+		G::File::open( out , path_out ) ;
+	}
+	if( !out.good() )
+		return "create error" ;
+
+	out << header << "\r\n" ;
+	in.clear() ;
+	in.seekg( 0 ) ;
+	G::File::copy( in , out ) ;
+
+	in.close() ;
+	out.close() ;
+	if( !in.eof() )
+		return "read error" ;
+	if( out.fail() )
+		return "write error" ;
+
+	bool ok = false ;
+	{
+		G::Root claim_root ;
+		ok = G::File::renameOnto( path_out , path_in , std::nothrow ) ;
+	}
+	if( !ok )
+		return "rename error" ;
+	return {} ;
+}
+
+std::string GFilters::DkimFilter::signature( const std::vector<Header> & headers , const std::string & body_hash ) const
+{
+	GSsl::Signer key = signer( m_key_file ) ;
+	GSsl::Digester digester = DkimFilterImp::library().digester( "SHA256" ) ;
+
+	// sign the last instance of each named header field, working
+	// upwards for repeated names (RFC-6376 5.4.2)
+	std::vector<bool> used( headers.size() ) ;
+	std::string h ;
+	bool have_from = false ;
+	for( const auto & name : m_header_names )
+	{
+		for( std::size_t i = headers.size() ; i > 0U ; i-- )
+		{
+			if( !used[i-1U] && headers[i-1U].first == name )
+			{
+				used[i-1U] = true ;
+				have_from = have_from || name == "from" ;
+				h.append(h.empty()?0U:1U,':').append( name ) ;
+				digester.add( canonicalHeader(headers[i-1U].second).append("\r\n",2U) ) ;
+				break ;
+			}
+		}
+	}
+	if( !have_from )
+		return {} ;
+
+	std::ostringstream ss ;
+	ss << "DKIM-Signature: v=1; a=" << (key.algorithm()=="ed25519"?"ed25519-sha256":"rsa-sha256")
+		<< "; c=relaxed/relaxed;\r\n\td=" << m_domain << "; s=" << m_selector
+		<< "; t=" << G::SystemTime::now().s() << ";\r\n\th=" << h
+		<< ";\r\n\tbh=" << G::Base64::encode(body_hash)
+		<< ";\r\n\tb=" ;
+	std::string header = ss.str() ;
+
+	// the signature header itself is hashed with an empty "b=" tag
+	// and without its trailing CRLF
+	digester.add( canonicalHeader(header) ) ;
+	return header.append( fold( G::Base64::encode(key.sign(digester.value(),"SHA256")) , 72U ) ) ;
+}
+
+GSsl::Signer GFilters::DkimFilter::signer( const std::string & key_file )
+{
+	// one signer per key file, shared by all threads -- signing does
+	// not modify the key and unit threads are only used if the tls
+	// library is thread-safe
+	static G::threading::mutex_type mutex ;
+	static std::map<std::string,GSsl::Signer> signers ;
+	G::threading::lock_type lock( mutex ) ;
+	auto p = signers.find( key_file ) ;
+	if( p == signers.end() )
+		p = signers.emplace( key_file , DkimFilterImp::library().signer(key_file) ).first ;
+	return p->second ;
+}
+
+std::string GFilters::DkimFilter::canonicalHeader( std::string_view field )
+{
+	// relaxed header canonicalisation (RFC-6376 3.4.2)
+	std::size_t colon = field.find( ':' ) ;
+	std::string_view name = G::Str::trimRightView( field.substr(0U,colon) , std::string_view(" \t",2U) ) ;
+	std::string result = G::Str::lower( name ) ;
+	result.append( 1U , ':' ) ;
+	std::string value ;
+	DkimFilterImp::appendCollapsed( value , field.substr(colon+1U) ) ;
+	if( !value.empty() && value[0] == ' ' )
+		value.erase( 0U , 1U ) ;
+	return result.append( value ) ;
+}
+
+std::string GFilters::DkimFilter::canonicalBodyLine( std::string_view line )
+{
+	// relaxed body canonicalisation (RFC-6376 3.4.4)
+	std::string result ;
+	result.reserve( line.size() ) ;
+	DkimFilterImp::appendCollapsed( result , line ) ;
+	if( !result.empty() && result.back() == ' ' )
+		result.pop_back() ;
+	return result ;
+}
+
+std::string GFilters::DkimFilter::fold( std::string_view s , std::size_t width )
+{
+	std::string result ;
+	for( std::size_t pos = 0U ; pos < s.size() ; pos += width )
+	{
+		if( pos )
+			result.append( "\r\n\t" , 3U ) ;
+		result.append( s.substr(pos,width) ) ;
+	}
+	return result ;
+}
@@ -0,0 +1,95 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gdkimfilter.h
+///
+
+#ifndef G_DKIM_FILTER_H
+#define G_DKIM_FILTER_H
+
+#include "gdef.h"
+#include "gsimplefilterbase.h"
+#include "gfilestore.h"
+#include "gstringview.h"
+#include "gstringarray.h"
+#include "gexception.h"
+#include "gssl.h"
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace GFilters
+{
+	class DkimFilter ;
+}
+
+//| \class GFilters::DkimFilter
+/// A filter that adds a RFC-6376 DKIM-Signature header to the message
+/// content, signing with the TLS library's GSsl::Signer. Uses
+/// "relaxed/relaxed" canonicalisation with "rsa-sha256" or
+/// "ed25519-sha256" (RFC-8463) depending on the key type.
+///
+/// The filter specification is "<domain>;<selector>;<key-file>" with
+/// an optional fourth field giving a colon-separated list of header
+/// field names to sign. Each private key is loaded from its PEM file
+/// once, normally at startup by load(), and the resulting signer is
+/// shared by all filter instances on all threads.
+///
+/// The content file is read in a single pass, with the header lines
+/// held in memory and the canonicalised body fed straight into the
+/// body hash. The new header is then prepended using a temporary
+/// file, as with GFilters::MessageIdFilter.
+///
+class GFilters::DkimFilter : public SimpleFilterBase
+{
+public:
+	G_EXCEPTION( Error , tx("dkim signing failed") )
+
+	DkimFilter( GNet::EventState , GStore::FileStore & ,
+		Filter::Type , const Filter::Config & , const std::string & spec ) ;
+			///< Constructor.
+
+	static G::StringArray split( const std::string & spec ) ;
+		///< Splits the filter specification into its fields. Returns
+		///< an empty list if invalid.
+
+	static void load( const std::string & spec ) ;
+		///< Loads and validates the private key named in the filter
+		///< specification, throwing on error. Used at startup so that
+		///< a bad key file is reported early.
+
+private: // overrides
+	Result run( const GStore::MessageId & , bool & , GStore::FileStore::State ) override ;
+
+private:
+	using Header = std::pair<std::string,std::string> ; // name, raw header field
+	std::string process( const G::Path & ) const ;
+	std::string signature( const std::vector<Header> & , const std::string & body_hash ) const ;
+	static GSsl::Signer signer( const std::string & key_file ) ;
+	static std::string canonicalHeader( std::string_view ) ;
+	static std::string canonicalBodyLine( std::string_view ) ;
+	static std::string fold( std::string_view , std::size_t ) ;
+
+private:
+	GStore::FileStore & m_store ;
+	std::string m_domain ;
+	std::string m_selector ;
+	std::string m_key_file ;
+	G::StringArray m_header_names ;
+} ;
+
+#endif
@@ -22,14 +22,17 @@
 #include "gfilterfactory.h"
 #include "gstringtoken.h"
 #include "gfilterchain.h"
+#include "gfiltergroup.h"
 #include "gfilestore.h"
 #include "gnullfilter.h"
 #include "gfile.h"
 #include "gnetworkfilter.h"
 #include "gexecutablefilter.h"
 #include "gspamfilter.h"
+#include "gspampool.h"
 #include "gdeliveryfilter.h"
 #include "gmessageidfilter.h"
+#include "gdkimfilter.h"
 #include "gcopyfilter.h"
 #include "gmxfilter.h"
 #include "gsplitfilter.h"
@@ -58,6 +61,19 @@ GFilters::FilterFactory::Spec GFilters::FilterFactory::parse( std::string_view s
 		for( G::StringTokenView t( spec_in , "," ) ; t ; ++t )
 			result += parse( t() , base_dir , app_dir , warnings_p ) ; // one level of recursion
 	}
+	else if( spec_in.find('&') != std::string::npos )
+	{
+		result = Spec( "group" , "" ) ;
+		for( G::StringTokenView t( spec_in , "&" ) ; t && !result.first.empty() ; ++t )
+		{
+			Spec branch = parse( t() , base_dir , app_dir , warnings_p ) ; // one more level of recursion
+			checkGroup( branch ) ;
+			if( branch.first.empty() )
+				result = branch ;
+			else
+				result.second.append(result.second.empty()?0U:1U,'&').append(branch.first).append(1U,':').append(branch.second) ;
+		}
+	}
 	else if( G::Str::headMatch( spec_in ,"exit:" ) )
 	{
 		result = Spec( "exit" , tail ) ;
@@ -76,12 +92,12 @@ GFilters::FilterFactory::Spec GFilters::FilterFactory::parse( std::string_view s
 	else if( G::Str::headMatch( spec_in , "spam:" ) )
 	{
 		result = Spec( "spam" , tail ) ;
-		checkNet( result ) ;
+		checkSpam( result ) ;
 	}
 	else if( G::Str::headMatch( spec_in , "spam-edit:" ) )
 	{
 		result = Spec( "spam-edit" , tail ) ;
-		checkNet( result ) ;
+		checkSpam( result ) ;
 	}
 	else if( G::Str::headMatch( spec_in , "deliver:" ) )
 	{
@@ -104,6 +120,11 @@ GFilters::FilterFactory::Spec GFilters::FilterFactory::parse( std::string_view s
 	{
 		result = Spec( "msgid" , tail ) ;
 	}
+	else if( G::Str::headMatch( spec_in , "dkim:" ) )
+	{
+		result = Spec( "dkim" , tail ) ;
+		checkDkim( result , base_dir , app_dir , warnings_p ) ;
+	}
 	else if( G::Str::headMatch( spec_in , "file:" ) )
 	{
 		result = Spec( "file" , tail ) ;
@@ -119,6 +140,19 @@ GFilters::FilterFactory::Spec GFilters::FilterFactory::parse( std::string_view s
 	return result ;
 }
 
+void GFilters::FilterFactory::load( const Spec & spec )
+{
+	if( spec.first == "chain" )
+	{
+		for( G::StringToken t( spec.second , "," ) ; t ; ++t )
+			load( Spec( G::Str::head(t(),":",false) , G::Str::tail(t(),":") ) ) ;
+	}
+	else if( spec.first == "dkim" )
+	{
+		DkimFilter::load( spec.second ) ;
+	}
+}
+
 std::unique_ptr<GSmtp::Filter> GFilters::FilterFactory::newFilter( GNet::EventState es ,
 	GSmtp::Filter::Type filter_type , const GSmtp::Filter::Config & filter_config ,
 	const FilterFactory::Spec & spec )
@@ -128,6 +162,11 @@ std::unique_ptr<GSmtp::Filter> GFilters::FilterFactory::newFilter( GNet::EventSt
 		// (one level of recursion -- FilterChain::ctor calls newFilter())
 		return std::make_unique<FilterChain>( es , *this , filter_type , filter_config , spec ) ;
 	}
+	else if( spec.first == "group" )
+	{
+		// (one level of recursion -- FilterGroup::ctor calls newFilter())
+		return std::make_unique<FilterGroup>( es , *this , filter_type , filter_config , spec ) ;
+	}
 	else if( spec.first == "spam" )
 	{
 		// "spam:" is read-only, not-always-pass
@@ -174,6 +213,10 @@ std::unique_ptr<GSmtp::Filter> GFilters::FilterFactory::newFilter( GNet::EventSt
 	{
 		return std::make_unique<MessageIdFilter>( es , m_file_store , filter_type , filter_config , spec.second ) ;
 	}
+	else if( spec.first == "dkim" )
+	{
+		return std::make_unique<DkimFilter>( es , m_file_store , filter_type , filter_config , spec.second ) ;
+	}
 	else
 	{
 		throw G::Exception( "invalid filter" , spec.second ) ;
@@ -199,6 +242,20 @@ void GFilters::FilterFactory::checkNumber( Spec & result )
 	}
 }
 
+void GFilters::FilterFactory::checkGroup( Spec & result )
+{
+	// only filters that are not expected to edit, move or delete the
+	// message files can run in parallel -- network filters are allowed
+	// because they are typically read-only scanners, but external
+	// programs are allowed to do all of those things
+	if( !result.first.empty() &&
+		result.first != "spam" && result.first != "net" && result.first != "exit" && result.first != "sleep" )
+	{
+		result.second = "invalid filter in parallel group: " + G::Str::printable(result.first) ;
+		result.first.clear() ;
+	}
+}
+
 void GFilters::FilterFactory::checkNet( Spec & result )
 {
 	try
@@ -212,6 +269,24 @@ void GFilters::FilterFactory::checkNet( Spec & result )
 	}
 }
 
+void GFilters::FilterFactory::checkSpam( Spec & result )
+{
+	// allow a semi-colon-separated list of spamd servers
+	G::StringArray servers = SpamPool::split( result.second ) ;
+	if( servers.empty() )
+		servers.push_back( result.second ) ;
+	for( const auto & server : servers )
+	{
+		Spec server_spec( result.first , server ) ;
+		checkNet( server_spec ) ;
+		if( server_spec.first.empty() )
+		{
+			result = server_spec ;
+			break ;
+		}
+	}
+}
+
 void GFilters::FilterFactory::checkRange( Spec & result )
 {
 	try
@@ -225,6 +300,27 @@ void GFilters::FilterFactory::checkRange( Spec & result )
 	}
 }
 
+void GFilters::FilterFactory::checkDkim( Spec & result ,
+	const G::Path & base_dir , const G::Path & app_dir , G::StringArray * warnings_p )
+{
+	// "<domain>;<selector>;<key-file>[;<header>:<header>...]"
+	G::StringArray fields = DkimFilter::split( result.second ) ;
+	if( fields.empty() )
+	{
+		result.second = "invalid dkim filter: expecting <domain>;<selector>;<key-file>" ;
+		result.first.clear() ;
+		return ;
+	}
+
+	Spec key_spec( result.first , fields[2] ) ;
+	fixFile( key_spec , base_dir , app_dir ) ;
+	fields[2] = key_spec.second ;
+	result.second = G::Str::join( ";" , fields ) ;
+
+	if( warnings_p && !G::File::exists(fields[2]) )
+		warnings_p->push_back( std::string("dkim key file does not exist: ").append(fields[2]) ) ;
+}
+
 void GFilters::FilterFactory::fixFile( Spec & result ,
 	const G::Path & base_dir , const G::Path & app_dir )
 {
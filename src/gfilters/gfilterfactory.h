@@ -59,6 +59,12 @@ public:
 			///< the component parts checked separately and the returned Spec
 			///< is like ("chain","file:foo,net:bar").
 			///<
+			///< List items can be groups of filters separated by ampersands
+			///< and these are run in parallel, with a Spec like
+			///< ("group","spam:127.0.0.1:783&spam:127.0.0.1:784"). Only the
+			///< "spam", "net", "exit" and "sleep" filters can be grouped,
+			///< and grouped "net" filters must not change the message files.
+			///<
 			///< Any relative file paths are made absolute using the given
 			///< base directory, if given. (This is normally from
 			///< G::Process::cwd() called at startup).
@@ -72,6 +78,12 @@ public:
 			///< Returns warnings by reference for non-fatal errors, such
 			///< as missing files.
 
+	static void load( const Spec & ) ;
+		///< Loads and validates any resources needed by the filters
+		///< in the given specification, such as DKIM signing keys,
+		///< throwing on error. This should be called at startup, after
+		///< the TLS library is initialised.
+
 public:
 	~FilterFactory() override = default ;
 	FilterFactory( const FilterFactory & ) = delete ;
@@ -86,9 +98,12 @@ protected: // overrides
 
 private:
 	static void checkNumber( Spec & ) ;
+	static void checkGroup( Spec & ) ;
 	static void checkNet( Spec & ) ;
+	static void checkSpam( Spec & ) ;
 	static void checkRange( Spec & ) ;
 	static void checkFile( Spec & , G::StringArray * ) ;
+	static void checkDkim( Spec & , const G::Path & , const G::Path & , G::StringArray * ) ;
 	static void fixFile( Spec & , const G::Path & , const G::Path & ) ;
 
 private:
@@ -0,0 +1,178 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gfiltergroup.cpp
+///
+
+#include "gdef.h"
+#include "gfiltergroup.h"
+#include "gslot.h"
+#include "gstringtoken.h"
+#include "gstr.h"
+#include "glog.h"
+#include "gassert.h"
+#include <algorithm>
+
+GFilters::FilterGroup::FilterGroup( GNet::EventState es , GSmtp::FilterFactoryBase & ff ,
+	Filter::Type filter_type , const Filter::Config & filter_config ,
+	const GSmtp::FilterFactoryBase::Spec & spec )
+{
+	using Spec = GSmtp::FilterFactoryBase::Spec ;
+	G_ASSERT( spec.first == "group" ) ;
+	for( G::StringToken t( spec.second , "&" ) ; t ; ++t )
+	{
+		std::string first = G::Str::head( t() , ":" , false ) ;
+		std::string second = G::Str::tail( t() , ":" ) ;
+		add( es , ff , filter_type , filter_config , Spec(first,second) ) ;
+	}
+
+	if( m_branches.empty() )
+		add( es , ff , filter_type , filter_config , {"exit","0"} ) ;
+}
+
+void GFilters::FilterGroup::add( GNet::EventState es , GSmtp::FilterFactoryBase & ff ,
+	Filter::Type filter_type , const Filter::Config & filter_config ,
+	const GSmtp::FilterFactoryBase::Spec & spec )
+{
+	Branch branch ;
+	branch.m_group = this ;
+	branch.m_index = m_branches.size() ;
+	branch.m_filter = ff.newFilter( es , filter_type , filter_config , spec ) ;
+	m_filter_id.append(m_filter_id.empty()?0U:1U,'&').append( branch.m_filter->id() ) ;
+	m_branches.push_back( std::move(branch) ) ;
+}
+
+GFilters::FilterGroup::~FilterGroup()
+{
+	for( auto & branch : m_branches )
+		branch.m_filter->doneSignal().disconnect() ;
+}
+
+std::string GFilters::FilterGroup::id() const
+{
+	return m_filter_id ;
+}
+
+bool GFilters::FilterGroup::quiet() const
+{
+	return std::all_of( m_branches.begin() , m_branches.end() ,
+		[](const Branch & branch){ return branch.m_filter->quiet() ; } ) ;
+}
+
+G::Slot::Signal<int> & GFilters::FilterGroup::doneSignal() noexcept
+{
+	return m_done_signal ;
+}
+
+void GFilters::FilterGroup::start( const GStore::MessageId & id )
+{
+	stop() ;
+	m_running = true ;
+	m_pending = m_branches.size() ;
+	m_result_index = 0U ;
+	for( auto & branch : m_branches )
+		branch.m_done = false ;
+
+	// start all the sub-filters together -- any one of them might
+	// complete synchronously, which might end the whole group
+	for( auto & branch : m_branches )
+	{
+		if( !m_running )
+			break ;
+		branch.m_running = true ;
+		branch.m_filter->doneSignal().connect( G::Slot::slot(branch,&Branch::onFilterDone) ) ;
+		branch.m_filter->start( id ) ;
+	}
+}
+
+void GFilters::FilterGroup::Branch::onFilterDone( int ok_abandon_fail )
+{
+	m_group->onFilterDone( m_index , ok_abandon_fail ) ;
+}
+
+void GFilters::FilterGroup::onFilterDone( std::size_t index , int ok_abandon_fail )
+{
+	Branch & branch = m_branches.at( index ) ;
+	branch.m_filter->doneSignal().disconnect() ;
+	branch.m_running = false ;
+	branch.m_done = true ;
+	m_result_index = index ;
+	G_ASSERT( m_pending != 0U ) ;
+	m_pending-- ;
+
+	if( ok_abandon_fail == 0 ) // ok
+	{
+		if( m_pending == 0U )
+		{
+			m_running = false ;
+			m_done_signal.emit( 0 ) ;
+		}
+	}
+	else // abandon/fail -- fail fast
+	{
+		G_DEBUG( "GFilters::FilterGroup::onFilterDone: [" << branch.m_filter->id() << "] cancelling remaining filters" ) ;
+		stop() ;
+		m_done_signal.emit( ok_abandon_fail ) ;
+	}
+}
+
+void GFilters::FilterGroup::cancel()
+{
+	stop() ;
+}
+
+void GFilters::FilterGroup::stop()
+{
+	for( auto & branch : m_branches )
+	{
+		if( branch.m_running )
+		{
+			branch.m_filter->cancel() ;
+			branch.m_filter->doneSignal().disconnect() ;
+			branch.m_running = false ;
+		}
+	}
+	m_pending = 0U ;
+	m_running = false ;
+}
+
+GSmtp::Filter::Result GFilters::FilterGroup::result() const
+{
+	return m_branches.at(m_result_index).m_filter->result() ;
+}
+
+std::string GFilters::FilterGroup::response() const
+{
+	return m_branches.at(m_result_index).m_filter->response() ;
+}
+
+int GFilters::FilterGroup::responseCode() const
+{
+	return m_branches.at(m_result_index).m_filter->responseCode() ;
+}
+
+std::string GFilters::FilterGroup::reason() const
+{
+	return m_branches.at(m_result_index).m_filter->reason() ;
+}
+
+bool GFilters::FilterGroup::special() const
+{
+	return std::any_of( m_branches.begin() , m_branches.end() ,
+		[](const Branch & branch){ return branch.m_done && branch.m_filter->special() ; } ) ;
+}
+
@@ -0,0 +1,100 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gfiltergroup.h
+///
+
+#ifndef G_FILTER_GROUP_H
+#define G_FILTER_GROUP_H
+
+#include "gdef.h"
+#include "gfilter.h"
+#include "gfilterfactory.h"
+#include "gslot.h"
+#include "geventstate.h"
+#include <memory>
+#include <vector>
+
+namespace GFilters
+{
+	class FilterGroup ;
+}
+
+//| \class GFilters::FilterGroup
+/// A Filter class that runs a group of read-only sub-filters in parallel.
+/// Network sub-filters are trusted not to change the message files.
+/// The group completes as soon as any sub-filter returns something other
+/// than success, with the remaining sub-filters being cancelled, or
+/// when all of them have succeeded.
+///
+/// The filter specification is like ("group","spam:127.0.0.1:783&spam:127.0.0.1:784").
+///
+class GFilters::FilterGroup : public GSmtp::Filter
+{
+public:
+	FilterGroup( GNet::EventState , GSmtp::FilterFactoryBase & , Filter::Type ,
+		const Filter::Config & , const GSmtp::FilterFactoryBase::Spec & spec ) ;
+			///< Constructor.
+
+	~FilterGroup() override ;
+		///< Destructor.
+
+public:
+	FilterGroup( const FilterGroup & ) = delete ;
+	FilterGroup( FilterGroup && ) = delete ;
+	FilterGroup & operator=( const FilterGroup & ) = delete ;
+	FilterGroup & operator=( FilterGroup && ) = delete ;
+
+private: // overrides
+	std::string id() const override ; // GSmtp::Filter
+	bool quiet() const override ; // GSmtp::Filter
+	G::Slot::Signal<int> & doneSignal() noexcept override ; // GSmtp::Filter
+	void start( const GStore::MessageId & ) override ; // GSmtp::Filter
+	void cancel() override ; // GSmtp::Filter
+	Result result() const override ; // GSmtp::Filter
+	std::string response() const override ; // GSmtp::Filter
+	int responseCode() const override ; // GSmtp::Filter
+	std::string reason() const override ; // GSmtp::Filter
+	bool special() const override ; // GSmtp::Filter
+
+private:
+	struct Branch /// A sub-filter and its completion state.
+	{
+		FilterGroup * m_group {nullptr} ;
+		std::size_t m_index {0U} ;
+		std::unique_ptr<GSmtp::Filter> m_filter ;
+		bool m_running {false} ;
+		bool m_done {false} ;
+		void onFilterDone( int ok_abandon_fail ) ;
+	} ;
+
+private:
+	void add( GNet::EventState , GSmtp::FilterFactoryBase & , Filter::Type ,
+		const Filter::Config & , const GSmtp::FilterFactoryBase::Spec & ) ;
+	void onFilterDone( std::size_t , int ) ;
+	void stop() ;
+
+private:
+	G::Slot::Signal<int> m_done_signal ;
+	std::string m_filter_id ;
+	std::vector<Branch> m_branches ;
+	std::size_t m_pending {0U} ;
+	std::size_t m_result_index {0U} ;
+	bool m_running {false} ;
+} ;
+
+#endif
@@ -26,6 +26,7 @@
 #include "gfile.h"
 #include "gdatetime.h"
 #include "gprocess.h"
+#include <atomic>
 #include <fstream>
 #include <sstream>
 
@@ -48,6 +49,14 @@ GSmtp::Filter::Result GFilters::MessageIdFilter::run( const GStore::MessageId &
 
 std::string GFilters::MessageIdFilter::process( const G::Path & path_in , const std::string & domain )
 {
+	G::MappedFile mapped ;
+	{
+		G::Root claim_root ;
+		mapped.map( path_in ) ;
+	}
+	if( mapped.mapped() )
+		return process( mapped , path_in , domain ) ;
+
 	std::ifstream in ;
 	{
 		G::Root claim_root ;
@@ -100,6 +109,57 @@ std::string GFilters::MessageIdFilter::process( const G::Path & path_in , const
 	return {} ;
 }
 
+std::string GFilters::MessageIdFilter::process( G::MappedFile & mapped , const G::Path & path_in ,
+	const std::string & domain )
+{
+	// as above, but scanning the headers in place and writing the new
+	// file from the mapped content in one go
+	std::string_view content = mapped.view() ;
+	bool have_id = false ;
+	{
+		static constexpr std::size_t line_limit = 10000U ;
+		for( std::size_t pos = 0U ; !have_id ; )
+		{
+			std::size_t eol = content.find( '\n' , pos ) ;
+			if( eol == std::string::npos || (eol-pos) >= line_limit )
+				return "format error" ; // eg. no empty line, line too long
+			std::string_view line = content.substr( pos , eol-pos ) ;
+			if( line.size() <= 1U )
+				break ;
+			have_id = isId( line ) ;
+			pos = eol + 1U ;
+		}
+	}
+
+	if( !have_id )
+	{
+		G::Path path_out = path_in.str().append(".tmp") ;
+		std::ofstream out ;
+		{
+			G::Root claim_root ;
+			G::File::open( out , path_out ) ;
+		}
+		if( !out.good() )
+			return "create error" ;
+
+		out << "Message-ID: " << newId(domain) << "\r\n" ;
+		out.write( content.data() , static_cast<std::streamsize>(content.size()) ) ;
+		out.close() ;
+		mapped.unmap() ; // before renaming
+		if( out.fail() )
+			return "write error" ;
+
+		bool ok = false ;
+		{
+			G::Root claim_root ;
+			ok = G::File::renameOnto( path_out , path_in , std::nothrow ) ;
+		}
+		if( !ok )
+			return "rename error" ;
+	}
+	return {} ;
+}
+
 bool GFilters::MessageIdFilter::isId( std::string_view line ) noexcept
 {
 	return line.find(':') != std::string::npos && G::sv_imatch( G::sv_substr_noexcept(line,0U,line.find(':')) , "message-id" ) ;
@@ -109,7 +169,7 @@ std::string GFilters::MessageIdFilter::newId( const std::string & domain )
 {
 	std::ostringstream ss ;
 	G::SystemTime now = G::SystemTime::now() ;
-	static int generator = 0 ;
+	static std::atomic<int> generator {0} ;
 	ss << "<"
 		<< now.s() << "." << now.us() << "."
 		<< G::Process::Id().str() << "." << generator++
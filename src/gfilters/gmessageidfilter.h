@@ -24,6 +24,7 @@
 #include "gdef.h"
 #include "gsimplefilterbase.h"
 #include "gfilestore.h"
+#include "gmappedfile.h"
 #include "gstringview.h"
 #include "gexception.h"
 
@@ -53,6 +54,7 @@ private: // overrides
 	Result run( const GStore::MessageId & , bool & , GStore::FileStore::State ) override ;
 
 private:
+	static std::string process( G::MappedFile & , const G::Path & , const std::string & domain ) ;
 	static bool isId( std::string_view ) noexcept ;
 	static std::string newId( const std::string & ) ;
 
@@ -60,35 +60,23 @@ GFilters::MxLookup::MxLookup( GNet::EventState es , Config config ,
 		m_ns_failures(0U) ,
 		m_nameservers(nameservers) ,
 		m_timer(*this,&MxLookup::onTimeout,es) ,
-		m_handler4(this,&MxLookup::readHandler4) ,
-		m_handler6(this,&MxLookup::readHandler6)
+		m_dns(GNet::DnsClient::instance())
 {
 	if( m_nameservers.empty() )
 	{
 		m_nameservers.push_back( GNet::Address::loopback( GNet::Address::Family::ipv4 , 53U ) ) ;
 		m_nameservers.push_back( GNet::Address::loopback( GNet::Address::Family::ipv6 , 53U ) ) ;
 	}
+}
 
-	bool ipv4 = std::find_if( m_nameservers.begin() , m_nameservers.end() ,
-		[](const GNet::Address &a_){return a_.is4();} ) != m_nameservers.end() ;
-	if( ipv4 )
-		m_socket4 = std::make_unique<GNet::DatagramSocket>( GNet::Address::Family::ipv4 , 0 , GNet::DatagramSocket::Config() ) ;
-
-	bool ipv6 = std::find_if( m_nameservers.begin() , m_nameservers.end() ,
-		[](const GNet::Address &a_){return a_.is6();} ) != m_nameservers.end() ;
-	if( ipv6 )
-	{
-		m_socket6 = std::make_unique<GNet::DatagramSocket>( GNet::Address::Family::ipv6 , 0 , GNet::DatagramSocket::Config() ) ;
-	}
+GFilters::MxLookup::~MxLookup()
+{
+	m_dns->cancel( *this ) ;
 }
 
 void GFilters::MxLookup::start( const GStore::MessageId & message_id , const std::string & forward_to , unsigned int port )
 {
-	if( !m_socket4 && !m_socket6 )
-	{
-		fail( "no nameserver" ) ;
-	}
-	else if( forward_to.empty() )
+	if( forward_to.empty() )
 	{
 		fail( "invalid empty doman" ) ;
 	}
@@ -100,45 +88,23 @@ void GFilters::MxLookup::start( const GStore::MessageId & message_id , const std
 		m_ns_failures = 0U ;
 		m_error.clear() ;
 		m_question = forward_to ;
-		addReadHandlers() ;
 		sendMxQuestion( m_ns_index , m_question ) ;
 		startTimer() ;
 	}
 }
 
-void GFilters::MxLookup::readHandler4()
+void GFilters::MxLookup::onDnsResponse( unsigned int tag , const GNet::DnsMessage & response )
 {
-	G_ASSERT( m_socket4.get() != nullptr ) ;
-	if( m_socket4 )
-		readHandler( *m_socket4 ) ;
+	G_DEBUG( "GFilters::MxLookup::onDnsResponse: dns message size " << response.n() ) ;
+	if( tag && tag < (m_nameservers.size()+1U) )
+		process( static_cast<std::size_t>(tag) - 1U , response ) ;
 }
 
-void GFilters::MxLookup::readHandler6()
+void GFilters::MxLookup::process( std::size_t ns_index , const GNet::DnsMessage & response )
 {
-	G_ASSERT( m_socket6.get() != nullptr ) ;
-	if( m_socket6 )
-		readHandler( *m_socket6 ) ;
-}
-
-void GFilters::MxLookup::readHandler( GNet::DatagramSocket & socket )
-{
-	G_DEBUG( "GFilters::MxLookup::readHandler" ) ;
-	std::vector<char> buffer( 4096U ) ; // 512 in RFC-1035 4.2.1
-	ssize_t nread = socket.read( buffer.data() , buffer.size() ) ;
-	if( nread > 0 )
-		process( buffer.data() , static_cast<std::size_t>(nread) ) ;
-	else
-		fail( "dns socket error: " + socket.reason() ) ;
-}
-
-void GFilters::MxLookup::process( const char * p , std::size_t n )
-{
-	G_DEBUG( "GFilters::MxLookup::process: dns message size " << n ) ;
 	using namespace MxLookupImp ;
-	GNet::DnsMessage response( p , n ) ;
-	if( response.valid() && response.QR() && response.ID() && response.ID() < (m_nameservers.size()+1U) )
+	if( response.valid() && response.QR() )
 	{
-		std::size_t ns_index = static_cast<std::size_t>(response.ID()) - 1U ;
 		auto pair = parse( response , m_nameservers.at(ns_index) , m_port ) ;
 		if( pair.first == Result::error && (m_ns_failures+1U) < m_nameservers.size() )
 			disable( ns_index , pair.second ) ;
@@ -236,9 +202,8 @@ void GFilters::MxLookup::sendMxQuestion( std::size_t ns_index , const std::strin
 		G_LOG_MORE( "GFilters::MxLookup::sendMxQuestion: mx: question: mx [" << mx_question << "] "
 			<< "to " << m_nameservers[ns_index].hostPartString()
 			<< (m_nameservers[ns_index].port()==53U?"":(" port "+G::Str::fromUInt(m_nameservers[ns_index].port()))) ) ;
-		unsigned int id = static_cast<unsigned int>(ns_index) + 1U ;
-		GNet::DnsMessageRequest request( "MX" , mx_question , id ) ;
-		socket(ns_index).writeto( request.p() , request.n() , m_nameservers[ns_index] ) ;
+		unsigned int tag = static_cast<unsigned int>(ns_index) + 1U ;
+		m_dns->query( *this , m_es , tag , "MX" , mx_question , m_nameservers[ns_index] ) ;
 	}
 }
 
@@ -248,38 +213,21 @@ void GFilters::MxLookup::sendHostQuestion( std::size_t ns_index , const std::str
 	{
 		G_LOG_MORE( "GFilters::MxLookup::sendHostQuestion: mx: question: host-ip [" << host_question << "] "
 			<< "to " << m_nameservers[ns_index].hostPartString() ) ;
-		unsigned int id = static_cast<unsigned int>(ns_index) + 1U ;
-		GNet::DnsMessageRequest request( "A" , host_question , id ) ;
-		socket(ns_index).writeto( request.p() , request.n() , m_nameservers[ns_index] ) ;
+		unsigned int tag = static_cast<unsigned int>(ns_index) + 1U ;
+		m_dns->query( *this , m_es , tag , "A" , host_question , m_nameservers[ns_index] ) ;
 	}
 }
 
 void GFilters::MxLookup::cancel()
 {
-	dropReadHandlers() ;
+	m_dns->cancel( *this ) ;
 	m_timer.cancelTimer() ;
 }
 
-void GFilters::MxLookup::addReadHandlers()
-{
-	if( m_socket6 )
-		m_socket6->addReadHandler( m_handler6 , m_es ) ;
-	if( m_socket4 )
-		m_socket4->addReadHandler( m_handler4 , m_es ) ;
-}
-
-void GFilters::MxLookup::dropReadHandlers()
-{
-	if( m_socket4 )
-		m_socket4->dropReadHandler() ;
-	if( m_socket6 )
-		m_socket6->dropReadHandler() ;
-}
-
 void GFilters::MxLookup::fail( const std::string & error )
 {
 	m_error = "mx: " + error ;
-	dropReadHandlers() ;
+	m_dns->cancel( *this ) ;
 	m_timer.startTimer( 0U ) ;
 }
 
@@ -314,30 +262,11 @@ void GFilters::MxLookup::succeed( const std::string & result )
 	m_done_signal.emit( m_message_id , result , "" ) ;
 }
 
-GNet::DatagramSocket & GFilters::MxLookup::socket( std::size_t ns_index )
-{
-	return m_nameservers.at(ns_index).is4() ? *m_socket4 : *m_socket6 ;
-}
-
 G::Slot::Signal<GStore::MessageId,std::string,std::string> & GFilters::MxLookup::doneSignal() noexcept
 {
 	return m_done_signal ;
 }
 
-// ==
-
-GFilters::MxLookup::ReadHandler::ReadHandler( MxLookup * p , Method m ) :
-	m_p(p) ,
-	m_m(m)
-{
-}
-
-void GFilters::MxLookup::ReadHandler::readEvent()
-{
-	if( m_p )
-		(m_p->*m_m)() ;
-}
-
 GFilters::MxLookup::Config::Config()
 = default ;
 
@@ -24,8 +24,7 @@
 #include "gdef.h"
 #include "gmessagestore.h"
 #include "gaddress.h"
-#include "gsocket.h"
-#include "geventhandler.h"
+#include "gdnsclient.h"
 #include "gdatetime.h"
 #include "gtimer.h"
 #include "gslot.h"
@@ -46,7 +45,9 @@ namespace GFilters
 /// 'restart_timeout' before the sequence starts again. There is no
 /// overall timeout.
 ///
-class GFilters::MxLookup
+/// The queries are sent using the shared GNet::DnsClient.
+///
+class GFilters::MxLookup : private GNet::DnsClientCallback
 {
 public:
 	struct Config /// A configuration structure for GFilters::MxLookup
@@ -66,6 +67,9 @@ public:
 		///< Constructor taking a list of nameservers.
 		/// \see GNet::nameservers()
 
+	~MxLookup() override ;
+		///< Destructor.
+
 	void start( const GStore::MessageId & , const std::string & question_domain , unsigned int port ) ;
 		///< Starts the lookup.
 
@@ -78,28 +82,23 @@ public:
 	void cancel() ;
 		///< Cancels the lookup so the doneSignal() is not emitted.
 
+public:
+	MxLookup( const MxLookup & ) = delete ;
+	MxLookup( MxLookup && ) = delete ;
+	MxLookup & operator=( const MxLookup & ) = delete ;
+	MxLookup & operator=( MxLookup && ) = delete ;
+
+private: // overrides
+	void onDnsResponse( unsigned int , const GNet::DnsMessage & ) override ; // GNet::DnsClientCallback
+
 private:
-	struct ReadHandler : GNet::EventHandler
-	{
-		using Method = void (MxLookup::*)() ;
-		ReadHandler( MxLookup * p , Method m ) ;
-		MxLookup * m_p ;
-		Method m_m ;
-		void readEvent() override ;
-	} ;
-	void readHandler4() ;
-	void readHandler6() ;
-	void readHandler( GNet::DatagramSocket & ) ;
 	void startTimer() ;
 	void onTimeout() ;
 	void sendMxQuestion( std::size_t , const std::string & ) ;
 	void sendHostQuestion( std::size_t , const std::string & ) ;
 	void fail( const std::string & ) ;
 	void succeed( const std::string & ) ;
-	void addReadHandlers() ;
-	void dropReadHandlers() ;
-	GNet::DatagramSocket & socket( std::size_t ) ;
-	void process( const char * , std::size_t ) ;
+	void process( std::size_t ns_index , const GNet::DnsMessage & ) ;
 	void disable( std::size_t , const std::string & ) ;
 
 private:
@@ -113,10 +112,7 @@ private:
 	std::size_t m_ns_failures ;
 	std::vector<GNet::Address> m_nameservers ;
 	GNet::Timer<MxLookup> m_timer ;
-	ReadHandler m_handler4 ;
-	ReadHandler m_handler6 ;
-	std::unique_ptr<GNet::DatagramSocket> m_socket4 ;
-	std::unique_ptr<GNet::DatagramSocket> m_socket6 ;
+	std::shared_ptr<GNet::DnsClient> m_dns ;
 	G::Slot::Signal<GStore::MessageId,std::string,std::string> m_done_signal ;
 } ;
 
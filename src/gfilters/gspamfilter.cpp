@@ -22,15 +22,18 @@
 #include "gspamfilter.h"
 #include "gstr.h"
 #include "glog.h"
+#include "gassert.h"
 
 GFilters::SpamFilter::SpamFilter( GNet::EventState es , GStore::FileStore & file_store ,
 	Filter::Type , const Filter::Config & config , const std::string & server ,
 	bool read_only , bool always_pass ) :
 		m_es(es) ,
 		m_done_timer(*this,&SpamFilter::onDoneTimeout,m_es) ,
+		m_retry_timer(*this,&SpamFilter::onRetryTimeout,m_es) ,
 		m_done_signal(true) ,
 		m_file_store(file_store) ,
-		m_location(server) ,
+		m_pool(SpamPool::get(server)) ,
+		m_message_id(GStore::MessageId::none()) ,
 		m_read_only(read_only) ,
 		m_always_pass(always_pass) ,
 		m_connection_timeout(config.timeout) ,
@@ -44,11 +47,13 @@ GFilters::SpamFilter::~SpamFilter()
 {
 	m_client_ptr.eventSignal().disconnect() ;
 	m_client_ptr.deletedSignal().disconnect() ;
+	if( m_server != SpamPool::npos )
+		m_pool->release( m_server ) ;
 }
 
 std::string GFilters::SpamFilter::id() const
 {
-	return m_location.displayString() ;
+	return m_pool->id() ;
 }
 
 bool GFilters::SpamFilter::quiet() const
@@ -57,41 +62,72 @@ bool GFilters::SpamFilter::quiet() const
 }
 
 void GFilters::SpamFilter::start( const GStore::MessageId & message_id )
+{
+	cancel() ;
+	m_done_signal.emitted( false ) ;
+	m_message_id = message_id ;
+	m_tried.assign( m_pool->size() , false ) ;
+	startClient() ;
+}
+
+void GFilters::SpamFilter::startClient()
 {
 	// the spam client can do more than one request, but it is simpler to start fresh
+	G_ASSERT( m_server == SpamPool::npos ) ;
+	m_server = m_pool->acquire( m_tried ) ;
+	G_ASSERT( m_server != SpamPool::npos ) ;
+	m_tried.at( m_server ) = true ;
 	m_client_ptr.reset( std::make_unique<GSmtp::SpamClient>( m_es.eh(m_client_ptr) ,
-		m_location , m_read_only , m_connection_timeout , m_response_timeout ) ) ;
+		m_pool->location(m_server) , m_read_only , m_connection_timeout , m_response_timeout ) ) ;
 
-	m_done_signal.emitted( false ) ;
 	m_text.erase() ;
-	m_client_ptr->request( m_file_store.contentPath(message_id).str() ) ; // (no need to wait for connection)
+	m_client_ptr->request( m_file_store.contentPath(m_message_id).str() ) ; // (no need to wait for connection)
 }
 
 void GFilters::SpamFilter::clientDeleted( const std::string & reason )
 {
-	if( !reason.empty() && !m_done_signal.emitted() )
-	{
-		G_WARNING( "GFilters::SpamFilter::clientDeleted: spamd interaction failed: " << reason ) ;
-	}
-	m_text = reason ;
-	done() ;
+	if( m_server != SpamPool::npos ) // ie. no response yet
+		failed( reason.empty() ? std::string("disconnected") : reason ) ;
 }
 
 void GFilters::SpamFilter::clientEvent( const std::string & s1 , const std::string & s2 , const std::string & )
 {
 	G_DEBUG( "GFilters::SpamFilter::clientEvent: [" << s1 << "] [" << s2 << "]" ) ;
-	if( s1 == "spam" )
+	if( s1 == "spam" && m_server != SpamPool::npos )
 	{
+		m_pool->success( m_server ) ;
+		m_server = SpamPool::npos ;
 		m_text = ( s2.empty() || m_always_pass ) ? std::string() : std::string("spam: ").append(G::Str::printable(s2)) ;
 		done() ;
 	}
-	else if( s1 == "failed" )
+	else if( s1 == "failed" && m_server != SpamPool::npos )
+	{
+		failed( G::Str::printable(s2) ) ;
+	}
+}
+
+void GFilters::SpamFilter::failed( const std::string & reason )
+{
+	m_pool->failure( m_server , reason ) ;
+	m_server = SpamPool::npos ;
+	if( m_pool->available( m_tried ) )
+	{
+		m_retry_timer.startTimer( 0U ) ;
+	}
+	else
 	{
-		m_text = G::Str::printable( s2 ) ;
+		G_WARNING( "GFilters::SpamFilter::failed: spamd interaction failed: " << reason ) ;
+		m_text = reason ;
 		done() ;
 	}
 }
 
+void GFilters::SpamFilter::onRetryTimeout()
+{
+	G_LOG( "GFilters::SpamFilter::onRetryTimeout: retrying spamd request on another server" ) ;
+	startClient() ;
+}
+
 bool GFilters::SpamFilter::special() const
 {
 	return false ;
@@ -137,8 +173,13 @@ void GFilters::SpamFilter::cancel()
 {
 	G_DEBUG( "GFilters::SpamFilter::cancel: cancelled" ) ;
 	m_done_timer.cancelTimer() ;
+	m_retry_timer.cancelTimer() ;
 	m_text.erase() ;
+	if( m_server != SpamPool::npos )
+	{
+		m_pool->release( m_server ) ;
+		m_server = SpamPool::npos ;
+	}
 	if( m_client_ptr.get() != nullptr && m_client_ptr->busy() )
 		m_client_ptr.reset() ;
 }
-
@@ -26,6 +26,10 @@
 #include "gfilestore.h"
 #include "gclientptr.h"
 #include "gspamclient.h"
+#include "gspampool.h"
+#include "gtimer.h"
+#include <memory>
+#include <vector>
 
 namespace GFilters
 {
@@ -38,6 +42,11 @@ namespace GFilters
 /// into the file. It parses the response's "Spam:" header to determine
 /// the overall pass/fail result, or it can optionally always pass.
 ///
+/// The server address can be a semi-colon-separated list of spamd
+/// servers that are load-balanced through a shared GFilters::SpamPool.
+/// If a server fails then the request is retried on the other servers
+/// in turn.
+///
 class GFilters::SpamFilter : public GSmtp::Filter
 {
 public:
@@ -45,7 +54,8 @@ public:
 		Filter::Type , const Filter::Config & ,
 		const std::string & server_location ,
 		bool read_only , bool always_pass ) ;
-			///< Constructor.
+			///< Constructor. The server location can be a
+			///< semi-colon-separated list.
 
 	~SpamFilter() override ;
 		///< Destructor.
@@ -71,15 +81,22 @@ public:
 private:
 	void clientEvent( const std::string & , const std::string & , const std::string & ) ;
 	void clientDeleted( const std::string & ) ;
+	void startClient() ;
+	void failed( const std::string & ) ;
 	void done() ;
 	void onDoneTimeout() ;
+	void onRetryTimeout() ;
 
 private:
 	GNet::EventState m_es ;
 	GNet::Timer<SpamFilter> m_done_timer ;
+	GNet::Timer<SpamFilter> m_retry_timer ;
 	G::Slot::Signal<int> m_done_signal ;
 	GStore::FileStore & m_file_store ;
-	GNet::Location m_location ;
+	std::shared_ptr<SpamPool> m_pool ;
+	std::size_t m_server {SpamPool::npos} ; // acquire()d from the pool
+	std::vector<bool> m_tried ;
+	GStore::MessageId m_message_id ;
 	bool m_read_only ;
 	bool m_always_pass ;
 	unsigned int m_connection_timeout ;
@@ -0,0 +1,177 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gspampool.cpp
+///
+
+#include "gdef.h"
+#include "gspampool.h"
+#include "gmetrics.h"
+#include "gstringtoken.h"
+#include "gstr.h"
+#include "glog.h"
+#include "gassert.h"
+#include <algorithm>
+#include <map>
+
+namespace GFilters
+{
+	namespace SpamPoolImp
+	{
+		G::Metrics::Counter requests_ok( "emailrelay_spamd_requests_total" , "result=\"ok\"" , "Requests to spamd servers" ) ;
+		G::Metrics::Counter requests_failed( "emailrelay_spamd_requests_total" , "result=\"failed\"" , "Requests to spamd servers" ) ;
+		G::Metrics::Counter requests_cancelled( "emailrelay_spamd_requests_total" , "result=\"cancelled\"" , "Requests to spamd servers" ) ;
+		constexpr unsigned int backoff_min = 5U ; // seconds
+		constexpr unsigned int backoff_max = 300U ;
+	}
+}
+
+std::shared_ptr<GFilters::SpamPool> GFilters::SpamPool::get( const std::string & servers )
+{
+	static G::threading::mutex_type mutex ;
+	static std::map<std::string,std::weak_ptr<SpamPool>> pools ;
+	G::threading::lock_type lock( mutex ) ;
+	std::shared_ptr<SpamPool> pool = pools[servers].lock() ;
+	if( !pool )
+	{
+		pool = std::make_shared<SpamPool>( servers ) ;
+		pools[servers] = pool ;
+	}
+	return pool ;
+}
+
+G::StringArray GFilters::SpamPool::split( const std::string & servers )
+{
+	G::StringArray result ;
+	for( G::StringToken t( servers , ";" ) ; t ; ++t )
+		result.push_back( t() ) ;
+	return result ;
+}
+
+GFilters::SpamPool::Server::Server( const std::string & s ) :
+	m_location(s)
+{
+}
+
+GFilters::SpamPool::SpamPool( const std::string & servers )
+{
+	for( const auto & s : split(servers) )
+		m_servers.emplace_back( s ) ;
+	if( m_servers.empty() )
+		m_servers.emplace_back( servers ) ; // GNet::Location throws
+}
+
+std::string GFilters::SpamPool::id() const
+{
+	std::string result ;
+	for( const auto & server : m_servers )
+		result.append(result.empty()?0U:1U,';').append( server.m_location.displayString() ) ;
+	return result ;
+}
+
+std::size_t GFilters::SpamPool::size() const noexcept
+{
+	return m_servers.size() ;
+}
+
+GNet::Location GFilters::SpamPool::location( std::size_t i ) const
+{
+	return m_servers.at(i).m_location ;
+}
+
+bool GFilters::SpamPool::available( const std::vector<bool> & excluded ) const
+{
+	for( std::size_t i = 0U ; i < m_servers.size() ; i++ )
+	{
+		if( i >= excluded.size() || !excluded[i] )
+			return true ;
+	}
+	return false ;
+}
+
+std::size_t GFilters::SpamPool::acquire( const std::vector<bool> & excluded )
+{
+	G::threading::lock_type lock( m_mutex ) ;
+	G::TimerTime now = G::TimerTime::now() ;
+
+	// choose the least busy healthy server, starting the search from
+	// a rotating position so that ties are shared out, or failing
+	// that the unhealthy server that is next due a retry
+	std::size_t best = npos ;
+	bool best_healthy = false ;
+	for( std::size_t n = 0U ; n < m_servers.size() ; n++ )
+	{
+		std::size_t i = ( m_next + n ) % m_servers.size() ;
+		if( i < excluded.size() && excluded[i] )
+			continue ;
+		const Server & server = m_servers[i] ;
+		bool healthy = server.m_failures == 0U || server.m_retry_time <= now ;
+		if( best == npos ||
+			( healthy && !best_healthy ) ||
+			( healthy && server.m_outstanding < m_servers[best].m_outstanding ) ||
+			( !healthy && !best_healthy && server.m_retry_time < m_servers[best].m_retry_time ) )
+		{
+			best = i ;
+			best_healthy = healthy ;
+		}
+	}
+	if( best != npos )
+	{
+		m_servers[best].m_outstanding++ ;
+		m_next = ( best + 1U ) % m_servers.size() ;
+		G_DEBUG( "GFilters::SpamPool::acquire: [" << m_servers[best].m_location.displayString() << "]: "
+			<< "outstanding=" << m_servers[best].m_outstanding << (best_healthy?"":" (unhealthy)") ) ;
+	}
+	return best ;
+}
+
+void GFilters::SpamPool::success( std::size_t i )
+{
+	G::threading::lock_type lock( m_mutex ) ;
+	Server & server = m_servers.at( i ) ;
+	G_ASSERT( server.m_outstanding != 0U ) ;
+	if( server.m_outstanding ) server.m_outstanding-- ;
+	if( server.m_failures )
+		G_LOG( "GFilters::SpamPool::success: spamd server [" << server.m_location.displayString() << "] is available again" ) ;
+	server.m_failures = 0U ;
+	SpamPoolImp::requests_ok.add() ;
+}
+
+void GFilters::SpamPool::failure( std::size_t i , const std::string & reason )
+{
+	namespace imp = SpamPoolImp ;
+	G::threading::lock_type lock( m_mutex ) ;
+	Server & server = m_servers.at( i ) ;
+	G_ASSERT( server.m_outstanding != 0U ) ;
+	if( server.m_outstanding ) server.m_outstanding-- ;
+	server.m_failures++ ;
+	unsigned int backoff = imp::backoff_min << std::min( server.m_failures-1U , 6U ) ;
+	backoff = std::min( backoff , imp::backoff_max ) ;
+	server.m_retry_time = G::TimerTime::now() + G::TimeInterval(backoff) ;
+	G_WARNING( "GFilters::SpamPool::failure: spamd server [" << server.m_location.displayString() << "] failed: "
+		<< reason << ": avoiding it for " << backoff << "s" ) ;
+	imp::requests_failed.add() ;
+}
+
+void GFilters::SpamPool::release( std::size_t i )
+{
+	G::threading::lock_type lock( m_mutex ) ;
+	Server & server = m_servers.at( i ) ;
+	if( server.m_outstanding ) server.m_outstanding-- ;
+	SpamPoolImp::requests_cancelled.add() ;
+}
+
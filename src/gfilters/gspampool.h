@@ -0,0 +1,123 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gspampool.h
+///
+
+#ifndef G_SPAM_POOL_H
+#define G_SPAM_POOL_H
+
+#include "gdef.h"
+#include "glocation.h"
+#include "gdatetime.h"
+#include "gstringarray.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace GFilters
+{
+	class SpamPool ;
+}
+
+//| \class GFilters::SpamPool
+/// A set of spamd servers that are used in turn by GFilters::SpamFilter.
+///
+/// The pool keeps a count of the outstanding requests for each server
+/// so that new requests go to the least busy server. Servers that fail
+/// are avoided for a back-off period that increases with the number of
+/// consecutive failures, but they are still used as a last resort.
+///
+/// Pools are shared between all filters that have the same server list,
+/// even across threads.
+///
+/// \code
+/// auto pool = SpamPool::get( "10.0.0.1:783;10.0.0.2:783" ) ;
+/// std::vector<bool> tried( pool->size() ) ;
+/// std::size_t i = pool->acquire( tried ) ;
+/// SpamClient client( ... , pool->location(i) , ... ) ;
+/// ...
+/// pool->success( i ) ;
+/// \endcode
+///
+class GFilters::SpamPool
+{
+public:
+	static constexpr std::size_t npos = std::string::npos ;
+
+	static std::shared_ptr<SpamPool> get( const std::string & servers ) ;
+		///< Returns a shared pool for the given semi-colon-separated
+		///< list of server addresses.
+
+	static G::StringArray split( const std::string & servers ) ;
+		///< Splits a semi-colon-separated server list.
+
+	explicit SpamPool( const std::string & servers ) ;
+		///< Constructor taking a semi-colon-separated list of
+		///< server addresses. Prefer get().
+
+	std::string id() const ;
+		///< Returns the server list for logging.
+
+	std::size_t size() const noexcept ;
+		///< Returns the number of servers.
+
+	GNet::Location location( std::size_t ) const ;
+		///< Returns the address of the given server.
+
+	std::size_t acquire( const std::vector<bool> & excluded ) ;
+		///< Chooses the best server that is not excluded and increments
+		///< its outstanding request count. Returns npos if all
+		///< excluded.
+
+	bool available( const std::vector<bool> & excluded ) const ;
+		///< Returns true if there is any server that is not excluded.
+
+	void success( std::size_t ) ;
+		///< Releases an acquire()d server after a successful request.
+
+	void failure( std::size_t , const std::string & reason ) ;
+		///< Releases an acquire()d server after a failed request,
+		///< starting or extending its back-off period.
+
+	void release( std::size_t ) ;
+		///< Releases an acquire()d server after a cancelled request.
+
+public:
+	~SpamPool() = default ;
+	SpamPool( const SpamPool & ) = delete ;
+	SpamPool( SpamPool && ) = delete ;
+	SpamPool & operator=( const SpamPool & ) = delete ;
+	SpamPool & operator=( SpamPool && ) = delete ;
+
+private:
+	struct Server /// A spamd server and its state.
+	{
+		explicit Server( const std::string & ) ;
+		GNet::Location m_location ;
+		std::size_t m_outstanding {0U} ;
+		unsigned int m_failures {0U} ;
+		G::TimerTime m_retry_time {G::TimerTime::zero()} ;
+	} ;
+
+private:
+	std::vector<Server> m_servers ;
+	std::size_t m_next {0U} ;
+	mutable G::threading::mutex_type m_mutex ; // protects the server state
+} ;
+
+#endif
@@ -611,6 +611,13 @@
 			#define GCONFIG_HAVE_SEM_INIT 0
 		#endif
 	#endif
+	#if !defined(GCONFIG_HAVE_SENDFILE)
+		#ifdef G_UNIX_LINUX
+			#define GCONFIG_HAVE_SENDFILE 1
+		#else
+			#define GCONFIG_HAVE_SENDFILE 0
+		#endif
+	#endif
 	#if !defined(GCONFIG_HAVE_X11)
 		#ifdef G_UNIX
 			#define GCONFIG_HAVE_X11 1
@@ -1119,6 +1126,7 @@
 		#if GCONFIG_ENABLE_STD_THREAD
 			#include <thread>
 			#include <mutex>
+			#include <condition_variable>
 			#include <cstring>
 			namespace G
 			{
@@ -1128,6 +1136,8 @@
 					using thread_type = std::thread ;
 					using mutex_type = std::mutex ;
 					using lock_type = std::lock_guard<std::mutex> ;
+					using unique_lock_type = std::unique_lock<std::mutex> ;
+					using cond_type = std::condition_variable ;
 					static bool works() ; // run-time test -- see gthread.cpp
 					static void yield() noexcept { std::this_thread::yield() ; }
 				} ;
@@ -1148,14 +1158,17 @@
 						void join() {}
 						id get_id() const { return 0 ; }
 				} ;
-				class dummy_mutex {} ;
+				class dummy_mutex { public: void lock() {} void unlock() {} } ;
 				class dummy_lock { public: explicit dummy_lock( dummy_mutex & ) {} } ;
+				class dummy_cond { public: void notify_one() noexcept {} void notify_all() noexcept {} template <typename T_lock,typename T_pred> void wait( T_lock & , T_pred ) {} } ;
 				struct threading
 				{
 					static constexpr bool using_std_thread = false ;
 					using thread_type = G::dummy_thread ;
 					using mutex_type = G::dummy_mutex ;
 					using lock_type = G::dummy_lock ;
+					using unique_lock_type = G::dummy_lock ;
+					using cond_type = G::dummy_cond ;
 					static bool works() ;
 					static void yield() noexcept {}
 				} ;
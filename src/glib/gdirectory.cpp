@@ -25,6 +25,7 @@
 #include "gprocess.h"
 #include "gstr.h"
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <iterator> // std::distance
 
@@ -55,7 +56,7 @@ G::Path G::Directory::path() const
 std::string G::Directory::tmp()
 {
 	std::ostringstream ss ;
-	static int sequence = 1 ;
+	static std::atomic<int> sequence {1} ;
 	ss << "." << SystemTime::now() << "." << sequence++ << "." << Process::Id() << ".tmp" ;
 	return ss.str() ;
 }
@@ -112,12 +113,13 @@ void G::DirectoryList::readImp( const G::Path & dir , bool sub_dirs , std::strin
 				item.m_is_link = iter.isLink() ;
 				item.m_path = iter.filePath() ;
 				item.m_name = iter.fileName() ;
-				m_list.insert( std::lower_bound(m_list.begin(),m_list.end(),item) , item ) ;
+				m_list.push_back( item ) ;
 			}
 			if( m_list.size() == limit )
 				break ;
 		}
 	}
+	std::sort( m_list.begin() , m_list.end() ) ; // not an ordered insert, which is quadratic
 }
 
 #ifndef G_LIB_SMALL
@@ -78,6 +78,8 @@ public:
 		unsigned long mode {0} ;
 		unsigned long long size {0} ;
 		unsigned long long blocks {0} ;
+		unsigned long long inode {0} ; // unix
+		unsigned long links {0} ; // hard link count
 		uid_t uid {0} ; // unix
 		gid_t gid {0} ; // unix
 		bool inherit {false} ; // unix, directory group ownership passed on to new files
@@ -291,6 +293,13 @@ public:
 	static void close( int fd ) noexcept ;
 		///< Calls ::close() or equivalent.
 
+	static bool sync( const Path & , std::nothrow_t ) noexcept ;
+		///< Flushes the file's data to permanent storage using
+		///< ::fsync() or equivalent. On unix the path can also be
+		///< a directory in order to make new directory entries
+		///< permanent; on windows this is a no-op for directories.
+		///< Returns false on error.
+
 	static std::streamoff seek( int fd , std::streamoff offset , Seek ) noexcept ;
 		///< Does ::lseek() or equivalent.
 
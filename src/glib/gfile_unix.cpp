@@ -161,6 +161,17 @@ void G::File::close( int fd ) noexcept
 	::close( fd ) ;
 }
 
+bool G::File::sync( const Path & path , std::nothrow_t ) noexcept
+{
+	static_assert( noexcept(path.cstr()) , "" ) ;
+	int fd = ::open( path.cstr() , O_RDONLY ) ; // NOLINT
+	if( fd < 0 )
+		return false ;
+	bool ok = ::fsync( fd ) == 0 ;
+	::close( fd ) ;
+	return ok ;
+}
+
 bool G::FileImp::removeImp( const char * path , int * e ) noexcept
 {
 	bool ok = path && 0 == std::remove( path ) ;
@@ -224,6 +235,8 @@ G::File::Stat G::File::statImp( const char * path , bool symlink_nofollow ) noex
 		s.mode = static_cast<unsigned long>( statbuf.st_mode & mode_t(07777) ) ; // NOLINT
 		s.size = static_cast<unsigned long long>( statbuf.st_size ) ;
 		s.blocks = static_cast<unsigned long long>(statbuf.st_size) >> 24U ;
+		s.inode = static_cast<unsigned long long>( statbuf.st_ino ) ;
+		s.links = static_cast<unsigned long>( statbuf.st_nlink ) ;
 		s.uid = statbuf.st_uid ;
 		s.gid = statbuf.st_gid ;
 		s.inherit = s.is_dir && ( G::is_bsd() || ( statbuf.st_mode & S_ISGID ) ) ;
@@ -217,6 +217,25 @@ void G::File::close( int fd ) noexcept
 	_close( fd ) ;
 }
 
+bool G::File::sync( const Path & path , std::nothrow_t ) noexcept
+{
+	int fd = open( path , InOutAppend::OutNoCreate ) ;
+	if( fd < 0 )
+	{
+		try
+		{
+			return isDirectory( path , std::nothrow ) ; // no-op
+		}
+		catch(...)
+		{
+			return false ;
+		}
+	}
+	bool ok = _commit( fd ) == 0 ;
+	_close( fd ) ;
+	return ok ;
+}
+
 bool G::File::remove( const Path & path , std::nothrow_t ) noexcept
 {
 	bool ok = nowide::remove( path ) ;
@@ -287,6 +306,7 @@ G::File::Stat G::File::statImp( const char * path , bool /*symlink_nofollow*/ )
 			s.mode = static_cast<unsigned long>( statbuf.st_mode & 07777 ) ;
 			s.size = static_cast<unsigned long long>( statbuf.st_size ) ;
 			s.blocks = static_cast<unsigned long long>( statbuf.st_size >> 24 ) ;
+			s.links = static_cast<unsigned long>( statbuf.st_nlink ) ;
 		}
 		else
 		{
@@ -37,8 +37,12 @@
 #include <utility>
 
 #ifndef G_LOG_THREAD_LOCAL
+#if GCONFIG_ENABLE_STD_THREAD
+#define G_LOG_THREAD_LOCAL thread_local
+#else
 #define G_LOG_THREAD_LOCAL
 #endif
+#endif
 
 namespace G
 {
@@ -175,11 +179,11 @@ public:
 		///< Returns a pointer to the controlling LogOutput object.
 		///< Returns nullptr if none.
 		///<
-		///< Non-main threads can do logging safely if the (private)
-		///< instance pointer is declared 'thread_local' at build-time.
-		///< Thread functions can then instantiate their own LogOutput
-		///< object on the stack, typically with the Config object
-		///< and file descriptor passed in from the main thread.
+		///< The (private) instance pointer is declared 'thread_local'
+		///< in multi-threaded builds so that non-main threads do no
+		///< logging unless they instantiate their own LogOutput object,
+		///< typically with the Config object and log-file path or file
+		///< descriptor passed in from the main thread.
 
 	Config config() const noexcept ;
 		///< Returns the current configuration.
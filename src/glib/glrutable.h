@@ -0,0 +1,173 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file glrutable.h
+///
+
+#ifndef G_LRU_TABLE_H
+#define G_LRU_TABLE_H
+
+#include "gdef.h"
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace G
+{
+	template <typename T> class LruTable ;
+}
+
+//| \class G::LruTable
+/// A fixed-size table of values keyed by string with least-recently-used
+/// eviction. The values are held in a vector and linked into an
+/// intrusive recency list by index, with a hash map from key to index,
+/// so lookups, insertions and evictions are all constant time and
+/// there is no allocation once the table is full.
+///
+/// \code
+/// G::LruTable<Entry> table( 1000U ) ;
+/// auto result = table.insert( key ) ;
+/// if( result.second ) initialise( *result.first ) ;
+/// \endcode
+///
+template <typename T>
+class G::LruTable
+{
+public:
+	explicit LruTable( std::size_t max_size ) ;
+		///< Constructor. The maximum size is at least one.
+
+	T * find( const std::string & key ) ;
+		///< Returns a pointer to the value for the given key, making
+		///< it the most recently used, or nullptr if not in the table.
+		///< The pointer is invalidated by the next insert().
+
+	std::pair<T*,bool> insert( const std::string & key ) ;
+		///< Finds the value for the given key, making it the most
+		///< recently used, or adds a default-constructed value,
+		///< evicting the least recently used entry if the table is
+		///< full. Returns the value pointer and true if newly added.
+		///< The pointer is invalidated by the next insert().
+
+	std::size_t size() const noexcept ;
+		///< Returns the number of entries.
+
+	std::size_t maxSize() const noexcept ;
+		///< Returns the maximum number of entries.
+
+private:
+	static constexpr std::size_t npos = static_cast<std::size_t>(-1) ;
+	struct Entry
+	{
+		std::string key ;
+		T value {} ;
+		std::size_t prev {npos} ;
+		std::size_t next {npos} ;
+	} ;
+	void unlink( std::size_t ) noexcept ;
+	void pushFront( std::size_t ) noexcept ;
+
+private:
+	std::size_t m_max_size ;
+	std::vector<Entry> m_entries ;
+	std::unordered_map<std::string,std::size_t> m_index ;
+	std::size_t m_head {npos} ; // most recently used
+	std::size_t m_tail {npos} ; // least recently used
+} ;
+
+template <typename T>
+G::LruTable<T>::LruTable( std::size_t max_size ) :
+	m_max_size(std::max(max_size,std::size_t(1U)))
+{
+}
+
+template <typename T>
+T * G::LruTable<T>::find( const std::string & key )
+{
+	auto p = m_index.find( key ) ;
+	if( p == m_index.end() )
+		return nullptr ;
+	std::size_t i = (*p).second ;
+	unlink( i ) ;
+	pushFront( i ) ;
+	return &m_entries[i].value ;
+}
+
+template <typename T>
+std::pair<T*,bool> G::LruTable<T>::insert( const std::string & key )
+{
+	T * value = find( key ) ;
+	if( value )
+		return {value,false} ;
+
+	std::size_t i = npos ;
+	if( m_entries.size() < m_max_size )
+	{
+		i = m_entries.size() ;
+		m_entries.emplace_back() ;
+	}
+	else
+	{
+		// evict the least-recently-used entry and reuse its slot
+		i = m_tail ;
+		unlink( i ) ;
+		m_index.erase( m_entries[i].key ) ;
+		m_entries[i].value = T() ;
+	}
+	m_entries[i].key = key ;
+	m_index.insert( {key,i} ) ;
+	pushFront( i ) ;
+	return {&m_entries[i].value,true} ;
+}
+
+template <typename T>
+std::size_t G::LruTable<T>::size() const noexcept
+{
+	return m_index.size() ;
+}
+
+template <typename T>
+std::size_t G::LruTable<T>::maxSize() const noexcept
+{
+	return m_max_size ;
+}
+
+template <typename T>
+void G::LruTable<T>::unlink( std::size_t i ) noexcept
+{
+	Entry & entry = m_entries[i] ;
+	if( entry.prev != npos ) m_entries[entry.prev].next = entry.next ;
+	if( entry.next != npos ) m_entries[entry.next].prev = entry.prev ;
+	if( m_head == i ) m_head = entry.next ;
+	if( m_tail == i ) m_tail = entry.prev ;
+	entry.prev = entry.next = npos ;
+}
+
+template <typename T>
+void G::LruTable<T>::pushFront( std::size_t i ) noexcept
+{
+	Entry & entry = m_entries[i] ;
+	entry.prev = npos ;
+	entry.next = m_head ;
+	if( m_head != npos ) m_entries[m_head].prev = i ;
+	m_head = i ;
+	if( m_tail == npos ) m_tail = i ;
+}
+
+#endif
@@ -0,0 +1,110 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gmappedfile.h
+///
+
+#ifndef G_MAPPED_FILE_H
+#define G_MAPPED_FILE_H
+
+#include "gdef.h"
+#include "gpath.h"
+#include "gstringview.h"
+#include <cstddef>
+
+namespace G
+{
+	class MappedFile ;
+}
+
+//| \class G::MappedFile
+/// A read-only memory mapping of the whole of an open file, giving
+/// access to the file contents as a single contiguous string_view.
+///
+/// Mapping is best-effort: map() returns false if the file is empty,
+/// larger than the given limit, or cannot be mapped (eg. on some
+/// network filesystems), and the caller should fall back to reading
+/// the file as a stream.
+///
+/// \code
+/// G::MappedFile mapped ;
+/// if( mapped.map( fd ) )
+///    scan( mapped.view() ) ;
+/// else
+///    scan( stream ) ;
+/// \endcode
+///
+/// The file descriptor can be closed once mapped. The file should
+/// not be truncated while mapped.
+///
+class G::MappedFile
+{
+public:
+	static constexpr std::size_t default_limit = sizeof(void*) > 4U ? (std::size_t(1U)<<30U) : (std::size_t(1U)<<26U) ;
+
+	MappedFile() noexcept ;
+		///< Default constructor for an unmapped object.
+
+	~MappedFile() ;
+		///< Destructor. Unmaps the file.
+
+	bool map( int fd , std::size_t limit = default_limit ) noexcept ;
+		///< Maps the whole of the given open file, up to the given
+		///< size limit. Any previous mapping is released first.
+		///< Returns false if empty, too big or if mapping fails.
+
+	bool map( const Path & , std::size_t limit = default_limit ) noexcept ;
+		///< An overload that opens the file, maps it and
+		///< closes it again.
+
+	void unmap() noexcept ;
+		///< Releases the mapping.
+
+	bool mapped() const noexcept ;
+		///< Returns true if map()ped.
+
+	std::string_view view() const noexcept ;
+		///< Returns the mapped file contents, or an empty view
+		///< if not mapped.
+
+public:
+	MappedFile( const MappedFile & ) = delete ;
+	MappedFile( MappedFile && ) = delete ;
+	MappedFile & operator=( const MappedFile & ) = delete ;
+	MappedFile & operator=( MappedFile && ) = delete ;
+
+private:
+	const char * m_p {nullptr} ;
+	std::size_t m_size {0U} ;
+	#ifdef G_WINDOWS
+	HANDLE m_h {HNULL} ;
+	#endif
+} ;
+
+inline
+bool G::MappedFile::mapped() const noexcept
+{
+	return m_p != nullptr ;
+}
+
+inline
+std::string_view G::MappedFile::view() const noexcept
+{
+	return m_p ? std::string_view(m_p,m_size) : std::string_view() ;
+}
+
+#endif
@@ -0,0 +1,73 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gmappedfile_unix.cpp
+///
+
+#include "gdef.h"
+#include "gmappedfile.h"
+#include "gfile.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+G::MappedFile::MappedFile() noexcept
+= default ;
+
+G::MappedFile::~MappedFile()
+{
+	unmap() ;
+}
+
+bool G::MappedFile::map( int fd , std::size_t limit ) noexcept
+{
+	unmap() ;
+	struct stat statbuf {} ;
+	if( fd < 0 || ::fstat( fd , &statbuf ) != 0 || !S_ISREG(statbuf.st_mode) ||
+		statbuf.st_size <= 0 || static_cast<std::size_t>(statbuf.st_size) > limit )
+			return false ;
+
+	auto size = static_cast<std::size_t>( statbuf.st_size ) ;
+	void * p = ::mmap( nullptr , size , PROT_READ , MAP_SHARED , fd , 0 ) ;
+	if( p == MAP_FAILED ) // NOLINT
+		return false ;
+
+	#ifdef MADV_SEQUENTIAL
+		::madvise( p , size , MADV_SEQUENTIAL ) ;
+	#endif
+	m_p = static_cast<const char*>( p ) ;
+	m_size = size ;
+	return true ;
+}
+
+bool G::MappedFile::map( const Path & path , std::size_t limit ) noexcept
+{
+	int fd = File::open( path , File::InOutAppend::In ) ;
+	bool ok = map( fd , limit ) ;
+	if( fd >= 0 )
+		File::close( fd ) ;
+	return ok ;
+}
+
+void G::MappedFile::unmap() noexcept
+{
+	if( m_p )
+		::munmap( const_cast<char*>(m_p) , m_size ) ; // NOLINT
+	m_p = nullptr ;
+	m_size = 0U ;
+}
+
@@ -0,0 +1,79 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gmappedfile_win32.cpp
+///
+
+#include "gdef.h"
+#include "gmappedfile.h"
+#include "gfile.h"
+#include <io.h>
+
+G::MappedFile::MappedFile() noexcept
+= default ;
+
+G::MappedFile::~MappedFile()
+{
+	unmap() ;
+}
+
+bool G::MappedFile::map( int fd , std::size_t limit ) noexcept
+{
+	unmap() ;
+	HANDLE h = fd >= 0 ? reinterpret_cast<HANDLE>( _get_osfhandle(fd) ) : INVALID_HANDLE_VALUE ; // NOLINT
+	LARGE_INTEGER size {} ;
+	if( h == INVALID_HANDLE_VALUE || !GetFileSizeEx( h , &size ) ||
+		size.QuadPart <= 0 || static_cast<unsigned long long>(size.QuadPart) > limit )
+			return false ;
+
+	m_h = CreateFileMappingA( h , nullptr , PAGE_READONLY , 0 , 0 , nullptr ) ;
+	if( m_h == HNULL )
+		return false ;
+
+	void * p = MapViewOfFile( m_h , FILE_MAP_READ , 0 , 0 , 0 ) ;
+	if( p == nullptr )
+	{
+		CloseHandle( m_h ) ;
+		m_h = HNULL ;
+		return false ;
+	}
+
+	m_p = static_cast<const char*>( p ) ;
+	m_size = static_cast<std::size_t>( size.QuadPart ) ;
+	return true ;
+}
+
+bool G::MappedFile::map( const Path & path , std::size_t limit ) noexcept
+{
+	int fd = File::open( path , File::InOutAppend::In ) ;
+	bool ok = map( fd , limit ) ;
+	if( fd >= 0 )
+		File::close( fd ) ;
+	return ok ;
+}
+
+void G::MappedFile::unmap() noexcept
+{
+	if( m_p )
+		UnmapViewOfFile( m_p ) ;
+	if( m_h != HNULL )
+		CloseHandle( m_h ) ;
+	m_p = nullptr ;
+	m_size = 0U ;
+	m_h = HNULL ;
+}
+
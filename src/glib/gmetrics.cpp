@@ -0,0 +1,212 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gmetrics.cpp
+///
+
+#include "gdef.h"
+#include "gmetrics.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+G::Metrics::Metric * G::Metrics::m_head = nullptr ;
+
+void G::Metrics::report( std::ostream & stream , const std::string & eol )
+{
+	std::vector<const Metric*> list ;
+	for( const Metric * p = m_head ; p ; p = p->m_next )
+		list.push_back( p ) ;
+
+	// registration order depends on the link order, so sort by name
+	std::stable_sort( list.begin() , list.end() ,
+		[](const Metric * a , const Metric * b){ return std::strcmp(a->name(),b->name()) < 0 ; } ) ;
+
+	const char * family = nullptr ;
+	for( const Metric * p : list )
+	{
+		if( family == nullptr || std::strcmp(family,p->name()) != 0 )
+		{
+			family = p->name() ;
+			stream << "# HELP " << p->name() << " " << p->help() << eol ;
+			stream << "# TYPE " << p->name() << " " << p->type() << eol ;
+		}
+		p->streamOut( stream , eol ) ;
+	}
+}
+
+// ==
+
+G::Metrics::Metric::Metric( const char * name , const char * labels , const char * help ) noexcept :
+	m_name(name) ,
+	m_labels(labels) ,
+	m_help(help) ,
+	m_next(Metrics::m_head)
+{
+	// (normally runs during static initialisation so no locking)
+	Metrics::m_head = this ;
+}
+
+const char * G::Metrics::Metric::name() const noexcept
+{
+	return m_name ;
+}
+
+const char * G::Metrics::Metric::labels() const noexcept
+{
+	return m_labels ;
+}
+
+const char * G::Metrics::Metric::help() const noexcept
+{
+	return m_help ;
+}
+
+// ==
+
+G::Metrics::Counter::Counter( const char * name , const char * labels , const char * help ) noexcept :
+	Metric(name,labels,help)
+{
+}
+
+void G::Metrics::Counter::add( unsigned long long n ) noexcept
+{
+	m_value.fetch_add( n , std::memory_order_relaxed ) ;
+}
+
+unsigned long long G::Metrics::Counter::value() const noexcept
+{
+	return m_value.load( std::memory_order_relaxed ) ;
+}
+
+const char * G::Metrics::Counter::type() const noexcept
+{
+	return "counter" ;
+}
+
+void G::Metrics::Counter::streamOut( std::ostream & stream , const std::string & eol ) const
+{
+	stream << name() ;
+	if( *labels() )
+		stream << "{" << labels() << "}" ;
+	stream << " " << value() << eol ;
+}
+
+// ==
+
+G::Metrics::Gauge::Gauge( const char * name , const char * labels , const char * help ) noexcept :
+	Metric(name,labels,help)
+{
+}
+
+void G::Metrics::Gauge::add( long long n ) noexcept
+{
+	m_value.fetch_add( n , std::memory_order_relaxed ) ;
+}
+
+void G::Metrics::Gauge::sub( long long n ) noexcept
+{
+	m_value.fetch_sub( n , std::memory_order_relaxed ) ;
+}
+
+void G::Metrics::Gauge::set( long long n ) noexcept
+{
+	m_value.store( n , std::memory_order_relaxed ) ;
+}
+
+long long G::Metrics::Gauge::value() const noexcept
+{
+	return m_value.load( std::memory_order_relaxed ) ;
+}
+
+const char * G::Metrics::Gauge::type() const noexcept
+{
+	return "gauge" ;
+}
+
+void G::Metrics::Gauge::streamOut( std::ostream & stream , const std::string & eol ) const
+{
+	stream << name() ;
+	if( *labels() )
+		stream << "{" << labels() << "}" ;
+	stream << " " << value() << eol ;
+}
+
+// ==
+
+const std::array<unsigned long long,G::Metrics::Histogram::buckets> G::Metrics::Histogram::m_bounds_us {{
+	1000U , 2500U , 5000U , 10000U , 25000U , 50000U , 100000U , 250000U , 500000U ,
+	1000000U , 2500000U , 5000000U , 10000000U , 30000000U , 60000000U }} ;
+
+const std::array<const char*,G::Metrics::Histogram::buckets> G::Metrics::Histogram::m_bounds_str {{
+	"0.001" , "0.0025" , "0.005" , "0.01" , "0.025" , "0.05" , "0.1" , "0.25" , "0.5" ,
+	"1" , "2.5" , "5" , "10" , "30" , "60" }} ;
+
+G::Metrics::Histogram::Histogram( const char * name , const char * labels , const char * help ) noexcept :
+	Metric(name,labels,help)
+{
+}
+
+void G::Metrics::Histogram::observe( const G::TimeInterval & interval ) noexcept
+{
+	unsigned long long us = static_cast<unsigned long long>(interval.s()) * 1000000ULL + interval.us() ;
+	std::size_t i = std::lower_bound( m_bounds_us.begin() , m_bounds_us.end() , us ) - m_bounds_us.begin() ;
+	m_count[i].fetch_add( 1U , std::memory_order_relaxed ) ;
+	m_sum_us.fetch_add( us , std::memory_order_relaxed ) ;
+}
+
+void G::Metrics::Histogram::observe( const G::TimerTime & start )
+{
+	observe( start.interval( G::TimerTime::now() ) ) ;
+}
+
+unsigned long long G::Metrics::Histogram::count() const noexcept
+{
+	unsigned long long n = 0U ;
+	for( const auto & c : m_count )
+		n += c.load( std::memory_order_relaxed ) ;
+	return n ;
+}
+
+const char * G::Metrics::Histogram::type() const noexcept
+{
+	return "histogram" ;
+}
+
+void G::Metrics::Histogram::streamOut( std::ostream & stream , const std::string & eol ) const
+{
+	std::string sep = *labels() ? std::string(labels()).append(1U,',') : std::string() ;
+	unsigned long long n = 0U ;
+	for( std::size_t i = 0U ; i < buckets ; i++ )
+	{
+		n += m_count[i].load( std::memory_order_relaxed ) ;
+		stream << name() << "_bucket{" << sep << "le=\"" << m_bounds_str[i] << "\"} " << n << eol ;
+	}
+	n += m_count[buckets].load( std::memory_order_relaxed ) ;
+	stream << name() << "_bucket{" << sep << "le=\"+Inf\"} " << n << eol ;
+
+	unsigned long long sum_us = m_sum_us.load( std::memory_order_relaxed ) ;
+	std::string us_str = std::to_string( sum_us % 1000000ULL ) ;
+	stream << name() << "_sum" ;
+	if( *labels() )
+		stream << "{" << labels() << "}" ;
+	stream << " " << (sum_us/1000000ULL) << "." << std::string(6U-us_str.size(),'0') << us_str << eol ;
+	stream << name() << "_count" ;
+	if( *labels() )
+		stream << "{" << labels() << "}" ;
+	stream << " " << n << eol ;
+}
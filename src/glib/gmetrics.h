@@ -0,0 +1,205 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gmetrics.h
+///
+
+#ifndef G_METRICS_H
+#define G_METRICS_H
+
+#include "gdef.h"
+#include "gdatetime.h"
+#include <array>
+#include <atomic>
+#include <string>
+#include <iostream>
+
+namespace G
+{
+	class Metrics ;
+}
+
+//| \class G::Metrics
+/// A process-wide registry of operational metrics, ie. counters, gauges
+/// and fixed-bucket latency histograms, with a report() method that uses
+/// the Prometheus text exposition format.
+///
+/// Metric objects should have static storage duration. They add themselves
+/// to the registry when constructed, so there is no separate registration
+/// step, and they are updated with relaxed atomic operations so that they
+/// are cheap enough for hot paths and can be used from worker threads.
+///
+/// Metrics that share a name but have different labels are reported
+/// together as one metric family.
+///
+/// \code
+/// namespace FooImp
+/// {
+///   G::Metrics::Counter ok_count( "foo_total" , "result=\"ok\"" , "Foo operations" ) ;
+/// }
+/// ...
+/// FooImp::ok_count.add() ;
+/// \endcode
+///
+class G::Metrics
+{
+public:
+	class Metric ;
+	class Counter ;
+	class Gauge ;
+	class Histogram ;
+
+	static void report( std::ostream & , const std::string & eol = "\n" ) ;
+		///< Streams out all the metrics in Prometheus text format,
+		///< grouped by name.
+
+public:
+	Metrics() = delete ;
+
+private:
+	friend class Metric ;
+	static Metric * m_head ;
+} ;
+
+//| \class G::Metrics::Metric
+/// A base class for G::Metrics metrics.
+///
+class G::Metrics::Metric
+{
+public:
+	Metric( const char * name , const char * labels , const char * help ) noexcept ;
+		///< Constructor. The name should follow Prometheus naming
+		///< conventions and the labels string should be empty or
+		///< contain comma-separated name="value" pairs. The strings
+		///< are not copied.
+
+	virtual ~Metric() = default ;
+		///< Destructor.
+
+	const char * name() const noexcept ;
+		///< Returns the metric name.
+
+	const char * labels() const noexcept ;
+		///< Returns the labels string.
+
+	const char * help() const noexcept ;
+		///< Returns the help text.
+
+	virtual const char * type() const noexcept = 0 ;
+		///< Returns the Prometheus metric type, eg. "counter".
+
+	virtual void streamOut( std::ostream & , const std::string & eol ) const = 0 ;
+		///< Streams out the metric's sample lines.
+
+public:
+	Metric( const Metric & ) = delete ;
+	Metric( Metric && ) = delete ;
+	Metric & operator=( const Metric & ) = delete ;
+	Metric & operator=( Metric && ) = delete ;
+
+private:
+	friend class G::Metrics ;
+	const char * m_name ;
+	const char * m_labels ;
+	const char * m_help ;
+	Metric * m_next ;
+} ;
+
+//| \class G::Metrics::Counter
+/// A monotonically increasing metric.
+///
+class G::Metrics::Counter : public Metric
+{
+public:
+	Counter( const char * name , const char * labels , const char * help ) noexcept ;
+		///< Constructor.
+
+	void add( unsigned long long n = 1U ) noexcept ;
+		///< Increments the counter.
+
+	unsigned long long value() const noexcept ;
+		///< Returns the current value.
+
+private: // overrides
+	const char * type() const noexcept override ;
+	void streamOut( std::ostream & , const std::string & ) const override ;
+
+private:
+	std::atomic<unsigned long long> m_value {0U} ;
+} ;
+
+//| \class G::Metrics::Gauge
+/// A metric that can go up and down.
+///
+class G::Metrics::Gauge : public Metric
+{
+public:
+	Gauge( const char * name , const char * labels , const char * help ) noexcept ;
+		///< Constructor.
+
+	void add( long long n = 1 ) noexcept ;
+		///< Increments the gauge.
+
+	void sub( long long n = 1 ) noexcept ;
+		///< Decrements the gauge.
+
+	void set( long long n ) noexcept ;
+		///< Sets the gauge value.
+
+	long long value() const noexcept ;
+		///< Returns the current value.
+
+private: // overrides
+	const char * type() const noexcept override ;
+	void streamOut( std::ostream & , const std::string & ) const override ;
+
+private:
+	std::atomic<long long> m_value {0} ;
+} ;
+
+//| \class G::Metrics::Histogram
+/// A latency histogram with a fixed set of buckets from one millisecond
+/// to one minute.
+///
+class G::Metrics::Histogram : public Metric
+{
+public:
+	Histogram( const char * name , const char * labels , const char * help ) noexcept ;
+		///< Constructor.
+
+	void observe( const G::TimeInterval & ) noexcept ;
+		///< Adds an observation.
+
+	void observe( const G::TimerTime & start ) ;
+		///< Adds an observation of the time since the given start time.
+
+	unsigned long long count() const noexcept ;
+		///< Returns the number of observations.
+
+private: // overrides
+	const char * type() const noexcept override ;
+	void streamOut( std::ostream & , const std::string & ) const override ;
+
+private:
+	static constexpr std::size_t buckets = 15U ;
+	static const std::array<unsigned long long,buckets> m_bounds_us ;
+	static const std::array<const char*,buckets> m_bounds_str ;
+	std::array<std::atomic<unsigned long long>,buckets+1U> m_count {} ; // not cumulative
+	std::atomic<unsigned long long> m_sum_us {0U} ;
+} ;
+
+#endif
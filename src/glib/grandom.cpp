@@ -27,9 +27,9 @@
 
 unsigned int G::Random::rand( unsigned int start , unsigned int end )
 {
-	static std::default_random_engine e ; // NOLINT cert-msc32-c
+	static thread_local std::default_random_engine e ; // NOLINT cert-msc32-c
 
-	static bool seeded = false ;
+	static thread_local bool seeded = false ;
 	if( !seeded )
 	{
 		#if defined(G_WINDOWS)
@@ -56,3 +56,14 @@ unsigned int G::Random::rand( unsigned int start , unsigned int end )
 	return dist( e ) ;
 }
 
+unsigned int G::Random::secureRand( unsigned int start , unsigned int end )
+{
+	#if defined(G_WINDOWS)
+		static thread_local std::random_device r ;
+	#else
+		static thread_local std::random_device r( "/dev/urandom" ) ;
+	#endif
+
+	std::uniform_int_distribution<unsigned int> dist( start , end ) ;
+	return dist( r ) ;
+}
@@ -26,12 +26,20 @@
 
 namespace G
 {
-	namespace Random /// An enclosing namespace for G::Random::rand().
+	namespace Random /// An enclosing namespace for G::Random::rand() and secureRand().
 	{
 		unsigned int rand( unsigned int start = 0U , unsigned int end = 32767 ) ;
 			///< Returns a random value, uniformly distributed over the
 			///< given range (including 'start' and 'end'), and automatically
 			///< seeded on first use.
+
+		unsigned int secureRand( unsigned int start = 0U , unsigned int end = 32767 ) ;
+			///< Returns a random value, uniformly distributed over the
+			///< given range, taken directly from the operating system's
+			///< cryptographic random source (eg. "/dev/urandom") rather
+			///< than from a seeded pseudo-random generator. Use this for
+			///< values that must not be predictable by an attacker.
+			///< Throws on error.
 	}
 }
 
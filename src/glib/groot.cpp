@@ -26,7 +26,8 @@
 #include "gprocess.h"
 #include "glog.h"
 
-G::Root * G::Root::m_this = nullptr ;
+thread_local G::Root * G::Root::m_this = nullptr ;
+G::threading::mutex_type G::Root::m_mutex ;
 bool G::Root::m_initialised = false ;
 bool G::Root::m_fixed_group = false ;
 G::Identity G::Root::m_nobody( G::Identity::invalid() ) ;
@@ -37,10 +38,7 @@ G::Root::Root() :
 {
 	check() ;
 	if( m_this == nullptr && m_initialised )
-	{
-		Process::beSpecial( m_startup , m_change_group ) ;
-		m_this = this ;
-	}
+		acquire() ;
 }
 
 G::Root::Root( bool change_group ) :
@@ -48,10 +46,7 @@ G::Root::Root( bool change_group ) :
 {
 	check() ;
 	if( m_this == nullptr && m_initialised )
-	{
-		Process::beSpecial( m_startup , m_change_group ) ;
-		m_this = this ;
-	}
+		acquire() ;
 }
 
 G::Root::~Root() // NOLINT bugprone-exception-escape
@@ -62,7 +57,25 @@ G::Root::~Root() // NOLINT bugprone-exception-escape
 		int e_saved = Process::errno_() ;
 		Process::beOrdinary( m_nobody , m_change_group ) ; // can throw - std::terminate is correct
 		Process::errno_( e_saved ) ;
+		m_mutex.unlock() ;
+	}
+}
+
+void G::Root::acquire()
+{
+	// the effective ids are process-wide so other threads wait here
+	// until this thread's outermost instance is destroyed
+	m_mutex.lock() ;
+	try
+	{
+		Process::beSpecial( m_startup , m_change_group ) ;
+	}
+	catch(...)
+	{
+		m_mutex.unlock() ;
+		throw ;
 	}
+	m_this = this ;
 }
 
 void G::Root::atExit() noexcept
@@ -35,7 +35,9 @@ namespace G
 /// privileges are not necessarily root privileges; they can be suid privileges.
 ///
 /// The class must be initialised by calling a static init() method. If instances
-/// are nested then the inner instances have no effect.
+/// are nested then the inner instances have no effect. The user-id is shared
+/// by all threads so instances on different threads are serialised by an
+/// internal mutex, with nesting tracked per thread.
 ///
 /// The effect of this class depends on whether the process's real-id is root
 /// or not. If the real-id is root then the effective-id is switched to
@@ -94,9 +96,11 @@ public:
 
 private:
 	static void check() ;
+	void acquire() ;
 
 private:
-	static Root * m_this ;
+	static thread_local Root * m_this ;
+	static threading::mutex_type m_mutex ;
 	static bool m_initialised ;
 	static bool m_fixed_group ;
 	static Identity m_nobody ;
@@ -24,6 +24,7 @@
 #include "gdef.h"
 #include "gexception.h"
 #include <map>
+#include <memory>
 
 namespace G
 {
@@ -70,6 +71,11 @@ namespace G
 /// identified by an exact match with the current state will be
 /// chosen in preference to the 'any' transition.
 ///
+/// Copies of a state machine share the same table of transitions, at
+/// least until a transition is added to one of them, so a fully-built
+/// state machine can be used as a prototype for many objects at little
+/// cost.
+///
 /// The 'end' state is special in that predicates are ignored for
 /// transitions which have 'end' as their 'normal' destintation
 /// state. This is because of a special implementation feature
@@ -163,7 +169,7 @@ private:
 	} ;
 	using Map = std::multimap<Event,Transition> ;
 	using Map_value_type = typename Map::value_type ;
-	Map m_map ;
+	std::shared_ptr<Map> m_map ; // copy-on-write
 	State m_state ;
 	State m_end ;
 	State m_same ;
@@ -184,6 +190,7 @@ public:
 
 template <typename T, typename State, typename Event, typename Argument>
 G::StateMachine<T,State,Event,Argument>::StateMachine( State s_start , State s_end , State s_same , State s_any ) :
+	m_map(std::make_shared<Map>()) ,
 	m_state(s_start) ,
 	m_end(s_end) ,
 	m_same(s_same) ,
@@ -205,7 +212,9 @@ void G::StateMachine<T,State,Event,Argument>::operator()( Event event , State fr
 		( alt == m_end && to != m_end ) )
 			StateMachineImp::throwError() ;
 
-	m_map.insert( Map_value_type( event , Transition(from,to,action,alt) ) ) ;
+	if( m_map.use_count() > 1 )
+		m_map = std::make_shared<Map>( *m_map ) ;
+	m_map->insert( Map_value_type( event , Transition(from,to,action,alt) ) ) ;
 }
 
 template <typename T, typename State, typename Event, typename Argument>
@@ -227,8 +236,9 @@ State G::StateMachine<T,State,Event,Argument>::apply( T & t , Event event , Argu
 {
 	m_event = event ;
 	State state = m_state ;
-	auto p = m_map.find( event ) ; // look up in the multimap keyed on event + current-state
-	for( ; p != m_map.end() && (*p).first == event ; ++p )
+	const Map & map = *m_map ;
+	auto p = map.find( event ) ; // look up in the multimap keyed on event + current-state
+	for( ; p != map.end() && (*p).first == event ; ++p )
 	{
 		if( (*p).second.from == m_any || (*p).second.from == m_state )
 		{
@@ -1019,6 +1019,27 @@ std::istream & G::Str::readLine( std::istream & stream , std::string & line , Eo
 	}
 }
 
+bool G::Str::readLine( std::string_view text , std::size_t & pos , std::string_view & line , Eol eol ) noexcept
+{
+	if( pos >= text.size() )
+		return false ;
+
+	std::size_t eol_pos = eol == Eol::CrLf ? text.find( "\r\n"_sv , pos ) : text.find_first_of( "\r\n"_sv , pos ) ;
+	std::size_t eol_size = 1U ;
+	if( eol_pos == std::string::npos )
+	{
+		eol_pos = text.size() ;
+		eol_size = 0U ; // unterminated last line
+	}
+	else if( text[eol_pos] == '\r' && (eol_pos+1U) < text.size() && text[eol_pos+1U] == '\n' )
+	{
+		eol_size = 2U ;
+	}
+	line = text.substr( pos , eol_pos-pos ) ;
+	pos = eol_pos + eol_size ;
+	return true ;
+}
+
 template <typename Tstring, typename Fn>
 bool G::StrImp::readLine( std::istream & stream , Tstring & line , char * next_p , std::size_t limit , Fn eol_fn )
 {
@@ -424,6 +424,13 @@ public:
 			///< An overload where lines are terminated with some
 			///< enumerated combination of CR, LF or CRLF.
 
+	static bool readLine( std::string_view text , std::size_t & pos , std::string_view & result , Eol ) noexcept ;
+		///< An overload that extracts the next line from in-memory
+		///< text, starting at 'pos', with the same end-of-line rules
+		///< as the Eol stream overload. The result excludes the
+		///< terminator and 'pos' is advanced past it. Returns false
+		///< if 'pos' is already at the end of the text.
+
 	static void splitIntoTokens( const std::string & in , StringArray & out , std::string_view ws , char esc = '\0' ) ;
 		///< Splits the string into 'ws'-delimited tokens. The behaviour is like
 		///< strtok() in that adjacent delimiters count as one and leading and
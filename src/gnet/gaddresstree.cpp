@@ -0,0 +1,282 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gaddresstree.cpp
+///
+
+#include "gdef.h"
+#include "gaddresstree.h"
+#include "gstr.h"
+#include "gassert.h"
+#include <algorithm>
+
+GNet::AddressTree::AddressTree() :
+	m_nodes(2U)
+{
+}
+
+GNet::AddressTree::AddressTree( const G::StringArray & ranges ) :
+	m_nodes(2U)
+{
+	m_nodes.reserve( 2U * ranges.size() + 2U ) ;
+	for( std::size_t i = 0U ; i < ranges.size() ; i++ )
+	{
+		if( !ranges[i].empty() && !add( ranges[i] , i ) )
+			throw InvalidRange( ranges[i] ) ;
+	}
+}
+
+bool GNet::AddressTree::validRange( std::string_view range )
+{
+	bool is6 = false ;
+	Key key {} ;
+	unsigned int bits = 0U ;
+	return parse( range , is6 , key , bits ) ;
+}
+
+bool GNet::AddressTree::add( std::string_view range , std::size_t value )
+{
+	bool is6 = false ;
+	Key key {} ;
+	unsigned int bits = 0U ;
+	if( !parse( range , is6 , key , bits ) )
+		return false ;
+	if( insert( is6?1U:0U , key , bits , value ) )
+		m_size++ ;
+	return true ;
+}
+
+std::size_t GNet::AddressTree::find( const Address & address ) const
+{
+	if( m_size == 0U || !( address.is4() || address.is6() ) )
+		return npos ;
+	Key key {} ;
+	keyOf( address , key ) ;
+	return address.is6() ? find( 1U , key , 128U ) : find( 0U , key , 32U ) ;
+}
+
+std::size_t GNet::AddressTree::find( std::string_view address ) const
+{
+	bool is6 = false ;
+	Key key {} ;
+	if( m_size == 0U || !parseAddress( address , is6 , key ) )
+		return npos ;
+	return is6 ? find( 1U , key , 128U ) : find( 0U , key , 32U ) ;
+}
+
+bool GNet::AddressTree::contains( const Address & address ) const
+{
+	return find( address ) != npos ;
+}
+
+bool GNet::AddressTree::empty() const noexcept
+{
+	return m_size == 0U ;
+}
+
+std::size_t GNet::AddressTree::size() const noexcept
+{
+	return m_size ;
+}
+
+bool GNet::AddressTree::parse( std::string_view range , bool & is6 , Key & key , unsigned int & bits )
+{
+	// "192.168.0.0/16", "192.168.*.*", "192.168.1.1", "fc00::/7", "::1" etc.
+	std::string_view host = G::Str::headView( range , "/" , false ) ;
+	std::string_view tail = G::Str::tailView( range , "/" ) ;
+	bool with_tail = host.size() != range.size() ;
+	if( with_tail && ( tail.empty() || !G::Str::isUInt(tail) ) )
+		return false ;
+
+	unsigned int wildcards = 0U ;
+	while( host.size() >= 2U && host.substr(host.size()-2U) == ".*"_sv )
+	{
+		host.remove_suffix( 2U ) ;
+		wildcards++ ;
+	}
+	if( host == "*"_sv && wildcards == 3U )
+	{
+		host = std::string_view() ;
+		wildcards++ ;
+	}
+	if( host.find('*') != std::string::npos || ( wildcards && with_tail ) )
+		return false ;
+
+	std::string host_str = G::sv_to_string( host ) ;
+	for( unsigned int i = 0U ; i < wildcards ; i++ )
+		host_str.append( host_str.empty() ? "0" : ".0" ) ;
+
+	if( !parseAddress( host_str , is6 , key ) || ( is6 && wildcards ) )
+		return false ;
+
+	unsigned int max_bits = is6 ? 128U : 32U ;
+	if( wildcards )
+		bits = max_bits - 8U * wildcards ;
+	else if( with_tail && G::Str::toUInt(tail,max_bits+1U) <= max_bits )
+		bits = G::Str::toUInt( tail ) ;
+	else if( with_tail )
+		return false ;
+	else
+		bits = max_bits ;
+
+	Key masked_key = key ;
+	mask( masked_key , bits ) ;
+	return masked_key == key ; // no host bits
+
+}
+
+bool GNet::AddressTree::parseAddress( std::string_view s , bool & is6 , Key & key )
+{
+	if( s.empty() || s.find_first_of("/*") != std::string::npos || !Address::validStrings( s , "0" ) )
+		return false ;
+	const Address address = Address::parse( s , 0U ) ;
+	if( !address.is4() && !address.is6() )
+		return false ;
+	is6 = address.is6() ;
+	keyOf( address , key ) ;
+	return true ;
+}
+
+void GNet::AddressTree::keyOf( const Address & address , Key & key )
+{
+	G_ASSERT( address.is4() || address.is6() ) ;
+	key.fill( 0U ) ;
+	if( address.is6() )
+	{
+		const auto * in6 = reinterpret_cast<const sockaddr_in6*>( address.address() ) ; // NOLINT
+		std::copy( in6->sin6_addr.s6_addr , in6->sin6_addr.s6_addr+16U , key.begin() ) ;
+	}
+	else
+	{
+		const auto * in4 = reinterpret_cast<const sockaddr_in*>( address.address() ) ; // NOLINT
+		const auto * p = reinterpret_cast<const unsigned char*>( &in4->sin_addr.s_addr ) ; // NOLINT
+		std::copy( p , p+4U , key.begin() ) ;
+	}
+}
+
+unsigned int GNet::AddressTree::bit( const Key & key , unsigned int i ) noexcept
+{
+	return ( key[i/8U] >> (7U-(i%8U)) ) & 1U ;
+}
+
+unsigned int GNet::AddressTree::common( const Key & a , const Key & b , unsigned int limit ) noexcept
+{
+	// returns the number of leading bits in common, up to the limit
+	unsigned int n = 0U ;
+	for( std::size_t i = 0U ; n < limit ; i++ , n += 8U )
+	{
+		unsigned int x = static_cast<unsigned int>( a[i] ^ b[i] ) ;
+		if( x )
+		{
+			while( !( x & 0x80U ) )
+			{
+				x <<= 1U ;
+				n++ ;
+			}
+			break ;
+		}
+	}
+	return std::min( n , limit ) ;
+}
+
+void GNet::AddressTree::mask( Key & key , unsigned int bits ) noexcept
+{
+	for( unsigned int i = 0U ; i < 16U ; i++ )
+	{
+		if( bits >= (i+1U)*8U )
+			continue ;
+		else if( bits <= i*8U )
+			key[i] = 0U ;
+		else
+			key[i] &= static_cast<unsigned char>( 0xffU << (8U-(bits-i*8U)) ) ;
+	}
+}
+
+unsigned int GNet::AddressTree::newNode( const Key & key , unsigned int bits , std::size_t value )
+{
+	Node node ;
+	node.m_key = key ;
+	node.m_bits = bits ;
+	node.m_value = value ;
+	m_nodes.push_back( node ) ;
+	return static_cast<unsigned int>( m_nodes.size() - 1U ) ;
+}
+
+bool GNet::AddressTree::insert( unsigned int root , const Key & key , unsigned int bits , std::size_t value )
+{
+	// each node's prefix is a strict extension of its parent's, so walk
+	// down while the child's prefix matches and split where it diverges
+	unsigned int n = root ;
+	for(;;)
+	{
+		if( m_nodes[n].m_bits == bits )
+		{
+			if( m_nodes[n].m_value != npos )
+				return false ;
+			m_nodes[n].m_value = value ;
+			return true ;
+		}
+
+		unsigned int b = bit( key , m_nodes[n].m_bits ) ;
+		unsigned int c = m_nodes[n].m_child[b] ;
+		if( c == 0U )
+		{
+			unsigned int leaf = newNode( key , bits , value ) ;
+			m_nodes[n].m_child[b] = leaf ;
+			return true ;
+		}
+
+		unsigned int c_bits = m_nodes[c].m_bits ;
+		unsigned int same = common( key , m_nodes[c].m_key , std::min(bits,c_bits) ) ;
+		if( same == c_bits )
+		{
+			n = c ;
+			continue ;
+		}
+
+		Key split_key = key ;
+		mask( split_key , same ) ;
+		unsigned int split = newNode( split_key , same , same == bits ? value : npos ) ;
+		m_nodes[split].m_child[bit(m_nodes[c].m_key,same)] = c ;
+		if( same != bits )
+		{
+			unsigned int leaf = newNode( key , bits , value ) ;
+			m_nodes[split].m_child[bit(key,same)] = leaf ;
+		}
+		m_nodes[n].m_child[b] = split ;
+		return true ;
+	}
+}
+
+std::size_t GNet::AddressTree::find( unsigned int root , const Key & key , unsigned int bits ) const
+{
+	std::size_t result = npos ;
+	unsigned int n = root ;
+	for(;;)
+	{
+		const Node & node = m_nodes[n] ;
+		if( node.m_value != npos )
+			result = node.m_value ;
+		if( node.m_bits >= bits )
+			break ;
+		unsigned int c = node.m_child[bit(key,node.m_bits)] ;
+		if( c == 0U || common( key , m_nodes[c].m_key , m_nodes[c].m_bits ) != m_nodes[c].m_bits )
+			break ;
+		n = c ;
+	}
+	return result ;
+}
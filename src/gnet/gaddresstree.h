@@ -0,0 +1,126 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gaddresstree.h
+///
+
+#ifndef G_NET_ADDRESS_TREE_H
+#define G_NET_ADDRESS_TREE_H
+
+#include "gdef.h"
+#include "gaddress.h"
+#include "gexception.h"
+#include "gstringarray.h"
+#include "gstringview.h"
+#include <array>
+#include <vector>
+#include <string>
+
+namespace GNet
+{
+	class AddressTree ;
+}
+
+//| \class GNet::AddressTree
+/// A set of IPv4 and IPv6 address ranges compiled into path-compressed
+/// binary radix trees, with a longest-prefix-match lookup that runs in
+/// time proportional to the address length, independent of the number
+/// of ranges.
+///
+/// Address ranges can be in CIDR format (eg. "192.168.0.0/16" or
+/// "fc00::/7"), in the dotted-quad wildcard format (eg. "192.168.*.*")
+/// or be plain addresses (eg. "192.168.1.1" or "::1"). CIDR ranges with
+/// host bits set beyond the prefix length (eg. "10.1.2.3/8") are
+/// rejected since they are probably mistakes.
+///
+/// Each range has an associated value, typically an index into some
+/// external list, which is returned by find().
+///
+/// \code
+/// AddressTree tree( {"10.0.0.0/8","192.168.*.*"} ) ;
+/// if( tree.contains(address) ) ...
+/// \endcode
+///
+class GNet::AddressTree
+{
+public:
+	G_EXCEPTION( InvalidRange , tx("invalid address range") )
+	static constexpr std::size_t npos = std::string::npos ;
+
+	AddressTree() ;
+		///< Default constructor for an empty() tree.
+
+	explicit AddressTree( const G::StringArray & ranges ) ;
+		///< Constructor taking a list of address ranges, using the
+		///< list indexes as the associated values. Empty strings
+		///< are ignored. Throws InvalidRange on error.
+
+	static bool validRange( std::string_view range ) ;
+		///< Returns true if the given string is a valid address range.
+
+	bool add( std::string_view range , std::size_t value ) ;
+		///< Adds an address range with an associated value. Returns
+		///< false, with no side-effects, if the range string is not
+		///< valid. If the same range is added more than once then
+		///< the first value is retained.
+
+	std::size_t find( const Address & address ) const ;
+		///< Returns the value associated with the most specific range
+		///< containing the given IPv4 or IPv6 address. Returns npos if
+		///< no match or if not an IPv4 or IPv6 address.
+
+	std::size_t find( std::string_view address ) const ;
+		///< An overload taking an address string, such as returned by
+		///< Address::hostPartString(). Returns npos if no match or if
+		///< not a valid IPv4 or IPv6 address.
+
+	bool contains( const Address & address ) const ;
+		///< Returns true if find() does not return npos.
+
+	bool empty() const noexcept ;
+		///< Returns true if there are no ranges.
+
+	std::size_t size() const noexcept ;
+		///< Returns the number of distinct ranges.
+
+private:
+	using Key = std::array<unsigned char,16U> ;
+	struct Node /// A radix tree node, holding a prefix of 'm_bits' bits.
+	{
+		Key m_key {} ;
+		unsigned int m_bits {0U} ;
+		std::array<unsigned int,2U> m_child {{0U,0U}} ; // zero if none
+		std::size_t m_value {npos} ;
+	} ;
+
+private:
+	static bool parse( std::string_view , bool & is6 , Key & , unsigned int & bits ) ;
+	static bool parseAddress( std::string_view , bool & is6 , Key & ) ;
+	static void keyOf( const Address & , Key & ) ;
+	bool insert( unsigned int root , const Key & , unsigned int bits , std::size_t value ) ;
+	std::size_t find( unsigned int root , const Key & , unsigned int bits ) const ;
+	unsigned int newNode( const Key & , unsigned int bits , std::size_t value ) ;
+	static unsigned int bit( const Key & , unsigned int ) noexcept ;
+	static unsigned int common( const Key & , const Key & , unsigned int limit ) noexcept ;
+	static void mask( Key & , unsigned int bits ) noexcept ;
+
+private:
+	std::vector<Node> m_nodes ; // IPv4 root at zero, IPv6 root at one
+	std::size_t m_size {0U} ;
+} ;
+
+#endif
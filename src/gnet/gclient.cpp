@@ -30,10 +30,49 @@
 #include "gassert.h"
 #include "gtest.h"
 #include "glog.h"
+#include <algorithm>
 #include <numeric>
 #include <sstream>
 #include <cstdlib>
 
+//| \class GNet::Client::Attempt
+/// One of several parallel connection attempts made by GNet::Client
+/// when name lookup returns more than one address. The successful
+/// attempt's socket is handed over to the Client with release().
+///
+class GNet::Client::Attempt : public EventHandler
+{
+public:
+	Attempt( Client & , EventState , const Address & , const Config & ) ;
+		///< Constructor. Starts connecting. Check active() for
+		///< immediate failure.
+
+	bool active() const ;
+		///< Returns true if still connecting.
+
+	Address address() const ;
+		///< Returns the remote address.
+
+	std::string reason() const ;
+		///< Returns the failure reason.
+
+	std::unique_ptr<StreamSocket> release() ;
+		///< Relinquishes the connected socket.
+
+private: // overrides
+	void writeEvent() override ; // GNet::EventHandler
+	void otherEvent( EventHandler::Reason ) override ; // GNet::EventHandler
+
+private:
+	void close() noexcept ;
+
+private:
+	Client & m_client ;
+	Address m_address ;
+	std::unique_ptr<StreamSocket> m_socket ;
+	std::string m_reason ;
+} ;
+
 GNet::Client::Client( EventState es , const Location & remote , const Config & config ) :
 	m_es(es) ,
 	m_config(config) ,
@@ -43,7 +82,8 @@ GNet::Client::Client( EventState es , const Location & remote , const Config & c
 	m_connect_timer(*this,&GNet::Client::onConnectTimeout,es) ,
 	m_connected_timer(*this,&GNet::Client::onConnectedTimeout,es) ,
 	m_response_timer(*this,&GNet::Client::onResponseTimeout,es) ,
-	m_idle_timer(*this,&GNet::Client::onIdleTimeout,es)
+	m_idle_timer(*this,&GNet::Client::onIdleTimeout,es) ,
+	m_attempt_timer(*this,&GNet::Client::onAttemptTimeout,es)
 {
 	G_DEBUG( "Client::ctor" ) ;
 	if( m_config.auto_start )
@@ -66,6 +106,7 @@ void GNet::Client::disconnect()
 	m_connected_timer.cancelTimer() ;
 	m_response_timer.cancelTimer() ;
 	m_idle_timer.cancelTimer() ;
+	m_attempt_timer.cancelTimer() ;
 
 	m_state = State::Disconnected ;
 	m_finished = true ;
@@ -73,6 +114,7 @@ void GNet::Client::disconnect()
 	m_sp.reset() ;
 	m_socket.reset() ;
 	m_resolver.reset() ;
+	m_attempts.clear() ;
 }
 #endif
 
@@ -157,7 +199,7 @@ void GNet::Client::onResolved( std::string error , Location location )
 		throw DnsError( error ) ;
 
 	G_DEBUG( "GNet::Client::onResolved: " << location.displayString() ) ;
-	m_remote_location.update( location.address() ) ;
+	m_remote_location.update( location.address() , location.alternates() ) ;
 	setState( State::Connecting ) ;
 	startConnecting() ;
 }
@@ -169,6 +211,23 @@ void GNet::Client::startConnecting()
 	if( G::Test::enabled("client-slow-connect") )
 		setState( State::Testing ) ;
 
+	// with more than one address make parallel connection attempts
+	//
+	if( m_state == State::Connecting && m_config.connection_attempt_delay_ms )
+	{
+		m_attempt_addresses = attemptAddresses( m_remote_location , m_config ) ;
+		if( m_attempt_addresses.size() > 1U )
+		{
+			m_sp.reset() ;
+			m_socket.reset() ;
+			m_attempts.clear() ;
+			m_attempt_next = 0U ;
+			startAttempt() ;
+			emit( "connecting" ) ;
+			return ;
+		}
+	}
+
 	// create and open a socket
 	//
 	m_sp.reset() ;
@@ -206,6 +265,95 @@ void GNet::Client::startConnecting()
 	}
 }
 
+std::vector<GNet::Address> GNet::Client::attemptAddresses( const Location & location , const Config & config )
+{
+	// interleave the address families, starting with the preferred address (RFC-8305 4)
+	const Address first = location.address() ;
+	std::vector<Address> same ;
+	std::vector<Address> other ;
+	for( const auto & address : location.alternates() )
+	{
+		if( config.bind_local_address && address.af() != config.local_address.af() )
+			continue ;
+		( address.af() == first.af() ? same : other ).push_back( address ) ;
+	}
+	std::vector<Address> result( 1U , first ) ;
+	for( std::size_t i = 0U ; i < std::max(same.size(),other.size()) ; i++ )
+	{
+		if( i < other.size() ) result.push_back( other[i] ) ;
+		if( i < same.size() ) result.push_back( same[i] ) ;
+	}
+	return result ;
+}
+
+void GNet::Client::startAttempt()
+{
+	m_attempt_timer.cancelTimer() ;
+	while( m_attempt_next < m_attempt_addresses.size() )
+	{
+		const Address & address = m_attempt_addresses[m_attempt_next++] ;
+		G_DEBUG( "GNet::Client::startAttempt: connecting to " << address.displayString() ) ;
+		m_attempts.push_back( std::make_unique<Attempt>( *this , m_es , address , m_config ) ) ;
+		if( m_attempts.back()->active() )
+		{
+			unsigned int ms = m_config.connection_attempt_delay_ms ;
+			if( m_attempt_next < m_attempt_addresses.size() )
+				m_attempt_timer.startTimer( ms / 1000U , (ms % 1000U) * 1000U ) ; // -> onAttemptTimeout()
+			return ;
+		}
+		G_DEBUG( "GNet::Client::startAttempt: cannot connect to " << address.displayString() << ": " << m_attempts.back()->reason() ) ;
+	}
+	if( !attempting() )
+	{
+		std::ostringstream ss ;
+		ss << "cannot connect to " << m_remote_location.host() << ":" << m_remote_location.service() << ":" ;
+		for( const auto & attempt : m_attempts )
+			ss << " " << attempt->address().displayString() << " (" << attempt->reason() << ")" ;
+		throw ConnectError( ss.str() ) ;
+	}
+}
+
+bool GNet::Client::attempting() const
+{
+	return std::any_of( m_attempts.begin() , m_attempts.end() ,
+		[](const std::unique_ptr<Attempt> & attempt){return attempt && attempt->active();} ) ;
+}
+
+void GNet::Client::onAttemptTimeout()
+{
+	G_DEBUG( "GNet::Client::onAttemptTimeout: starting next connection attempt" ) ;
+	startAttempt() ;
+}
+
+void GNet::Client::onAttemptFailed()
+{
+	startAttempt() ; // start the next one early, or throw if none left
+}
+
+void GNet::Client::onAttemptConnected( Attempt & winner )
+{
+	G_DEBUG( "GNet::Client::onAttemptConnected: connected to " << winner.address().displayString() ) ;
+	m_attempt_timer.cancelTimer() ;
+	m_remote_location.promote( winner.address() ) ;
+
+	// take the winning socket and abandon the rest -- the winner
+	// itself is kept until later since it is on the call stack
+	//
+	m_socket = winner.release() ;
+	for( auto & attempt : m_attempts )
+	{
+		if( attempt.get() != &winner )
+			attempt.reset() ;
+	}
+	socket().addOtherHandler( *this , m_es ) ;
+
+	EventHandler & eh = *this ;
+	SocketProtocolSink & sp_sink = *this ;
+	m_sp = std::make_unique<SocketProtocol>( eh , m_es , sp_sink , *m_socket , m_config.socket_protocol_config ) ;
+
+	onWriteable() ; // connected, or socksing
+}
+
 void GNet::Client::finish()
 {
 	m_finished = true ;
@@ -529,3 +677,77 @@ GNet::Client::Config & GNet::Client::Config::set_all_timeouts( unsigned int all_
 }
 #endif
 
+
+// ==
+
+GNet::Client::Attempt::Attempt( Client & client , EventState es , const Address & address , const Config & config ) :
+	m_client(client) ,
+	m_address(address) ,
+	m_socket(std::make_unique<StreamSocket>(address.family(),config.stream_socket_config))
+{
+	m_socket->addWriteHandler( *this , es ) ;
+	m_socket->addOtherHandler( *this , es ) ;
+	if( config.bind_local_address )
+	{
+		G::Root claim_root ;
+		m_socket->bind( config.local_address ) ;
+	}
+	if( !m_socket->connect( address ) )
+	{
+		m_reason = m_socket->reason() ;
+		close() ;
+	}
+}
+
+bool GNet::Client::Attempt::active() const
+{
+	return m_socket != nullptr ;
+}
+
+GNet::Address GNet::Client::Attempt::address() const
+{
+	return m_address ;
+}
+
+std::string GNet::Client::Attempt::reason() const
+{
+	return m_reason.empty() ? std::string("abandoned") : m_reason ;
+}
+
+void GNet::Client::Attempt::writeEvent()
+{
+	G_ASSERT( m_socket != nullptr ) ;
+	if( m_socket->getPeerAddress().first )
+	{
+		m_client.onAttemptConnected( *this ) ;
+	}
+	else
+	{
+		m_reason = "connection failed" ;
+		close() ;
+		m_client.onAttemptFailed() ;
+	}
+}
+
+void GNet::Client::Attempt::otherEvent( EventHandler::Reason reason )
+{
+	m_reason = EventHandler::str( reason ) ;
+	close() ;
+	m_client.onAttemptFailed() ;
+}
+
+std::unique_ptr<GNet::StreamSocket> GNet::Client::Attempt::release()
+{
+	G_ASSERT( m_socket != nullptr ) ;
+	m_socket->dropWriteHandler() ;
+	m_socket->dropOtherHandler() ;
+	setDescriptor( Descriptor() ) ; // see EventHandler::dtor
+	m_reason = "connected" ;
+	return std::move( m_socket ) ;
+}
+
+void GNet::Client::Attempt::close() noexcept
+{
+	m_socket.reset() ;
+	setDescriptor( Descriptor() ) ; // see EventHandler::dtor
+}
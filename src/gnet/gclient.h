@@ -42,6 +42,7 @@
 #include "gstr.h"
 #include <string>
 #include <memory>
+#include <vector>
 
 namespace GNet
 {
@@ -63,6 +64,12 @@ namespace GNet
 /// method and possibly fed back to the next Client that connects to the
 /// same host/service in order to implement name lookup cacheing.
 ///
+/// If name lookup returns more than one address then connections are
+/// attempted in parallel, RFC-8305 "happy eyeballs" style: the addresses
+/// are interleaved by address family and each connection attempt is
+/// started after a short delay or as soon as the previous one fails. The
+/// first connection to succeed is used and the others are abandoned.
+///
 /// Received data is delivered through a virtual method onReceive(), with
 /// optional line-buffering.
 ///
@@ -95,6 +102,7 @@ public:
 		unsigned int connection_timeout {0U} ;
 		unsigned int response_timeout {0U} ;
 		unsigned int idle_timeout {0U} ;
+		unsigned int connection_attempt_delay_ms {250U} ; // zero to connect to the first resolved address only
 		bool no_throw_on_peer_disconnect {false} ; // call SocketProtocolSink::onPeerDisconnect() instead
 
 		Config & set_stream_socket_config( const StreamSocket::Config & ) ;
@@ -107,6 +115,7 @@ public:
 		Config & set_connection_timeout( unsigned int ) noexcept ;
 		Config & set_response_timeout( unsigned int ) noexcept ;
 		Config & set_idle_timeout( unsigned int ) noexcept ;
+		Config & set_connection_attempt_delay_ms( unsigned int ) noexcept ;
 		Config & set_all_timeouts( unsigned int ) noexcept ;
 		Config & set_no_throw_on_peer_disconnect( bool = true ) noexcept ;
 	} ;
@@ -273,6 +282,8 @@ public:
 	bool send( const std::string & , std::size_t ) = delete ;
 
 private:
+	class Attempt ;
+	friend class Attempt ;
 	enum class State
 	{
 		Idle ,
@@ -286,6 +297,12 @@ private:
 	bool onDataImp( const char * , std::size_t , std::size_t , std::size_t , char ) ;
 	void emit( const std::string & ) ;
 	void startConnecting() ;
+	void startAttempt() ;
+	void onAttemptTimeout() ;
+	void onAttemptConnected( Attempt & ) ;
+	void onAttemptFailed() ;
+	bool attempting() const ;
+	static std::vector<Address> attemptAddresses( const Location & , const Config & ) ;
 	void bindLocalAddress( const Address & ) ;
 	void setState( State ) ;
 	void onStartTimeout() ;
@@ -314,6 +331,10 @@ private:
 	Timer<Client> m_connected_timer ;
 	Timer<Client> m_response_timer ;
 	Timer<Client> m_idle_timer ;
+	Timer<Client> m_attempt_timer ;
+	std::vector<Address> m_attempt_addresses ;
+	std::size_t m_attempt_next {0U} ;
+	std::vector<std::unique_ptr<Attempt>> m_attempts ;
 	G::Slot::Signal<const std::string&,const std::string&,const std::string&> m_event_signal ;
 	std::string m_event_logging_string ;
 } ;
@@ -328,6 +349,7 @@ inline GNet::Client::Config & GNet::Client::Config::set_local_address( const Add
 inline GNet::Client::Config & GNet::Client::Config::set_connection_timeout( unsigned int t ) noexcept { connection_timeout = t ; return *this ; }
 inline GNet::Client::Config & GNet::Client::Config::set_response_timeout( unsigned int t ) noexcept { response_timeout = t ; return *this ; }
 inline GNet::Client::Config & GNet::Client::Config::set_idle_timeout( unsigned int t ) noexcept { idle_timeout = t ; return *this ; }
+inline GNet::Client::Config & GNet::Client::Config::set_connection_attempt_delay_ms( unsigned int ms ) noexcept { connection_attempt_delay_ms = ms ; return *this ; }
 inline GNet::Client::Config & GNet::Client::Config::set_no_throw_on_peer_disconnect( bool b ) noexcept { no_throw_on_peer_disconnect = b ; return *this ; }
 
 #endif
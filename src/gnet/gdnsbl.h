@@ -25,6 +25,7 @@
 #include "geventstate.h"
 #include "gaddress.h"
 #include "gstringview.h"
+#include "gstringarray.h"
 #include <functional>
 #include <memory>
 
@@ -56,6 +57,9 @@ public:
 	static void checkConfig( const std::string & ) ;
 		///< See DnsBlock::checkConfig().
 
+	static G::StringArray allowList( std::string_view config ) ;
+		///< See DnsBlock::allowList().
+
 public:
 	Dnsbl( const Dnsbl & ) = delete ;
 	Dnsbl( Dnsbl && ) = delete ;
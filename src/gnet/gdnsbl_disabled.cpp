@@ -49,3 +49,8 @@ void GNet::Dnsbl::checkConfig( const std::string & config )
 	if( !config.empty() )
 		throw G::Exception( "dnsbl has been disabled in this build" ) ;
 }
+
+G::StringArray GNet::Dnsbl::allowList( std::string_view )
+{
+	return {} ;
+}
@@ -64,3 +64,7 @@ void GNet::Dnsbl::checkConfig( const std::string & config )
 	DnsBlock::checkConfig( config ) ;
 }
 
+G::StringArray GNet::Dnsbl::allowList( std::string_view config )
+{
+	return DnsBlock::allowList( config ) ;
+}
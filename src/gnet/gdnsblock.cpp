@@ -21,9 +21,11 @@
 #include "gdef.h"
 #include "gdnsblock.h"
 #include "gdnsmessage.h"
+#include "gdnsclient.h"
+#include "gaddresstree.h"
 #include "gresolver.h"
-#include "gnameservers.h"
 #include "glocal.h"
+#include "gmetrics.h"
 #include "gstr.h"
 #include "gtest.h"
 #include "gassert.h"
@@ -38,6 +40,7 @@ namespace GNet
 	{
 		static constexpr std::string_view default_timeout_ms {"5000",4U} ;
 		static constexpr unsigned int default_threshold {1U} ;
+		G::Metrics::Histogram latency( "emailrelay_dnsbl_duration_seconds" , "" , "DNSBL query latency" ) ;
 
 		struct HostList /// A streamable adaptor for a list of addresses.
 		{
@@ -76,6 +79,12 @@ GNet::DnsBlock::DnsBlock( DnsBlockCallback & callback , EventState es , std::str
 		configure( config ) ;
 }
 
+GNet::DnsBlock::~DnsBlock()
+{
+	if( m_dns )
+		m_dns->cancel( *this ) ;
+}
+
 void GNet::DnsBlock::checkConfig( const std::string & config )
 {
 	try
@@ -93,14 +102,33 @@ void GNet::DnsBlock::configure( std::string_view config )
 	configureImp( config , this ) ;
 }
 
+G::StringArray GNet::DnsBlock::allowList( std::string_view config )
+{
+	G::StringArray result ;
+	for( const auto & field : G::Str::splitIntoFields( config , ',' ) )
+	{
+		if( !field.empty() && field[0] == '!' )
+			result.push_back( field.substr(1U) ) ;
+	}
+	return result ;
+}
+
 void GNet::DnsBlock::configureImp( std::string_view config , DnsBlock * dnsblock_p )
 {
 	// allow old format
 	//  tcp-address,timeout,threshold,domain[,domain...]
 	// or new
 	//  domain[,domain...[,threshold[,timeout[,tcp-address]]]]
+	// with "!<address-range>" allowlist fields anywhere
 
 	G::StringArray list = G::Str::splitIntoFields( config , ',' ) ;
+	for( const auto & range : allowList(config) )
+	{
+		if( !AddressTree::validRange(range) )
+			throw ConfigError( "invalid allowlist address range" , range ) ;
+	}
+	list.erase( std::remove_if( list.begin() , list.end() ,
+		[](const std::string & field){return !field.empty() && field[0] == '!';} ) , list.end() ) ;
 	if( list.empty() )
 		throw BadFieldCount() ;
 
@@ -152,15 +180,10 @@ void GNet::DnsBlock::configure( const Address & dns_server , unsigned int thresh
 	m_timeout = timeout ;
 }
 
-GNet::Address GNet::DnsBlock::nameServerAddress()
-{
-	std::vector<Address> list = GNet::nameservers() ;
-	return list.empty() ? Address::loopback( Address::Family::ipv4 , 53U ) : list[0] ;
-}
-
 GNet::Address GNet::DnsBlock::nameServerAddress( const std::string & s )
 {
-	return s.empty() ? nameServerAddress() : Address::parse(s,Address::NotLocal()) ;
+	// the default address means the system's nameservers in rotation
+	return s.empty() ? Address::defaultAddress() : Address::parse(s,Address::NotLocal()) ;
 }
 
 bool GNet::DnsBlock::isDomain( std::string_view s ) noexcept
@@ -187,7 +210,8 @@ unsigned int GNet::DnsBlock::ms( std::string_view s )
 
 void GNet::DnsBlock::start( const Address & address )
 {
-	G_DEBUG( "GNet::DnsBlock::start: dns-server=" << m_dns_server.displayString() << " "
+	G_DEBUG( "GNet::DnsBlock::start: dns-server="
+		<< (m_dns_server==Address::defaultAddress()?std::string("default"):m_dns_server.displayString()) << " "
 		<< "threshold=" << m_threshold << " "
 		<< "timeout=" << m_timeout << "(" << m_allow_on_timeout << ") "
 		<< "address=" << address.hostPartString() << " "
@@ -204,36 +228,22 @@ void GNet::DnsBlock::start( const Address & address )
 		return ;
 	}
 
-	// re-base the sequence number if necessary
-	static unsigned int id_generator = 10 ;
-	if( (id_generator+m_servers.size()) > 65535U )
-		id_generator = 10 ;
-
-	// create a socket to receive responses
-	int protocol = 0 ;
-	DatagramSocket::Config datagram_socket_config ;
-	m_socket_ptr = std::make_unique<DatagramSocket>( m_dns_server.family() , protocol , datagram_socket_config ) ;
-	m_socket_ptr->addReadHandler( *this , m_es ) ;
+	if( !m_dns )
+		m_dns = DnsClient::instance() ;
 
-	// send a DNS query to each configured server
+	// send a DNS query for each configured server, tagged with the server index
 	std::string prefix = queryString( address ) ; // eg. "1.0.0.127"
-	unsigned int id = m_id_base = id_generator ;
-	for( G::StringArray::const_iterator server_p = m_servers.begin() ; server_p != m_servers.end() ;
-		++server_p , id++ , id_generator++ )
+	for( std::size_t i = 0U ; i < m_servers.size() ; i++ )
 	{
-		std::string server = G::Str::trimmed( *server_p , G::Str::ws() ) ;
+		std::string server = G::Str::trimmed( m_servers[i] , G::Str::ws() ) ;
 
 		m_result.add( DnsBlockServerResult(server) ) ;
 
 		const char * type = address.family() == Address::Family::ipv4 ? "A" : "AAAA" ;
-		DnsMessage message = DnsMessage::request( type , std::string(prefix).append(1U,'.').append(server) , id ) ;
-		G_DEBUG( "GNet::DnsBlock::start: sending [" << prefix << "."
-			<< server << "] to [" << m_dns_server.displayString() << "]: id " << id ) ;
-
-		ssize_t rc = m_socket_ptr->writeto( message.p() , message.n() , m_dns_server ) ;
-		if( rc < 0 || static_cast<std::size_t>(rc) != message.n() )
-			throw SendError( m_socket_ptr->reason() ) ;
+		G_DEBUG( "GNet::DnsBlock::start: sending [" << prefix << "." << server << "]" ) ;
+		m_dns->query( *this , m_es , static_cast<unsigned int>(i) , type , std::string(prefix).append(1U,'.').append(server) , m_dns_server ) ;
 	}
+	m_start_time = G::TimerTime::now() ;
 	m_timer.startTimer( m_timeout ) ;
 }
 
@@ -242,25 +252,16 @@ bool GNet::DnsBlock::busy() const
 	return m_timer.active() ;
 }
 
-void GNet::DnsBlock::readEvent()
+void GNet::DnsBlock::onDnsResponse( unsigned int index , const DnsMessage & message )
 {
-	static std::vector<char> buffer;
-	buffer.resize( 4096U ) ; // 512 in RFC-1035 4.2.1
-	ssize_t rc = m_socket_ptr->read( buffer.data() , buffer.size() ) ;
-	if( rc <= 0 || static_cast<std::size_t>(rc) >= buffer.size() )
-		throw BadDnsResponse() ;
-	buffer.resize( static_cast<std::size_t>(rc) ) ;
-
-	DnsMessage message( buffer ) ;
-	if( !message.valid() || !message.QR() || message.ID() < m_id_base ||
-		message.ID() >= (m_id_base+m_servers.size()) || message.RCODE() > 5 )
+	if( !message.valid() || !message.QR() || index >= m_result.list().size() || message.RCODE() > 5 )
 	{
-		G_WARNING( "GNet::DnsBlock::readEvent: invalid dns response: qr=" << message.QR()
+		G_WARNING( "GNet::DnsBlock::onDnsResponse: invalid dns response: qr=" << message.QR()
 			<< " rcode=" << message.RCODE() << " id=" << message.ID() ) ;
 		return ;
 	}
 
-	m_result.at(message.ID()-m_id_base).set( message.addresses() ) ;
+	m_result.at(index).set( message.addresses() ) ;
 
 	std::size_t server_count = m_result.list().size() ;
 	std::size_t responder_count = countResponders( m_result.list() ) ;
@@ -269,7 +270,7 @@ void GNet::DnsBlock::readEvent()
 
 	G_ASSERT( laggard_count < server_count ) ;
 
-	G_DEBUG( "GNet::DnsBlock::readEvent: id=" << message.ID() << " rcode=" << message.RCODE()
+	G_DEBUG( "GNet::DnsBlock::onDnsResponse: index=" << index << " rcode=" << message.RCODE()
 		<< (message.ANCOUNT()?" deny ":" allow ")
 		<< "got=" << responder_count << "/" << server_count << " deny-count=" << deny_count << "/" << m_threshold ) ;
 
@@ -280,8 +281,9 @@ void GNet::DnsBlock::readEvent()
 
 	if( finished )
 	{
-		m_socket_ptr.reset() ;
+		m_dns->cancel( *this ) ;
 		m_timer.cancelTimer() ;
+		DnsBlockImp::latency.observe( m_start_time ) ;
 		m_result.type() = ( m_threshold && deny_count >= m_threshold ) ?
 			DnsBlockResult::Type::Deny :
 			DnsBlockResult::Type::Allow ;
@@ -291,7 +293,10 @@ void GNet::DnsBlock::readEvent()
 
 void GNet::DnsBlock::onTimeout()
 {
-	m_socket_ptr.reset() ;
+	if( m_dns )
+		m_dns->cancel( *this ) ;
+	if( !m_result.list().empty() )
+		DnsBlockImp::latency.observe( m_start_time ) ;
 	m_result.type() = m_result.list().empty() ?
 		( m_servers.empty() ? DnsBlockResult::Type::Inactive : DnsBlockResult::Type::Local ) :
 		( m_allow_on_timeout ? DnsBlockResult::Type::TimeoutAllow : DnsBlockResult::Type::TimeoutDeny ) ;
@@ -24,12 +24,11 @@
 #include "gdef.h"
 #include "gaddress.h"
 #include "gdatetime.h"
-#include "geventhandler.h"
+#include "gdnsclient.h"
 #include "geventstate.h"
 #include "gexception.h"
 #include "gstringarray.h"
 #include "gtimer.h"
-#include "gsocket.h"
 #include "gstringview.h"
 #include <memory>
 #include <vector>
@@ -139,17 +138,17 @@ private:
 /// sends DNS requests for each configured block-list server
 /// incorporating the IP address to be tested, for example
 /// "1.0.168.192.nospam.com". All requests go to the same DNS
-/// server and are cached or routed in the normal way, so the
-/// block-list servers are not contacted directly.
+/// server, or the system's nameservers in rotation, and are cached
+/// or routed in the normal way, so the block-list servers are not
+/// contacted directly. The requests are sent using the shared
+/// GNet::DnsClient.
 ///
-class GNet::DnsBlock : private EventHandler
+class GNet::DnsBlock : private DnsClientCallback
 {
 public:
 	G_EXCEPTION( Error , tx("dnsbl error") )
 	G_EXCEPTION( ConfigError , tx("invalid dnsbl configuration") )
 	G_EXCEPTION( BadFieldCount , tx("not enough comma-sparated fields") )
-	G_EXCEPTION( SendError , tx("socket send failed") )
-	G_EXCEPTION( BadDnsResponse , tx("invalid dns response") )
 	using ResultList = std::vector<DnsBlockServerResult> ;
 
 	DnsBlock( DnsBlockCallback & , EventState , std::string_view config = {} ) ;
@@ -168,6 +167,12 @@ public:
 	static void checkConfig( const std::string & ) ;
 		///< Checks the configure() string, throwing on error.
 
+	static G::StringArray allowList( std::string_view config ) ;
+		///< Returns the allowlist address ranges from the configure()
+		///< string. Allowlist ranges are fields with a leading "!",
+		///< eg. "!192.168.0.0/16", anywhere in the configuration
+		///< string; they are ignored by configure() itself.
+
 	void start( const Address & ) ;
 		///< Starts an asychronous check on the given address. The result
 		///< is delivered via the callback interface passed to the ctor.
@@ -176,14 +181,14 @@ public:
 		///< Returns true after start() and before the completion callback.
 
 public:
-	~DnsBlock() override = default ;
+	~DnsBlock() override ;
 	DnsBlock( const DnsBlock & ) = delete ;
 	DnsBlock( DnsBlock && ) = delete ;
 	DnsBlock & operator=( const DnsBlock & ) = delete ;
 	DnsBlock & operator=( DnsBlock && ) = delete ;
 
 private: // overrides
-	void readEvent() override ; // Override from GNet::EventHandler.
+	void onDnsResponse( unsigned int , const DnsMessage & ) override ; // GNet::DnsClientCallback
 
 private:
 	static void configureImp( std::string_view , DnsBlock * ) ;
@@ -191,7 +196,6 @@ private:
 	static std::string queryString( const Address & ) ;
 	static std::size_t countResponders( const ResultList & ) ;
 	static std::size_t countDeniers( const ResultList & ) ;
-	static Address nameServerAddress() ;
 	static Address nameServerAddress( const std::string & ) ;
 	static bool isDomain( std::string_view ) noexcept ;
 	static bool isPositive( std::string_view ) noexcept ;
@@ -207,8 +211,8 @@ private:
 	Address m_dns_server ;
 	G::TimeInterval m_timeout {0U} ;
 	DnsBlockResult m_result ;
-	unsigned int m_id_base {0U} ;
-	std::unique_ptr<DatagramSocket> m_socket_ptr ;
+	G::TimerTime m_start_time {G::TimerTime::zero()} ;
+	std::shared_ptr<DnsClient> m_dns ;
 } ;
 
 //| \class GNet::DnsBlockCallback
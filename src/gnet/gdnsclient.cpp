@@ -0,0 +1,465 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gdnsclient.cpp
+///
+
+#include "gdef.h"
+#include "gdnsclient.h"
+#include "gclient.h"
+#include "geventloggingcontext.h"
+#include "gnameservers.h"
+#include "gnetdone.h"
+#include "gmetrics.h"
+#include "grandom.h"
+#include "gstr.h"
+#include "gassert.h"
+#include "glog.h"
+#include <algorithm>
+
+namespace GNet
+{
+	namespace DnsClientImp
+	{
+		constexpr unsigned int tcp_timeout = 10U ;
+		constexpr std::size_t udp_size_limit = 4096U ; // 512 in RFC-1035 4.2.1
+		constexpr std::size_t pool_size = 4U ; // sockets per address family
+		constexpr unsigned int socket_queries_limit = 100U ; // queries before a socket is replaced
+		constexpr unsigned int bind_attempts = 10U ;
+		G::Metrics::Counter queries_udp( "emailrelay_dns_queries_total" , "transport=\"udp\"" , "DNS queries sent" ) ;
+		G::Metrics::Counter queries_tcp( "emailrelay_dns_queries_total" , "transport=\"tcp\"" , "DNS queries sent" ) ;
+		G::Metrics::Counter queries_shared( "emailrelay_dns_queries_shared_total" , "" , "DNS queries answered by another in-flight query" ) ;
+		std::string lowercase( std::string s )
+		{
+			G::Str::toLower( s ) ;
+			if( !s.empty() && s.back() == '.' )
+				s.pop_back() ;
+			return s ;
+		}
+	}
+}
+
+//| \class GNet::DnsClientTcp
+/// A GNet::Client that repeats a truncated DNS query over TCP, as per
+/// RFC-1035 4.2.2. The response is stored into the owning
+/// DnsClient::Pending structure and the client then finishes itself
+/// by throwing GNet::Done.
+///
+class GNet::DnsClientTcp : public Client
+{
+public:
+	DnsClientTcp( EventState , const Address & nameserver , const std::string & type ,
+		const std::string & name , unsigned int id , std::vector<char> & response_out ) ;
+
+private: // overrides
+	bool onReceive( const char * , std::size_t , std::size_t , std::size_t , char ) override ;
+	void onConnect() override ;
+	void onSendComplete() override ;
+	void onDelete( const std::string & ) override ;
+	void onSecure( const std::string & , const std::string & , const std::string & ) override ;
+
+private:
+	static Location location( const Address & ) ;
+
+private:
+	std::string m_request ;
+	std::vector<char> m_buffer ;
+	std::vector<char> & m_response ;
+} ;
+
+GNet::DnsClientTcp::DnsClientTcp( EventState es , const Address & nameserver , const std::string & type ,
+	const std::string & name , unsigned int id , std::vector<char> & response_out ) :
+		Client(es,location(nameserver),
+			Client::Config()
+				.set_line_buffer_config(LineBuffer::Config::transparent())
+				.set_connection_timeout(DnsClientImp::tcp_timeout)
+				.set_response_timeout(DnsClientImp::tcp_timeout)) ,
+		m_response(response_out)
+{
+	DnsMessageRequest request( type , name , id ) ;
+	m_request.reserve( request.n() + 2U ) ;
+	m_request.append( 1U , static_cast<char>((request.n()>>8U)&0xffU) ) ;
+	m_request.append( 1U , static_cast<char>(request.n()&0xffU) ) ;
+	m_request.append( request.p() , request.n() ) ;
+}
+
+GNet::Location GNet::DnsClientTcp::location( const Address & nameserver )
+{
+	return Location::nosocks( nameserver.hostPartString() + ":" + G::Str::fromUInt(nameserver.port()) ) ;
+}
+
+void GNet::DnsClientTcp::onConnect()
+{
+	send( m_request ) ;
+}
+
+bool GNet::DnsClientTcp::onReceive( const char * p , std::size_t n , std::size_t , std::size_t , char )
+{
+	m_buffer.insert( m_buffer.end() , p , p+n ) ;
+	if( m_buffer.size() >= 2U )
+	{
+		std::size_t size = ( static_cast<std::size_t>(static_cast<unsigned char>(m_buffer[0])) << 8U ) |
+			static_cast<std::size_t>(static_cast<unsigned char>(m_buffer[1])) ;
+		if( m_buffer.size() >= (size+2U) )
+		{
+			m_response.assign( m_buffer.begin()+2U , m_buffer.begin()+2U+size ) ; // NOLINT narrowing
+			finish() ;
+			throw GNet::Done() ;
+		}
+	}
+	return true ;
+}
+
+void GNet::DnsClientTcp::onSendComplete()
+{
+}
+
+void GNet::DnsClientTcp::onDelete( const std::string & )
+{
+}
+
+void GNet::DnsClientTcp::onSecure( const std::string & , const std::string & , const std::string & )
+{
+}
+
+// ==
+
+std::shared_ptr<GNet::DnsClient> GNet::DnsClient::instance()
+{
+	static thread_local std::weak_ptr<DnsClient> weak_instance ;
+	std::shared_ptr<DnsClient> ptr = weak_instance.lock() ;
+	if( !ptr )
+	{
+		ptr = std::make_shared<DnsClient>() ;
+		ptr->m_self = ptr ;
+		weak_instance = ptr ;
+	}
+	return ptr ;
+}
+
+GNet::DnsClient::DnsClient() :
+	m_es(EventState::create(std::nothrow)) ,
+	m_nameservers(GNet::nameservers(53U)) ,
+	m_sockets(DnsClientImp::pool_size*2U) ,
+	m_collect_timer(*this,&DnsClient::onCollectTimeout,m_es)
+{
+	if( m_nameservers.empty() )
+		m_nameservers.push_back( Address::loopback( Address::Family::ipv4 , 53U ) ) ;
+}
+
+GNet::DnsClient::~DnsClient()
+= default ;
+
+std::size_t GNet::DnsClient::pending() const noexcept
+{
+	return m_pending.size() ;
+}
+
+std::string GNet::DnsClient::key( const std::string & type , const std::string & name , const Address & nameserver )
+{
+	return std::string(type).append(1U,' ').append(DnsClientImp::lowercase(name)).append(1U,' ')
+		.append( nameserver == Address::defaultAddress() ? std::string(1U,'*') : nameserver.displayString() ) ;
+}
+
+void GNet::DnsClient::query( DnsClientCallback & callback , EventState es , unsigned int tag ,
+	const std::string & type , const std::string & name , const Address & nameserver )
+{
+	std::string query_key = key( type , name , nameserver ) ;
+	auto key_p = m_keys.find( query_key ) ;
+	if( key_p != m_keys.end() )
+	{
+		G_DEBUG( "GNet::DnsClient::query: sharing in-flight query: [" << query_key << "]" ) ;
+		DnsClientImp::queries_shared.add() ;
+		m_pending.at((*key_p).second)->m_waiters.push_back( {&callback,es,tag} ) ;
+		return ;
+	}
+
+	Address address = nameserver == Address::defaultAddress() ? nextNameserver() : nameserver ;
+	std::shared_ptr<Socket> socket_ptr = socket( address.family() ) ;
+	unsigned int id = newId( *socket_ptr ) ;
+	DnsMessageRequest request( type , name , id ) ;
+	G_DEBUG( "GNet::DnsClient::query: sending [" << type << " " << name << "] "
+		<< "to [" << address.displayString() << "]: socket " << socket_ptr->m_serial << ": id " << id ) ;
+
+	PendingKey pending_key( socket_ptr->m_serial , id ) ;
+	auto pending = std::make_unique<Pending>( *this , socket_ptr , id , query_key , type , name , address ) ;
+	DatagramSocket & socket = socket_ptr->m_socket ;
+	ssize_t rc = socket.writeto( request.p() , request.n() , address ) ;
+	if( rc < 0 || static_cast<std::size_t>(rc) != request.n() )
+		throw SendError( socket.reason() ) ;
+	DnsClientImp::queries_udp.add() ;
+
+	pending->m_waiters.push_back( {&callback,es,tag} ) ;
+	m_pending[pending_key] = std::move( pending ) ;
+	m_keys[query_key] = pending_key ;
+}
+
+void GNet::DnsClient::cancel( DnsClientCallback & callback ) noexcept
+{
+	auto is_callback = [&callback](const Waiter & w_){return w_.m_callback == &callback;} ;
+	if( m_delivering != nullptr )
+	{
+		for( auto & waiter : *m_delivering )
+		{
+			if( is_callback(waiter) )
+				waiter.m_callback = nullptr ;
+		}
+	}
+	for( auto p = m_pending.begin() ; p != m_pending.end() ; )
+	{
+		auto & waiters = (*p).second->m_waiters ;
+		waiters.erase( std::remove_if( waiters.begin() , waiters.end() , is_callback ) , waiters.end() ) ;
+		if( waiters.empty() )
+		{
+			auto next = std::next( p ) ;
+			remove( p ) ;
+			p = next ;
+		}
+		else
+		{
+			++p ;
+		}
+	}
+}
+
+void GNet::DnsClient::remove( PendingMap::iterator p )
+{
+	m_keys.erase( (*p).second->m_key ) ;
+	m_pending.erase( p ) ;
+}
+
+unsigned int GNet::DnsClient::newId( const Socket & socket ) const
+{
+	unsigned int id = 0U ;
+	do
+	{
+		id = G::Random::secureRand( 0U , 65535U ) ;
+	} while( m_pending.find(PendingKey(socket.m_serial,id)) != m_pending.end() ) ;
+	return id ;
+}
+
+std::shared_ptr<GNet::DnsClient::Socket> GNet::DnsClient::socket( Address::Family family )
+{
+	// round-robin over the family's half of the pool -- a worn-out
+	// socket is replaced in the pool but stays open until its
+	// outstanding queries are finished with
+	std::size_t offset = family == Address::Family::ipv6 ? DnsClientImp::pool_size : 0U ;
+	std::shared_ptr<Socket> & slot = m_sockets.at( offset + (m_socket_index++ % DnsClientImp::pool_size) ) ;
+	if( !slot || slot->m_queries >= DnsClientImp::socket_queries_limit )
+	{
+		slot = std::make_shared<Socket>( *this , ++m_socket_serial , family , m_es ) ;
+		G_DEBUG( "GNet::DnsClient::socket: new dns socket " << slot->m_serial << ": "
+			<< slot->m_socket.getLocalAddress().displayString() ) ;
+	}
+	slot->m_queries++ ;
+	return slot ;
+}
+
+void GNet::DnsClient::bindRandom( DatagramSocket & socket , Address::Family family )
+{
+	// choose our own random source port rather than relying on
+	// the kernel's ephemeral port allocation
+	for( unsigned int i = 0U ; i < DnsClientImp::bind_attempts ; i++ )
+	{
+		if( socket.bind( Address(family,G::Random::secureRand(1024U,65535U)) , std::nothrow ) )
+			return ;
+	}
+	G_DEBUG( "GNet::DnsClient::bindRandom: using an ephemeral port" ) ;
+}
+
+GNet::Address GNet::DnsClient::nextNameserver()
+{
+	G_ASSERT( !m_nameservers.empty() ) ;
+	if( m_nameserver_index >= m_nameservers.size() )
+		m_nameserver_index = 0U ;
+	return m_nameservers[m_nameserver_index++] ;
+}
+
+void GNet::DnsClient::readSocket( Socket & socket_ )
+{
+	// keep alive in case a callback drops the last reference
+	std::shared_ptr<DnsClient> keep_alive = m_self.lock() ;
+
+	m_buffer.resize( DnsClientImp::udp_size_limit ) ;
+	Address source = Address::defaultAddress() ;
+	DatagramSocket & socket = socket_.m_socket ;
+	ssize_t rc = socket.readfrom( m_buffer.data() , m_buffer.size() , source ) ;
+	if( rc <= 0 || static_cast<std::size_t>(rc) >= m_buffer.size() )
+	{
+		G_WARNING( "GNet::DnsClient::readSocket: invalid dns response: " << (rc<0?socket.reason():std::string("bad size")) ) ;
+		return ;
+	}
+	m_buffer.resize( static_cast<std::size_t>(rc) ) ;
+
+	DnsMessage message( m_buffer ) ;
+	auto p = m_buffer.size() >= 12U ? m_pending.find( PendingKey(socket_.m_serial,message.ID()) ) : m_pending.end() ;
+	if( p == m_pending.end() || !message.QR() || source != (*p).second->m_nameserver || !matches(*(*p).second,message) )
+	{
+		G_DEBUG( "GNet::DnsClient::readSocket: ignoring unexpected dns response from " << source.displayString() ) ;
+		return ;
+	}
+
+	Pending & pending = *(*p).second ;
+	if( pending.m_tcp.busy() || pending.m_tcp_done )
+	{
+		G_DEBUG( "GNet::DnsClient::readSocket: ignoring duplicate dns response: id " << message.ID() ) ;
+	}
+	else if( message.TC() )
+	{
+		G_DEBUG( "GNet::DnsClient::readSocket: truncated dns response: id " << message.ID() ) ;
+		pending.m_truncated = m_buffer ;
+		startTcp( pending ) ;
+	}
+	else
+	{
+		deliver( (*p).first , m_buffer ) ;
+	}
+}
+
+bool GNet::DnsClient::matches( const Pending & pending , const DnsMessage & message ) const
+{
+	try
+	{
+		if( message.QDCOUNT() != 1U )
+			return false ;
+		DnsMessageQuestion question = message.question( 0U ) ;
+		return
+			question.qtype() == DnsMessageRecordType::value( pending.m_type , std::nothrow ) &&
+			DnsClientImp::lowercase( question.qname() ) == DnsClientImp::lowercase( pending.m_name ) ;
+	}
+	catch( std::exception & )
+	{
+		return false ;
+	}
+}
+
+void GNet::DnsClient::startTcp( Pending & pending )
+{
+	try
+	{
+		pending.m_tcp.reset( std::make_unique<DnsClientTcp>( m_es.eh(pending.m_tcp) ,
+			pending.m_nameserver , pending.m_type , pending.m_name , pending.m_id , pending.m_tcp_response ) ) ;
+		DnsClientImp::queries_tcp.add() ;
+	}
+	catch( std::exception & e )
+	{
+		G_WARNING( "GNet::DnsClient::startTcp: dns tcp query failed: " << e.what() ) ;
+		std::vector<char> truncated = pending.m_truncated ;
+		deliver( PendingKey(pending.m_socket->m_serial,pending.m_id) , truncated ) ;
+	}
+}
+
+void GNet::DnsClient::Pending::onTcpDeleted( const std::string & reason )
+{
+	// the ClientPtr is still on the stack, so finish up on a timer
+	if( !reason.empty() )
+		G_WARNING( "GNet::DnsClient::Pending::onTcpDeleted: dns tcp query failed: " << reason ) ;
+	m_tcp_done = true ;
+	m_dns.m_collect_timer.startTimer( 0U ) ;
+}
+
+void GNet::DnsClient::onCollectTimeout()
+{
+	std::shared_ptr<DnsClient> keep_alive = m_self.lock() ;
+	std::vector<std::pair<PendingKey,std::vector<char>>> responses ;
+	for( auto & pair : m_pending )
+	{
+		Pending & pending = *pair.second ;
+		if( pending.m_tcp_done )
+			responses.emplace_back( pair.first , pending.m_tcp_response.empty() ? pending.m_truncated : pending.m_tcp_response ) ;
+	}
+	for( const auto & response : responses )
+		deliver( response.first , response.second ) ;
+}
+
+void GNet::DnsClient::deliver( PendingKey pending_key , const std::vector<char> & buffer )
+{
+	auto p = m_pending.find( pending_key ) ;
+	if( p == m_pending.end() )
+		return ;
+
+	// take the waiters and forget the query before any callbacks
+	std::vector<Waiter> waiters ;
+	waiters.swap( (*p).second->m_waiters ) ;
+	remove( p ) ;
+
+	DnsMessage message( buffer ) ;
+	m_delivering = &waiters ;
+	G::ScopeExit _( [this](){m_delivering=nullptr;} ) ;
+	for( std::size_t i = 0U ; i < waiters.size() ; i++ )
+	{
+		if( waiters[i].m_callback == nullptr ) // cancelled by an earlier callback
+			continue ;
+
+		EventState & es = waiters[i].m_es ;
+		EventLoggingContext set_logging_context( es ) ;
+		try
+		{
+			waiters[i].m_callback->onDnsResponse( waiters[i].m_tag , message ) ;
+		}
+		catch( GNet::Done & e )
+		{
+			if( es.hasExceptionHandler() )
+				es.doOnException( e , true ) ;
+			else
+				throw ;
+		}
+		catch( std::exception & e )
+		{
+			if( es.hasExceptionHandler() )
+				es.doOnException( e , false ) ;
+			else
+				throw ;
+		}
+	}
+}
+
+// ==
+
+GNet::DnsClient::Pending::Pending( DnsClient & dns , std::shared_ptr<Socket> socket , unsigned int id ,
+	const std::string & key , const std::string & type , const std::string & name , const Address & nameserver ) :
+		m_dns(dns) ,
+		m_id(id) ,
+		m_key(key) ,
+		m_type(type) ,
+		m_name(name) ,
+		m_nameserver(nameserver) ,
+		m_socket(std::move(socket))
+{
+	m_tcp.deletedSignal().connect( G::Slot::slot(*this,&Pending::onTcpDeleted) ) ;
+}
+
+GNet::DnsClient::Pending::~Pending()
+{
+	m_tcp.deletedSignal().disconnect() ;
+}
+
+// ==
+
+GNet::DnsClient::Socket::Socket( DnsClient & dns , unsigned long serial , Address::Family family , EventState es ) :
+	m_dns(dns) ,
+	m_serial(serial) ,
+	m_socket(family,0,DatagramSocket::Config(GNet::Socket::Config().set_bind_reuse(false)))
+{
+	bindRandom( m_socket , family ) ;
+	m_socket.addReadHandler( *this , es ) ;
+}
+
+void GNet::DnsClient::Socket::readEvent()
+{
+	m_dns.readSocket( *this ) ; // may delete this
+}
@@ -0,0 +1,199 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gdnsclient.h
+///
+
+#ifndef G_NET_DNS_CLIENT_H
+#define G_NET_DNS_CLIENT_H
+
+#include "gdef.h"
+#include "gaddress.h"
+#include "gdnsmessage.h"
+#include "geventhandler.h"
+#include "geventstate.h"
+#include "gexception.h"
+#include "gsocket.h"
+#include "gtimer.h"
+#include "gclientptr.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace GNet
+{
+	class DnsClient ;
+	class DnsClientCallback ;
+	class DnsClientTcp ;
+}
+
+//| \class GNet::DnsClient
+/// An asynchronous DNS stub resolver that is shared by all the DNS users
+/// running on the same event-loop thread, such as GNet::DnsBlock and
+/// GFilters::MxLookup.
+///
+/// Queries are sent from a small pool of UDP sockets, each bound to
+/// a random source port, and each socket is replaced by a new one on
+/// a new port after it has been used for a limited number of queries.
+/// Transaction ids come from the operating system's cryptographic
+/// random source and a response is only accepted if it arrives on the
+/// query's socket from the query's nameserver with the query's id and
+/// question. Identical queries to the same nameserver that are in
+/// flight at the same time are sent only once and the response is
+/// delivered to all of them. Truncated responses are retried over TCP.
+///
+/// There are no timeouts or retries at this level. Users should
+/// cancel() their queries if there is no timely response.
+///
+/// \code
+/// struct Foo : DnsClientCallback
+/// {
+///   Foo( EventState es ) : m_es(es) , m_dns(DnsClient::instance()) {}
+///   ~Foo() { m_dns->cancel( *this ) ; }
+///   void start() { m_dns->query( *this , m_es , 1U , "MX" , "example.com" , Address::defaultAddress() ) ; }
+///   void onDnsResponse( unsigned int tag , const DnsMessage & ) override ;
+///   EventState m_es ;
+///   std::shared_ptr<DnsClient> m_dns ;
+/// } ;
+/// \endcode
+///
+class GNet::DnsClient
+{
+public:
+	G_EXCEPTION( Error , tx("dns error") )
+	G_EXCEPTION( SendError , tx("dns socket send failed") )
+
+	static std::shared_ptr<DnsClient> instance() ;
+		///< Returns a shared reference to the DnsClient for the current
+		///< thread, creating it if necessary. The instance is destroyed
+		///< when the last reference goes away.
+
+	DnsClient() ;
+		///< Constructor. Prefer instance().
+
+	~DnsClient() ;
+		///< Destructor.
+
+	void query( DnsClientCallback & , EventState , unsigned int tag ,
+		const std::string & type , const std::string & name ,
+		const Address & nameserver ) ;
+			///< Starts an asynchronous query. The response is delivered
+			///< to the callback, together with the tag, with any exception
+			///< thrown out of the callback going to the given EventState's
+			///< exception handler. If the nameserver address is
+			///< Address::defaultAddress() then the system's nameservers
+			///< are used in rotation. Throws on error.
+
+	void cancel( DnsClientCallback & ) noexcept ;
+		///< Cancels all of the callback's queries.
+
+	std::size_t pending() const noexcept ;
+		///< Returns the number of queries waiting for a response.
+
+public:
+	DnsClient( const DnsClient & ) = delete ;
+	DnsClient( DnsClient && ) = delete ;
+	DnsClient & operator=( const DnsClient & ) = delete ;
+	DnsClient & operator=( DnsClient && ) = delete ;
+
+private:
+	struct Waiter /// A query user waiting for a response.
+	{
+		DnsClientCallback * m_callback ;
+		EventState m_es ;
+		unsigned int m_tag ;
+	} ;
+	struct Socket : EventHandler /// A pooled UDP socket with its read handler.
+	{
+		Socket( DnsClient & , unsigned long serial , Address::Family , EventState ) ;
+		void readEvent() override ;
+		DnsClient & m_dns ;
+		unsigned long m_serial ;
+		unsigned int m_queries {0U} ;
+		DatagramSocket m_socket ;
+	} ;
+	using PendingKey = std::pair<unsigned long,unsigned int> ; // socket serial, id
+	struct Pending /// An in-flight query.
+	{
+		Pending( DnsClient & , std::shared_ptr<Socket> , unsigned int id , const std::string & key ,
+			const std::string & type , const std::string & name , const Address & nameserver ) ;
+		~Pending() ;
+		void onTcpDeleted( const std::string & ) ;
+		DnsClient & m_dns ;
+		unsigned int m_id ;
+		std::string m_key ;
+		std::string m_type ;
+		std::string m_name ;
+		Address m_nameserver ;
+		std::shared_ptr<Socket> m_socket ;
+		std::vector<Waiter> m_waiters ;
+		std::vector<char> m_truncated ;
+		std::vector<char> m_tcp_response ;
+		ClientPtr<DnsClientTcp> m_tcp ;
+		bool m_tcp_done {false} ;
+		Pending( const Pending & ) = delete ;
+		Pending( Pending && ) = delete ;
+		Pending & operator=( const Pending & ) = delete ;
+		Pending & operator=( Pending && ) = delete ;
+	} ;
+	using PendingMap = std::map<PendingKey,std::unique_ptr<Pending>> ;
+
+private:
+	friend class DnsClientTcp ;
+	static std::string key( const std::string & type , const std::string & name , const Address & ) ;
+	unsigned int newId( const Socket & ) const ;
+	std::shared_ptr<Socket> socket( Address::Family ) ;
+	static void bindRandom( DatagramSocket & , Address::Family ) ;
+	Address nextNameserver() ;
+	void readSocket( Socket & ) ;
+	bool matches( const Pending & , const DnsMessage & ) const ;
+	void startTcp( Pending & ) ;
+	void onCollectTimeout() ;
+	void deliver( PendingKey , const std::vector<char> & ) ;
+	void remove( PendingMap::iterator ) ;
+
+private:
+	std::weak_ptr<DnsClient> m_self ;
+	EventState m_es ;
+	std::vector<Address> m_nameservers ;
+	std::size_t m_nameserver_index {0U} ;
+	PendingMap m_pending ;
+	std::map<std::string,PendingKey> m_keys ;
+	std::vector<std::shared_ptr<Socket>> m_sockets ;
+	std::size_t m_socket_index {0U} ;
+	unsigned long m_socket_serial {0UL} ;
+	std::vector<Waiter> * m_delivering {nullptr} ;
+	Timer<DnsClient> m_collect_timer ;
+	std::vector<char> m_buffer ;
+} ;
+
+//| \class GNet::DnsClientCallback
+/// A callback interface for GNet::DnsClient.
+///
+class GNet::DnsClientCallback
+{
+public:
+	virtual ~DnsClientCallback() = default ;
+		///< Destructor.
+
+	virtual void onDnsResponse( unsigned int tag , const DnsMessage & ) = 0 ;
+		///< Called with a response from DnsClient::query().
+} ;
+
+#endif
@@ -23,13 +23,13 @@
 #include "gexceptionsource.h"
 #include "glogoutput.h"
 
-GNet::EventLoggingContext * GNet::EventLoggingContext::m_inner = nullptr ;
+thread_local GNet::EventLoggingContext * GNet::EventLoggingContext::m_inner = nullptr ;
 
 // use a static string here for run-time efficiency -- however, it does
 // make the effects of an inner nested object persist beyond its scope --
 // in practice that is not a problem because the event-loop's outer object
 // and any inner object are both destroyed in quick succession
-std::string GNet::EventLoggingContext::m_s ;
+thread_local std::string GNet::EventLoggingContext::m_s ;
 
 #ifndef G_LIB_SMALL
 GNet::EventLoggingContext::EventLoggingContext( std::string_view s ) :
@@ -64,9 +64,9 @@ private:
 	static void set( std::string & , EventState ) ;
 
 private:
-	static EventLoggingContext * m_inner ;
+	static thread_local EventLoggingContext * m_inner ;
 	EventLoggingContext * m_outer ;
-	static std::string m_s ;
+	static thread_local std::string m_s ;
 } ;
 
 #endif
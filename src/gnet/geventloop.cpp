@@ -23,7 +23,7 @@
 #include "glog.h"
 #include "gassert.h"
 
-GNet::EventLoop * GNet::EventLoop::m_this = nullptr ;
+thread_local GNet::EventLoop * GNet::EventLoop::m_this = nullptr ;
 
 GNet::EventLoop::EventLoop()
 {
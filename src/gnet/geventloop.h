@@ -47,7 +47,8 @@ namespace GNet
 /// when running on windows.
 ///
 /// The class has a static member for finding an instance, but instances
-/// are not created automatically.
+/// are not created automatically. The instance pointer is thread-local
+/// so that separate threads can each run their own event loop.
 ///
 /// \code
 /// int main()
@@ -155,7 +156,7 @@ public:
 	EventLoop & operator=( EventLoop && ) = delete ;
 
 private:
-	static EventLoop * m_this ;
+	static thread_local EventLoop * m_this ;
 } ;
 
 #endif
@@ -24,6 +24,7 @@
 #include "gresolver.h"
 #include "gassert.h"
 #include "glog.h"
+#include <algorithm>
 
 GNet::Location::Location( const std::string & spec , int family ) :
 	m_host(head(sockless(spec))) ,
@@ -172,6 +173,7 @@ bool GNet::Location::update( const Address & address , std::nothrow_t )
 		return false ;
 
 	m_address = address ;
+	m_alternates.clear() ;
 	m_family = address.af() ; // not enum
 	m_address_valid = true ;
 	m_update_time = G::SystemTime::now() ;
@@ -179,6 +181,39 @@ bool GNet::Location::update( const Address & address , std::nothrow_t )
 	return true ;
 }
 
+void GNet::Location::update( const Address & address , const std::vector<Address> & alternates )
+{
+	int family = m_family ;
+	update( address ) ;
+	for( const auto & alternate : alternates )
+	{
+		if( ( alternate.is4() || alternate.is6() ) && ( family == AF_UNSPEC || alternate.af() == family ) &&
+			!alternate.same(address,true) &&
+			std::none_of( m_alternates.begin() , m_alternates.end() ,
+				[&alternate](const Address & a){return a.same(alternate,true);} ) )
+		{
+			m_alternates.push_back( alternate ) ;
+		}
+	}
+}
+
+std::vector<GNet::Address> GNet::Location::alternates() const
+{
+	return m_alternates ;
+}
+
+bool GNet::Location::promote( const Address & alternate )
+{
+	auto p = std::find_if( m_alternates.begin() , m_alternates.end() ,
+		[&alternate](const Address & a){return a.same(alternate,true);} ) ;
+	if( !m_address_valid || p == m_alternates.end() )
+		return false ;
+	std::swap( *p , m_address ) ;
+	m_family = m_address.af() ;
+	G_DEBUG( "GNet::Location::promote: resolved location [" << displayString() << "]" ) ;
+	return true ;
+}
+
 std::string GNet::Location::displayString() const
 {
 	if( resolved() )
@@ -26,6 +26,7 @@
 #include "gdatetime.h"
 #include "gexception.h"
 #include <new>
+#include <vector>
 
 namespace GNet
 {
@@ -117,6 +118,22 @@ public:
 		///< host() and service(). Returns false if an invalid address
 		///< family.
 
+	void update( const Address & address , const std::vector<Address> & alternates ) ;
+		///< An overload that also records the other addresses returned
+		///< by the name lookup, in order of preference. Alternates that
+		///< are the same as the main address or that are not of the
+		///< family() passed to the constructor are ignored.
+
+	std::vector<Address> alternates() const ;
+		///< Returns the alternative addresses recorded by update(),
+		///< not including address(). Any update() with a single
+		///< address clears the alternates.
+
+	bool promote( const Address & alternate ) ;
+		///< Swaps the given alternate with the main address(), typically
+		///< because it was the first to accept a connection. Returns
+		///< false if not one of the alternates().
+
 	bool resolved() const ;
 		///< Returns true after update() has been called or resolveTrivially()
 		///< succeeded.
@@ -151,6 +168,7 @@ private:
 	std::string m_service ;
 	bool m_address_valid ;
 	Address m_address ;
+	std::vector<Address> m_alternates ;
 	int m_family ;
 	G::SystemTime m_update_time ;
 	bool m_using_socks ;
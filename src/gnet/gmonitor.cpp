@@ -75,7 +75,7 @@ private:
 
 GNet::Monitor * & GNet::Monitor::pthis() noexcept
 {
-	static GNet::Monitor * p = nullptr ;
+	static thread_local GNet::Monitor * p = nullptr ;
 	return p ;
 }
 
@@ -37,7 +37,8 @@ namespace GNet
 
 //| \class GNet::Monitor
 /// A singleton for monitoring GNet::Client and GNet::ServerPeer
-/// connections.
+/// connections. The singleton pointer is thread-local so each
+/// event-loop thread can have its own instance.
 /// \see GNet::Client, GNet::ServerPeer
 ///
 class GNet::Monitor
@@ -80,10 +80,10 @@ private:
 	Location m_location ;
 	ResolverFuture m_future ;
 	G::threading::thread_type m_thread ;
-	static std::size_t m_zcount ;
+	static thread_local std::size_t m_zcount ;
 } ;
 
-std::size_t GNet::ResolverImp::m_zcount = 0U ;
+thread_local std::size_t GNet::ResolverImp::m_zcount = 0U ;
 
 GNet::ResolverImp::ResolverImp( Resolver & resolver , EventState es , const Location & location , const Resolver::Config & config ) :
 	m_resolver(&resolver) ,
@@ -136,7 +136,11 @@ void GNet::ResolverImp::onFutureEvent()
 
 	ResolverFuture::Result result = m_future.get() ;
 	if( !m_future.error() )
-		m_location.update( result.address ) ;
+	{
+		ResolverFuture::List list ;
+		m_future.get( list ) ;
+		m_location.update( result.address , list ) ;
+	}
 
 	if( m_thread.joinable() )
 		m_thread.join() ; // worker thread is finishing, so no delay here
@@ -212,7 +216,9 @@ std::pair<std::string,std::string> GNet::Resolver::resolve( Location & location
 	else
 	{
 		G_DEBUG( "GNet::Resolver::resolve: resolve result [" << result.address.displayString() << "]" ) ;
-		location.update( result.address ) ;
+		ResolverFuture::List list ;
+		future.get( list ) ;
+		location.update( result.address , list ) ;
 		return {{},result.canonicalName} ;
 	}
 }
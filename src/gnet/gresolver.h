@@ -88,9 +88,11 @@ public:
 
 	static std::pair<std::string,std::string> resolve( Location & , const Config & ) ;
 		///< Does synchronous name resolution. Fills in the address
-		///< of the supplied Location structure. Returns
-		///< an error string (empty on success) and the canonical
-		///< name, if requested (see Config::with_canonical_name).
+		///< of the supplied Location structure, together with any
+		///< alternative addresses (see Location::alternates()).
+		///< Returns an error string (empty on success) and the
+		///< canonical name, if requested (see
+		///< Config::with_canonical_name).
 
 	static std::string resolve( Location & ) ;
 		///< Does synchronous name resolution. Fills in the address
@@ -24,11 +24,21 @@
 #include "gtest.h"
 #include "gstr.h"
 #include "gidn.h"
+#include "gmetrics.h"
+#include "gdatetime.h"
 #include "gsleep.h"
 #include "glog.h"
 #include <cstring>
 #include <cstdio>
 
+namespace GNet
+{
+	namespace ResolverFutureImp
+	{
+		G::Metrics::Histogram latency( "emailrelay_dns_resolve_duration_seconds" , "" , "Address resolution latency" ) ;
+	}
+}
+
 GNet::ResolverFuture::ResolverFuture( const std::string & host , const std::string & service ,
 	int family , const Resolver::Config & config ) :
 		m_config(config) ,
@@ -70,8 +80,10 @@ std::string GNet::ResolverFuture::encode( const std::string & host , bool raw )
 GNet::ResolverFuture & GNet::ResolverFuture::run() noexcept
 {
 	// worker thread -- as simple as possible
+	G::TimerTime start = G::TimerTime::now() ;
 	if( m_config.test_slow ) sleep( 10 ) ;
 	m_rc = GetAddrInfo::getaddrinfo( m_host_p , m_service_p , &m_ai_hint , &m_ai ) ;
+	ResolverFutureImp::latency.observe( start ) ;
 	return *this ;
 }
 
@@ -156,6 +156,18 @@ bool GNet::ServerPeer::send( const std::vector<std::string_view> & segments , st
 }
 #endif
 
+bool GNet::ServerPeer::sendFileCapable() const
+{
+	return m_sp.sendFileCapable() ;
+}
+
+bool GNet::ServerPeer::sendFile( int fd , std::size_t offset , std::size_t size )
+{
+	if( m_config.kick_idle_timer_on_send && m_config.idle_timeout )
+		m_idle_timer.startTimer( m_config.idle_timeout ) ;
+	return m_sp.sendFile( fd , offset , size ) ;
+}
+
 void GNet::ServerPeer::writeEvent()
 {
 	if( m_sp.writeEvent() )
@@ -100,6 +100,15 @@ public:
 		///< returned then segment data pointers must stay valid until
 		///< onSendComplete() is triggered.
 
+	bool sendFileCapable() const ;
+		///< Returns true if sendFile() can be used on this connection.
+
+	bool sendFile( int fd , std::size_t offset , std::size_t size ) ;
+		///< Sends file data using zero-copy transmission. If false is
+		///< returned then the file descriptor must stay open until
+		///< onSendComplete() is triggered. Throws on error.
+		///< Precondition: sendFileCapable().
+
 	Address localAddress() const override ;
 		///< Returns the local address. Throws on error.
 		///< Override from GNet::Connection.
@@ -524,6 +524,11 @@ GNet::Socket::ssize_type GNet::StreamSocket::write( const char * buffer , size_t
 	return writeImp( buffer , length ) ; // SocketBase
 }
 
+GNet::Socket::ssize_type GNet::StreamSocket::writev( const std::string_view * segments , std::size_t count )
+{
+	return writevImp( segments , count ) ; // SocketBase
+}
+
 GNet::AcceptInfo GNet::StreamSocket::accept()
 {
 	AddressStorage addr ;
@@ -66,6 +66,7 @@ public:
 	} ;
 	using size_type = G::ReadWrite::size_type ;
 	using ssize_type = G::ReadWrite::ssize_type ;
+	static constexpr std::size_t writevLimit = 64U ; // see writevImp()
 	struct Accepted /// Overload discriminator class for GNet::SocketBase.
 		{} ;
 	struct Raw /// Overload discriminator class for GNet::SocketBase.
@@ -172,6 +173,12 @@ protected:
 		///< for write() that can be called from derived classes'
 		///< overrides.
 
+	ssize_type writevImp( const std::string_view * segments , std::size_t count ) ;
+		///< Writes a gather-list of buffers to the socket using
+		///< a single system call. Up to writevLimit() segments
+		///< are used. The return value and error state are as
+		///< for writeImp().
+
 	static bool error( int rc ) ;
 		///< Returns true if the given return code indicates an
 		///< error.
@@ -402,6 +409,14 @@ public:
 	ssize_type write( const char * buf , size_type len ) override ;
 		///< Override from Socket::write().
 
+	ssize_type writev( const std::string_view * segments , std::size_t count ) ;
+		///< Writes the given segments in one system call, such as
+		///< sendmsg(), returning the number of bytes written or -1.
+		///< Empty segments are allowed. Only the first writevLimit
+		///< segments are used, so the return value should be compared
+		///< against the size of that many segments. See also
+		///< G::ReadWrite::write().
+
 	AcceptInfo accept() ;
 		///< Accepts an incoming connection, returning a new()ed
 		///< socket and the peer address.
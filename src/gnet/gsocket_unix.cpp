@@ -30,6 +30,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/uio.h>
+#include <array>
 
 bool GNet::SocketBase::supports( Address::Family af , int type , int protocol )
 {
@@ -117,6 +119,40 @@ bool GNet::SocketBase::sizeError( ssize_t size )
 	return size < 0 ;
 }
 
+GNet::SocketBase::ssize_type GNet::SocketBase::writevImp( const std::string_view * segments , std::size_t count )
+{
+	std::array<::iovec,writevLimit> iov {} ;
+	std::size_t n = 0U ;
+	size_type length = 0U ;
+	for( std::size_t i = 0U ; i < count && n < iov.size() ; i++ )
+	{
+		if( segments[i].empty() ) continue ;
+		iov[n].iov_base = const_cast<char*>( segments[i].data() ) ; // NOLINT
+		iov[n].iov_len = segments[i].size() ;
+		length += segments[i].size() ;
+		n++ ;
+	}
+	if( n == 0U )
+		return 0 ;
+
+	// not G::Msg::sendto() because that always adds SCM_RIGHTS control data
+	::msghdr msg {} ;
+	msg.msg_iov = iov.data() ;
+	msg.msg_iovlen = n ;
+	ssize_type nsent = ::sendmsg( m_fd.fd() , &msg , MSG_NOSIGNAL ) ;
+	if( sizeError(nsent) )
+	{
+		saveReason() ;
+		G_DEBUG( "GNet::SocketBase::writevImp: write error: " << reason() ) ;
+		return -1 ;
+	}
+	else if( static_cast<size_type>(nsent) < length )
+	{
+		saveReason() ;
+	}
+	return nsent ;
+}
+
 bool GNet::SocketBase::eNotConn() const
 {
 	return m_reason == ENOTCONN ;
@@ -24,6 +24,7 @@
 #include "gstr.h"
 #include "gassert.h"
 #include <errno.h>
+#include <array>
 
 bool GNet::SocketBase::supports( Address::Family af , int type , int protocol )
 {
@@ -99,6 +100,35 @@ bool GNet::SocketBase::sizeError( ssize_t size )
 	return size == SOCKET_ERROR ;
 }
 
+GNet::SocketBase::ssize_type GNet::SocketBase::writevImp( const std::string_view * segments , std::size_t count )
+{
+	std::array<WSABUF,writevLimit> bufs {} ;
+	DWORD n = 0U ;
+	size_type length = 0U ;
+	for( std::size_t i = 0U ; i < count && n < bufs.size() ; i++ )
+	{
+		if( segments[i].empty() ) continue ;
+		bufs[n].buf = const_cast<char*>( segments[i].data() ) ; // NOLINT
+		bufs[n].len = static_cast<ULONG>( segments[i].size() ) ;
+		length += segments[i].size() ;
+		n++ ;
+	}
+	if( n == 0U )
+		return 0 ;
+
+	DWORD nsent = 0 ;
+	if( WSASend( m_fd.fd() , bufs.data() , n , &nsent , 0 , nullptr , nullptr ) == SOCKET_ERROR )
+	{
+		saveReason() ;
+		return -1 ;
+	}
+	else if( static_cast<size_type>(nsent) < length )
+	{
+		saveReason() ;
+	}
+	return static_cast<ssize_type>( nsent ) ;
+}
+
 bool GNet::SocketBase::eNotConn() const
 {
 	return m_reason == WSAENOTCONN ;
@@ -23,14 +23,126 @@
 #include "gstringview.h"
 #include "gcall.h"
 #include "gtimer.h"
+#include "gfutureevent.h"
+#include "gcleanup.h"
 #include "gssl.h"
 #include "gsocketprotocol.h"
+#include "gmetrics.h"
+#include "gprocess.h"
 #include "gstr.h"
 #include "gtest.h"
 #include "gassert.h"
 #include "glog.h"
 #include <memory>
 #include <numeric>
+#include <algorithm>
+#include <array>
+#include <exception>
+#if GCONFIG_HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
+namespace GNet
+{
+	namespace SocketProtocolMetrics
+	{
+		G::Metrics::Counter bytes_in( "emailrelay_network_received_bytes_total" , "" , "Application data bytes received" ) ;
+		G::Metrics::Counter bytes_out( "emailrelay_network_sent_bytes_total" , "" , "Application data bytes sent" ) ;
+		G::Metrics::Counter handshakes_offloaded( "emailrelay_tls_handshake_steps_total" , "thread=\"worker\"" , "TLS handshake steps" ) ;
+		G::Metrics::Counter handshakes_inline( "emailrelay_tls_handshake_steps_total" , "thread=\"main\"" , "TLS handshake steps" ) ;
+	}
+	namespace SocketProtocolImpBuffer
+	{
+		thread_local std::vector<char> shared ; // event-loop-wide raw read buffer, one per event-loop thread
+		thread_local bool shared_lent {false} ;
+		struct Lease ;
+	}
+	class SocketProtocolHandshake ;
+}
+
+//| \class GNet::SocketProtocolImpBuffer::Lease
+/// A RAII class that lends out the shared read buffer, or falls back
+/// to the given per-connection buffer if the shared buffer is already
+/// lent out or not allowed. The per-connection buffer is grown on
+/// demand.
+///
+struct GNet::SocketProtocolImpBuffer::Lease
+{
+	Lease( bool use_shared , std::vector<char> & own , std::size_t size ) :
+		m_shared(use_shared && !shared_lent) ,
+		m_buffer(m_shared?shared:own) ,
+		m_size(std::max(std::size_t(1U),size))
+	{
+		if( m_buffer.size() < m_size )
+			m_buffer.resize( m_size ) ;
+		if( m_shared )
+			shared_lent = true ;
+	}
+	~Lease()
+	{
+		if( m_shared )
+			shared_lent = false ;
+	}
+	char * data() noexcept { return m_buffer.data() ; }
+	std::size_t size() const noexcept { return m_size ; }
+	Lease( const Lease & ) = delete ;
+	Lease( Lease && ) = delete ;
+	Lease & operator=( const Lease & ) = delete ;
+	Lease & operator=( Lease && ) = delete ;
+	bool m_shared ;
+	std::vector<char> & m_buffer ;
+	std::size_t m_size ;
+} ;
+
+//| \class GNet::SocketProtocolHandshake
+/// Runs one step of a TLS handshake on a worker thread so that the
+/// expensive public-key operations do not hold up the event loop.
+/// Completion is signalled back to the event-loop thread through a
+/// GNet::FutureEvent. The destructor joins the worker thread, but
+/// the wait is short because the socket is non-blocking.
+///
+class GNet::SocketProtocolHandshake : private FutureEventHandler
+{
+public:
+	using Result = GSsl::Protocol::Result ;
+	using Callback = void (SocketProtocolImp::*)( Result , std::exception_ptr ) ;
+
+	SocketProtocolHandshake( SocketProtocolImp & , Callback , EventState ,
+		GSsl::Protocol & , G::ReadWrite & , bool accept ) ;
+			// Constructor. Starts the worker thread.
+
+	~SocketProtocolHandshake() override ;
+		// Destructor. Joins the worker thread.
+
+	static bool available( unsigned int limit ) ;
+		// Returns true if a new worker thread can be started,
+		// given the configured limit.
+
+public:
+	SocketProtocolHandshake( const SocketProtocolHandshake & ) = delete ;
+	SocketProtocolHandshake( SocketProtocolHandshake && ) = delete ;
+	SocketProtocolHandshake & operator=( const SocketProtocolHandshake & ) = delete ;
+	SocketProtocolHandshake & operator=( SocketProtocolHandshake && ) = delete ;
+
+private: // overrides
+	void onFutureEvent() override ; // GNet::FutureEventHandler
+
+private:
+	static void run( SocketProtocolHandshake * , HANDLE ) noexcept ;
+
+private:
+	SocketProtocolImp & m_imp ;
+	Callback m_callback ;
+	GSsl::Protocol & m_ssl ;
+	G::ReadWrite & m_io ;
+	bool m_accept ;
+	Result m_result {Result::error} ;
+	std::exception_ptr m_exception ;
+	GSsl::Library::LogLines m_log_lines ;
+	FutureEvent m_future_event ;
+	G::threading::thread_type m_thread ;
+	static thread_local unsigned int m_busy ;
+} ;
 
 //| \class GNet::SocketProtocolImp
 /// A pimple-pattern implementation class used by GNet::SocketProtocol.
@@ -41,6 +153,7 @@ public:
 	using Result = GSsl::Protocol::Result ;
 	using Segment = std::string_view ;
 	using Segments = std::vector<Segment> ;
+	static constexpr std::size_t ssl_record_size = 16384U ; // max tls plaintext record
 	struct Position /// A pointer into the scatter/gather payload of GNet::SocketProtocolImp::send().
 	{
 		Position() = default ;
@@ -58,6 +171,8 @@ public:
 	void otherEvent( EventHandler::Reason , bool ) ;
 	bool send( std::string_view data , std::size_t offset ) ;
 	bool send( const Segments & , std::size_t ) ;
+	bool sendFileCapable() const ;
+	bool sendFile( int fd , std::size_t offset , std::size_t size ) ;
 	void shutdown() ;
 	void secureConnect() ;
 	bool secureConnectCapable() const ;
@@ -83,13 +198,18 @@ private:
 	bool rawOtherEvent( EventHandler::Reason ) ;
 	bool rawSend( const Segments & , Position , bool = false ) ;
 	bool rawSendImp( const Segments & , Position , Position & ) ;
+	bool rawSendFileImp() ;
 	void rawReset() ;
 	void sslReadImp() ;
 	bool sslSend( const Segments & segments , Position pos ) ;
 	bool sslSendImp() ;
 	bool sslSendImp( const Segments & segments , Position pos , Position & ) ;
 	void secureConnectImp() ;
+	void secureConnectResult( Result ) ;
 	void secureAcceptImp() ;
+	void secureAcceptResult( Result ) ;
+	bool startHandshake( bool accept ) ;
+	void onHandshake( Result , std::exception_ptr ) ;
 	void shutdownImp() ;
 	void logSecure( const std::string & , const std::string & ) const ;
 	void onSecureConnectionTimeout() ;
@@ -111,10 +231,15 @@ private:
 	Segments m_segments ;
 	Position m_position ;
 	std::string m_data_copy ;
+	std::string m_ssl_buffer ;
+	int m_file_fd {-1} ;
+	std::size_t m_file_offset {0U} ;
+	std::size_t m_file_size {0U} ; // remaining
 	bool m_failed {false} ;
 	std::unique_ptr<GSsl::Protocol> m_ssl ;
+	std::unique_ptr<SocketProtocolHandshake> m_handshake ; // after m_ssl
 	State m_state {State::raw} ;
-	std::vector<char> m_read_buffer ;
+	std::vector<char> m_read_buffer ; // lazily allocated
 	ssize_t m_read_buffer_n {0} ;
 	Timer<SocketProtocolImp> m_secure_connection_timer ;
 	std::string m_peer_certificate ;
@@ -150,7 +275,6 @@ GNet::SocketProtocolImp::SocketProtocolImp( EventHandler & handler , EventState
 		m_socket(socket) ,
 		m_config(config) ,
 		m_one_segment(1U) ,
-		m_read_buffer(std::max(std::size_t(1U),config.read_buffer_size)) ,
 		m_secure_connection_timer(*this,&SocketProtocolImp::onSecureConnectionTimeout,es)
 {
 	if( m_config.server_tls_profile.empty() ) m_config.server_tls_profile = "server" ;
@@ -320,6 +444,42 @@ bool GNet::SocketProtocolImp::send( const Segments & segments , std::size_t offs
 	return rc ;
 }
 
+bool GNet::SocketProtocolImp::sendFileCapable() const
+{
+	return GCONFIG_HAVE_SENDFILE && m_state == State::raw ;
+}
+
+bool GNet::SocketProtocolImp::sendFile( int fd , std::size_t offset , std::size_t size )
+{
+	if( !sendFileCapable() )
+		throw SocketProtocol::SendError( "file transmission not available" ) ;
+
+	if( !finished(m_segments,m_position) || m_file_fd != -1 )
+		throw SocketProtocol::SendError( "still busy sending the last packet" ) ;
+
+	if( size == 0U )
+		return true ;
+
+	m_file_fd = fd ;
+	m_file_offset = offset ;
+	m_file_size = size ;
+	bool all_sent = rawSendFileImp() ;
+	if( !all_sent && failed() )
+	{
+		m_file_fd = -1 ;
+		throw SocketProtocol::SendError( "sendfile" , G::Process::strerror(G::Process::errno_()) ) ;
+	}
+	else if( all_sent )
+	{
+		m_file_fd = -1 ;
+	}
+	else
+	{
+		m_socket.addWriteHandler( m_handler , m_es ) ;
+	}
+	return all_sent ;
+}
+
 void GNet::SocketProtocolImp::shutdown()
 {
 	if( m_state == State::raw )
@@ -401,8 +561,16 @@ void GNet::SocketProtocolImp::secureConnectImp()
 	G_ASSERT( m_ssl != nullptr ) ;
 	G_ASSERT( m_state == State::connecting ) ;
 
+	if( startHandshake( false ) )
+		return ; // -> onHandshake()
+
 	Result rc = m_ssl->connect( m_socket ) ;
 	G_DEBUG( "SocketProtocolImp::secureConnectImp: result=" << GSsl::Protocol::str(rc) ) ;
+	secureConnectResult( rc ) ;
+}
+
+void GNet::SocketProtocolImp::secureConnectResult( Result rc )
+{
 	if( rc == Result::error )
 	{
 		m_socket.dropWriteHandler() ;
@@ -456,8 +624,16 @@ void GNet::SocketProtocolImp::secureAcceptImp()
 	G_ASSERT( m_ssl != nullptr ) ;
 	G_ASSERT( m_state == State::accepting ) ;
 
+	if( startHandshake( true ) )
+		return ; // -> onHandshake()
+
 	Result rc = m_ssl->accept( m_socket ) ;
 	G_DEBUG( "SocketProtocolImp::secureAcceptImp: result=" << GSsl::Protocol::str(rc) ) ;
+	secureAcceptResult( rc ) ;
+}
+
+void GNet::SocketProtocolImp::secureAcceptResult( Result rc )
+{
 	if( rc == Result::error )
 	{
 		m_socket.dropWriteHandler() ;
@@ -484,6 +660,38 @@ void GNet::SocketProtocolImp::secureAcceptImp()
 	}
 }
 
+bool GNet::SocketProtocolImp::startHandshake( bool accept )
+{
+	if( m_config.handshake_threads == 0U || !SocketProtocolHandshake::available(m_config.handshake_threads) )
+	{
+		SocketProtocolMetrics::handshakes_inline.add() ;
+		return false ;
+	}
+
+	// no socket events while the worker thread has the ssl object
+	m_socket.dropReadHandler() ;
+	m_socket.dropWriteHandler() ;
+
+	SocketProtocolMetrics::handshakes_offloaded.add() ;
+	m_handshake = std::make_unique<SocketProtocolHandshake>( *this , &SocketProtocolImp::onHandshake ,
+		m_es , *m_ssl , m_socket , accept ) ;
+	return true ;
+}
+
+void GNet::SocketProtocolImp::onHandshake( Result rc , std::exception_ptr exception )
+{
+	G_DEBUG( "SocketProtocolImp::onHandshake: result=" << GSsl::Protocol::str(rc) ) ;
+	G_ASSERT( m_state == State::connecting || m_state == State::accepting ) ;
+	m_handshake.reset() ; // our caller, but it has finished with itself
+	m_socket.addReadHandler( m_handler , m_es ) ;
+	if( exception )
+		std::rethrow_exception( exception ) ;
+	else if( m_state == State::connecting )
+		secureConnectResult( rc ) ;
+	else
+		secureAcceptResult( rc ) ;
+}
+
 bool GNet::SocketProtocolImp::sslSend( const Segments & segments , Position pos )
 {
 	if( !finished(m_segments,m_position) )
@@ -522,14 +730,28 @@ bool GNet::SocketProtocolImp::sslSendImp( const Segments & segments , Position p
 {
 	while( !finished(segments,pos) )
 	{
+		// coalesce runs of small segments so that they go out in
+		// one tls record -- the coalesced buffer is kept unchanged
+		// across read/write retries since the tls library requires
+		// the same buffer to be re-presented
+		if( m_ssl_buffer.empty() && chunk(segments,pos).size() < ssl_record_size && (pos.segment+1U) < segments.size() )
+		{
+			for( Position p = pos ; !finished(segments,p) && m_ssl_buffer.size() < ssl_record_size ; p = newPosition(segments,Position(p.segment+1U,0U),0U) )
+			{
+				std::string_view c = chunk( segments , p ) ;
+				m_ssl_buffer.append( c.data() , std::min(c.size(),ssl_record_size-m_ssl_buffer.size()) ) ;
+			}
+		}
+
 		ssize_t nsent = 0 ;
-		std::string_view c = chunk( segments , pos ) ;
+		std::string_view c = m_ssl_buffer.empty() ? chunk( segments , pos ) : std::string_view( m_ssl_buffer ) ;
 		GSsl::Protocol::Result result = m_ssl->write( c.data() , c.size() , nsent ) ;
 		if( result == Result::error )
 		{
 			m_socket.dropWriteHandler() ;
 			m_state = State::idle ;
 			m_failed = true ;
+			m_ssl_buffer.clear() ;
 			return false ; // failed
 		}
 		else if( result == Result::read )
@@ -546,8 +768,10 @@ bool GNet::SocketProtocolImp::sslSendImp( const Segments & segments , Position p
 		{
 			// continue to next chunk
 			G_ASSERT( nsent >= 0 ) ;
+			SocketProtocolMetrics::bytes_out.add( nsent >= 0 ? static_cast<std::size_t>(nsent) : 0U ) ;
 			pos_out = pos = newPosition( segments , pos ,
 				nsent >= 0 ? static_cast<std::size_t>(nsent) : std::size_t(0U) ) ;
+			m_ssl_buffer.clear() ;
 		}
 	}
 	m_state = State::idle ;
@@ -560,6 +784,9 @@ void GNet::SocketProtocolImp::sslReadImp()
 	G_ASSERT( m_state == State::idle ) ;
 	G_ASSERT( m_ssl != nullptr ) ;
 
+	if( m_read_buffer.empty() )
+		m_read_buffer.resize( std::max(std::size_t(1U),m_config.read_buffer_size) ) ;
+
 	Result rc = Result::more ;
 	for( int sanity = 0 ; rc == Result::more && sanity < 100000 ; sanity++ )
 	{
@@ -588,6 +815,7 @@ void GNet::SocketProtocolImp::sslReadImp()
 			std::size_t n = static_cast<std::size_t>(m_read_buffer_n) ;
 			m_read_buffer_n = 0 ;
 			G_DEBUG( "SocketProtocolImp::sslReadImp: calling onData(): " << n ) ;
+			SocketProtocolMetrics::bytes_in.add( n ) ;
 			if( n != 0U )
 			{
 				G::CallFrame this_( m_stack ) ;
@@ -611,7 +839,8 @@ bool GNet::SocketProtocolImp::rawOtherEvent( EventHandler::Reason reason )
 		G_DEBUG( "GNet::SocketProtocolImp::rawOtherEvent: shutdown: clearing receive queue" ) ;
 		for(;;)
 		{
-			const ssize_t rc = m_socket.read( m_read_buffer.data() , m_read_buffer.size() ) ;
+			SocketProtocolImpBuffer::Lease buffer( m_config.shared_read_buffer , m_read_buffer , m_config.read_buffer_size ) ;
+			const ssize_t rc = m_socket.read( buffer.data() , buffer.size() ) ;
 			G_DEBUG( "GNet::SocketProtocolImp::rawOtherEvent: read " << m_socket.asString() << ": " << rc ) ;
 			if( rc == 0 )
 			{
@@ -621,9 +850,10 @@ bool GNet::SocketProtocolImp::rawOtherEvent( EventHandler::Reason reason )
 			{
 				throw SocketProtocol::ReadError( m_socket.reason() ) ;
 			}
-			G_ASSERT( static_cast<std::size_t>(rc) <= m_read_buffer.size() ) ;
+			G_ASSERT( static_cast<std::size_t>(rc) <= buffer.size() ) ;
+			SocketProtocolMetrics::bytes_in.add( static_cast<std::size_t>(rc) ) ;
 			G::CallFrame this_( m_stack ) ;
-			m_sink.onData( m_read_buffer.data() , static_cast<std::size_t>(rc) ) ;
+			m_sink.onData( buffer.data() , static_cast<std::size_t>(rc) ) ;
 			if( this_.deleted() ) break ;
 		}
 		return true ;
@@ -636,7 +866,8 @@ bool GNet::SocketProtocolImp::rawOtherEvent( EventHandler::Reason reason )
 
 bool GNet::SocketProtocolImp::rawReadEvent( bool no_throw_on_peer_disconnect )
 {
-	const ssize_t rc = m_socket.read( m_read_buffer.data() , m_read_buffer.size() ) ;
+	SocketProtocolImpBuffer::Lease buffer( m_config.shared_read_buffer , m_read_buffer , m_config.read_buffer_size ) ;
+	const ssize_t rc = m_socket.read( buffer.data() , buffer.size() ) ;
 	if( rc == 0 && no_throw_on_peer_disconnect )
 	{
 		m_socket.dropReadHandler() ;
@@ -649,8 +880,9 @@ bool GNet::SocketProtocolImp::rawReadEvent( bool no_throw_on_peer_disconnect )
 	}
 	else if( rc != -1 )
 	{
-		G_ASSERT( static_cast<std::size_t>(rc) <= m_read_buffer.size() ) ;
-		m_sink.onData( m_read_buffer.data() , static_cast<std::size_t>(rc) ) ;
+		G_ASSERT( static_cast<std::size_t>(rc) <= buffer.size() ) ;
+		SocketProtocolMetrics::bytes_in.add( static_cast<std::size_t>(rc) ) ;
+		m_sink.onData( buffer.data() , static_cast<std::size_t>(rc) ) ;
 	}
 	else
 	{
@@ -664,7 +896,7 @@ bool GNet::SocketProtocolImp::rawSend( const Segments & segments , Position pos
 {
 	G_ASSERT( !do_copy || segments.size() == 1U ) ; // copy => one segment
 
-	if( !finished(m_segments,m_position) )
+	if( !finished(m_segments,m_position) || m_file_fd != -1 )
 		throw SocketProtocol::SendError( "still busy sending the last packet" ) ;
 
 	Position pos_out ;
@@ -709,6 +941,20 @@ bool GNet::SocketProtocolImp::rawSend( const Segments & segments , Position pos
 bool GNet::SocketProtocolImp::rawWriteEvent()
 {
 	m_socket.dropWriteHandler() ;
+	if( m_file_fd != -1 )
+	{
+		bool all_sent = rawSendFileImp() ;
+		if( !all_sent && failed() )
+		{
+			m_file_fd = -1 ;
+			throw SocketProtocol::SendError( "sendfile" ) ;
+		}
+		if( all_sent )
+			m_file_fd = -1 ;
+		else
+			m_socket.addWriteHandler( m_handler , m_es ) ;
+		return all_sent ;
+	}
 	bool all_sent = rawSendImp( m_segments , m_position , m_position ) ;
 	if( !all_sent && failed() )
 	{
@@ -732,10 +978,20 @@ bool GNet::SocketProtocolImp::rawWriteEvent()
 
 bool GNet::SocketProtocolImp::rawSendImp( const Segments & segments , Position pos , Position & pos_out )
 {
+	// gather the pending segments, starting part-way through the first,
+	// and send them with one system call per batch
+	std::array<std::string_view,SocketBase::writevLimit> iov ;
 	while( !finished(segments,pos) )
 	{
-		std::string_view c = chunk( segments , pos ) ;
-		ssize_t rc = m_socket.write( c.data() , c.size() ) ;
+		std::size_t n = 0U ;
+		std::size_t length = 0U ;
+		for( Position p = pos ; !finished(segments,p) && n < iov.size() ; p = newPosition(segments,Position(p.segment+1U,0U),0U) )
+		{
+			iov[n] = chunk( segments , p ) ;
+			length += iov[n++].size() ;
+		}
+
+		ssize_t rc = n == 1U ? m_socket.write( iov[0].data() , iov[0].size() ) : m_socket.writev( iov.data() , n ) ;
 		if( rc < 0 && ! m_socket.eWouldBlock() )
 		{
 			// fatal error, eg. disconnection
@@ -743,24 +999,57 @@ bool GNet::SocketProtocolImp::rawSendImp( const Segments & segments , Position p
 			m_failed = true ;
 			return false ; // failed()
 		}
-		else if( rc < 0 || static_cast<std::size_t>(rc) < c.size() )
+		else if( rc < 0 || static_cast<std::size_t>(rc) < length )
 		{
 			// flow control asserted -- return the position where we stopped
 			std::size_t nsent = rc > 0 ? static_cast<std::size_t>(rc) : 0U ;
+			SocketProtocolMetrics::bytes_out.add( nsent ) ;
 			pos_out = newPosition( segments , pos , nsent ) ;
 			G_ASSERT( !finished(segments,pos_out) ) ;
 			return false ; // not all sent
 		}
 		else
 		{
+			SocketProtocolMetrics::bytes_out.add( static_cast<std::size_t>(rc) ) ;
 			pos = newPosition( segments , pos , static_cast<std::size_t>(rc) ) ;
 		}
 	}
 	return true ; // all sent
 }
 
+bool GNet::SocketProtocolImp::rawSendFileImp()
+{
+	#if GCONFIG_HAVE_SENDFILE
+		while( m_file_size )
+		{
+			off_t offset = static_cast<off_t>( m_file_offset ) ;
+			ssize_t rc = ::sendfile( m_socket.fd() , m_file_fd , &offset , m_file_size ) ;
+			int e = G::Process::errno_() ;
+			if( rc == 0 || ( rc < 0 && e != EAGAIN && e != EWOULDBLOCK && e != EINTR ) )
+			{
+				// fatal error, or the file has been truncated
+				if( rc == 0 ) G::Process::errno_( G::SignalSafe() , EIO ) ;
+				m_failed = true ;
+				return false ; // failed()
+			}
+			else if( rc < 0 )
+			{
+				return e == EINTR ? rawSendFileImp() : false ; // not all sent
+			}
+			SocketProtocolMetrics::bytes_out.add( static_cast<std::size_t>(rc) ) ;
+			m_file_offset += static_cast<std::size_t>( rc ) ;
+			m_file_size -= std::min( m_file_size , static_cast<std::size_t>(rc) ) ;
+		}
+		return true ; // all sent
+	#else
+		m_failed = true ;
+		return false ;
+	#endif
+}
+
 void GNet::SocketProtocolImp::rawReset()
 {
+	m_file_fd = -1 ;
 	m_segments.clear() ;
 	m_position = Position() ;
 	m_data_copy.clear() ;
@@ -853,6 +1142,16 @@ bool GNet::SocketProtocol::send( const std::vector<std::string_view> & data , st
 	return m_imp->send( data , offset ) ;
 }
 
+bool GNet::SocketProtocol::sendFileCapable() const
+{
+	return m_imp->sendFileCapable() ;
+}
+
+bool GNet::SocketProtocol::sendFile( int fd , std::size_t offset , std::size_t size )
+{
+	return m_imp->sendFile( fd , offset , size ) ;
+}
+
 void GNet::SocketProtocol::shutdown()
 {
 	m_imp->shutdown() ;
@@ -897,3 +1196,68 @@ std::string GNet::SocketProtocol::peerCertificate() const
 	return m_imp->peerCertificate() ;
 }
 
+
+// ==
+
+thread_local unsigned int GNet::SocketProtocolHandshake::m_busy = 0U ;
+
+GNet::SocketProtocolHandshake::SocketProtocolHandshake( SocketProtocolImp & imp , Callback callback ,
+	EventState es , GSsl::Protocol & ssl , G::ReadWrite & io , bool accept ) :
+		m_imp(imp) ,
+		m_callback(callback) ,
+		m_ssl(ssl) ,
+		m_io(io) ,
+		m_accept(accept) ,
+		m_future_event(*this,es)
+{
+	G_ASSERT( G::threading::works() ) ; // see available()
+	G::Cleanup::Block block_signals ;
+	m_thread = G::threading::thread_type( SocketProtocolHandshake::run , this , m_future_event.handle() ) ;
+	m_busy++ ;
+}
+
+GNet::SocketProtocolHandshake::~SocketProtocolHandshake()
+{
+	try
+	{
+		if( m_thread.joinable() )
+			m_thread.join() ;
+	}
+	catch(...)
+	{
+	}
+	m_busy-- ;
+}
+
+bool GNet::SocketProtocolHandshake::available( unsigned int limit )
+{
+	const GSsl::Library * library = GSsl::Library::instance() ;
+	return m_busy < limit && library != nullptr && library->threadSafe() && G::threading::works() ;
+}
+
+void GNet::SocketProtocolHandshake::run( SocketProtocolHandshake * This , HANDLE handle ) noexcept
+{
+	// thread function, spawned from ctor and join()ed from dtor
+	GSsl::Library::capture( &This->m_log_lines ) ;
+	try
+	{
+		This->m_result = This->m_accept ? This->m_ssl.accept(This->m_io) : This->m_ssl.connect(This->m_io) ;
+	}
+	catch(...) // worker thread outer function
+	{
+		This->m_exception = std::current_exception() ;
+	}
+	GSsl::Library::capture( nullptr ) ;
+	FutureEvent::send( handle ) ;
+}
+
+void GNet::SocketProtocolHandshake::onFutureEvent()
+{
+	if( m_thread.joinable() )
+		m_thread.join() ; // worker thread is finishing, so no delay here
+
+	for( const auto & line : m_log_lines )
+		GSsl::Library::log( line.first , line.second ) ;
+
+	(m_imp.*m_callback)( m_result , m_exception ) ; // deletes this
+}
@@ -54,6 +54,12 @@ namespace GNet
 /// mode the read handler delivers data via the onData() callback interface
 /// and the write handler is used to flush the output pipeline.
 ///
+/// By default raw reads go into a buffer that is shared by all connections
+/// and lent to the sink for the duration of the onData() callback, so an
+/// idle connection holds no read buffer of its own. A per-connection
+/// buffer is allocated on first use for TLS reads or if the shared buffer
+/// is already lent out.
+///
 class GNet::SocketProtocol
 {
 public:
@@ -69,11 +75,15 @@ public:
 	struct Config /// A configuration structure for GNet::SocketProtocol.
 	{
 		std::size_t read_buffer_size {G::Limits<>::net_buffer} ;
+		bool shared_read_buffer {true} ;
 		unsigned int secure_connection_timeout {0U} ;
+		unsigned int handshake_threads {0U} ; // run tls handshakes on worker threads, up to this limit
 		std::string server_tls_profile ;
 		std::string client_tls_profile ;
 		Config & set_read_buffer_size( std::size_t n ) noexcept ;
+		Config & set_shared_read_buffer( bool b = true ) noexcept ;
 		Config & set_secure_connection_timeout( unsigned int t ) noexcept ;
+		Config & set_handshake_threads( unsigned int n ) noexcept ;
 		Config & set_server_tls_profile( const std::string & s ) ;
 		Config & set_client_tls_profile( const std::string & s ) ;
 	} ;
@@ -127,6 +137,19 @@ public:
 		///< and the segment pointers must stay valid until
 		///< writeEvent() returns true.
 
+	bool sendFileCapable() const ;
+		///< Returns true if sendFile() can be used, ie. if the
+		///< connection is not using TLS and the operating system
+		///< supports zero-copy file transmission.
+
+	bool sendFile( int fd , std::size_t offset , std::size_t size ) ;
+		///< Sends data directly from an open file using zero-copy
+		///< sendfile(). Returns false if flow control asserted before
+		///< all the data is sent, in which case the file descriptor
+		///< must stay open until writeEvent() returns true. Throws
+		///< SendError on error, including if the file is shorter
+		///< than expected. Precondition: sendFileCapable().
+
 	void shutdown() ;
 		///< Initiates a TLS-close if secure, together with a
 		///< Socket::shutdown(1).
@@ -180,7 +203,8 @@ public:
 		///< Destructor.
 
 	virtual void onData( const char * , std::size_t ) = 0 ;
-		///< Called when data is read from the socket.
+		///< Called when data is read from the socket. The data
+		///< is only valid for the duration of the call.
 
 	virtual void onSecure( const std::string & peer_certificate ,
 		const std::string & protocol , const std::string & cipher ) = 0 ;
@@ -198,7 +222,9 @@ public:
 } ;
 
 inline GNet::SocketProtocol::Config & GNet::SocketProtocol::Config::set_read_buffer_size( std::size_t n ) noexcept { read_buffer_size = n ; return *this ; }
+inline GNet::SocketProtocol::Config & GNet::SocketProtocol::Config::set_shared_read_buffer( bool b ) noexcept { shared_read_buffer = b ; return *this ; }
 inline GNet::SocketProtocol::Config & GNet::SocketProtocol::Config::set_secure_connection_timeout( unsigned int t ) noexcept { secure_connection_timeout = t ; return *this ; }
+inline GNet::SocketProtocol::Config & GNet::SocketProtocol::Config::set_handshake_threads( unsigned int n ) noexcept { handshake_threads = n ; return *this ; }
 inline GNet::SocketProtocol::Config & GNet::SocketProtocol::Config::set_server_tls_profile( const std::string & s ) { server_tls_profile = s ; return *this ; }
 inline GNet::SocketProtocol::Config & GNet::SocketProtocol::Config::set_client_tls_profile( const std::string & s ) { client_tls_profile = s ; return *this ; }
 
@@ -88,10 +88,10 @@ private:
 	bool m_logged {false} ;
 	G::NewProcess m_process ;
 	G::threading::thread_type m_thread ;
-	static std::size_t m_zcount ;
+	static thread_local std::size_t m_zcount ;
 } ;
 
-std::size_t GNet::TaskImp::m_zcount = 0U ;
+thread_local std::size_t GNet::TaskImp::m_zcount = 0U ;
 
 // ==
 
@@ -70,7 +70,7 @@ GNet::TimerList::Lock::~Lock()
 
 // ==
 
-GNet::TimerList * GNet::TimerList::m_this = nullptr ;
+thread_local GNet::TimerList * GNet::TimerList::m_this = nullptr ;
 
 GNet::TimerList::TimerList()
 {
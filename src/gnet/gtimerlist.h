@@ -157,7 +157,7 @@ private:
 	static void disarmIn( List & , ExceptionHandler * ) noexcept ;
 
 private:
-	static TimerList * m_this ;
+	static thread_local TimerList * m_this ;
 	mutable const TimerBase * m_soonest{nullptr} ;
 	unsigned int m_adjust{0} ;
 	bool m_locked{false} ;
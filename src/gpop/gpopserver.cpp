@@ -59,6 +59,16 @@ bool GPop::ServerPeer::protocolSend( std::string_view line , std::size_t offset
 	return output.empty() ? true : send( output ) ; // GNet::ServerPeer::send()
 }
 
+bool GPop::ServerPeer::protocolSendFile( int fd , std::size_t offset , std::size_t size )
+{
+	return sendFile( fd , offset , size ) ; // GNet::ServerPeer::sendFile()
+}
+
+bool GPop::ServerPeer::protocolSendFileCapable() const
+{
+	return sendFileCapable() ;
+}
+
 void GPop::ServerPeer::onSendComplete()
 {
 	m_protocol.resume() ; // calls back to protocolSend()
@@ -110,10 +120,16 @@ std::unique_ptr<GNet::ServerPeer> GPop::Server::newPeer( GNet::EventStateUnbound
 	try
 	{
 		std::string reason ;
-		if( !m_config.allow_remote && !peer_info.m_address.isLocal(reason) )
+		bool is_local = peer_info.m_address.isLocal( reason ) ;
+		if( !m_config.allow_remote && !is_local )
 		{
 			G_WARNING( "GPop::Server: configured to reject non-local pop connection: " << reason ) ;
 		}
+		else if( !is_local && m_config.allow_remote_ranges && !m_config.allow_remote_ranges->contains(peer_info.m_address) )
+		{
+			G_WARNING( "GPop::Server: configured to reject pop connection from outside the allowed address ranges: "
+				<< peer_info.m_address.hostPartString() ) ;
+		}
 		else
 		{
 			GNet::Address peer_address = peer_info.m_address ;
@@ -23,6 +23,7 @@
 
 #include "gdef.h"
 #include "gmultiserver.h"
+#include "gaddresstree.h"
 #include "glinebuffer.h"
 #include "gpopserverprotocol.h"
 #include "gsecrets.h"
@@ -32,6 +33,7 @@
 #include <string>
 #include <sstream>
 #include <memory>
+#include <utility>
 #include <list>
 
 namespace GPop
@@ -57,6 +59,8 @@ public:
 
 private: // overrides
 	bool protocolSend( std::string_view , std::size_t ) override ; // GPop::ServerProtocol::Sender
+	bool protocolSendFile( int , std::size_t , std::size_t ) override ; // GPop::ServerProtocol::Sender
+	bool protocolSendFileCapable() const override ; // GPop::ServerProtocol::Sender
 	void onDelete( const std::string & ) override ; // GNet::ServerPeer
 	bool onReceive( const char * , std::size_t , std::size_t , std::size_t , char ) override ; // GNet::ServerPeer
 	void onSecure( const std::string & , const std::string & , const std::string & ) override ; // GNet::SocketProtocolSink
@@ -89,6 +93,7 @@ public:
 	struct Config /// A structure containing GPop::Server configuration parameters.
 	{
 		bool allow_remote {false} ;
+		std::shared_ptr<const GNet::AddressTree> allow_remote_ranges ; // null for any
 		unsigned int port {110} ;
 		G::StringArray addresses ;
 		GNet::ServerPeer::Config net_server_peer_config ;
@@ -97,6 +102,7 @@ public:
 		std::string sasl_server_config ;
 
 		Config & set_allow_remote( bool = true ) noexcept ;
+		Config & set_allow_remote_ranges( std::shared_ptr<const GNet::AddressTree> ) ;
 		Config & set_port( unsigned int ) noexcept ;
 		Config & set_addresses( const G::StringArray & ) ;
 		Config & set_net_server_peer_config( const GNet::ServerPeer::Config & ) ;
@@ -133,6 +139,7 @@ private:
 } ;
 
 inline GPop::Server::Config & GPop::Server::Config::set_allow_remote( bool b ) noexcept { allow_remote = b ; return *this ; }
+inline GPop::Server::Config & GPop::Server::Config::set_allow_remote_ranges( std::shared_ptr<const GNet::AddressTree> p ) { allow_remote_ranges = std::move(p) ; return *this ; }
 inline GPop::Server::Config & GPop::Server::Config::set_port( unsigned int p ) noexcept { port = p ; return *this ; }
 inline GPop::Server::Config & GPop::Server::Config::set_addresses( const G::StringArray & a ) { addresses = a ; return *this ; }
 inline GPop::Server::Config & GPop::Server::Config::set_net_server_peer_config( const GNet::ServerPeer::Config & c ) { net_server_peer_config = c ; return *this ; }
@@ -25,10 +25,22 @@
 #include "gstringtoken.h"
 #include "gtest.h"
 #include "gbase64.h"
+#include "gfile.h"
 #include "gassert.h"
 #include "glog.h"
 #include <sstream>
 #include <algorithm>
+#include <vector>
+
+namespace GPop
+{
+	namespace ServerProtocolImp
+	{
+		constexpr std::size_t chunk_size = 65536U ;
+		bool clean( int fd , std::size_t & size ) ;
+		bool clean( std::string_view content ) noexcept ;
+	}
+}
 
 GPop::ServerProtocol::ServerProtocol( Sender & sender , Security & security , Store & store ,
 	const GAuth::SaslServerSecrets & server_secrets , const std::string & sasl_server_config ,
@@ -40,32 +52,52 @@ GPop::ServerProtocol::ServerProtocol( Sender & sender , Security & security , St
 		m_config(config) ,
 		m_sasl(GAuth::SaslServerFactory::newSaslServer(server_secrets,true,sasl_server_config,config.sasl_server_challenge_domain)) ,
 		m_peer_address(peer_address) ,
-		m_fsm(State::sStart,State::sEnd,State::s_Same,State::s_Any)
+		m_fsm(sharedFsm(security.securityEnabled()))
 {
 	// (dont send anything to the peer from this ctor -- the Sender object is not fuly constructed)
+}
 
-	m_fsm( Event::eStat , State::sActive , State::sActive , &ServerProtocol::doStat ) ;
-	m_fsm( Event::eList , State::sActive , State::sActive , &ServerProtocol::doList ) ;
-	m_fsm( Event::eRetr , State::sActive , State::sData , &ServerProtocol::doRetr , State::sActive ) ;
-	m_fsm( Event::eTop , State::sActive , State::sData , &ServerProtocol::doTop , State::sActive ) ;
-	m_fsm( Event::eDele , State::sActive , State::sActive , &ServerProtocol::doDele ) ;
-	m_fsm( Event::eNoop , State::sActive , State::sActive , &ServerProtocol::doNoop ) ;
-	m_fsm( Event::eRset , State::sActive , State::sActive , &ServerProtocol::doRset ) ;
-	m_fsm( Event::eUidl , State::sActive , State::sActive , &ServerProtocol::doUidl ) ;
-	m_fsm( Event::eSent , State::sData , State::sActive , &ServerProtocol::doNothing ) ;
-	m_fsm( Event::eUser , State::sStart , State::sStart , &ServerProtocol::doUser ) ;
-	m_fsm( Event::ePass , State::sStart , State::sActive , &ServerProtocol::doPass , State::sStart ) ;
-	m_fsm( Event::eApop , State::sStart , State::sActive , &ServerProtocol::doApop , State::sStart ) ;
-	m_fsm( Event::eQuit , State::sStart , State::sEnd , &ServerProtocol::doQuitEarly ) ;
-	m_fsm( Event::eCapa , State::sStart , State::sStart , &ServerProtocol::doCapa ) ;
-	m_fsm( Event::eCapa , State::sActive , State::sActive , &ServerProtocol::doCapa ) ;
-	if( m_security.securityEnabled() )
-		m_fsm( Event::eStls , State::sStart , State::sStart , &ServerProtocol::doStls , State::sStart ) ;
-	m_fsm( Event::eAuth , State::sStart , State::sAuth , &ServerProtocol::doAuth , State::sStart ) ;
-	m_fsm( Event::eAuthData , State::sAuth , State::sAuth , &ServerProtocol::doAuthData , State::sStart ) ;
-	m_fsm( Event::eAuthComplete , State::sAuth , State::sActive , &ServerProtocol::doAuthComplete ) ;
-	m_fsm( Event::eCapa , State::sActive , State::sActive , &ServerProtocol::doCapa ) ;
-	m_fsm( Event::eQuit , State::sActive , State::sEnd , &ServerProtocol::doQuit ) ;
+const GPop::ServerProtocol::Fsm & GPop::ServerProtocol::sharedFsm( bool with_stls )
+{
+	// the transition table is built once and shared by all sessions
+	if( with_stls )
+	{
+		static const Fsm fsm = newFsm( true ) ;
+		return fsm ;
+	}
+	else
+	{
+		static const Fsm fsm = newFsm( false ) ;
+		return fsm ;
+	}
+}
+
+GPop::ServerProtocol::Fsm GPop::ServerProtocol::newFsm( bool with_stls )
+{
+	Fsm fsm( State::sStart , State::sEnd , State::s_Same , State::s_Any ) ;
+	fsm( Event::eStat , State::sActive , State::sActive , &ServerProtocol::doStat ) ;
+	fsm( Event::eList , State::sActive , State::sActive , &ServerProtocol::doList ) ;
+	fsm( Event::eRetr , State::sActive , State::sData , &ServerProtocol::doRetr , State::sActive ) ;
+	fsm( Event::eTop , State::sActive , State::sData , &ServerProtocol::doTop , State::sActive ) ;
+	fsm( Event::eDele , State::sActive , State::sActive , &ServerProtocol::doDele ) ;
+	fsm( Event::eNoop , State::sActive , State::sActive , &ServerProtocol::doNoop ) ;
+	fsm( Event::eRset , State::sActive , State::sActive , &ServerProtocol::doRset ) ;
+	fsm( Event::eUidl , State::sActive , State::sActive , &ServerProtocol::doUidl ) ;
+	fsm( Event::eSent , State::sData , State::sActive , &ServerProtocol::doNothing ) ;
+	fsm( Event::eUser , State::sStart , State::sStart , &ServerProtocol::doUser ) ;
+	fsm( Event::ePass , State::sStart , State::sActive , &ServerProtocol::doPass , State::sStart ) ;
+	fsm( Event::eApop , State::sStart , State::sActive , &ServerProtocol::doApop , State::sStart ) ;
+	fsm( Event::eQuit , State::sStart , State::sEnd , &ServerProtocol::doQuitEarly ) ;
+	fsm( Event::eCapa , State::sStart , State::sStart , &ServerProtocol::doCapa ) ;
+	fsm( Event::eCapa , State::sActive , State::sActive , &ServerProtocol::doCapa ) ;
+	if( with_stls )
+		fsm( Event::eStls , State::sStart , State::sStart , &ServerProtocol::doStls , State::sStart ) ;
+	fsm( Event::eAuth , State::sStart , State::sAuth , &ServerProtocol::doAuth , State::sStart ) ;
+	fsm( Event::eAuthData , State::sAuth , State::sAuth , &ServerProtocol::doAuthData , State::sStart ) ;
+	fsm( Event::eAuthComplete , State::sAuth , State::sActive , &ServerProtocol::doAuthComplete ) ;
+	fsm( Event::eCapa , State::sActive , State::sActive , &ServerProtocol::doCapa ) ;
+	fsm( Event::eQuit , State::sActive , State::sEnd , &ServerProtocol::doQuit ) ;
+	return fsm ;
 }
 
 void GPop::ServerProtocol::init()
@@ -136,24 +168,79 @@ void GPop::ServerProtocol::apply( const std::string & line )
 		sendContent() ;
 }
 
+GPop::ServerProtocol::~ServerProtocol()
+{
+	closeContentFile() ;
+}
+
+void GPop::ServerProtocol::openContent( int id )
+{
+	// map the content file if possible, otherwise fall back to a stream
+	int fd = m_store_list.contentFile( id ) ;
+	m_content_mapped.map( fd ) ;
+	G::File::close( fd ) ;
+	m_content_pos = 0U ;
+	if( !m_content_mapped.mapped() )
+		m_content = m_store_list.content( id ) ;
+}
+
 void GPop::ServerProtocol::sendContent()
 {
-	// send until no more content or until blocked by flow-control
-	std::string line( 200 , '.' ) ;
+	if( m_content_fd != -1 )
+		return sendContentFile() ;
+
+	// send in large chunks until no more content or until blocked by flow-control
 	std::size_t n = 0 ;
 	bool eot = false ;
-	while( sendContentLine(line,eot) && !eot )
-		n++ ;
+	bool blocked = false ;
+	while( !eot && !blocked )
+	{
+		m_content_buffer.clear() ;
+		while( !eot && m_content_buffer.size() < ServerProtocolImp::chunk_size )
+		{
+			eot = readContentLine( m_content_buffer ) ;
+			if( !eot ) n++ ;
+		}
+		blocked = !m_sender.protocolSend( m_content_buffer , 0U ) ;
+	}
 
 	G_LOG( "GPop::ServerProtocol: tx>>: [" << n << " line(s) of content]" ) ;
 	if( eot )
 	{
 		G_LOG( "GPop::ServerProtocol: tx>>: \".\"" ) ;
 		m_content.reset() ; // free up resources
+		m_content_mapped.unmap() ;
+		std::string().swap( m_content_buffer ) ;
 		m_fsm.apply( *this , Event::eSent , "" ) ; // State::sData -> State::sActive
 	}
 }
 
+void GPop::ServerProtocol::sendContentFile()
+{
+	// send the whole content file in one go and then the terminator
+	if( !m_content_file_sent )
+	{
+		m_content_file_sent = true ;
+		if( !m_sender.protocolSendFile( m_content_fd , 0U , m_content_size ) )
+			return ; // resume() when sent
+	}
+
+	G_LOG( "GPop::ServerProtocol: tx>>: [" << m_content_size << " octet(s) of content]" ) ;
+	closeContentFile() ;
+	m_sender.protocolSend( ".\r\n"_sv , 0U ) ;
+	G_LOG( "GPop::ServerProtocol: tx>>: \".\"" ) ;
+	m_fsm.apply( *this , Event::eSent , "" ) ; // State::sData -> State::sActive
+}
+
+void GPop::ServerProtocol::closeContentFile() noexcept
+{
+	if( m_content_fd != -1 )
+		G::File::close( m_content_fd ) ;
+	m_content_fd = -1 ;
+	m_content_size = 0U ;
+	m_content_file_sent = false ;
+}
+
 void GPop::ServerProtocol::resume()
 {
 	// flow control is not an issue for protocol responses because we
@@ -165,28 +252,41 @@ void GPop::ServerProtocol::resume()
 		sendContent() ;
 }
 
-bool GPop::ServerProtocol::sendContentLine( std::string & line , bool & eot )
+bool GPop::ServerProtocol::readContentLine( std::string & buffer )
 {
-	G_ASSERT( m_content != nullptr ) ;
+	// appends a dot-stuffed content line, or the terminator if
+	// end-of-text, returning true if end-of-text
+	G_ASSERT( m_content != nullptr || m_content_mapped.mapped() ) ;
 
 	bool limited = m_in_body && m_body_limit == 0L ;
 	if( m_body_limit > 0L && m_in_body )
 		m_body_limit-- ;
 
-	line.erase( 1U ) ; // leave "."
-	bool eof = !G::Str::readLine( *m_content , line ,
-		m_config.crlf_only ? G::Str::Eol::CrLf : G::Str::Eol::Cr_Lf_CrLf ,
-		/*pre_erase_result=*/false ) ;
+	std::size_t pos = buffer.size() ;
+	buffer.append( 1U , '.' ) ;
+	G::Str::Eol eol = m_config.crlf_only ? G::Str::Eol::CrLf : G::Str::Eol::Cr_Lf_CrLf ;
+	bool eof = false ;
+	if( m_content_mapped.mapped() )
+	{
+		std::string_view line ;
+		eof = !G::Str::readLine( m_content_mapped.view() , m_content_pos , line , eol ) ;
+		buffer.append( line.data() , line.size() ) ;
+	}
+	else
+	{
+		eof = !G::Str::readLine( *m_content , buffer , eol , /*pre_erase_result=*/false ) ;
+	}
 
-	eot = eof || limited ;
-	if( eot ) line.erase( 1U ) ;
-	line.append( "\r\n" , 2U ) ;
-	std::size_t offset = eot ? 0U : ( line.at(1U) == '.' ? 0U : 1U ) ;
+	bool eot = eof || limited ;
+	if( eot ) buffer.erase( pos+1U ) ;
+	buffer.append( "\r\n" , 2U ) ;
+	if( !eot && buffer.at(pos+1U) != '.' )
+		buffer.erase( pos , 1U ) ;
 
-	if( !m_in_body && line.length() == (offset+2U) )
+	if( !m_in_body && buffer.size() == (pos+2U) )
 		m_in_body = true ;
 
-	return m_sender.protocolSend( line , offset ) ;
+	return eot ;
 }
 
 int GPop::ServerProtocol::commandNumber( const std::string & line , int default_ , std::size_t index ) const
@@ -335,7 +435,27 @@ void GPop::ServerProtocol::doRetr( const std::string & line , bool & more )
 	}
 	else
 	{
-		m_content = m_store_list.content(id) ;
+		// use zero-copy transmission if the content is already in
+		// wire format, otherwise read and dot-stuff line-by-line --
+		// the format is checked once and then remembered in the
+		// store's maildrop cache
+		using Format = StoreMessage::Format ;
+		Format format = m_sender.protocolSendFileCapable() ? m_store_list.format( id ) : Format::Other ;
+		if( format == Format::Wire )
+		{
+			m_content_fd = m_store_list.contentFile( id ) ;
+			m_content_size = static_cast<std::size_t>( m_store_list.byteCount(id) ) ;
+		}
+		else if( format == Format::Unknown )
+		{
+			m_content_fd = m_store_list.contentFile( id ) ;
+			bool clean = ServerProtocolImp::clean( m_content_fd , m_content_size ) ;
+			m_store_list.setFormat( id , clean ? Format::Wire : Format::Other ) ;
+			if( !clean )
+				closeContentFile() ;
+		}
+		if( m_content_fd == -1 )
+			openContent( id ) ;
 		m_body_limit = -1L ;
 
 		std::ostringstream ss ;
@@ -356,7 +476,7 @@ void GPop::ServerProtocol::doTop( const std::string & line , bool & more )
 	}
 	else
 	{
-		m_content = m_store_list.content( id ) ;
+		openContent( id ) ;
 		m_body_limit = n ;
 		m_in_body = false ;
 		sendOk() ;
@@ -670,3 +790,63 @@ std::string GPop::ServerProtocolText::user( const std::string & id ) const
 	return std::string("user: ",6U).append(id) ;
 }
 
+// ==
+
+bool GPop::ServerProtocolImp::clean( int fd , std::size_t & size )
+{
+	// returns true if the content can be sent as-is, ie. only CRLF
+	// line endings, no lines starting with a dot, and ending with
+	// CRLF (or empty)
+	{
+		G::MappedFile mapped ;
+		if( mapped.map( fd ) )
+		{
+			size = mapped.view().size() ;
+			return clean( mapped.view() ) ;
+		}
+	}
+
+	std::vector<char> buffer( chunk_size ) ;
+	size = 0U ;
+	char prev = '\n' ;
+	char prev_prev = '\r' ;
+	for(;;)
+	{
+		ssize_t rc = G::File::read( fd , buffer.data() , buffer.size() ) ;
+		if( rc < 0 )
+			return false ;
+		if( rc == 0 )
+			break ;
+		for( std::size_t i = 0U ; i < static_cast<std::size_t>(rc) ; i++ )
+		{
+			char c = buffer[i] ;
+			if( ( c == '.' && prev == '\n' ) ||
+				( c == '\n' && prev != '\r' ) ||
+				( c != '\n' && prev == '\r' ) )
+					return false ;
+			prev_prev = prev ;
+			prev = c ;
+		}
+		size += static_cast<std::size_t>( rc ) ;
+	}
+	return prev == '\n' && prev_prev == '\r' ;
+}
+
+bool GPop::ServerProtocolImp::clean( std::string_view content ) noexcept
+{
+	// as above, but scanning for line endings rather than
+	// character-by-character
+	if( content.empty() )
+		return true ;
+	if( content[0] == '.' || content.size() < 2U || content.substr(content.size()-2U) != "\r\n"_sv )
+		return false ;
+	for( std::size_t pos = content.find_first_of( "\r\n"_sv ) ; pos != std::string::npos ;
+		pos = content.find_first_of( "\r\n"_sv , pos+2U ) )
+	{
+		if( content[pos] != '\r' || (pos+1U) >= content.size() || content[pos+1U] != '\n' )
+			return false ;
+		if( (pos+2U) < content.size() && content[pos+2U] == '.' )
+			return false ;
+	}
+	return true ;
+}
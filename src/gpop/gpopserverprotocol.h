@@ -30,6 +30,7 @@
 #include "gstringview.h"
 #include "gtimer.h"
 #include "gexception.h"
+#include "gmappedfile.h"
 #include <memory>
 
 namespace GPop
@@ -55,6 +56,8 @@ public:
 	{
 	public:
 		virtual bool protocolSend( std::string_view , std::size_t offset ) = 0 ;
+		virtual bool protocolSendFile( int fd , std::size_t offset , std::size_t size ) = 0 ;
+		virtual bool protocolSendFileCapable() const = 0 ;
 		virtual ~Sender() = default ;
 	} ;
 
@@ -151,7 +154,7 @@ private:
 	using Fsm = G::StateMachine<ServerProtocol,State,Event,EventData> ;
 
 public:
-	~ServerProtocol() = default ;
+	~ServerProtocol() ;
 	ServerProtocol( const ServerProtocol & ) = delete ;
 	ServerProtocol( ServerProtocol && ) = delete ;
 	ServerProtocol & operator=( const ServerProtocol & ) = delete ;
@@ -185,10 +188,15 @@ private:
 	void sendList( const std::string & , bool ) ;
 	std::string commandWord( const std::string & ) const ;
 	std::string commandParameter( const std::string & , std::size_t index = 1U ) const ;
+	static const Fsm & sharedFsm( bool with_stls ) ;
+	static Fsm newFsm( bool with_stls ) ;
 	static std::string commandPart( const std::string & , std::size_t index ) ;
 	static Event commandEvent( std::string_view ) ;
+	void openContent( int id ) ;
 	void sendContent() ;
-	bool sendContentLine( std::string & , bool & ) ;
+	void sendContentFile() ;
+	bool readContentLine( std::string & ) ;
+	void closeContentFile() noexcept ;
 	void sendLine( std::string_view , bool has_crlf = false ) ;
 	void sendLine( std::string && ) ;
 	void sendLines( std::ostringstream & ) ;
@@ -209,6 +217,12 @@ private:
 	Fsm m_fsm ;
 	std::string m_user ;
 	std::unique_ptr<std::istream> m_content ;
+	G::MappedFile m_content_mapped ;
+	std::size_t m_content_pos {0U} ;
+	std::string m_content_buffer ;
+	int m_content_fd {-1} ;
+	std::size_t m_content_size {0U} ;
+	bool m_content_file_sent {false} ;
 	long m_body_limit {-1L} ;
 	bool m_in_body {false} ;
 	bool m_secure {false} ;
@@ -25,6 +25,7 @@
 #include "gstr.h"
 #include "gfile.h"
 #include "gdirectory.h"
+#include "gdatetime.h"
 #include "gtest.h"
 #include "groot.h"
 #include "gassert.h"
@@ -52,10 +53,6 @@ namespace GPop
 		struct FileDeleter : private G::Root /// Used by GPop::Store like G::Root when deleting.
 		{
 		} ;
-		unsigned long toSize( const std::string & s )
-		{
-			return (s.empty() || !G::Str::isULong(s) ) ? 0UL : G::Str::toULong(s,G::Str::Limited()) ;
-		}
 	}
 }
 
@@ -150,6 +147,98 @@ bool GPop::Store::byName() const
 	return m_config.by_name ;
 }
 
+std::vector<GPop::StoreMessage> GPop::Store::list( const G::Path & edir , const G::Path & sdir )
+{
+	G::File::Stat estat ;
+	G::File::Stat sstat ;
+	{
+		StoreImp::DirectoryReader claim_reader ;
+		estat = G::File::stat( edir ) ;
+		sstat = m_config.by_name ? G::File::stat( sdir ) : estat ;
+	}
+	if( estat.error || sstat.error )
+		return scan( edir , sdir ) ;
+
+	auto p = m_cache.find( edir.str() ) ;
+	if( p != m_cache.end() &&
+		(*p).second.edir_mtime_s == estat.mtime_s && (*p).second.edir_mtime_us == estat.mtime_us &&
+		(*p).second.sdir_mtime_s == sstat.mtime_s && (*p).second.sdir_mtime_us == sstat.mtime_us )
+	{
+		G_DEBUG( "GPop::Store::list: using cached maildrop list for " << edir ) ;
+		return (*p).second.list ;
+	}
+
+	std::vector<StoreMessage> result = scan( edir , sdir ) ;
+
+	// only cache if the directories were not modified in the current
+	// second, since another change within the same mtime granularity
+	// would go unnoticed
+	std::time_t now = G::SystemTime::now().s() ;
+	if( estat.mtime_s < now && sstat.mtime_s < now )
+	{
+		Maildrop & maildrop = m_cache[edir.str()] ;
+		maildrop.edir_mtime_s = estat.mtime_s ;
+		maildrop.edir_mtime_us = estat.mtime_us ;
+		maildrop.sdir_mtime_s = sstat.mtime_s ;
+		maildrop.sdir_mtime_us = sstat.mtime_us ;
+		maildrop.list = result ;
+	}
+	else if( p != m_cache.end() )
+	{
+		m_cache.erase( p ) ;
+	}
+	return result ;
+}
+
+std::vector<GPop::StoreMessage> GPop::Store::scan( const G::Path & edir , const G::Path & sdir ) const
+{
+	// build a list of envelope files, with content file sizes
+	std::vector<StoreMessage> result ;
+	StoreImp::DirectoryReader claim_reader ;
+	G::DirectoryList iter ;
+	std::size_t n = iter.readType( edir , ".envelope" ) ;
+	result.reserve( n ) ;
+	while( iter.more() )
+	{
+		std::string ename = iter.fileName() ;
+		std::string name = G::Str::head( ename , ename.rfind('.') ) ;
+		std::string cname = name + ".content" ;
+
+		G::File::Stat cstat = G::File::stat( G::Path(edir,cname) ) ;
+		bool in_parent = false ;
+		if( cstat.error && m_config.by_name )
+		{
+			G::File::Stat pstat = G::File::stat( G::Path(sdir,cname) ) ;
+			if( !pstat.error )
+			{
+				in_parent = true ;
+				cstat = pstat ;
+			}
+		}
+
+		auto csize = cstat.error || cstat.is_dir ? 0UL : static_cast<StoreMessage::Size>(cstat.size) ;
+		if( csize )
+		{
+			result.emplace_back( name , csize , in_parent ) ;
+			result.back().mtime_s = cstat.mtime_s ;
+			result.back().mtime_us = cstat.mtime_us ;
+		}
+	}
+	return result ;
+}
+
+void GPop::Store::setFormat( const G::Path & edir , std::size_t offset , const StoreMessage & message )
+{
+	auto p = m_cache.find( edir.str() ) ;
+	if( p != m_cache.end() && offset < (*p).second.list.size() )
+	{
+		StoreMessage & cached = (*p).second.list[offset] ;
+		if( cached.name == message.name && cached.size == message.size &&
+			cached.mtime_s == message.mtime_s && cached.mtime_us == message.mtime_us )
+				cached.format = message.format ;
+	}
+}
+
 // ===
 
 GPop::StoreMessage::StoreMessage( const std::string & name_in , Size size_in , bool in_parent_in ) :
@@ -193,31 +282,7 @@ GPop::StoreUser::StoreUser( Store & store , const std::string & user ) :
 	m_sdir(store.dir())
 {
 	G_ASSERT( !user.empty() ) ;
-
-	// build a list of envelope files, with content file sizes
-	{
-		StoreImp::DirectoryReader claim_reader ;
-		G::DirectoryList iter ;
-		std::size_t n = iter.readType( m_edir , ".envelope" ) ;
-		m_list.reserve( n ) ;
-		while( iter.more() )
-		{
-			std::string ename = iter.fileName() ;
-			std::string name = G::Str::head( ename , ename.rfind('.') ) ;
-			std::string cname = name + ".content" ;
-
-			bool in_parent =
-				!G::File::exists( G::Path(m_edir,cname) , std::nothrow ) &&
-				m_store.byName() &&
-				G::File::exists( G::Path(m_sdir,cname) , std::nothrow ) ;
-
-			G::Path cpath = in_parent ? G::Path(m_sdir,cname) : G::Path(m_edir,cname) ;
-
-			auto csize = StoreImp::toSize( G::File::sizeString(cpath) ) ;
-			if( csize )
-				m_list.emplace_back( name , csize , in_parent ) ;
-		}
-	}
+	m_list = m_store.list( m_edir , m_sdir ) ;
 }
 
 // ==
@@ -226,6 +291,7 @@ GPop::StoreList::StoreList()
 = default ;
 
 GPop::StoreList::StoreList( const StoreUser & store_user , bool allow_delete ) :
+	m_store(&store_user.m_store) ,
 	m_allow_delete(allow_delete) ,
 	m_edir(store_user.m_edir) ,
 	m_sdir(store_user.m_sdir) ,
@@ -304,6 +370,58 @@ std::unique_ptr<std::istream> GPop::StoreList::content( int id ) const
 	return fstream ;
 }
 
+int GPop::StoreList::contentFile( int id ) const
+{
+	G_ASSERT( valid(id) ) ;
+	if( !valid(id) )
+		throw CannotRead( std::to_string(id) ) ;
+
+	std::size_t offset = static_cast<std::size_t>(id) - 1U ;
+	G::Path cpath = m_list.at(offset).cpath(m_edir,m_sdir) ;
+	G_DEBUG( "GPop::StoreList::contentFile: " << id << " " << cpath ) ;
+
+	int fd = -1 ;
+	{
+		StoreImp::FileReader claim_reader ;
+		fd = G::File::open( cpath , G::File::InOutAppend::In ) ;
+	}
+	if( fd < 0 )
+		throw CannotRead( cpath.str() ) ;
+	return fd ;
+}
+
+GPop::StoreMessage::Format GPop::StoreList::format( int id ) const
+{
+	if( !valid(id) )
+		return StoreMessage::Format::Unknown ;
+
+	// only trust the recorded format if the content file is unchanged
+	std::size_t offset = static_cast<std::size_t>(id) - 1U ;
+	const StoreMessage & message = m_list.at( offset ) ;
+	if( message.format == StoreMessage::Format::Unknown )
+		return message.format ;
+	G::File::Stat stat ;
+	{
+		StoreImp::FileReader claim_reader ;
+		stat = G::File::stat( message.cpath(m_edir,m_sdir) ) ;
+	}
+	bool unchanged = !stat.error && stat.size == message.size &&
+		stat.mtime_s == message.mtime_s && stat.mtime_us == message.mtime_us ;
+	return unchanged ? message.format : StoreMessage::Format::Unknown ;
+}
+
+void GPop::StoreList::setFormat( int id , StoreMessage::Format format )
+{
+	if( valid(id) )
+	{
+		std::size_t offset = static_cast<std::size_t>(id) - 1U ;
+		StoreMessage & message = m_list.at( offset ) ;
+		message.format = format ;
+		if( m_store != nullptr )
+			m_store->setFormat( m_edir , offset , message ) ;
+	}
+}
+
 void GPop::StoreList::remove( int id )
 {
 	if( valid(id) )
@@ -28,6 +28,8 @@
 #include <memory>
 #include <iostream>
 #include <set>
+#include <map>
+#include <ctime>
 #include <vector>
 
 namespace GPop
@@ -43,6 +45,12 @@ namespace GPop
 /// store allows content files to be in the envelope file's parent
 /// directory.
 ///
+/// The store keeps a cache of maildrop listings, keyed by directory
+/// and invalidated by directory modification times, so that repeated
+/// logins do not need to re-scan and re-stat every file. The cached
+/// listing also remembers which content files are already in wire
+/// format so that they are only read once to find out.
+///
 class GPop::Store
 {
 public:
@@ -76,6 +84,20 @@ public:
 		///< Returns true if the spool directory is affected
 		///< by the user name.
 
+	std::vector<StoreMessage> list( const G::Path & edir , const G::Path & sdir ) ;
+		///< Returns the list of messages having envelope files in
+		///< the given directory, with content files in the same
+		///< directory or, if byName(), in the main spool directory.
+		///< The result is cached until the modification time of
+		///< either directory changes, so content files that are
+		///< edited in-place are not seen with their new size.
+
+	void setFormat( const G::Path & edir , std::size_t offset , const StoreMessage & ) ;
+		///< Records the message's content format in the cached
+		///< listing for the given directory, if the listing is
+		///< still the one that the message came from. The
+		///< offset is the message's position in the listing.
+
 public:
 	~Store() = default ;
 	Store( const Store & ) = delete ;
@@ -83,12 +105,24 @@ public:
 	Store & operator=( const Store & ) = delete ;
 	Store & operator=( Store && ) = delete ;
 
+private:
+	struct Maildrop /// A cached maildrop listing used by GPop::Store.
+	{
+		std::time_t edir_mtime_s {0} ;
+		unsigned int edir_mtime_us {0U} ;
+		std::time_t sdir_mtime_s {0} ;
+		unsigned int sdir_mtime_us {0U} ;
+		std::vector<StoreMessage> list ;
+	} ;
+
 private:
 	static bool accessible( const G::Path & dir , bool ) ;
+	std::vector<StoreMessage> scan( const G::Path & edir , const G::Path & sdir ) const ;
 
 private:
 	G::Path m_path ;
 	Config m_config ;
+	std::map<std::string,Maildrop> m_cache ;
 } ;
 
 //| \class GPop::StoreMessage
@@ -98,6 +132,12 @@ class GPop::StoreMessage
 {
 public:
 	using Size = unsigned long ;
+	enum class Format // content format
+	{
+		Unknown ,
+		Wire , // CRLF line endings, no leading dots, ending with CRLF
+		Other
+	} ;
 	StoreMessage( const std::string & name , Size size , bool in_parent ) ;
 	G::Path epath( const G::Path & edir ) const ;
 	G::Path cpath( const G::Path & edir , const G::Path & sdir ) const ;
@@ -110,6 +150,9 @@ public:
 	Size size ;
 	bool in_parent ;
 	bool deleted {false} ;
+	std::time_t mtime_s {0} ; // content file
+	unsigned int mtime_us {0U} ;
+	Format format {Format::Unknown} ;
 } ;
 
 //| \class GPop::StoreUser
@@ -184,6 +227,21 @@ public:
 	std::unique_ptr<std::istream> content( int id ) const ;
 		///< Retrieves the message content.
 
+	int contentFile( int id ) const ;
+		///< Opens the message content file for reading and
+		///< returns the file descriptor. The caller should
+		///< G::File::close() it. Throws CannotRead on error.
+
+	StoreMessage::Format format( int id ) const ;
+		///< Returns the message's content format as recorded by
+		///< setFormat(), or Format::Unknown if not recorded or
+		///< if the content file has changed since.
+
+	void setFormat( int id , StoreMessage::Format ) ;
+		///< Records the message's content format, including in
+		///< the store's cached maildrop listing so that it is
+		///< still known in later sessions.
+
 	void remove( int ) ;
 		///< Marks the message files for deletion.
 
@@ -207,6 +265,7 @@ private:
 	bool shared( const StoreMessage & ) const ;
 
 private:
+	Store * m_store {nullptr} ;
 	bool m_allow_delete {false} ;
 	G::Path m_edir ;
 	G::Path m_sdir ;
@@ -29,11 +29,14 @@
 #include "gsmtpserverprotocol.h"
 #include "gclientptr.h"
 #include "gsmtpforward.h"
+#include "gaddresstree.h"
 #include "gstringview.h"
 #include "gstringarray.h"
 #include "gstringmap.h"
 #include <string>
 #include <list>
+#include <map>
+#include <functional>
 #include <sstream>
 #include <utility>
 #include <memory>
@@ -56,10 +59,13 @@ namespace GSmtp
 class GSmtp::AdminServerPeer : public GNet::ServerPeer
 {
 public:
+	using InfoFunctions = std::map<std::string,std::function<std::string()>> ;
+
 	AdminServerPeer( GNet::EventStateUnbound , GNet::ServerPeerInfo && , AdminServerImp & ,
 		const std::string & remote , const G::StringMap & info_commands ,
-		bool with_terminate ) ;
-			///< Constructor.
+		const InfoFunctions & info_functions , bool with_terminate ) ;
+			///< Constructor. The info functions are like the info
+			///< commands but they are evaluated on demand.
 
 	~AdminServerPeer() override ;
 		///< Destructor.
@@ -87,10 +93,13 @@ private:
 	void clientDone( const std::string & ) ;
 	static bool is( std::string_view , std::string_view ) ;
 	static std::pair<bool,std::string> find( std::string_view , const G::StringMap & map ) ;
+	static std::pair<bool,std::string> find( std::string_view , const InfoFunctions & ) ;
+	G::StringArray infoKeys() const ;
 	void flush() ;
 	void forward() ;
 	void help() ;
 	void status() ;
+	void metrics() ;
 	void sendMessageIds( const std::vector<GStore::MessageId> & ) ;
 	void sendLine( std::string && ) ;
 	void sendLineCopy( std::string ) ;
@@ -110,6 +119,7 @@ private:
 	GNet::ClientPtr<GSmtp::Forward> m_client_ptr ;
 	bool m_notifying {false} ;
 	G::StringMap m_info_commands ;
+	InfoFunctions m_info_functions ;
 	bool m_with_terminate ;
 	unsigned int m_error_limit {30U} ;
 	unsigned int m_error_count {0U} ;
@@ -127,8 +137,10 @@ public:
 		unsigned int port {10026U} ;
 		bool with_terminate {false} ;
 		bool allow_remote {false} ;
+		std::shared_ptr<const GNet::AddressTree> allow_remote_ranges ; // null for any
 		std::string remote_address ;
 		G::StringMap info_commands ;
+		AdminServerPeer::InfoFunctions info_functions ;
 		Client::Config smtp_client_config ;
 		GNet::Server::Config net_server_config ;
 		GNet::ServerPeer::Config net_server_peer_config ;
@@ -136,8 +148,10 @@ public:
 		Config & set_port( unsigned int ) noexcept ;
 		Config & set_with_terminate( bool = true ) noexcept ;
 		Config & set_allow_remote( bool = true ) noexcept ;
+		Config & set_allow_remote_ranges( std::shared_ptr<const GNet::AddressTree> ) ;
 		Config & set_remote_address( const std::string & ) ;
 		Config & set_info_commands( const G::StringMap & ) ;
+		Config & set_info_function( const std::string & , std::function<std::string()> ) ;
 		Config & set_smtp_client_config( const Client::Config & ) ;
 		Config & set_net_server_config( const GNet::Server::Config & ) ;
 		Config & set_net_server_peer_config( const GNet::ServerPeer::Config & ) ;
@@ -204,8 +218,10 @@ private:
 inline GSmtp::AdminServer::Config & GSmtp::AdminServer::Config::set_port( unsigned int n ) noexcept { port = n ; return *this ; }
 inline GSmtp::AdminServer::Config & GSmtp::AdminServer::Config::set_with_terminate( bool b ) noexcept { with_terminate = b ; return *this ; }
 inline GSmtp::AdminServer::Config & GSmtp::AdminServer::Config::set_allow_remote( bool b ) noexcept { allow_remote = b ; return *this ; }
+inline GSmtp::AdminServer::Config & GSmtp::AdminServer::Config::set_allow_remote_ranges( std::shared_ptr<const GNet::AddressTree> p ) { allow_remote_ranges = std::move(p) ; return *this ; }
 inline GSmtp::AdminServer::Config & GSmtp::AdminServer::Config::set_remote_address( const std::string & s ) { remote_address = s ; return *this ; }
 inline GSmtp::AdminServer::Config & GSmtp::AdminServer::Config::set_info_commands( const G::StringMap & m ) { info_commands = m ; return *this ; }
+inline GSmtp::AdminServer::Config & GSmtp::AdminServer::Config::set_info_function( const std::string & k , std::function<std::string()> fn ) { info_functions[k] = std::move(fn) ; return *this ; }
 inline GSmtp::AdminServer::Config & GSmtp::AdminServer::Config::set_smtp_client_config( const Client::Config & c ) { smtp_client_config = c ; return *this ; }
 inline GSmtp::AdminServer::Config & GSmtp::AdminServer::Config::set_net_server_config( const GNet::Server::Config & c ) { net_server_config = c ; return *this ; }
 inline GSmtp::AdminServer::Config & GSmtp::AdminServer::Config::set_net_server_peer_config( const GNet::ServerPeer::Config & c ) { net_server_peer_config = c ; return *this ; }
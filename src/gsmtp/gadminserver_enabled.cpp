@@ -27,6 +27,8 @@
 #include "gprocess.h"
 #include "glocal.h"
 #include "gmonitor.h"
+#include "gmetrics.h"
+#include "gaddresstree.h"
 #include "gslot.h"
 #include "gstringtoken.h"
 #include "gstr.h"
@@ -34,6 +36,16 @@
 #include "glog.h"
 #include <utility>
 #include <limits>
+#include <algorithm>
+
+namespace GSmtp
+{
+	namespace AdminServerImpMetrics
+	{
+		G::Metrics::Gauge spool_pending( "emailrelay_spool_messages" , "state=\"pending\"" , "Messages in the spool" ) ;
+		G::Metrics::Gauge spool_failed( "emailrelay_spool_messages" , "state=\"failed\"" , "Messages in the spool" ) ;
+	}
+}
 
 class GSmtp::AdminServerImp : public GNet::MultiServer
 {
@@ -80,7 +92,7 @@ private:
 
 GSmtp::AdminServerPeer::AdminServerPeer( GNet::EventStateUnbound esu , GNet::ServerPeerInfo && peer_info ,
 	AdminServerImp & server_imp , const std::string & remote_address ,
-	const G::StringMap & info_commands ,
+	const G::StringMap & info_commands , const InfoFunctions & info_functions ,
 	bool with_terminate ) :
 		GNet::ServerPeer(esbind(esu,this),std::move(peer_info),GNet::LineBuffer::Config::autodetect()),
 		m_es(esbind(esu,this)) ,
@@ -88,6 +100,7 @@ GSmtp::AdminServerPeer::AdminServerPeer( GNet::EventStateUnbound esu , GNet::Ser
 		m_prompt("E-MailRelay> ") ,
 		m_remote_address(remote_address) ,
 		m_info_commands(info_commands) ,
+		m_info_functions(info_functions) ,
 		m_with_terminate(with_terminate)
 {
 	G_LOG_S( "GSmtp::AdminServerPeer: admin connection from " << peerAddress().displayString() ) ;
@@ -140,6 +153,10 @@ bool GSmtp::AdminServerPeer::onReceive( const char * line_data , std::size_t lin
 	{
 		status() ;
 	}
+	else if( is(t(),"metrics") )
+	{
+		metrics() ;
+	}
 	else if( is(t(),"notify") )
 	{
 		m_notifying = true ;
@@ -153,6 +170,11 @@ bool GSmtp::AdminServerPeer::onReceive( const char * line_data , std::size_t lin
 	{
 		sendMessageIds( m_server_imp.store().failures() ) ;
 	}
+	else if( is(t(),"rescan") )
+	{
+		m_server_imp.store().rescan() ;
+		sendLine( "OK" ) ;
+	}
 	else if( is(t(),"unfail-all") )
 	{
 		m_server_imp.store().unfailAll() ;
@@ -173,13 +195,18 @@ bool GSmtp::AdminServerPeer::onReceive( const char * line_data , std::size_t lin
 		if( GNet::EventLoop::exists() )
 			GNet::EventLoop::instance().quit("") ;
 	}
-	else if( is(t(),"info") && !m_info_commands.empty() )
+	else if( is(t(),"info") && !infoKeys().empty() )
 	{
 		std::string_view arg = (++t)() ;
-		if( arg.empty() || !find(arg,m_info_commands).first )
-			sendLine( std::move(std::string("usage: info {").append(G::Str::join("|",G::Str::keys(m_info_commands))).append(1U,'}')) ) ;
+		std::pair<bool,std::string> info { false , {} } ;
+		if( !arg.empty() )
+			info = find( arg , m_info_commands ) ;
+		if( !arg.empty() && !info.first )
+			info = find( arg , m_info_functions ) ;
+		if( !info.first )
+			sendLine( std::move(std::string("usage: info {").append(G::Str::join("|",infoKeys())).append(1U,'}')) ) ;
 		else
-			sendLine( find(arg,m_info_commands).second ) ;
+			sendLine( std::move(info.second) ) ;
 	}
 	else if( is(t(),"dnsbl") )
 	{
@@ -250,6 +277,25 @@ std::pair<bool,std::string> GSmtp::AdminServerPeer::find( std::string_view line
 	return { false , {} } ;
 }
 
+std::pair<bool,std::string> GSmtp::AdminServerPeer::find( std::string_view line , const InfoFunctions & map )
+{
+	for( const auto & item : map )
+	{
+		if( is(line,item.first) )
+			return { true , item.second() } ;
+	}
+	return { false , {} } ;
+}
+
+G::StringArray GSmtp::AdminServerPeer::infoKeys() const
+{
+	G::StringArray keys = G::Str::keys( m_info_commands ) ;
+	for( const auto & item : m_info_functions )
+		keys.push_back( item.first ) ;
+	std::sort( keys.begin() , keys.end() ) ;
+	return keys ;
+}
+
 void GSmtp::AdminServerPeer::help()
 {
 	sendLine( std::move(std::string("commands: ")
@@ -258,11 +304,13 @@ void GSmtp::AdminServerPeer::help()
 		.append( "flush, " )
 		.append( "forward, " )
 		.append( "help, " )
-		.append( "info, " , m_info_commands.empty() ? 0U : 6U )
+		.append( "info, " , infoKeys().empty() ? 0U : 6U )
 		.append( "list, " )
+		.append( "metrics, " )
 		.append( "notify, " )
 		.append( "pid, " )
 		.append( "quit, " )
+		.append( "rescan, " )
 		.append( "smtp, " )
 		.append( "status, " )
 		.append( "terminate, " , m_with_terminate ? 11U : 0U )
@@ -361,6 +409,20 @@ void GSmtp::AdminServerPeer::status()
 	}
 }
 
+void GSmtp::AdminServerPeer::metrics()
+{
+	// the spool depth is sampled here rather than tracked incrementally
+	// since the spool directory can be changed externally
+	AdminServerImpMetrics::spool_pending.set( static_cast<long long>(m_server_imp.store().ids().size()) ) ;
+	AdminServerImpMetrics::spool_failed.set( static_cast<long long>(m_server_imp.store().failures().size()) ) ;
+
+	std::ostringstream ss ;
+	G::Metrics::report( ss ) ;
+	std::string report = ss.str() ;
+	G::Str::trimRight( report , "\n" ) ;
+	sendLine( std::move(report) ) ;
+}
+
 void GSmtp::AdminServerPeer::sendMessageIds( const std::vector<GStore::MessageId> & ids )
 {
 	std::ostringstream ss ;
@@ -475,15 +537,21 @@ std::unique_ptr<GNet::ServerPeer> GSmtp::AdminServerImp::newPeer( GNet::EventSta
 	try
 	{
 		std::string reason ;
-		if( !m_config.allow_remote && !peer_info.m_address.isLocal(reason) )
+		bool is_local = peer_info.m_address.isLocal( reason ) ;
+		if( !m_config.allow_remote && !is_local )
 		{
 			G_WARNING( "GSmtp::Server: configured to reject non-local admin connection: " << reason ) ;
 		}
+		else if( !is_local && m_config.allow_remote_ranges && !m_config.allow_remote_ranges->contains(peer_info.m_address) )
+		{
+			G_WARNING( "GSmtp::Server: configured to reject admin connection from outside the allowed address ranges: "
+				<< peer_info.m_address.hostPartString() ) ;
+		}
 		else
 		{
 			ptr = std::make_unique<AdminServerPeer>( esu , std::move(peer_info) , *this ,
 				m_config.remote_address , m_config.info_commands ,
-				m_config.with_terminate ) ;
+				m_config.info_functions , m_config.with_terminate ) ;
 		}
 	}
 	catch( std::exception & e ) // newPeer()
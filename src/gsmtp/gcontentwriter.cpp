@@ -0,0 +1,233 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gcontentwriter.cpp
+///
+
+#include "gdef.h"
+#include "gcontentwriter.h"
+#include "gcleanup.h"
+#include "gassert.h"
+#include "glog.h"
+#include <algorithm>
+#include <iterator>
+
+GSmtp::ContentWriterPool::ContentWriterPool( GNet::EventState es , std::size_t threads ) :
+	m_thread_count(std::max(threads,std::size_t(1U))) ,
+	m_timer(*this,&ContentWriterPool::onTimeout,es)
+{
+}
+
+GSmtp::ContentWriterPool::~ContentWriterPool()
+{
+	{
+		G::threading::lock_type lock( m_mutex ) ;
+		m_stop = true ;
+	}
+	m_cond.notify_all() ;
+	for( auto & thread : m_threads )
+	{
+		try
+		{
+			thread.join() ;
+		}
+		catch(...)
+		{
+		}
+	}
+	for( auto & job : m_queue )
+		GNet::FutureEvent::send( job->handle ) ;
+}
+
+bool GSmtp::ContentWriterPool::works()
+{
+	return G::threading::works() ;
+}
+
+void GSmtp::ContentWriterPool::submit( std::shared_ptr<Job> job )
+{
+	// start the threads on first use, not before any daemon fork()
+	if( m_threads.size() < m_thread_count )
+	{
+		G::Cleanup::Block block_signals ; // signals are delivered to the main thread
+		while( m_threads.size() < m_thread_count )
+			m_threads.emplace_back( ContentWriterPool::run , this ) ;
+	}
+	{
+		G::threading::lock_type lock( m_mutex ) ;
+		m_queue.push_back( job ) ;
+	}
+	m_cond.notify_one() ;
+}
+
+void GSmtp::ContentWriterPool::run( ContentWriterPool * This ) noexcept
+{
+	// thread function, spawned from the constructor and join()ed from the destructor
+	for(;;)
+	{
+		std::shared_ptr<Job> job ;
+		{
+			G::threading::unique_lock_type lock( This->m_mutex ) ;
+			This->m_cond.wait( lock , [This](){return This->m_stop || !This->m_queue.empty();} ) ;
+			if( This->m_stop )
+				break ;
+			job = This->m_queue.front() ;
+			This->m_queue.pop_front() ;
+		}
+
+		std::exception_ptr exception ;
+		try
+		{
+			job->msg->writeContent( job->close ) ;
+		}
+		catch(...) // worker thread outer function
+		{
+			exception = std::current_exception() ; // see result()
+		}
+
+		// never hold the last reference to the message on this thread
+		HANDLE handle = job->handle ;
+		{
+			G::threading::lock_type lock( This->m_mutex ) ;
+			job->exception = exception ;
+			job->done = true ;
+			job.reset() ;
+		}
+		GNet::FutureEvent::send( handle ) ;
+	}
+}
+
+std::exception_ptr GSmtp::ContentWriterPool::result( const Job & job ) const
+{
+	G::threading::lock_type lock( m_mutex ) ;
+	G_ASSERT( job.done ) ;
+	return job.exception ;
+}
+
+void GSmtp::ContentWriterPool::abandon( std::shared_ptr<Job> job )
+{
+	bool queued = false ;
+	{
+		G::threading::lock_type lock( m_mutex ) ;
+		auto p = std::find( m_queue.begin() , m_queue.end() , job ) ;
+		queued = p != m_queue.end() ;
+		if( queued )
+			m_queue.erase( p ) ;
+	}
+	if( queued )
+	{
+		GNet::FutureEvent::send( job->handle ) ;
+	}
+	else
+	{
+		m_abandoned.push_back( job ) ;
+		if( !m_timer.active() )
+			m_timer.startTimer( 1U ) ;
+	}
+}
+
+void GSmtp::ContentWriterPool::onTimeout()
+{
+	// release abandoned messages on this thread once their jobs are done
+	std::vector<std::shared_ptr<Job>> done ;
+	{
+		G::threading::lock_type lock( m_mutex ) ;
+		auto p = std::partition( m_abandoned.begin() , m_abandoned.end() ,
+			[](const std::shared_ptr<Job> & job_){return !job_->done;} ) ;
+		std::move( p , m_abandoned.end() , std::back_inserter(done) ) ;
+		m_abandoned.erase( p , m_abandoned.end() ) ;
+	}
+	G_DEBUG( "GSmtp::ContentWriterPool::onTimeout: releasing " << done.size() << " abandoned message(s)" ) ;
+	done.clear() ;
+	if( !m_abandoned.empty() )
+		m_timer.startTimer( 1U ) ;
+}
+
+// ==
+
+GSmtp::ContentWriter::ContentWriter( GNet::EventState es , std::shared_ptr<ContentWriterPool> pool ) :
+	m_es(es) ,
+	m_pool(std::move(pool))
+{
+	G_ASSERT( m_pool != nullptr ) ;
+}
+
+GSmtp::ContentWriter::~ContentWriter()
+{
+	cancel() ;
+}
+
+void GSmtp::ContentWriter::start( std::shared_ptr<GStore::NewMessage> msg , bool close )
+{
+	G_ASSERT( !busy() ) ;
+	retire() ;
+	m_future_event = std::make_unique<GNet::FutureEvent>( static_cast<GNet::FutureEventHandler&>(*this) , m_es ) ;
+	auto job = std::make_shared<ContentWriterPool::Job>() ;
+	job->msg = msg ;
+	job->close = close ;
+	job->handle = m_future_event->handle() ;
+	try
+	{
+		m_pool->submit( job ) ;
+	}
+	catch(...)
+	{
+		GNet::FutureEvent::send( job->handle ) ; // close the handle
+		throw ;
+	}
+	m_job = job ;
+}
+
+void GSmtp::ContentWriter::onFutureEvent()
+{
+	if( m_job == nullptr )
+		return ; // cancelled
+
+	std::exception_ptr e = m_pool->result( *m_job ) ;
+	m_job.reset() ;
+	if( e )
+		std::rethrow_exception( e ) ;
+	m_done_signal.emit() ;
+}
+
+bool GSmtp::ContentWriter::busy() const noexcept
+{
+	return m_job != nullptr ;
+}
+
+void GSmtp::ContentWriter::cancel() noexcept
+{
+	if( m_job )
+	{
+		G_DEBUG( "GSmtp::ContentWriter::cancel: abandoning content write" ) ;
+		m_pool->abandon( m_job ) ;
+		m_job.reset() ;
+		retire() ;
+	}
+}
+
+void GSmtp::ContentWriter::retire() noexcept
+{
+	// keep the latest future-event object alive for a while since
+	// we might be running inside its callback
+	m_spent_future_event = std::move( m_future_event ) ;
+}
+
+G::Slot::Signal<> & GSmtp::ContentWriter::doneSignal() noexcept
+{
+	return m_done_signal ;
+}
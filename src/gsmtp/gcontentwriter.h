@@ -0,0 +1,175 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gcontentwriter.h
+///
+
+#ifndef G_SMTP_CONTENT_WRITER_H
+#define G_SMTP_CONTENT_WRITER_H
+
+#include "gdef.h"
+#include "gnewmessage.h"
+#include "gfutureevent.h"
+#include "geventstate.h"
+#include "gtimer.h"
+#include "gslot.h"
+#include <deque>
+#include <memory>
+#include <vector>
+#include <exception>
+
+namespace GSmtp
+{
+	class ContentWriter ;
+	class ContentWriterPool ;
+}
+
+//| \class GSmtp::ContentWriterPool
+/// A small pool of worker threads that write out the deferred content
+/// of GStore::NewMessage objects on behalf of GSmtp::ContentWriter
+/// objects. See GStore::NewMessage::deferContent().
+///
+/// The worker threads last for the lifetime of the pool and take
+/// jobs from a shared queue. A message is kept alive by its job, so
+/// an unwanted job can be abandon()ed without waiting for it, and the
+/// message is then released back on the event-loop thread once the
+/// job is done.
+///
+class GSmtp::ContentWriterPool
+{
+public:
+	struct Job /// A content-writing job for GSmtp::ContentWriterPool.
+	{
+		std::shared_ptr<GStore::NewMessage> msg ;
+		bool close {false} ;
+		HANDLE handle {} ; // future-event handle, sent when done
+		std::exception_ptr exception ;
+		bool done {false} ;
+	} ;
+
+	ContentWriterPool( GNet::EventState , std::size_t threads ) ;
+		///< Constructor. The worker threads are started by the
+		///< first submit().
+
+	~ContentWriterPool() ;
+		///< Destructor. Stops the worker threads, waiting for any
+		///< writes that are in progress.
+
+	static bool works() ;
+		///< Returns true if worker threads are available.
+
+	void submit( std::shared_ptr<Job> ) ;
+		///< Queues a job. The job's future-event handle is sent
+		///< once writeContent() has been called on a worker thread.
+		///< Throws if the worker threads cannot be started.
+
+	std::exception_ptr result( const Job & ) const ;
+		///< Returns any exception from a job that is done.
+
+	void abandon( std::shared_ptr<Job> ) ;
+		///< Drops a job that is no longer wanted. If the job has not
+		///< yet started then it is discarded, otherwise its message
+		///< is held until the job is done.
+
+public:
+	ContentWriterPool( const ContentWriterPool & ) = delete ;
+	ContentWriterPool( ContentWriterPool && ) = delete ;
+	ContentWriterPool & operator=( const ContentWriterPool & ) = delete ;
+	ContentWriterPool & operator=( ContentWriterPool && ) = delete ;
+
+private:
+	static void run( ContentWriterPool * ) noexcept ;
+	void onTimeout() ;
+
+private:
+	mutable G::threading::mutex_type m_mutex ; // protects m_queue, m_stop and Job::exception/done
+	G::threading::cond_type m_cond ;
+	std::deque<std::shared_ptr<Job>> m_queue ;
+	bool m_stop {false} ;
+	std::size_t m_thread_count ;
+	std::vector<G::threading::thread_type> m_threads ;
+	std::vector<std::shared_ptr<Job>> m_abandoned ; // event-loop thread only
+	GNet::Timer<ContentWriterPool> m_timer ;
+} ;
+
+//| \class GSmtp::ContentWriter
+/// Writes out the deferred content of a GStore::NewMessage using a
+/// shared GSmtp::ContentWriterPool so that a slow spool disk does not
+/// hold up the event loop.
+///
+/// Each start() queues a job with the pool and the doneSignal() is
+/// emitted back on the event loop once it has finished. Any exception
+/// thrown on the worker thread is rethrown out of the event loop's
+/// event handler.
+///
+/// \code
+/// if( msg->deferContent() ) ...
+/// msg->addContent( p , n ) ;
+/// if( !writer.busy() && msg->queuedContent() > chunk )
+///   writer.start( msg , false ) ;
+/// \endcode
+///
+class GSmtp::ContentWriter : private GNet::FutureEventHandler
+{
+public:
+	ContentWriter( GNet::EventState , std::shared_ptr<ContentWriterPool> ) ;
+		///< Constructor.
+
+	~ContentWriter() override ;
+		///< Destructor. Cancels any outstanding write without
+		///< waiting for it.
+
+	void start( std::shared_ptr<GStore::NewMessage> , bool close ) ;
+		///< Starts writing out the message's queued content on a
+		///< worker thread, optionally closing the content file
+		///< at the end.
+		///<
+		///< Precondition: !busy()
+
+	bool busy() const noexcept ;
+		///< Returns true if a write is outstanding.
+
+	void cancel() noexcept ;
+		///< Cancels any outstanding write and its doneSignal()
+		///< without waiting for it to finish.
+
+	G::Slot::Signal<> & doneSignal() noexcept ;
+		///< Returns a signal that is emitted when the
+		///< write has finished.
+
+public:
+	ContentWriter( const ContentWriter & ) = delete ;
+	ContentWriter( ContentWriter && ) = delete ;
+	ContentWriter & operator=( const ContentWriter & ) = delete ;
+	ContentWriter & operator=( ContentWriter && ) = delete ;
+
+private: // overrides
+	void onFutureEvent() override ; // GNet::FutureEventHandler
+
+private:
+	void retire() noexcept ;
+
+private:
+	GNet::EventState m_es ;
+	std::shared_ptr<ContentWriterPool> m_pool ;
+	std::unique_ptr<GNet::FutureEvent> m_future_event ;
+	std::unique_ptr<GNet::FutureEvent> m_spent_future_event ;
+	std::shared_ptr<ContentWriterPool::Job> m_job ;
+	G::Slot::Signal<> m_done_signal ;
+} ;
+
+#endif
@@ -0,0 +1,253 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gcutthroughmessage.cpp
+///
+
+#include "gdef.h"
+#include "gcutthroughmessage.h"
+#include "gassert.h"
+#include "gstringview.h"
+#include "glog.h"
+
+GSmtp::CutThroughMessage::CutThroughMessage( const GStore::MessageId & id , const std::string & from ,
+	const GStore::MessageStore::SmtpInfo & smtp_info ) :
+		m_id(id) ,
+		m_stream(&m_buffer)
+{
+	// (as per GStore::NewFile)
+	m_env.from = from ;
+	m_env.from_auth_in = smtp_info.auth ;
+	m_env.body_type = GStore::Envelope::parseSmtpBodyType( smtp_info.body ) ;
+	m_env.utf8_mailboxes =
+		smtp_info.address_style == GStore::MessageStore::AddressStyle::Utf8Mailbox ||
+		smtp_info.address_style == GStore::MessageStore::AddressStyle::Utf8Both ;
+}
+
+GSmtp::CutThroughMessage::~CutThroughMessage()
+= default ;
+
+void GSmtp::CutThroughMessage::addTo( const std::string & to , GStore::MessageStore::AddressStyle address_style )
+{
+	m_env.to_remote.push_back( to ) ;
+	if( address_style == GStore::MessageStore::AddressStyle::Utf8Mailbox ||
+		address_style == GStore::MessageStore::AddressStyle::Utf8Both )
+	{
+		m_env.utf8_mailboxes = true ;
+	}
+}
+
+void GSmtp::CutThroughMessage::addContent( const char * data , std::size_t data_size )
+{
+	m_size += data_size ;
+	m_buffer.add( data , data_size ) ;
+}
+
+void GSmtp::CutThroughMessage::setComplete()
+{
+	m_buffer.setComplete() ;
+}
+
+std::size_t GSmtp::CutThroughMessage::buffered() const noexcept
+{
+	return m_buffer.available() ;
+}
+
+void GSmtp::CutThroughMessage::commit( std::unique_ptr<GStore::StoredMessage> stored )
+{
+	G_ASSERT( stored && stored->id().str() == m_id.str() ) ;
+	m_stored = std::move( stored ) ;
+}
+
+GStore::MessageId GSmtp::CutThroughMessage::id() const
+{
+	return m_id ;
+}
+
+std::string GSmtp::CutThroughMessage::location() const
+{
+	return m_stored ? m_stored->location() : m_id.str() ;
+}
+
+std::string GSmtp::CutThroughMessage::from() const
+{
+	return m_env.from ;
+}
+
+std::string GSmtp::CutThroughMessage::to( std::size_t i ) const
+{
+	return i < m_env.to_remote.size() ? m_env.to_remote[i] : std::string() ;
+}
+
+std::size_t GSmtp::CutThroughMessage::toCount() const
+{
+	return m_env.to_remote.size() ;
+}
+
+std::size_t GSmtp::CutThroughMessage::contentSize() const
+{
+	return m_size ; // so far
+}
+
+std::istream & GSmtp::CutThroughMessage::contentStream()
+{
+	return m_stream ;
+}
+
+std::string_view GSmtp::CutThroughMessage::contentView()
+{
+	return {} ; // still growing
+}
+
+void GSmtp::CutThroughMessage::close()
+{
+	// no-op -- the content is in memory
+}
+
+std::string GSmtp::CutThroughMessage::reopen()
+{
+	return {} ;
+}
+
+void GSmtp::CutThroughMessage::destroy()
+{
+	if( m_stored )
+		m_stored->destroy() ;
+	m_stored.reset() ;
+}
+
+void GSmtp::CutThroughMessage::fail( const std::string & reason , int reason_code )
+{
+	if( m_stored )
+	{
+		m_stored->fail( reason , reason_code ) ;
+	}
+	else
+	{
+		G_DEBUG( "GSmtp::CutThroughMessage::fail: not yet stored: " << reason ) ;
+	}
+	m_stored.reset() ;
+}
+
+GStore::MessageStore::BodyType GSmtp::CutThroughMessage::bodyType() const
+{
+	return m_env.body_type ;
+}
+
+std::string GSmtp::CutThroughMessage::authentication() const
+{
+	return m_env.authentication ;
+}
+
+std::string GSmtp::CutThroughMessage::fromAuthIn() const
+{
+	return m_env.from_auth_in ;
+}
+
+std::string GSmtp::CutThroughMessage::fromAuthOut() const
+{
+	return m_env.from_auth_out ;
+}
+
+std::string GSmtp::CutThroughMessage::forwardTo() const
+{
+	return m_env.forward_to ;
+}
+
+std::string GSmtp::CutThroughMessage::forwardToAddress() const
+{
+	return m_env.forward_to_address ;
+}
+
+std::string GSmtp::CutThroughMessage::clientAccountSelector() const
+{
+	return m_env.client_account_selector ;
+}
+
+bool GSmtp::CutThroughMessage::utf8Mailboxes() const
+{
+	return m_env.utf8_mailboxes ;
+}
+
+void GSmtp::CutThroughMessage::editRecipients( const G::StringArray & recipients )
+{
+	m_env.to_remote = recipients ;
+	if( m_stored )
+		m_stored->editRecipients( recipients ) ;
+}
+
+unsigned int GSmtp::CutThroughMessage::retryCount() const
+{
+	return m_env.retry_count ;
+}
+
+std::time_t GSmtp::CutThroughMessage::retryTime() const
+{
+	return m_env.retry_time ;
+}
+
+void GSmtp::CutThroughMessage::retry( std::time_t next , const std::string & reason )
+{
+	m_env.retry_count++ ;
+	m_env.retry_time = next ;
+	if( m_stored )
+		m_stored->retry( next , reason ) ;
+}
+
+// ==
+
+void GSmtp::CutThroughMessage::Buffer::add( const char * data , std::size_t data_size )
+{
+	// discard what has been read, but only when it is worth the copying
+	std::size_t used = this->used() ;
+	if( used && used >= (m_data.size()-used) )
+	{
+		m_data.erase( 0U , used ) ;
+		m_end -= used ;
+		used = 0U ;
+	}
+
+	// expose only complete lines until the content is complete
+	std::size_t eol = std::string_view(data,data_size).rfind( '\n' ) ;
+	if( eol != std::string::npos )
+		m_end = m_data.size() + eol + 1U ;
+	m_data.append( data , data_size ) ;
+	expose( used ) ;
+}
+
+void GSmtp::CutThroughMessage::Buffer::setComplete()
+{
+	std::size_t used = this->used() ;
+	m_end = m_data.size() ;
+	expose( used ) ;
+}
+
+void GSmtp::CutThroughMessage::Buffer::expose( std::size_t used )
+{
+	char * p = m_data.data() ;
+	setg( p , p+used , p+m_end ) ;
+}
+
+std::size_t GSmtp::CutThroughMessage::Buffer::used() const noexcept
+{
+	return eback() ? static_cast<std::size_t>( gptr() - eback() ) : 0U ;
+}
+
+std::size_t GSmtp::CutThroughMessage::Buffer::available() const noexcept
+{
+	return m_data.size() - used() ;
+}
@@ -0,0 +1,143 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gcutthroughmessage.h
+///
+
+#ifndef G_SMTP_CUT_THROUGH_MESSAGE_H
+#define G_SMTP_CUT_THROUGH_MESSAGE_H
+
+#include "gdef.h"
+#include "gstoredmessage.h"
+#include "gmessagestore.h"
+#include "genvelope.h"
+#include <streambuf>
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace GSmtp
+{
+	class CutThroughMessage ;
+}
+
+//| \class GSmtp::CutThroughMessage
+/// A GStore::StoredMessage that is used to forward a message while
+/// it is still being received. The envelope is built up from the
+/// incoming SMTP commands and the content stream is fed from the
+/// incoming content lines as they arrive.
+///
+/// The content stream only exposes complete lines until the content
+/// is marked as complete, and it runs dry (ie. goes bad()) when it
+/// has caught up with the incoming data -- the client protocol must
+/// be told that the content is still pending (see
+/// GSmtp::ClientProtocol::start()).
+///
+/// Once the spooled copy of the message has been committed to the
+/// message store it should be passed in with commit() so that the
+/// destroy(), fail() and editRecipients() methods have something to
+/// act on.
+///
+/// \see GSmtp::ProtocolMessageForward
+///
+class GSmtp::CutThroughMessage : public GStore::StoredMessage
+{
+public:
+	CutThroughMessage( const GStore::MessageId & , const std::string & from ,
+		const GStore::MessageStore::SmtpInfo & ) ;
+			///< Constructor.
+
+	~CutThroughMessage() override ;
+		///< Destructor.
+
+	void addTo( const std::string & to , GStore::MessageStore::AddressStyle ) ;
+		///< Adds a remote recipient.
+
+	void addContent( const char * , std::size_t ) ;
+		///< Adds content.
+
+	void setComplete() ;
+		///< Marks the content as complete so that the content
+		///< stream exposes any unterminated last line and then
+		///< goes bad() at the end.
+
+	std::size_t buffered() const noexcept ;
+		///< Returns the number of content bytes that have been
+		///< added but not yet read from the content stream.
+
+	void commit( std::unique_ptr<GStore::StoredMessage> ) ;
+		///< Provides the spooled copy of the message from the
+		///< message store.
+
+private: // overrides
+	GStore::MessageId id() const override ; // GStore::StoredMessage
+	std::string location() const override ; // GStore::StoredMessage
+	std::string from() const override ; // GStore::StoredMessage
+	std::string to( std::size_t ) const override ; // GStore::StoredMessage
+	std::size_t toCount() const override ; // GStore::StoredMessage
+	std::size_t contentSize() const override ; // GStore::StoredMessage
+	std::istream & contentStream() override ; // GStore::StoredMessage
+	std::string_view contentView() override ; // GStore::StoredMessage
+	void close() override ; // GStore::StoredMessage
+	std::string reopen() override ; // GStore::StoredMessage
+	void destroy() override ; // GStore::StoredMessage
+	void fail( const std::string & reason , int reason_code ) override ; // GStore::StoredMessage
+	GStore::MessageStore::BodyType bodyType() const override ; // GStore::StoredMessage
+	std::string authentication() const override ; // GStore::StoredMessage
+	std::string fromAuthIn() const override ; // GStore::StoredMessage
+	std::string fromAuthOut() const override ; // GStore::StoredMessage
+	std::string forwardTo() const override ; // GStore::StoredMessage
+	std::string forwardToAddress() const override ; // GStore::StoredMessage
+	std::string clientAccountSelector() const override ; // GStore::StoredMessage
+	bool utf8Mailboxes() const override ; // GStore::StoredMessage
+	void editRecipients( const G::StringArray & ) override ; // GStore::StoredMessage
+	unsigned int retryCount() const override ; // GStore::StoredMessage
+	std::time_t retryTime() const override ; // GStore::StoredMessage
+	void retry( std::time_t , const std::string & ) override ; // GStore::StoredMessage
+
+public:
+	CutThroughMessage( const CutThroughMessage & ) = delete ;
+	CutThroughMessage( CutThroughMessage && ) = delete ;
+	CutThroughMessage & operator=( const CutThroughMessage & ) = delete ;
+	CutThroughMessage & operator=( CutThroughMessage && ) = delete ;
+
+private:
+	class Buffer : public std::streambuf /// A growable input streambuf.
+	{
+	public:
+		void add( const char * , std::size_t ) ;
+		void setComplete() ;
+		std::size_t available() const noexcept ;
+	private:
+		std::size_t used() const noexcept ;
+		void expose( std::size_t ) ;
+	private:
+		std::string m_data ;
+		std::size_t m_end {0U} ; // end of complete lines
+
+	} ;
+
+private:
+	GStore::MessageId m_id ;
+	GStore::Envelope m_env ;
+	std::size_t m_size {0U} ;
+	Buffer m_buffer ;
+	std::istream m_stream ;
+	std::unique_ptr<GStore::StoredMessage> m_stored ;
+} ;
+
+#endif
@@ -61,6 +61,9 @@ namespace GSmtp
 /// completion signal may be emitted before the initiating call
 /// returns.
 ///
+/// Content can be written to the store asynchronously, in which
+/// case the busy() method is used for flow control.
+///
 class GSmtp::ProtocolMessage
 {
 public:
@@ -133,6 +136,15 @@ public:
 		///< Returns the current content size. Returns the maximum
 		///< std::size_t value on overflow.
 
+	virtual bool busy() const = 0 ;
+		///< Returns true if added content is being written out
+		///< asynchronously and the backlog is big enough that no
+		///< more content should be added until the changeSignal().
+
+	virtual G::Slot::Signal<> & changeSignal() = 0 ;
+		///< Returns a signal that is raised when busy() might
+		///< have changed.
+
 	virtual std::string from() const = 0 ;
 		///< Returns the setFrom() user string.
 
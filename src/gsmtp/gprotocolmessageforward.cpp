@@ -25,11 +25,22 @@
 #include "gstr.h"
 #include "glog.h"
 
+namespace GSmtp
+{
+	namespace ProtocolMessageForwardImp
+	{
+		// the most content that is held in memory while waiting for a slow
+		// upstream server before cut-through is abandoned in favour of
+		// store-and-forward
+		constexpr std::size_t cut_through_buffer_limit = 1024U * 1024U ;
+	}
+}
+
 GSmtp::ProtocolMessageForward::ProtocolMessageForward( GNet::EventState es ,
 	GStore::MessageStore & store , FilterFactoryBase & ff , std::unique_ptr<ProtocolMessage> pm ,
 	const GSmtp::Client::Config & client_config ,
 	const GAuth::SaslClientSecrets & client_secrets ,
-	const std::string & forward_to , int forward_to_family ) :
+	const std::string & forward_to , int forward_to_family , bool cut_through ) :
 		m_es(es) ,
 		m_store(store) ,
 		m_ff(ff) ,
@@ -38,11 +49,13 @@ GSmtp::ProtocolMessageForward::ProtocolMessageForward( GNet::EventState es ,
 		m_client_secrets(client_secrets) ,
 		m_pm(pm.release()) ,
 		m_id(GStore::MessageId::none()) ,
-		m_processed_signal(true)
+		m_processed_signal(true) ,
+		m_cut_through(cut_through)
 {
 	// signal plumbing to receive 'done' events
 	m_pm->processedSignal().connect( G::Slot::slot(*this,&ProtocolMessageForward::protocolMessageProcessed) ) ;
 	m_client_ptr.deleteSignal().connect( G::Slot::slot(*this,&ProtocolMessageForward::clientDone) ) ;
+	m_ct_client_ptr.deleteSignal().connect( G::Slot::slot(*this,&ProtocolMessageForward::cutThroughClientDone) ) ;
 }
 
 GSmtp::ProtocolMessageForward::~ProtocolMessageForward()
@@ -51,6 +64,9 @@ GSmtp::ProtocolMessageForward::~ProtocolMessageForward()
 	m_client_ptr.deleteSignal().disconnect() ;
 	if( m_client_ptr.get() != nullptr )
 		m_client_ptr->messageDoneSignal().disconnect() ;
+	m_ct_client_ptr.deleteSignal().disconnect() ;
+	if( m_ct_client_ptr.get() != nullptr )
+		m_ct_client_ptr->messageDoneSignal().disconnect() ;
 }
 
 GSmtp::ProtocolMessage::ProcessedSignal & GSmtp::ProtocolMessageForward::processedSignal() noexcept
@@ -62,16 +78,37 @@ void GSmtp::ProtocolMessageForward::reset()
 {
 	m_pm->reset() ;
 	m_client_ptr.reset() ;
+	cutThroughAbandon( {} ) ;
+	if( m_ct_client_ptr.get() != nullptr )
+		m_ct_client_ptr->messageDoneSignal().disconnect() ;
+	m_ct_client_ptr.reset() ;
 }
 
 void GSmtp::ProtocolMessageForward::clear()
 {
 	m_pm->clear() ;
+	if( m_ct_state != CutThrough::Off && m_ct_state != CutThrough::Idle )
+		cutThroughAbandon( "cancelled" ) ;
+	m_ct_state = CutThrough::Off ;
+	m_ct_message.reset() ;
 }
 
 GStore::MessageId GSmtp::ProtocolMessageForward::setFrom( const std::string & from , const FromInfo & from_info )
 {
-	return m_pm->setFrom( from , from_info ) ;
+	GStore::MessageId id = m_pm->setFrom( from , from_info ) ;
+	if( m_cut_through )
+	{
+		if( m_ct_state != CutThrough::Off && m_ct_state != CutThrough::Idle )
+			cutThroughAbandon( "cancelled" ) ;
+
+		GStore::MessageStore::SmtpInfo smtp_info ;
+		smtp_info.auth = from_info.auth ;
+		smtp_info.body = from_info.body ;
+		smtp_info.address_style = from_info.address_style ;
+		m_ct_message = std::make_shared<CutThroughMessage>( id , from , smtp_info ) ;
+		m_ct_state = CutThrough::Idle ;
+	}
+	return id ;
 }
 
 GSmtp::ProtocolMessage::FromInfo GSmtp::ProtocolMessageForward::fromInfo() const
@@ -86,17 +123,32 @@ std::string GSmtp::ProtocolMessageForward::bodyType() const
 
 bool GSmtp::ProtocolMessageForward::addTo( const ToInfo & to_info )
 {
-	return m_pm->addTo( to_info ) ;
+	bool ok = m_pm->addTo( to_info ) ;
+	if( ok && m_ct_state == CutThrough::Idle && !to_info.status.is_local )
+		m_ct_message->addTo( to_info.status.address , to_info.address_style ) ;
+	return ok ;
 }
 
 void GSmtp::ProtocolMessageForward::addReceived( const std::string & line )
 {
 	m_pm->addReceived( line ) ;
+	if( m_ct_state == CutThrough::Idle )
+		cutThroughStart() ;
+	if( m_ct_state == CutThrough::Streaming )
+	{
+		std::string line_crlf = std::string(line).append( "\r\n" , 2U ) ;
+		cutThroughAdd( line_crlf.data() , line_crlf.size() , GStore::NewMessage::Status::Ok ) ;
+	}
 }
 
 GStore::NewMessage::Status GSmtp::ProtocolMessageForward::addContent( const char * line_data , std::size_t line_size )
 {
-	return m_pm->addContent( line_data , line_size ) ;
+	GStore::NewMessage::Status status = m_pm->addContent( line_data , line_size ) ;
+	if( m_ct_state == CutThrough::Idle )
+		cutThroughStart() ;
+	if( m_ct_state == CutThrough::Streaming && line_size )
+		cutThroughAdd( line_data , line_size , status ) ;
+	return status ;
 }
 
 std::size_t GSmtp::ProtocolMessageForward::contentSize() const
@@ -104,6 +156,16 @@ std::size_t GSmtp::ProtocolMessageForward::contentSize() const
 	return m_pm->contentSize() ;
 }
 
+bool GSmtp::ProtocolMessageForward::busy() const
+{
+	return m_pm->busy() ;
+}
+
+G::Slot::Signal<> & GSmtp::ProtocolMessageForward::changeSignal()
+{
+	return m_pm->changeSignal() ;
+}
+
 std::string GSmtp::ProtocolMessageForward::from() const
 {
 	return m_pm->from() ;
@@ -114,6 +176,8 @@ void GSmtp::ProtocolMessageForward::process( const std::string & auth_id , const
 {
 	// commit to the store -- forward when the commit is complete
 	m_processed_signal.reset() ; // one-shot reset
+	if( m_ct_state == CutThrough::Streaming )
+		m_ct_state = CutThrough::Storing ;
 	m_pm->process( auth_id , peer_socket_address , peer_certificate ) ;
 }
 
@@ -123,6 +187,9 @@ void GSmtp::ProtocolMessageForward::protocolMessageProcessed( const ProtocolMess
 	G_DEBUG( "ProtocolMessageForward::protocolMessageProcessed: " << (info.success?1:0) << " "
 		<< info.id.str() << " [" << info.response << "] [" << info.reason << "]" ) ;
 
+	if( m_ct_state == CutThrough::Storing && cutThroughCommit( info ) )
+		return ; // the upstream response will complete the processing
+
 	G::CallFrame this_( m_call_stack ) ;
 	if( info.success && info.id.valid() )
 	{
@@ -201,3 +268,139 @@ void GSmtp::ProtocolMessageForward::clientDone( const std::string & reason )
 	m_processed_signal.emit( { ok , m_id , 0 , ok?"":"forwarding failed" , reason } ) ;
 }
 
+
+void GSmtp::ProtocolMessageForward::cutThroughStart()
+{
+	// start the upstream transaction, re-using the client from
+	// the last message if possible
+	G_ASSERT( m_ct_message != nullptr ) ;
+	const GStore::StoredMessage & message = *m_ct_message ;
+	m_ct_state = CutThrough::Off ;
+	if( message.toCount() == 0U ||
+		message.bodyType() == GStore::MessageStore::BodyType::BinaryMime )
+	{
+		// no remote recipients, or needs BDAT
+		m_ct_message.reset() ;
+		return ;
+	}
+	try
+	{
+		G_DEBUG( "GSmtp::ProtocolMessageForward::cutThroughStart: cut-through forwarding of message " << message.id().str() ) ;
+		if( m_ct_client_ptr.get() == nullptr )
+		{
+			m_ct_client_ptr.reset( std::make_unique<GSmtp::Client>( m_es.eh(m_ct_client_ptr) ,
+				m_ff , m_client_location , m_client_secrets , m_client_config ) ) ;
+
+			m_ct_client_ptr->messageDoneSignal().connect( G::Slot::slot( *this ,
+				&GSmtp::ProtocolMessageForward::cutThroughMessageDone ) ) ;
+		}
+		m_ct_client_ptr->sendMessage( std::shared_ptr<GStore::StoredMessage>(m_ct_message) , true ) ;
+		m_ct_state = CutThrough::Streaming ;
+	}
+	catch( std::exception & e )
+	{
+		G_WARNING( "GSmtp::ProtocolMessageForward::cutThroughStart: cut-through exception: " << e.what() ) ;
+		cutThroughAbandon( e.what() ) ;
+	}
+}
+
+void GSmtp::ProtocolMessageForward::cutThroughAdd( const char * data , std::size_t size ,
+	GStore::NewMessage::Status status )
+{
+	G_ASSERT( m_ct_message != nullptr && m_ct_client_ptr.get() != nullptr ) ;
+	m_ct_message->addContent( data , size ) ;
+	if( status != GStore::NewMessage::Status::Ok )
+		cutThroughAbandon( "message not stored" ) ;
+	else if( m_ct_message->buffered() > ProtocolMessageForwardImp::cut_through_buffer_limit )
+		cutThroughAbandon( "upstream server too slow" ) ;
+	else
+		m_ct_client_ptr->contentAdded( false ) ;
+}
+
+bool GSmtp::ProtocolMessageForward::cutThroughCommit( const ProtocolMessage::ProcessedInfo & info )
+{
+	// the message has been stored (or not) -- complete the upstream
+	// transaction with the end-of-data
+	if( info.success && info.id.valid() )
+	{
+		try
+		{
+			m_id = info.id ;
+			m_ct_message->commit( m_store.get(info.id) ) ;
+			m_ct_message->setComplete() ;
+			m_ct_state = CutThrough::Ending ;
+			m_ct_client_ptr->contentAdded( true ) ;
+			return true ;
+		}
+		catch( std::exception & e )
+		{
+			G_WARNING( "GSmtp::ProtocolMessageForward::cutThroughCommit: cut-through exception: " << e.what() ) ;
+			cutThroughAbandon( e.what() ) ;
+		}
+	}
+	else
+	{
+		// dropping the connection before the end-of-data
+		// makes the upstream server discard the message
+		cutThroughAbandon( "message rejected" ) ;
+	}
+	return false ;
+}
+
+void GSmtp::ProtocolMessageForward::cutThroughAbandon( const std::string & reason )
+{
+	G_LOG_IF( !reason.empty() && m_ct_state != CutThrough::Off , "GSmtp::ProtocolMessageForward::cutThroughAbandon: "
+		"cut-through forwarding abandoned: " << reason ) ;
+	if( m_ct_state != CutThrough::Off && m_ct_state != CutThrough::Idle )
+	{
+		// the client is mid-transaction so get rid of it
+		if( m_ct_client_ptr.get() != nullptr )
+			m_ct_client_ptr->messageDoneSignal().disconnect() ;
+		m_ct_client_ptr.reset() ;
+	}
+	m_ct_message.reset() ;
+	m_ct_state = CutThrough::Off ;
+}
+
+void GSmtp::ProtocolMessageForward::cutThroughMessageDone( const Client::MessageDoneInfo & info )
+{
+	G_DEBUG( "GSmtp::ProtocolMessageForward::cutThroughMessageDone: \"" << info.response << "\"" ) ;
+	const bool ok = info.response.empty() ;
+	if( m_ct_state == CutThrough::Ending )
+	{
+		// upstream response to end-of-data -- the stored copy
+		// has already been deleted or failed by the client
+		m_ct_message.reset() ;
+		m_ct_state = CutThrough::Off ;
+		m_processed_signal.emit( { ok , m_id , ok?0:info.response_code , info.response , std::string() } ) ;
+	}
+	else if( m_ct_state == CutThrough::Streaming || m_ct_state == CutThrough::Storing )
+	{
+		// early failure, eg. recipient rejected -- the client is idle so it can
+		// be kept, but fall back to store-and-forward for this message
+		G_LOG( "GSmtp::ProtocolMessageForward::cutThroughMessageDone: "
+			"cut-through forwarding abandoned: " << info.response ) ;
+		m_ct_message.reset() ;
+		m_ct_state = CutThrough::Off ;
+	}
+}
+
+void GSmtp::ProtocolMessageForward::cutThroughClientDone( const std::string & reason )
+{
+	G_DEBUG( "GSmtp::ProtocolMessageForward::cutThroughClientDone: \"" << reason << "\"" ) ;
+	if( m_ct_state == CutThrough::Ending )
+	{
+		// the stored copy has been failed by the client if it connected
+		m_ct_message.reset() ;
+		m_ct_state = CutThrough::Off ;
+		m_processed_signal.emit( { false , m_id , 0 , "forwarding failed" ,
+			reason.empty() ? std::string("disconnected") : reason } ) ;
+	}
+	else if( m_ct_state == CutThrough::Streaming || m_ct_state == CutThrough::Storing )
+	{
+		G_LOG( "GSmtp::ProtocolMessageForward::cutThroughClientDone: "
+			"cut-through forwarding abandoned: " << reason ) ;
+		m_ct_message.reset() ;
+		m_ct_state = CutThrough::Off ;
+	}
+}
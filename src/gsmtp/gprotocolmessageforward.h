@@ -27,6 +27,8 @@
 #include "gprotocolmessage.h"
 #include "gprotocolmessagestore.h"
 #include "gsmtpforward.h"
+#include "gsmtpclient.h"
+#include "gcutthroughmessage.h"
 #include "gsaslclientsecrets.h"
 #include "gmessagestore.h"
 #include "gnewmessage.h"
@@ -50,6 +52,17 @@ namespace GSmtp
 /// class (ie. its sibling class) to do the storage, and to an instance
 /// of the GSmtp::Forward class to do the forwarding.
 ///
+/// In 'cut-through' mode the upstream SMTP transaction is started as
+/// soon as the envelope is complete and the content is streamed
+/// upstream as it arrives, using a GSmtp::Client and a
+/// GSmtp::CutThroughMessage, while still being stored in the
+/// message store. The upstream end-of-data is held back until the
+/// stored copy has been committed, and the upstream response to it
+/// becomes the response to the submitting client. The stored copy
+/// is then deleted or failed as normal. Any problem with the
+/// upstream transaction before then causes a fallback to normal
+/// store-and-forward.
+///
 /// \see GSmtp::ProtocolMessageStore
 ///
 class GSmtp::ProtocolMessageForward : public ProtocolMessage
@@ -60,7 +73,8 @@ public:
 		std::unique_ptr<ProtocolMessage> pm ,
 		const GSmtp::Client::Config & client_config ,
 		const GAuth::SaslClientSecrets & client_secrets ,
-		const std::string & forward_to , int forward_to_family ) ;
+		const std::string & forward_to , int forward_to_family ,
+		bool cut_through ) ;
 			///< Constructor.
 
 	~ProtocolMessageForward() override ;
@@ -75,6 +89,8 @@ private: // overrides
 	void addReceived( const std::string & ) override ; // GSmtp::ProtocolMessage
 	GStore::NewMessage::Status addContent( const char * , std::size_t ) override ; // GSmtp::ProtocolMessage
 	std::size_t contentSize() const override ; // GSmtp::ProtocolMessage
+	bool busy() const override ; // GSmtp::ProtocolMessage
+	G::Slot::Signal<> & changeSignal() override ; // GSmtp::ProtocolMessage
 	std::string from() const override ; // GSmtp::ProtocolMessage
 	ProtocolMessage::FromInfo fromInfo() const override ; // GSmtp::ProtocolMessage
 	std::string bodyType() const override ; // GSmtp::ProtocolMessage
@@ -92,6 +108,22 @@ private:
 	void messageDone( const Client::MessageDoneInfo & ) ; // GSmtp::Client::messageDoneSignal()
 	void protocolMessageProcessed( const ProtocolMessage::ProcessedInfo & ) ; // GSmtp::ProtocolMessage::processedSignal()
 	std::string forward( const GStore::MessageId & , bool & ) ;
+	void cutThroughStart() ;
+	void cutThroughAdd( const char * , std::size_t , GStore::NewMessage::Status ) ;
+	bool cutThroughCommit( const ProtocolMessage::ProcessedInfo & ) ;
+	void cutThroughAbandon( const std::string & ) ;
+	void cutThroughMessageDone( const Client::MessageDoneInfo & ) ; // GSmtp::Client::messageDoneSignal()
+	void cutThroughClientDone( const std::string & ) ; // GNet::ClientPtr::deleteSignal()
+
+private:
+	enum class CutThrough
+	{
+		Off , // store-and-forward
+		Idle , // envelope in progress
+		Streaming , // streaming content upstream
+		Storing , // waiting for the stored copy to be committed
+		Ending // waiting for the upstream response to end-of-data
+	} ;
 
 private:
 	GNet::EventState m_es ;
@@ -105,6 +137,10 @@ private:
 	GNet::ClientPtr<GSmtp::Forward> m_client_ptr ;
 	GStore::MessageId m_id ;
 	ProtocolMessage::ProcessedSignal m_processed_signal ;
+	bool m_cut_through ;
+	CutThrough m_ct_state {CutThrough::Off} ;
+	GNet::ClientPtr<GSmtp::Client> m_ct_client_ptr ;
+	std::shared_ptr<CutThroughMessage> m_ct_message ;
 } ;
 
 #endif
@@ -21,21 +21,39 @@
 #include "gdef.h"
 #include "gprotocolmessagestore.h"
 #include "gmessagestore.h"
+#include "gmetrics.h"
 #include "gstr.h"
 #include "gassert.h"
 #include "glog.h"
 
-GSmtp::ProtocolMessageStore::ProtocolMessageStore( GStore::MessageStore & store ,
-	std::unique_ptr<Filter> filter ) :
+namespace GSmtp
+{
+	namespace ProtocolMessageStoreImp
+	{
+		G::Metrics::Histogram filter_latency( "emailrelay_filter_duration_seconds" , "type=\"server\"" , "Filter latency" ) ;
+		constexpr std::size_t write_chunk = 64U * 1024U ; // start a write once this much content is queued
+		constexpr std::size_t write_limit = 1024U * 1024U ; // busy() once this much content is queued
+	}
+}
+
+GSmtp::ProtocolMessageStore::ProtocolMessageStore( GNet::EventState es , GStore::MessageStore & store ,
+	std::unique_ptr<Filter> filter , std::shared_ptr<ContentWriterPool> writer_pool ) :
 		m_store(store) ,
 		m_filter(std::move(filter))
 {
 	m_filter->doneSignal().connect( G::Slot::slot(*this,&ProtocolMessageStore::filterDone) ) ;
+	if( writer_pool )
+	{
+		m_writer = std::make_unique<ContentWriter>( es , writer_pool ) ;
+		m_writer->doneSignal().connect( G::Slot::slot(*this,&ProtocolMessageStore::writerDone) ) ;
+	}
 }
 
 GSmtp::ProtocolMessageStore::~ProtocolMessageStore()
 {
 	m_filter->doneSignal().disconnect() ;
+	if( m_writer )
+		m_writer->doneSignal().disconnect() ;
 }
 
 void GSmtp::ProtocolMessageStore::reset()
@@ -47,6 +65,11 @@ void GSmtp::ProtocolMessageStore::reset()
 void GSmtp::ProtocolMessageStore::clear()
 {
 	G_DEBUG( "GSmtp::ProtocolMessageStore::clear" ) ;
+	if( m_writer )
+		m_writer->cancel() ; // does not block
+	m_deferred = false ;
+	m_closing = false ;
+	m_process_pending = false ;
 	m_new_msg.reset() ;
 	m_from.erase() ;
 	m_from_info = FromInfo() ;
@@ -70,6 +93,7 @@ GStore::MessageId GSmtp::ProtocolMessageStore::setFrom( const std::string & from
 	smtp_info.address_style = from_info.address_style ;
 	const std::string & from_auth_out = std::string() ;
 	m_new_msg = m_store.newMessage( from , smtp_info , from_auth_out ) ;
+	m_deferred = m_writer && m_new_msg->deferContent() ;
 
 	m_from = from ;
 	m_from_info = from_info ;
@@ -108,7 +132,23 @@ void GSmtp::ProtocolMessageStore::addReceived( const std::string & received_line
 GStore::NewMessage::Status GSmtp::ProtocolMessageStore::addContent( const char * data , std::size_t data_size )
 {
 	G_ASSERT( m_new_msg != nullptr ) ;
-	return m_new_msg->addContent( data , data_size ) ;
+	GStore::NewMessage::Status status = m_new_msg->addContent( data , data_size ) ;
+	if( m_deferred && !m_writer->busy() && !m_process_pending &&
+		m_new_msg->queuedContent() >= ProtocolMessageStoreImp::write_chunk )
+	{
+		startWriter( false ) ;
+	}
+	return status ;
+}
+
+bool GSmtp::ProtocolMessageStore::busy() const
+{
+	return m_deferred && m_new_msg && m_new_msg->queuedContent() >= ProtocolMessageStoreImp::write_limit ;
+}
+
+G::Slot::Signal<> & GSmtp::ProtocolMessageStore::changeSignal() noexcept
+{
+	return m_change_signal ;
 }
 
 std::size_t GSmtp::ProtocolMessageStore::contentSize() const
@@ -133,18 +173,82 @@ std::string GSmtp::ProtocolMessageStore::bodyType() const
 
 void GSmtp::ProtocolMessageStore::process( const std::string & session_auth_id ,
 	const std::string & peer_socket_address , const std::string & peer_certificate )
+{
+	G_DEBUG( "GSmtp::ProtocolMessageStore::process: \""
+		<< session_auth_id << "\", \"" << peer_socket_address << "\"" ) ;
+	G_ASSERT( m_new_msg != nullptr ) ;
+
+	m_auth_id = session_auth_id ;
+	m_peer_socket_address = peer_socket_address ;
+	m_peer_certificate = peer_certificate ;
+
+	if( m_deferred )
+	{
+		// flush and close the content on the worker thread -- see writerDone()
+		m_process_pending = true ;
+		if( !m_writer->busy() )
+			startWriter( true ) ;
+	}
+	else
+	{
+		processImp() ;
+	}
+}
+
+void GSmtp::ProtocolMessageStore::startWriter( bool close )
 {
 	try
 	{
-		G_DEBUG( "GSmtp::ProtocolMessageStore::process: \""
-			<< session_auth_id << "\", \"" << peer_socket_address << "\"" ) ;
-		G_ASSERT( m_new_msg != nullptr ) ;
+		m_closing = close ;
+		m_writer->start( m_new_msg , close ) ;
+	}
+	catch( std::exception & e ) // eg. cannot create thread
+	{
+		// carry on synchronously
+		G_WARNING( "GSmtp::ProtocolMessageStore::startWriter: cannot start content writer: " << e.what() ) ;
+		m_new_msg->writeContent( false ) ;
+		m_closing = false ;
+		if( m_process_pending )
+		{
+			m_process_pending = false ;
+			processImp() ;
+		}
+	}
+}
 
+void GSmtp::ProtocolMessageStore::writerDone()
+{
+	if( m_new_msg == nullptr )
+		return ;
+
+	if( m_process_pending && m_closing )
+	{
+		m_closing = false ;
+		m_process_pending = false ;
+		processImp() ;
+	}
+	else if( m_process_pending )
+	{
+		startWriter( true ) ;
+	}
+	else
+	{
+		if( m_new_msg->queuedContent() >= ProtocolMessageStoreImp::write_chunk )
+			startWriter( false ) ;
+		m_change_signal.emit() ;
+	}
+}
+
+void GSmtp::ProtocolMessageStore::processImp()
+{
+	try
+	{
 		// write ".new" envelope and close the content
-		m_new_msg->prepare( session_auth_id , peer_socket_address , peer_certificate ) ;
+		m_new_msg->prepare( m_auth_id , m_peer_socket_address , m_peer_certificate ) ;
 
 		// start filtering
 		G_LOG_MORE( "GSmtp::ProtocolMessageStore::process: filter [" << m_filter->id() << "]: [" << m_new_msg->id().str() << "]" ) ;
+		m_filter_start = G::TimerTime::now() ;
 		m_filter->start( m_new_msg->id() ) ;
 	}
 	catch( std::exception & e ) // catch filtering errors, size-limit errors, and file i/o errors
@@ -160,6 +264,7 @@ void GSmtp::ProtocolMessageStore::filterDone( int filter_result )
 	try
 	{
 		G_DEBUG( "GSmtp::ProtocolMessageStore::filterDone: " << filter_result ) ;
+		ProtocolMessageStoreImp::filter_latency.observe( m_filter_start ) ;
 		G_ASSERT( static_cast<int>(m_filter->result()) == filter_result ) ;
 		G_ASSERT( m_new_msg != nullptr ) ;
 
@@ -26,7 +26,10 @@
 #include "gmessagestore.h"
 #include "gnewmessage.h"
 #include "gfilter.h"
+#include "gcontentwriter.h"
+#include "geventstate.h"
 #include "gslot.h"
+#include "gdatetime.h"
 #include <string>
 #include <memory>
 
@@ -38,14 +41,23 @@ namespace GSmtp
 //| \class GSmtp::ProtocolMessageStore
 /// A concrete implementation of the ProtocolMessage interface
 /// that stores incoming messages in the message store.
+///
+/// If a GSmtp::ContentWriterPool is supplied and the new message
+/// supports deferred content then the content is written out by
+/// the pool's worker threads, with busy() applying back-pressure to
+/// the client once the backlog gets too big. The content file is
+/// then flushed and closed on a worker thread before the filter is
+/// started.
+///
 /// \see GSmtp::ProtocolMessageForward
 ///
 class GSmtp::ProtocolMessageStore : public ProtocolMessage
 {
 public:
-	ProtocolMessageStore( GStore::MessageStore & store ,
-		std::unique_ptr<Filter> ) ;
-			///< Constructor.
+	ProtocolMessageStore( GNet::EventState , GStore::MessageStore & store ,
+		std::unique_ptr<Filter> , std::shared_ptr<ContentWriterPool> = {} ) ;
+			///< Constructor. Content is written asynchronously if
+			///< the optional writer pool is given.
 
 	~ProtocolMessageStore() override ;
 		///< Destructor.
@@ -59,6 +71,8 @@ private: // overrides
 	void addReceived( const std::string & ) override ; // GSmtp::ProtocolMessage
 	GStore::NewMessage::Status addContent( const char * , std::size_t ) override ; // GSmtp::ProtocolMessage
 	std::size_t contentSize() const override ; // GSmtp::ProtocolMessage
+	bool busy() const override ; // GSmtp::ProtocolMessage
+	G::Slot::Signal<> & changeSignal() noexcept override ; // GSmtp::ProtocolMessage
 	std::string from() const override ; // GSmtp::ProtocolMessage
 	ProtocolMessage::FromInfo fromInfo() const override ; // GSmtp::ProtocolMessage
 	std::string bodyType() const override ; // GSmtp::ProtocolMessage
@@ -73,14 +87,26 @@ public:
 
 private:
 	void filterDone( int ) ;
+	void writerDone() ;
+	void startWriter( bool close ) ;
+	void processImp() ;
 
 private:
 	GStore::MessageStore & m_store ;
 	std::unique_ptr<Filter> m_filter ;
-	std::unique_ptr<GStore::NewMessage> m_new_msg ;
+	std::shared_ptr<GStore::NewMessage> m_new_msg ; // shared with any ContentWriterPool job
+	G::TimerTime m_filter_start {G::TimerTime::zero()} ;
 	std::string m_from ;
 	FromInfo m_from_info ;
 	ProtocolMessage::ProcessedSignal m_processed_signal ;
+	G::Slot::Signal<> m_change_signal ;
+	std::unique_ptr<ContentWriter> m_writer ;
+	bool m_deferred {false} ;
+	bool m_closing {false} ;
+	bool m_process_pending {false} ;
+	std::string m_auth_id ;
+	std::string m_peer_socket_address ;
+	std::string m_peer_certificate ;
 } ;
 
 #endif
@@ -0,0 +1,162 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gratelimiter.cpp
+///
+
+#include "gdef.h"
+#include "gratelimiter.h"
+#include "gmetrics.h"
+#include "glog.h"
+#include <algorithm>
+
+namespace GSmtp
+{
+	namespace RateLimiterImp
+	{
+		G::Metrics::Counter connections_limited( "emailrelay_smtp_server_rate_limited_total" , "type=\"connection\"" , "Rate-limited SMTP connections and messages" ) ;
+		G::Metrics::Counter messages_limited( "emailrelay_smtp_server_rate_limited_total" , "type=\"message\"" , "Rate-limited SMTP connections and messages" ) ;
+	}
+}
+
+GSmtp::RateLimiter::RateLimiter( const Config & config ) :
+	m_config(config) ,
+	m_table(config.table_size)
+{
+	m_config.period = std::max( m_config.period , 1U ) ;
+}
+
+bool GSmtp::RateLimiter::enabled() const noexcept
+{
+	return m_config.connections != 0U || m_config.messages != 0U ;
+}
+
+bool GSmtp::RateLimiter::acceptConnection( const GNet::Address & client )
+{
+	if( m_config.connections == 0U )
+		return true ;
+
+	Entry & entry = find( connectionKey(client) ) ;
+	if( entry.connection_tokens < 1.0 )
+	{
+		G_LOG( "GSmtp::RateLimiter::acceptConnection: connection rate exceeded: " << client.hostPartString() ) ;
+		RateLimiterImp::connections_limited.add() ;
+		return false ;
+	}
+	entry.connection_tokens -= 1.0 ;
+	return true ;
+}
+
+bool GSmtp::RateLimiter::checkMessage( const GNet::Address & client , const std::string & auth_id )
+{
+	if( m_config.messages == 0U )
+		return true ;
+
+	bool ok = find( messageKey(client,auth_id) ).message_tokens >= 1.0 ;
+	if( !ok )
+	{
+		G_LOG( "GSmtp::RateLimiter::checkMessage: message rate exceeded: " << client.hostPartString()
+			<< (auth_id.empty()?"":" ") << auth_id ) ;
+		RateLimiterImp::messages_limited.add() ;
+	}
+	return ok ;
+}
+
+bool GSmtp::RateLimiter::acceptMessage( const GNet::Address & client , const std::string & auth_id )
+{
+	if( m_config.messages == 0U )
+		return true ;
+
+	Entry & entry = find( messageKey(client,auth_id) ) ;
+	if( entry.message_tokens < 1.0 )
+	{
+		G_LOG( "GSmtp::RateLimiter::acceptMessage: message rate exceeded: " << client.hostPartString()
+			<< (auth_id.empty()?"":" ") << auth_id ) ;
+		RateLimiterImp::messages_limited.add() ;
+		return false ;
+	}
+	entry.message_tokens -= 1.0 ;
+	return true ;
+}
+
+GSmtp::RateLimiter::Entry & GSmtp::RateLimiter::find( const std::string & key )
+{
+	auto result = m_table.insert( key ) ;
+	Entry & entry = *result.first ;
+	if( result.second )
+	{
+		entry.connection_tokens = m_config.connections ;
+		entry.message_tokens = m_config.messages ;
+		entry.time = G::TimerTime::now() ;
+	}
+	else
+	{
+		refill( entry ) ;
+	}
+	return entry ;
+}
+
+void GSmtp::RateLimiter::refill( Entry & entry ) const
+{
+	G::TimerTime now = G::TimerTime::now() ;
+	if( now <= entry.time )
+		return ;
+	G::TimeInterval interval( entry.time , now ) ;
+	double elapsed = interval.s() + interval.us() / 1000000.0 ;
+	entry.time = now ;
+	entry.connection_tokens = std::min( double(m_config.connections) ,
+		entry.connection_tokens + elapsed * rate(m_config.connections,m_config.period) ) ;
+	entry.message_tokens = std::min( double(m_config.messages) ,
+		entry.message_tokens + elapsed * rate(m_config.messages,m_config.period) ) ;
+}
+
+double GSmtp::RateLimiter::rate( unsigned int limit , unsigned int period ) noexcept
+{
+	return double(limit) / double(period) ;
+}
+
+std::string GSmtp::RateLimiter::connectionKey( const GNet::Address & client )
+{
+	// compact binary keys -- IPv6 clients are keyed on their /64 prefix
+	// since they typically have a whole subnet to choose from
+	std::string key ;
+	if( client.is4() )
+	{
+		const auto * in4 = reinterpret_cast<const sockaddr_in*>( client.address() ) ; // NOLINT
+		const auto * p = reinterpret_cast<const char*>( &in4->sin_addr.s_addr ) ; // NOLINT
+		key.assign( 1U , '4' ).append( p , 4U ) ;
+	}
+	else if( client.is6() )
+	{
+		const auto * in6 = reinterpret_cast<const sockaddr_in6*>( client.address() ) ; // NOLINT
+		const auto * p = reinterpret_cast<const char*>( in6->sin6_addr.s6_addr ) ; // NOLINT
+		key.assign( 1U , '6' ).append( p , 8U ) ;
+	}
+	else
+	{
+		key.assign( 1U , 'l' ).append( client.hostPartString() ) ;
+	}
+	return key ;
+}
+
+std::string GSmtp::RateLimiter::messageKey( const GNet::Address & client , const std::string & auth_id ) const
+{
+	if( m_config.by_auth && !auth_id.empty() )
+		return std::string(1U,'a').append( auth_id ) ;
+	else
+		return connectionKey( client ) ;
+}
@@ -0,0 +1,111 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gratelimiter.h
+///
+
+#ifndef G_SMTP_RATE_LIMITER_H
+#define G_SMTP_RATE_LIMITER_H
+
+#include "gdef.h"
+#include "gaddress.h"
+#include "gdatetime.h"
+#include "glrutable.h"
+#include <string>
+
+namespace GSmtp
+{
+	class RateLimiter ;
+}
+
+//| \class GSmtp::RateLimiter
+/// Limits the rate of incoming SMTP connections and messages on a
+/// per-client basis using token buckets.
+///
+/// Each client has a bucket for connections and another for messages,
+/// each holding up to the configured number of tokens and refilling
+/// continuously over the configured period. Clients are identified
+/// by their network address or, optionally for messages, by their
+/// authentication id.
+///
+/// The buckets are kept in a fixed-size table with least-recently-used
+/// eviction so that memory use is bounded. Evicted clients simply
+/// start again with full buckets.
+///
+class GSmtp::RateLimiter
+{
+public:
+	struct Config /// A configuration structure for GSmtp::RateLimiter.
+	{
+		unsigned int connections {0U} ; // per period, zero for no limit
+		unsigned int messages {0U} ; // per period, zero for no limit
+		unsigned int period {60U} ; // seconds
+		bool by_auth {false} ; // authenticated clients' messages keyed on the auth id
+		std::size_t table_size {10000U} ;
+
+		Config & set_connections( unsigned int ) noexcept ;
+		Config & set_messages( unsigned int ) noexcept ;
+		Config & set_period( unsigned int ) noexcept ;
+		Config & set_by_auth( bool = true ) noexcept ;
+		Config & set_table_size( std::size_t ) noexcept ;
+	} ;
+
+	explicit RateLimiter( const Config & ) ;
+		///< Constructor.
+
+	bool enabled() const noexcept ;
+		///< Returns true if there is a non-zero connection or
+		///< message limit.
+
+	bool acceptConnection( const GNet::Address & client ) ;
+		///< Takes a connection token for the given client address.
+		///< Returns false if the client has exceeded its connection
+		///< rate.
+
+	bool checkMessage( const GNet::Address & client , const std::string & auth_id ) ;
+		///< Returns false if the client has no message tokens left,
+		///< without taking a token.
+
+	bool acceptMessage( const GNet::Address & client , const std::string & auth_id ) ;
+		///< Takes a message token for the given client. Returns false
+		///< if the client has exceeded its message rate.
+
+private:
+	struct Entry
+	{
+		double connection_tokens {0.0} ;
+		double message_tokens {0.0} ;
+		G::TimerTime time {G::TimerTime::zero()} ;
+	} ;
+	Entry & find( const std::string & key ) ;
+	void refill( Entry & ) const ;
+	std::string messageKey( const GNet::Address & , const std::string & ) const ;
+	static std::string connectionKey( const GNet::Address & ) ;
+	static double rate( unsigned int limit , unsigned int period ) noexcept ;
+
+private:
+	Config m_config ;
+	G::LruTable<Entry> m_table ;
+} ;
+
+inline GSmtp::RateLimiter::Config & GSmtp::RateLimiter::Config::set_connections( unsigned int n ) noexcept { connections = n ; return *this ; }
+inline GSmtp::RateLimiter::Config & GSmtp::RateLimiter::Config::set_messages( unsigned int n ) noexcept { messages = n ; return *this ; }
+inline GSmtp::RateLimiter::Config & GSmtp::RateLimiter::Config::set_period( unsigned int s ) noexcept { period = s ; return *this ; }
+inline GSmtp::RateLimiter::Config & GSmtp::RateLimiter::Config::set_by_auth( bool b ) noexcept { by_auth = b ; return *this ; }
+inline GSmtp::RateLimiter::Config & GSmtp::RateLimiter::Config::set_table_size( std::size_t n ) noexcept { table_size = n ; return *this ; }
+
+#endif
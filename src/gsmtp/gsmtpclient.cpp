@@ -27,10 +27,19 @@
 #include "gsmtpclient.h"
 #include "gfilterfactorybase.h"
 #include "gresolver.h"
+#include "gmetrics.h"
 #include "gassert.h"
 #include "glog.h"
 #include <utility>
 
+namespace GSmtp
+{
+	namespace ClientImp
+	{
+		G::Metrics::Histogram filter_latency( "emailrelay_filter_duration_seconds" , "type=\"client\"" , "Filter latency" ) ;
+	}
+}
+
 GSmtp::Client::Client( GNet::EventState es , FilterFactoryBase & ff , const GNet::Location & remote ,
 	const GAuth::SaslClientSecrets & secrets , const Config & config ) :
 		GNet::Client(es.logging(this),remote,normalise(config.net_client_config)) ,
@@ -65,14 +74,28 @@ G::Slot::Signal<const GSmtp::Client::MessageDoneInfo&> & GSmtp::Client::messageD
 }
 
 void GSmtp::Client::sendMessage( std::unique_ptr<GStore::StoredMessage> message )
+{
+	sendMessage( std::shared_ptr<GStore::StoredMessage>(message.release()) , false ) ;
+}
+
+void GSmtp::Client::sendMessage( std::shared_ptr<GStore::StoredMessage> message , bool content_pending )
 {
 	G_ASSERT( message.get() != nullptr ) ;
 	m_message = std::move( message ) ;
+	m_content_pending = content_pending ;
 	m_event_logging_string = eventLoggingString( m_message.get() , m_config ) ;
 	if( ready() )
 		start() ;
 }
 
+void GSmtp::Client::contentAdded( bool complete )
+{
+	if( complete )
+		m_content_pending = false ;
+	if( m_message && connected() )
+		m_protocol.contentAdded( complete ) ;
+}
+
 bool GSmtp::Client::ready() const
 {
 	return m_config.secure_tunnel ? ( connected() && m_secure ) : connected() ;
@@ -106,7 +129,7 @@ void GSmtp::Client::start()
 	eventSignal().emit( "sending" , std::string(message()->id().str()) , std::string() ) ;
 	if( this_.deleted() ) return ;
 
-	m_protocol.start( std::weak_ptr<GStore::StoredMessage>(message()) ) ;
+	m_protocol.start( std::weak_ptr<GStore::StoredMessage>(message()) , m_content_pending ) ;
 }
 
 std::shared_ptr<GStore::StoredMessage> GSmtp::Client::message()
@@ -137,6 +160,7 @@ void GSmtp::Client::filterStart()
 		G_LOG_MORE( "GSmtp::Client::filterStart: client-filter [" << m_filter->id() << "]: [" << message()->id().str() << "]" ) ;
 		message()->close() ; // allow external editing
 		m_filter_special = false ;
+		m_filter_start = G::TimerTime::now() ;
 		m_filter->start( message()->id() ) ;
 	}
 }
@@ -149,6 +173,7 @@ void GSmtp::Client::onNoFilterTimeout()
 void GSmtp::Client::filterDone( int filter_result )
 {
 	G_ASSERT( static_cast<int>(m_filter->result()) == filter_result ) ;
+	ClientImp::filter_latency.observe( m_filter_start ) ;
 
 	const bool ok = filter_result == 0 ;
 	const bool abandon = filter_result == 1 ;
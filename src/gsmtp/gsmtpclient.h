@@ -37,6 +37,7 @@
 #include "gslot.h"
 #include "gtimer.h"
 #include "gstringview.h"
+#include "gdatetime.h"
 #include "gstringarray.h"
 #include "gexception.h"
 #include <memory>
@@ -116,6 +117,17 @@ public:
 		///<
 		///< Does nothing if there are no message recipients.
 
+	void sendMessage( std::shared_ptr<GStore::StoredMessage> message , bool content_pending ) ;
+		///< An overload taking a shared message. If 'content_pending'
+		///< is true then the message's content stream is still
+		///< growing and contentAdded() must be called as more content
+		///< is added. See ClientProtocol::start().
+
+	void contentAdded( bool complete ) ;
+		///< Used after sendMessage() with 'content_pending' to
+		///< indicate that more content is available from the message's
+		///< content stream, with 'complete' true once it is all there.
+
 	void quitAndFinish() ;
 		///< Finishes a sendMessage() sequence. Sends a QUIT command and
 		///< finish()es the GNet::Client.
@@ -164,6 +176,8 @@ private:
 	G::Slot::Signal<const MessageDoneInfo&> m_message_done_signal ;
 	bool m_secure {false} ;
 	bool m_filter_special {false} ;
+	bool m_content_pending {false} ;
+	G::TimerTime m_filter_start {G::TimerTime::zero()} ;
 	G::CallStack m_stack ;
 	std::string m_event_logging_string ;
 } ;
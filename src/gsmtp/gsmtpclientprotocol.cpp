@@ -23,6 +23,7 @@
 #include "gsaslclient.h"
 #include "gbase64.h"
 #include "gtest.h"
+#include "gmetrics.h"
 #include "gstr.h"
 #include "gstringfield.h"
 #include "gstringtoken.h"
@@ -39,6 +40,9 @@ namespace GSmtp
 	{
 		class EhloReply ;
 		struct AuthError ;
+		G::Metrics::Counter messages_forwarded( "emailrelay_smtp_client_messages_total" , "result=\"forwarded\"" , "Messages processed by the SMTP client" ) ;
+		G::Metrics::Counter messages_abandoned( "emailrelay_smtp_client_messages_total" , "result=\"abandoned\"" , "Messages processed by the SMTP client" ) ;
+		G::Metrics::Counter messages_failed( "emailrelay_smtp_client_messages_total" , "result=\"failed\"" , "Messages processed by the SMTP client" ) ;
 	}
 }
 
@@ -82,13 +86,14 @@ void GSmtp::ClientProtocol::reconfigure( const std::string & ehlo )
 	m_config.ehlo = ehlo ;
 }
 
-void GSmtp::ClientProtocol::start( std::weak_ptr<GStore::StoredMessage> message_in )
+void GSmtp::ClientProtocol::start( std::weak_ptr<GStore::StoredMessage> message_in , bool content_pending )
 {
 	G_DEBUG( "GSmtp::ClientProtocol::start" ) ;
 
 	// reinitialise for the new message
 	m_message_state = MessageState() ;
 	m_message_state.ptr = message_in ;
+	m_message_state.content_pending = content_pending ;
 	m_message_p = message_in.lock().get() ;
 	m_message_state.selector = m_message_p->clientAccountSelector() ;
 	m_message_state.id = m_message_p->id().str() ;
@@ -126,6 +131,25 @@ void GSmtp::ClientProtocol::sendComplete()
 	}
 }
 
+void GSmtp::ClientProtocol::contentAdded( bool complete )
+{
+	if( complete )
+		m_message_state.content_pending = false ;
+
+	if( m_protocol.state == State::Data && m_message_state.content_stalled )
+	{
+		m_message_state.content_stalled = false ;
+		message().contentStream().clear() ;
+		std::size_t n = sendContentLines() ;
+		G_LOG( "GSmtp::ClientProtocol: tx>>: [" << n << " line(s) of content]" ) ;
+		if( endOfContent() )
+		{
+			m_protocol.state = State::SentDot ;
+			sendEot() ;
+		}
+	}
+}
+
 G::Slot::Signal<const GSmtp::ClientProtocol::DoneInfo &> & GSmtp::ClientProtocol::doneSignal() noexcept
 {
 	return m_done_signal ;
@@ -423,10 +447,11 @@ bool GSmtp::ClientProtocol::applyEvent( const ClientReply & reply )
 			send( "RSET\r\n"_sv ) ;
 		}
 		else if( ( message().bodyType() == BodyType::BinaryMime || G::Test::enabled("smtp-client-prefer-bdat") ) &&
-			m_session.server.has_binarymime && m_session.server.has_chunking )
+			m_session.server.has_binarymime && m_session.server.has_chunking && !m_message_state.content_pending )
 		{
 			// RFC-3030
 			m_message_state.content_size = message().contentSize() ;
+			m_message_state.content_view = message().contentView() ;
 			std::string content_size_str = std::to_string( m_message_state.content_size ) ;
 
 			bool one_chunk = (m_message_state.content_size+5U) <= m_config.bdat_chunk_size ; // 5 for " LAST"
@@ -457,6 +482,7 @@ bool GSmtp::ClientProtocol::applyEvent( const ClientReply & reply )
 	{
 		// DATA command accepted -- send content until flow-control asserted or all sent
 		m_protocol.state = State::Data ;
+		m_message_state.content_view = message().contentView() ;
 		std::size_t n = sendContentLines() ;
 		G_LOG( "GSmtp::ClientProtocol: tx>>: [" << n << " line(s) of content]" ) ;
 		if( endOfContent() )
@@ -492,6 +518,7 @@ bool GSmtp::ClientProtocol::applyEvent( const ClientReply & reply )
 		m_protocol.state = State::MessageDone ;
 		m_message_line.clear() ;
 		m_message_buffer.clear() ;
+		m_message_state.content_view = std::string_view() ;
 		if( reply.positive() && m_message_state.to_accepted < message().toCount() )
 			raiseDoneSignal( 0 , "one or more recipients rejected" ) ;
 		else
@@ -589,6 +616,13 @@ void GSmtp::ClientProtocol::raiseDoneSignal( int response_code , const std::stri
 	if( !response.empty() && response_code == 0 )
 		G_WARNING( "GSmtp::ClientProtocol: smtp client protocol: " << response << std::string_view(": ",reason.empty()?0U:2U) << G::Str::printable(reason) ) ;
 
+	if( response_code == -1 )
+		ClientProtocolImp::messages_abandoned.add() ;
+	else if( response.empty() && response_code >= 0 )
+		ClientProtocolImp::messages_forwarded.add() ;
+	else
+		ClientProtocolImp::messages_failed.add() ;
+
 	m_message_p = nullptr ;
 	cancelTimer() ;
 
@@ -597,7 +631,13 @@ void GSmtp::ClientProtocol::raiseDoneSignal( int response_code , const std::stri
 
 bool GSmtp::ClientProtocol::endOfContent()
 {
-	return !message().contentStream().good() ;
+	// a growing content stream that has run out is stalled rather
+	// than finished -- see contentAdded()
+	const bool eof = m_message_state.content_view.empty() ?
+		!message().contentStream().good() :
+		m_message_state.content_pos >= m_message_state.content_view.size() ;
+	m_message_state.content_stalled = eof && m_message_state.content_pending ;
+	return eof && !m_message_state.content_pending ;
 }
 
 std::string_view GSmtp::ClientProtocol::checkSendable()
@@ -772,6 +812,9 @@ bool GSmtp::ClientProtocol::sendNextContentLine( std::string & line )
 	// bare LF line endings -- to avoid data shuffling the dot-escaping is
 	// done by keeping a leading dot in the string buffer
 	G_ASSERT( !line.empty() && line.at(0) == '.' ) ;
+	if( !m_message_state.content_view.empty() )
+		return sendNextContentViewLine( line ) ;
+
 	bool ok = false ;
 	line.erase( 1U ) ; // leave "."
 	if( G::Str::readLine( message().contentStream() , line ,
@@ -784,6 +827,29 @@ bool GSmtp::ClientProtocol::sendNextContentLine( std::string & line )
 	return ok ;
 }
 
+bool GSmtp::ClientProtocol::sendNextContentViewLine( std::string & line )
+{
+	// as above but reading from contiguous content -- lines that are
+	// already CR-LF terminated and that need no dot-escaping are sent
+	// without copying
+	std::string_view content = m_message_state.content_view ;
+	std::size_t & pos = m_message_state.content_pos ;
+	std::size_t start = pos ;
+	std::string_view content_line ;
+	if( !G::Str::readLine( content , pos , content_line ,
+		m_config.crlf_only ? G::Str::Eol::CrLf : G::Str::Eol::Cr_Lf_CrLf ) )
+			return false ;
+
+	bool crlf = ( pos - start - content_line.size() ) == 2U ;
+	if( crlf && ( content_line.empty() || content_line[0] != '.' ) )
+		return sendContentLineImp( content.substr(start,pos-start) , 0U ) ;
+
+	line.erase( 1U ) ; // leave "."
+	line.append( content_line.data() , content_line.size() ) ;
+	line.append( "\r\n" , 2U ) ;
+	return sendContentLineImp( line , line.at(1U) == '.' ? 0U : 1U ) ;
+}
+
 void GSmtp::ClientProtocol::sendEhlo()
 {
 	send( "EHLO "_sv , m_config.ehlo , "\r\n"_sv ) ;
@@ -847,12 +913,24 @@ bool GSmtp::ClientProtocol::sendBdatAndChunk( std::size_t size , const std::stri
 
 	G_ASSERT( buffer_size > datapos ) ;
 	G_ASSERT( (out+datapos) < (m_message_buffer.data()+m_message_buffer.size()) ) ;
-	message().contentStream().read( out+datapos , buffer_size-datapos ) ; // NOLINT narrowing
-	std::streamsize gcount = message().contentStream().gcount() ;
-
-	G_ASSERT( gcount >= 0 ) ;
-	//static_assert( sizeof(std::streamsize) == sizeof(std::size_t) , "" ) ; // not msvc
-	std::size_t nread = static_cast<std::size_t>( gcount ) ;
+	std::size_t nread = 0U ;
+	if( m_message_state.content_view.empty() )
+	{
+		message().contentStream().read( out+datapos , buffer_size-datapos ) ; // NOLINT narrowing
+		std::streamsize gcount = message().contentStream().gcount() ;
+		G_ASSERT( gcount >= 0 ) ;
+		//static_assert( sizeof(std::streamsize) == sizeof(std::size_t) , "" ) ; // not msvc
+		nread = static_cast<std::size_t>( gcount ) ;
+	}
+	else
+	{
+		std::string_view chunk = m_message_state.content_view.substr(
+			std::min(m_message_state.content_pos,m_message_state.content_view.size()) , buffer_size-datapos ) ;
+		if( !chunk.empty() )
+			std::memcpy( out+datapos , chunk.data() , chunk.size() ) ; // NOLINT
+		m_message_state.content_pos += chunk.size() ;
+		nread = chunk.size() ;
+	}
 
 	bool eof = (datapos+nread) < buffer_size ;
 	if( eof && !last )
@@ -897,7 +975,7 @@ void GSmtp::ClientProtocol::sendChunkImp( const char * p , std::size_t n )
 	m_sender.protocolSend( sv , 0U , false ) ;
 }
 
-bool GSmtp::ClientProtocol::sendContentLineImp( const std::string & line , std::size_t offset )
+bool GSmtp::ClientProtocol::sendContentLineImp( std::string_view line , std::size_t offset )
 {
 	bool all_sent = m_sender.protocolSend( line , offset , false ) ;
 	if( !all_sent && m_config.response_timeout != 0U )
@@ -140,11 +140,16 @@ public:
 	void reconfigure( const std::string & ehlo ) ;
 		///< Updates a configuration parameter after construction.
 
-	void start( std::weak_ptr<GStore::StoredMessage> ) ;
+	void start( std::weak_ptr<GStore::StoredMessage> , bool content_pending = false ) ;
 		///< Starts transmission of the given message. The doneSignal()
 		///< is used to indicate that the message has been processed
 		///< and the shared object should remain valid until then.
 		///<
+		///< If 'content_pending' is true then the message's content
+		///< stream is still growing: running out of content does not
+		///< end the DATA phase, BDAT is not used, and contentAdded()
+		///< must be called as more content becomes available.
+		///<
 		///< Precondition: GStore::StoredMessage::toCount() != 0
 
 	void finish() ;
@@ -155,6 +160,12 @@ public:
 		///< To be called when a blocked connection becomes unblocked.
 		///< See ClientProtocol::Sender::protocolSend().
 
+	void contentAdded( bool complete ) ;
+		///< To be called when more content has been added to a message
+		///< that was start()ed with 'content_pending', with 'complete'
+		///< true once the content stream has all of the content. Resumes
+		///< sending content if the DATA phase had run out.
+
 	void filterDone( Filter::Result result , const std::string & response , const std::string & reason ) ;
 		///< To be called when the Filter interface has done its thing.
 		///< If the result is Result::ok then the message processing
@@ -227,6 +238,10 @@ private:
 		G::StringArray to_rejected ; // list of rejected recipients
 		std::size_t chunk_data_size {0U} ;
 		std::string chunk_data_size_str ;
+		bool content_pending {false} ; // content stream still growing
+		std::string_view content_view ; // contiguous content, if available
+		std::size_t content_pos {0U} ; // read position within content_view
+		bool content_stalled {false} ; // in State::Data waiting for contentAdded()
 	} ;
 	struct SessionState
 	{
@@ -265,13 +280,14 @@ private:
 	void send( std::string_view , std::string_view , std::string_view = {} , std::string_view = {} , bool = false ) ;
 	std::size_t sendContentLines() ;
 	bool sendNextContentLine( std::string & ) ;
+	bool sendNextContentViewLine( std::string & ) ;
 	void sendEhlo() ;
 	void sendHelo() ;
 	bool sendMailFrom() ;
 	void sendRcptTo() ;
 	bool sendBdatAndChunk( std::size_t , const std::string & , bool ) ;
 	//
-	bool sendContentLineImp( const std::string & , std::size_t ) ;
+	bool sendContentLineImp( std::string_view , std::size_t ) ;
 	void sendChunkImp( const char * , std::size_t ) ;
 	bool sendImp( std::string_view , std::size_t sensitive_from = std::string::npos ) ;
 
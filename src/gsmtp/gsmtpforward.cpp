@@ -336,6 +336,11 @@ std::string GSmtp::Forward::peerAddressString() const
 	return m_client_ptr.get() ? m_client_ptr->peerAddressString() : std::string() ;
 }
 
+bool GSmtp::Forward::hasConnected() const
+{
+	return m_client_ptr.get() ? m_client_ptr->hasConnected() : m_has_connected ;
+}
+
 bool GSmtp::Forward::finished() const
 {
 	// (our owning ClientPtr treats exceptions as non-errors after quitAndFinish())
@@ -114,6 +114,10 @@ public:
 	std::string peerAddressString() const ;
 		///< Returns the Client's peerAddressString() if currently connected.
 
+	bool hasConnected() const ;
+		///< Returns true if the current Client, or the most recently
+		///< deleted one, has successfully connected.
+
 public:
 	Forward( const Forward & ) = delete ;
 	Forward( Forward && ) = delete ;
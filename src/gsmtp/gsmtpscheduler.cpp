@@ -0,0 +1,472 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gsmtpscheduler.cpp
+///
+
+#include "gdef.h"
+#include "gsmtpscheduler.h"
+#include "gclientptr.h"
+#include "gnetdone.h"
+#include "gdatetime.h"
+#include "gstr.h"
+#include "glog.h"
+#include "gassert.h"
+#include <algorithm>
+
+class GSmtp::Scheduler::Worker /// A GSmtp::Forward instance servicing a GSmtp::Scheduler queue.
+{
+public:
+	Worker( Scheduler & , std::size_t queue ) ;
+	~Worker() ;
+	void send( std::unique_ptr<GStore::StoredMessage> ) ;
+	void quit() ;
+	std::size_t queue() const noexcept ;
+	const GStore::MessageId & id() const noexcept ;
+	bool busy() const noexcept ;
+	bool dead() const noexcept ;
+	std::string peerAddressString() const ;
+
+public:
+	Worker( const Worker & ) = delete ;
+	Worker( Worker && ) = delete ;
+	Worker & operator=( const Worker & ) = delete ;
+	Worker & operator=( Worker && ) = delete ;
+
+private:
+	void onMessageDone( const Client::MessageDoneInfo & ) ;
+	void onEvent( const std::string & , const std::string & , const std::string & ) ;
+	void onDelete( const std::string & ) ;
+	void onDeleted( const std::string & ) ;
+
+private:
+	Scheduler & m_scheduler ;
+	std::size_t m_queue ;
+	GNet::ClientPtr<Forward> m_ptr ;
+	GStore::MessageId m_id {GStore::MessageId::none()} ;
+	bool m_connected {false} ;
+} ;
+
+// ==
+
+GSmtp::Scheduler::Scheduler( GNet::EventState es , GStore::MessageStore & store ,
+	FilterFactoryBase & ff , const GNet::Location & forward_to_default ,
+	const GAuth::SaslClientSecrets & secrets , const Forward::Config & forward_config ,
+	const Config & config ) :
+		m_es(es) ,
+		m_store(store) ,
+		m_ff(ff) ,
+		m_forward_to_default(forward_to_default) ,
+		m_secrets(secrets) ,
+		m_forward_config(forward_config) ,
+		m_config(config) ,
+		m_dispatch_timer(*this,&Scheduler::onDispatchTimeout,m_es)
+{
+	m_config.concurrency = std::max( 1U , m_config.concurrency ) ;
+	m_config.retry_max = std::max( m_config.retry_base , m_config.retry_max ) ;
+	scan() ;
+	m_dispatch_timer.startTimer( 0U ) ;
+}
+
+GSmtp::Scheduler::~Scheduler()
+= default ;
+
+void GSmtp::Scheduler::scan()
+{
+	// group the spooled messages into per-destination queues,
+	// skipping any that are waiting for their retry time
+	const std::time_t now = G::SystemTime::now().s() ;
+	std::size_t count = 0U ;
+	auto iter = m_store.iterator( /*lock=*/false ) ;
+	for(;;)
+	{
+		std::unique_ptr<GStore::StoredMessage> message = iter->next() ;
+		if( message == nullptr )
+			break ;
+
+		if( message->retryTime() > now )
+		{
+			G_DEBUG( "GSmtp::Scheduler::scan: [" << message->id().str() << "]: deferred until " << message->retryTime() ) ;
+			m_deferred++ ;
+			continue ;
+		}
+
+		const bool routed = !message->forwardTo().empty() ;
+		std::string destination = routed ? message->forwardTo() : message->forwardToAddress() ;
+		std::string key = std::string(1U,routed?'r':'a').append(destination).append(1U,'\n').append(message->clientAccountSelector()) ;
+		auto p = m_queue_map.find( key ) ;
+		if( p == m_queue_map.end() )
+		{
+			Queue queue ;
+			queue.destination = destination ;
+			queue.selector = message->clientAccountSelector() ;
+			m_queues.push_back( queue ) ;
+			p = m_queue_map.insert( {key,m_queues.size()-1U} ).first ;
+		}
+		m_queues[p->second].ids.push_back( message->id() ) ;
+		count++ ;
+	}
+	G_LOG_IF( count , "GSmtp::Scheduler::scan: forwarding: " << count << " message" << (count==1U?"":"s")
+		<< " for " << m_queues.size() << " destination" << (m_queues.size()==1U?"":"s")
+		<< (m_deferred?" (":"") << (m_deferred?std::to_string(m_deferred):std::string()) << (m_deferred?" deferred)":"") ) ;
+}
+
+void GSmtp::Scheduler::onDispatchTimeout()
+{
+	reap() ;
+	dispatch() ;
+}
+
+void GSmtp::Scheduler::dispatch()
+{
+	// start messages on idle or new connections, visiting the queues round-robin
+	for( bool progress = !m_stop ; progress ; )
+	{
+		progress = false ;
+		for( std::size_t n = 0U ; n < m_queues.size() ; n++ )
+		{
+			std::size_t q = m_next ;
+			m_next = ( m_next + 1U ) % m_queues.size() ;
+			Queue & queue = m_queues[q] ;
+			if( queue.deferred || queue.ids.empty() )
+				continue ;
+
+			Worker * worker = idleWorker( q ) ;
+			if( worker && full() && waiting(q) )
+			{
+				// hand the connection over to another queue
+				G_DEBUG( "GSmtp::Scheduler::dispatch: releasing connection for " << name(queue) ) ;
+				worker->quit() ;
+				continue ;
+			}
+			if( worker == nullptr && ( full() || queue.workers >= m_config.concurrency || ( queue.workers && waiting(q) ) ) )
+				continue ;
+
+			std::unique_ptr<GStore::StoredMessage> message = next( queue ) ;
+			if( message == nullptr )
+				continue ;
+
+			if( worker == nullptr )
+			{
+				G_DEBUG( "GSmtp::Scheduler::dispatch: new connection for " << name(queue) ) ;
+				m_workers.push_back( std::make_unique<Worker>( *this , q ) ) ;
+				queue.workers++ ;
+				worker = m_workers.back().get() ;
+			}
+			worker->send( std::move(message) ) ;
+			progress = true ;
+		}
+	}
+
+	// disconnect idle connections that have nothing left to do
+	for( auto & worker : m_workers )
+	{
+		const Queue & queue = m_queues[worker->queue()] ;
+		if( !worker->dead() && !worker->busy() &&
+			( m_stop || queue.deferred || queue.ids.empty() || waiting(worker->queue()) ) )
+				worker->quit() ;
+	}
+	reap() ;
+
+	if( m_workers.empty() )
+	{
+		G_LOG( "GSmtp::Scheduler::dispatch: forwarding: no more messages to send"
+			<< (m_sent||m_deferred?": ":"")
+			<< (m_sent?std::to_string(m_sent).append(" sent"):std::string())
+			<< (m_sent&&m_deferred?", ":"")
+			<< (m_deferred?std::to_string(m_deferred).append(" deferred"):std::string()) ) ;
+		m_finished = true ;
+		throw GNet::Done() ; // terminates us
+	}
+}
+
+void GSmtp::Scheduler::reap()
+{
+	for( auto p = m_workers.begin() ; p != m_workers.end() ; )
+	{
+		if( (*p)->dead() )
+		{
+			G_ASSERT( m_queues.at((*p)->queue()).workers != 0U ) ;
+			m_queues[(*p)->queue()].workers-- ;
+			p = m_workers.erase( p ) ;
+		}
+		else
+		{
+			++p ;
+		}
+	}
+}
+
+bool GSmtp::Scheduler::full() const
+{
+	return m_config.connections != 0U &&
+		std::count_if( m_workers.begin() , m_workers.end() ,
+			[](const std::unique_ptr<Worker> & w){return !w->dead();} ) >= static_cast<std::ptrdiff_t>(m_config.connections) ;
+}
+
+bool GSmtp::Scheduler::waiting( std::size_t q ) const
+{
+	// returns true if some other queue is waiting for its first connection
+	if( m_config.connections == 0U )
+		return false ;
+	for( std::size_t i = 0U ; i < m_queues.size() ; i++ )
+	{
+		const Queue & queue = m_queues[i] ;
+		if( i != q && queue.workers == 0U && !queue.deferred && !queue.ids.empty() )
+			return true ;
+	}
+	return false ;
+}
+
+GSmtp::Scheduler::Worker * GSmtp::Scheduler::idleWorker( std::size_t q )
+{
+	for( auto & worker : m_workers )
+	{
+		if( worker->queue() == q && !worker->dead() && !worker->busy() )
+			return worker.get() ;
+	}
+	return nullptr ;
+}
+
+std::unique_ptr<GStore::StoredMessage> GSmtp::Scheduler::next( Queue & queue )
+{
+	const std::time_t now = G::SystemTime::now().s() ;
+	while( !queue.ids.empty() )
+	{
+		GStore::MessageId id = queue.ids.front() ;
+		queue.ids.pop_front() ;
+
+		std::unique_ptr<GStore::StoredMessage> message ;
+		try
+		{
+			message = m_store.get( id ) ;
+		}
+		catch( std::exception & e ) // eg. deleted or locked by another process
+		{
+			G_DEBUG( "GSmtp::Scheduler::next: skipping [" << id.str() << "]: " << e.what() ) ;
+			continue ;
+		}
+
+		if( message->retryTime() > now )
+		{
+			G_DEBUG( "GSmtp::Scheduler::next: skipping deferred message [" << id.str() << "]" ) ;
+		}
+		else if( message->toCount() == 0U && m_forward_config.fail_if_no_remote_recipients )
+		{
+			G_WARNING( "GSmtp::Scheduler::next: forwarding [" << id.str() << "]: failing message with no remote recipients" ) ;
+			message->fail( "no remote recipients" , 0 ) ;
+		}
+		else if( message->toCount() == 0U )
+		{
+			G_DEBUG( "GSmtp::Scheduler::next: forwarding [" << id.str() << "]: skipping message with no remote recipients" ) ;
+		}
+		else
+		{
+			return message ;
+		}
+	}
+	return {} ;
+}
+
+void GSmtp::Scheduler::defer( Queue & queue , const GStore::MessageId & id , const std::string & reason )
+{
+	// defer the failed message and everything else queued for the same destination
+	std::vector<GStore::MessageId> ids ;
+	if( id.valid() )
+		ids.push_back( id ) ;
+	ids.insert( ids.end() , queue.ids.begin() , queue.ids.end() ) ;
+	queue.ids.clear() ;
+	queue.deferred = true ;
+
+	std::size_t count = 0U ;
+	std::time_t retry_time = 0 ;
+	for( const auto & deferred_id : ids )
+	{
+		try
+		{
+			std::unique_ptr<GStore::StoredMessage> message = m_store.get( deferred_id ) ;
+			retry_time = retryTime( message->retryCount() ) ;
+			message->retry( retry_time , reason ) ;
+			count++ ;
+		}
+		catch( std::exception & e )
+		{
+			G_DEBUG( "GSmtp::Scheduler::defer: cannot defer [" << deferred_id.str() << "]: " << e.what() ) ;
+		}
+	}
+	m_deferred += count ;
+
+	G_WARNING( "GSmtp::Scheduler::defer: forwarding to " << name(queue) << ": connection failed: " << reason
+		<< ": " << count << " message" << (count==1U?"":"s") << " deferred"
+		<< (count==1U?std::string(" for ").append(std::to_string(retry_time-G::SystemTime::now().s())).append("s"):std::string()) ) ;
+}
+
+std::time_t GSmtp::Scheduler::retryTime( unsigned int retry_count ) const
+{
+	// exponential backoff: base, 2*base, 4*base ... max
+	unsigned long delay = m_config.retry_base ;
+	for( unsigned int i = 0U ; i < retry_count && delay < m_config.retry_max ; i++ )
+		delay *= 2UL ;
+	delay = std::min( delay , static_cast<unsigned long>(m_config.retry_max) ) ;
+	return G::SystemTime::now().s() + static_cast<std::time_t>(delay) ;
+}
+
+void GSmtp::Scheduler::onWorkerDone( Worker & , const Client::MessageDoneInfo & info )
+{
+	if( info.response.empty() )
+		m_sent++ ;
+	if( info.filter_special )
+		m_stop = true ;
+	m_dispatch_timer.startTimer( 0U ) ;
+}
+
+void GSmtp::Scheduler::onWorkerDeleted( Worker & worker , const std::string & reason , bool connected )
+{
+	G_DEBUG( "GSmtp::Scheduler::onWorkerDeleted: [" << reason << "] " << (connected?"connected":"not connected") ) ;
+	if( !reason.empty() && !connected )
+		defer( m_queues.at(worker.queue()) , worker.id() , reason ) ;
+	m_dispatch_timer.startTimer( 0U ) ;
+}
+
+void GSmtp::Scheduler::onWorkerEvent( const std::string & p1 , const std::string & p2 , const std::string & p3 )
+{
+	m_event_signal.emit( std::string(p1) , std::string(p2) , std::string(p3) ) ;
+}
+
+void GSmtp::Scheduler::doOnDelete( const std::string & reason , bool done )
+{
+	// (our owning ClientPtr is handling an exception by deleting us)
+	G_WARNING_IF( !done && !reason.empty() , "GSmtp::Scheduler::doOnDelete: forwarding error: " << reason ) ;
+}
+
+bool GSmtp::Scheduler::finished() const
+{
+	return m_finished ;
+}
+
+std::string GSmtp::Scheduler::peerAddressString() const
+{
+	// (used for logging)
+	for( const auto & worker : m_workers )
+	{
+		std::string s = worker->peerAddressString() ;
+		if( !s.empty() )
+			return s ;
+	}
+	return {} ;
+}
+
+std::string GSmtp::Scheduler::name( const Queue & queue )
+{
+	std::string s = queue.destination.empty() ? std::string("default destination") :
+		std::string(1U,'[').append(G::Str::printable(queue.destination)).append(1U,']') ;
+	if( !queue.selector.empty() )
+		s.append(" selector=[").append(G::Str::printable(queue.selector)).append(1U,']') ;
+	return s ;
+}
+
+G::Slot::Signal<const std::string&,const std::string&,const std::string&> & GSmtp::Scheduler::eventSignal() noexcept
+{
+	return m_event_signal ;
+}
+
+// ==
+
+GSmtp::Scheduler::Worker::Worker( Scheduler & scheduler , std::size_t queue ) :
+	m_scheduler(scheduler) ,
+	m_queue(queue)
+{
+	m_ptr.eventSignal().connect( G::Slot::slot(*this,&Worker::onEvent) ) ;
+	m_ptr.deleteSignal().connect( G::Slot::slot(*this,&Worker::onDelete) ) ;
+	m_ptr.deletedSignal().connect( G::Slot::slot(*this,&Worker::onDeleted) ) ;
+	m_ptr.reset( std::make_unique<Forward>( m_scheduler.m_es.eh(m_ptr) , m_scheduler.m_ff ,
+		m_scheduler.m_forward_to_default , m_scheduler.m_secrets , m_scheduler.m_forward_config ) ) ;
+	m_ptr->messageDoneSignal().connect( G::Slot::slot(*this,&Worker::onMessageDone) ) ;
+}
+
+GSmtp::Scheduler::Worker::~Worker()
+{
+	if( m_ptr.get() )
+		m_ptr->messageDoneSignal().disconnect() ;
+	m_ptr.deletedSignal().disconnect() ;
+	m_ptr.deleteSignal().disconnect() ;
+	m_ptr.eventSignal().disconnect() ;
+}
+
+void GSmtp::Scheduler::Worker::send( std::unique_ptr<GStore::StoredMessage> message )
+{
+	G_ASSERT( m_ptr.get() != nullptr ) ;
+	m_id = message->id() ;
+	m_ptr->sendMessage( std::move(message) ) ;
+}
+
+void GSmtp::Scheduler::Worker::quit()
+{
+	// send QUIT and disconnect, as for GSmtp::Forward::onMessageDoneSignal()
+	G_ASSERT( m_ptr.get() != nullptr ) ;
+	m_ptr->messageDoneSignal().disconnect() ;
+	m_ptr->quitAndFinish() ;
+	m_ptr.reset() ;
+}
+
+void GSmtp::Scheduler::Worker::onMessageDone( const Client::MessageDoneInfo & info )
+{
+	m_id = GStore::MessageId::none() ;
+	m_scheduler.onWorkerDone( *this , info ) ;
+}
+
+void GSmtp::Scheduler::Worker::onEvent( const std::string & p1 , const std::string & p2 , const std::string & p3 )
+{
+	m_scheduler.onWorkerEvent( p1 , p2 , p3 ) ;
+}
+
+void GSmtp::Scheduler::Worker::onDelete( const std::string & )
+{
+	// save the state of the Forward before it goes away
+	G_ASSERT( m_ptr.get() ) ;
+	m_connected = m_ptr->hasConnected() ;
+}
+
+void GSmtp::Scheduler::Worker::onDeleted( const std::string & reason )
+{
+	m_scheduler.onWorkerDeleted( *this , reason , m_connected ) ;
+}
+
+std::size_t GSmtp::Scheduler::Worker::queue() const noexcept
+{
+	return m_queue ;
+}
+
+const GStore::MessageId & GSmtp::Scheduler::Worker::id() const noexcept
+{
+	return m_id ;
+}
+
+bool GSmtp::Scheduler::Worker::busy() const noexcept
+{
+	return m_id.valid() ;
+}
+
+bool GSmtp::Scheduler::Worker::dead() const noexcept
+{
+	return m_ptr.get() == nullptr ;
+}
+
+std::string GSmtp::Scheduler::Worker::peerAddressString() const
+{
+	return m_ptr.get() ? m_ptr->peerAddressString() : std::string() ;
+}
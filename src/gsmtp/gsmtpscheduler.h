@@ -0,0 +1,164 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gsmtpscheduler.h
+///
+
+#ifndef G_SMTP_SCHEDULER_H
+#define G_SMTP_SCHEDULER_H
+
+#include "gdef.h"
+#include "gsmtpforward.h"
+#include "glocation.h"
+#include "gsaslclientsecrets.h"
+#include "gmessagestore.h"
+#include "gstoredmessage.h"
+#include "gfilterfactorybase.h"
+#include "geventstate.h"
+#include "gslot.h"
+#include "gtimer.h"
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ctime>
+
+namespace GSmtp
+{
+	class Scheduler ;
+}
+
+//| \class GSmtp::Scheduler
+/// A class for forwarding messages from a message store that groups
+/// the messages into per-destination queues and runs a separate
+/// GSmtp::Forward instance for each connection.
+///
+/// The destination of a message is its forwardTo() routing parameter,
+/// or failing that its forwardToAddress(), or failing that the default
+/// forward-to address. Each destination queue can have a limited number
+/// of concurrent connections, and there can be an overall limit on the
+/// number of connections. When the overall limit is reached connections
+/// are handed over to waiting queues between messages, so queues are
+/// serviced round-robin and a slow destination does not starve the
+/// others.
+///
+/// If a connection to a destination fails then all its queued messages
+/// are deferred using GStore::StoredMessage::retry() with an exponential
+/// backoff time, and the deferred messages are skipped until their retry
+/// time comes round.
+///
+/// Once all messages have been sent or deferred the scheduler throws
+/// GNet::Done. See GNet::ClientPtr.
+///
+class GSmtp::Scheduler
+{
+public:
+	struct Config /// A structure containing GSmtp::Scheduler configuration parameters.
+	{
+		unsigned int concurrency {1U} ; // connections per destination
+		unsigned int connections {0U} ; // total connections, or zero for no limit
+		unsigned int retry_base {60U} ; // seconds before the first retry
+		unsigned int retry_max {14400U} ; // maximum seconds between retries
+		Config & set_concurrency( unsigned int ) noexcept ;
+		Config & set_connections( unsigned int ) noexcept ;
+		Config & set_retry_base( unsigned int ) noexcept ;
+		Config & set_retry_max( unsigned int ) noexcept ;
+	} ;
+
+	Scheduler( GNet::EventState , GStore::MessageStore & store ,
+		FilterFactoryBase & , const GNet::Location & forward_to_default ,
+		const GAuth::SaslClientSecrets & , const Forward::Config & forward_config ,
+		const Config & config ) ;
+			///< Constructor. Reads the message store and starts
+			///< forwarding.
+
+	~Scheduler() ;
+		///< Destructor.
+
+	G::Slot::Signal<const std::string&,const std::string&,const std::string&> & eventSignal() noexcept ;
+		///< See GNet::Client::eventSignal().
+
+	void doOnDelete( const std::string & reason , bool done ) ;
+		///< Used by owning ClientPtr when handling an exception.
+
+	bool finished() const ;
+		///< Returns true once all the forwarding connections
+		///< have finished.
+
+	std::string peerAddressString() const ;
+		///< Returns a connected peer address, for logging.
+
+public:
+	Scheduler( const Scheduler & ) = delete ;
+	Scheduler( Scheduler && ) = delete ;
+	Scheduler & operator=( const Scheduler & ) = delete ;
+	Scheduler & operator=( Scheduler && ) = delete ;
+
+private:
+	class Worker ;
+	struct Queue /// A per-destination queue of message ids.
+	{
+		std::string destination ; // forward-to, forward-to-address, or empty for the default
+		std::string selector ;
+		std::deque<GStore::MessageId> ids ;
+		unsigned int workers {0U} ;
+		bool deferred {false} ;
+	} ;
+
+private:
+	void scan() ;
+	void onDispatchTimeout() ;
+	void dispatch() ;
+	void reap() ;
+	bool full() const ;
+	bool waiting( std::size_t ) const ;
+	Worker * idleWorker( std::size_t ) ;
+	std::unique_ptr<GStore::StoredMessage> next( Queue & ) ;
+	void defer( Queue & , const GStore::MessageId & , const std::string & ) ;
+	std::time_t retryTime( unsigned int retry_count ) const ;
+	void onWorkerDone( Worker & , const Client::MessageDoneInfo & ) ;
+	void onWorkerDeleted( Worker & , const std::string & , bool ) ;
+	void onWorkerEvent( const std::string & , const std::string & , const std::string & ) ;
+	static std::string name( const Queue & ) ;
+
+private:
+	GNet::EventState m_es ;
+	GStore::MessageStore & m_store ;
+	FilterFactoryBase & m_ff ;
+	GNet::Location m_forward_to_default ;
+	const GAuth::SaslClientSecrets & m_secrets ;
+	Forward::Config m_forward_config ;
+	Config m_config ;
+	GNet::Timer<Scheduler> m_dispatch_timer ;
+	std::vector<Queue> m_queues ;
+	std::map<std::string,std::size_t> m_queue_map ;
+	std::vector<std::unique_ptr<Worker>> m_workers ;
+	std::size_t m_next {0U} ;
+	std::size_t m_sent {0U} ;
+	std::size_t m_deferred {0U} ;
+	bool m_stop {false} ;
+	bool m_finished {false} ;
+	G::Slot::Signal<const std::string&,const std::string&,const std::string&> m_event_signal ;
+} ;
+
+inline GSmtp::Scheduler::Config & GSmtp::Scheduler::Config::set_concurrency( unsigned int n ) noexcept { concurrency = n ; return *this ; }
+inline GSmtp::Scheduler::Config & GSmtp::Scheduler::Config::set_connections( unsigned int n ) noexcept { connections = n ; return *this ; }
+inline GSmtp::Scheduler::Config & GSmtp::Scheduler::Config::set_retry_base( unsigned int n ) noexcept { retry_base = n ; return *this ; }
+inline GSmtp::Scheduler::Config & GSmtp::Scheduler::Config::set_retry_max( unsigned int n ) noexcept { retry_max = n ; return *this ; }
+
+#endif
@@ -36,10 +36,9 @@
 GSmtp::ServerPeer::ServerPeer( GNet::EventStateUnbound esu ,
 	GNet::ServerPeerInfo && peer_info , Server & server , bool enabled , VerifierFactoryBase & vf ,
 	const GAuth::SaslServerSecrets & server_secrets , const Server::Config & server_config ,
-	std::unique_ptr<ServerProtocol::Text> ptext ) :
+	std::unique_ptr<ServerProtocol::Text> ptext , RateLimiter * rate_limiter ) :
 		GNet::ServerPeer(esbind(esu,this),std::move(peer_info),GNet::LineBuffer::Config::transparent()) ,
 		m_server(server) ,
-		m_server_config(server_config) ,
 		m_block(std::bind(&ServerPeer::onDnsBlockResult,this,std::placeholders::_1),esbind(esu,this),server_config.dnsbl_config) ,
 		m_check_timer(*this,&ServerPeer::onCheckTimeout,esbind(esu,this)) ,
 		m_verifier(vf.newVerifier(esbind(esu,this),server_config.verifier_config,server_config.verifier_spec)) ,
@@ -47,7 +46,7 @@ GSmtp::ServerPeer::ServerPeer( GNet::EventStateUnbound esu ,
 		m_ptext(ptext.release()) ,
 		m_protocol(*this,*m_verifier,*m_pmessage,server_secrets,
 			*m_ptext,peerAddress(),
-			server_config.protocol_config,enabled) ,
+			server_config.protocol_config,enabled,rate_limiter) ,
 		m_input_buffer(esbind(esu,this),m_protocol,server_config.buffer_config)
 {
 	G_LOG_S( "GSmtp::ServerPeer: smtp connection from " << peerAddress().displayString() ) ;
@@ -55,7 +54,14 @@ GSmtp::ServerPeer::ServerPeer( GNet::EventStateUnbound esu ,
 	if( !server_config.protocol_config.tls_connection )
 		m_check_timer.startTimer( 1U ) ;
 
-	if( server_config.dnsbl_config.empty() )
+	if( rate_limiter && !rate_limiter->acceptConnection( peerAddress() ) )
+	{
+		G_LOG_S( "GSmtp::ServerPeer: smtp connection refused: too many connections from "
+			<< peerAddress().hostPartString() ) ;
+		m_refused = true ;
+		m_protocol.refuse() ;
+	}
+	else if( server_config.dnsbl_config.empty() )
 		m_protocol.init() ;
 	else
 		m_block.start( peerAddress() ) ;
@@ -82,8 +88,9 @@ void GSmtp::ServerPeer::onData( const char * data , std::size_t size )
 
 	// this override intercepts incoming data before it is applied to the
 	// base class's line buffer so that we can discard anything received
-	// before we have even sent an initial greeting
-	if( m_block.busy() )
+	// before we have even sent an initial greeting, or after
+	// the connection has been refused
+	if( m_block.busy() || m_refused )
 		return ;
 
 	// the base class's line buffer is configured as transparent so
@@ -189,8 +196,22 @@ GSmtp::Server::Server( GNet::EventState es , GStore::MessageStore & store , Filt
 		m_forward_to(forward_to) ,
 		m_forward_to_family(forward_to_family) ,
 		m_client_secrets(client_secrets) ,
-		m_dnsbl_suspend_time(G::TimerTime::zero())
+		m_dnsbl_suspend_time(G::TimerTime::zero()) ,
+		m_rate_limiter(server_config.rate_limit_config)
 {
+	if( server_config.cut_through && !forward_to.empty() )
+	{
+		m_cut_through = cutThroughFilter( server_config.filter_spec ) && cutThroughFilter( client_config.filter_spec ) ;
+		if( !m_cut_through )
+			G_WARNING( "GSmtp::Server: " << G::txt("cut-through forwarding disabled by the use of message filters") ) ;
+	}
+	if( server_config.async_content )
+	{
+		if( ContentWriterPool::works() )
+			m_content_writer_pool = std::make_shared<ContentWriterPool>( es , 2U ) ;
+		else
+			G_WARNING( "GSmtp::Server: " << G::txt("asynchronous spool writes disabled: no threads") ) ;
+	}
 }
 
 GSmtp::Server::~Server()
@@ -224,17 +245,25 @@ std::unique_ptr<GNet::ServerPeer> GSmtp::Server::newPeer( GNet::EventStateUnboun
 	try
 	{
 		std::string reason ;
-		if( ! m_server_config.allow_remote && !peer_info.m_address.isLocal(reason) )
+		bool is_local = peer_info.m_address.isLocal( reason ) ;
+		if( ! m_server_config.allow_remote && !is_local )
 		{
 			G_WARNING( "GSmtp::Server: "
 				<< format(txt("configured to reject non-local smtp connection: %1%")) % reason ) ;
 		}
+		else if( !is_local && m_server_config.allow_remote_ranges && !m_server_config.allow_remote_ranges->contains(peer_info.m_address) )
+		{
+			G_WARNING( "GSmtp::Server: "
+				<< format(txt("configured to reject smtp connection from outside the allowed address ranges: %1%"))
+					% peer_info.m_address.hostPartString() ) ;
+		}
 		else
 		{
 			GNet::Address peer_address = peer_info.m_address ;
 			ptr = std::make_unique<ServerPeer>( esu , std::move(peer_info) , *this ,
-				m_enabled , m_vf , m_server_secrets , serverConfig() ,
-				newProtocolText(m_server_config.anonymous_smtp,m_server_config.anonymous_content,peer_address,m_server_config.domain) ) ;
+				m_enabled , m_vf , m_server_secrets , serverConfig(peer_address) ,
+				newProtocolText(m_server_config.anonymous_smtp,m_server_config.anonymous_content,peer_address,m_server_config.domain) ,
+				m_rate_limiter.enabled() ? &m_rate_limiter : nullptr ) ;
 		}
 	}
 	catch( std::exception & e ) // newPeer()
@@ -244,10 +273,15 @@ std::unique_ptr<GNet::ServerPeer> GSmtp::Server::newPeer( GNet::EventStateUnboun
 	return ptr ;
 }
 
-GSmtp::Server::Config GSmtp::Server::serverConfig() const
+GSmtp::Server::Config GSmtp::Server::serverConfig( const GNet::Address & peer_address ) const
 {
 	if( !m_dnsbl_suspend_time.isZero() && G::TimerTime::now() < m_dnsbl_suspend_time )
 		return Config(m_server_config).set_dnsbl_config({}) ;
+	if( m_server_config.dnsbl_allow && m_server_config.dnsbl_allow->contains(peer_address) )
+	{
+		G_LOG( "GSmtp::Server::serverConfig: dnsbl check skipped for allowlisted address " << peer_address.hostPartString() ) ;
+		return Config(m_server_config).set_dnsbl_config({}) ;
+	}
 	return m_server_config ;
 }
 
@@ -276,9 +310,10 @@ std::unique_ptr<GSmtp::Filter> GSmtp::Server::newFilter( GNet::EventState es ) c
 		m_server_config.filter_spec ) ;
 }
 
-std::unique_ptr<GSmtp::ProtocolMessage> GSmtp::Server::newProtocolMessageStore( std::unique_ptr<Filter> filter )
+std::unique_ptr<GSmtp::ProtocolMessage> GSmtp::Server::newProtocolMessageStore( GNet::EventState es ,
+	std::unique_ptr<Filter> filter )
 {
-	return std::make_unique<ProtocolMessageStore>( m_store , std::move(filter) ) ;
+	return std::make_unique<ProtocolMessageStore>( es , m_store , std::move(filter) , m_content_writer_pool ) ;
 }
 
 std::unique_ptr<GSmtp::ProtocolMessage> GSmtp::Server::newProtocolMessageForward( GNet::EventState es ,
@@ -286,14 +321,21 @@ std::unique_ptr<GSmtp::ProtocolMessage> GSmtp::Server::newProtocolMessageForward
 {
 	// wrap the given 'store' object in a 'forward' one
 	return std::make_unique<ProtocolMessageForward>( es , m_store , m_ff , std::move(pm) , m_client_config ,
-		m_client_secrets , m_forward_to , m_forward_to_family ) ; // up-cast
+		m_client_secrets , m_forward_to , m_forward_to_family , m_cut_through ) ; // up-cast
+}
+
+bool GSmtp::Server::cutThroughFilter( const FilterFactoryBase::Spec & spec )
+{
+	// cut-through forwarding sends the content before the filters could
+	// change it, so only allow filters that do not look at the content
+	return spec.first == "exit" || spec.first == "sleep" ;
 }
 
 std::unique_ptr<GSmtp::ProtocolMessage> GSmtp::Server::newProtocolMessage( GNet::EventState es )
 {
 	const bool do_forward = ! m_forward_to.empty() ;
 	return do_forward ?
-		newProtocolMessageForward( es , newProtocolMessageStore(newFilter(es)) ) :
-		newProtocolMessageStore( newFilter(es) ) ;
+		newProtocolMessageForward( es , newProtocolMessageStore(es,newFilter(es)) ) :
+		newProtocolMessageStore( es , newFilter(es) ) ;
 }
 
@@ -25,6 +25,7 @@
 #include "gmultiserver.h"
 #include "gsmtpclient.h"
 #include "gdnsbl.h"
+#include "gaddresstree.h"
 #include "glinebuffer.h"
 #include "gverifier.h"
 #include "gmessagestore.h"
@@ -33,6 +34,8 @@
 #include "gsmtpserverprotocol.h"
 #include "gsmtpserversender.h"
 #include "gsmtpserverbufferin.h"
+#include "gratelimiter.h"
+#include "gcontentwriter.h"
 #include "gprotocolmessage.h"
 #include "glimits.h"
 #include "gexception.h"
@@ -40,6 +43,7 @@
 #include <string>
 #include <sstream>
 #include <memory>
+#include <utility>
 #include <list>
 
 namespace GSmtp
@@ -59,6 +63,7 @@ public:
 	struct Config /// A configuration structure for GSmtp::Server.
 	{
 		bool allow_remote {false} ;
+		std::shared_ptr<const GNet::AddressTree> allow_remote_ranges ; // null for any
 		G::StringArray interfaces ;
 		unsigned int port {0U} ;
 		std::string ident ;
@@ -72,10 +77,15 @@ public:
 		GNet::Server::Config net_server_config ;
 		ServerProtocol::Config protocol_config ;
 		std::string dnsbl_config ;
+		std::shared_ptr<const GNet::AddressTree> dnsbl_allow ; // null for none
 		ServerBufferIn::Config buffer_config ;
 		std::string domain ;
+		bool cut_through {false} ;
+		RateLimiter::Config rate_limit_config ;
+		bool async_content {false} ;
 
 		Config & set_allow_remote( bool = true ) noexcept ;
+		Config & set_allow_remote_ranges( std::shared_ptr<const GNet::AddressTree> ) ;
 		Config & set_interfaces( const G::StringArray & ) ;
 		Config & set_port( unsigned int ) noexcept ;
 		Config & set_ident( const std::string & ) ;
@@ -90,8 +100,12 @@ public:
 		Config & set_net_server_config( const GNet::Server::Config & ) ;
 		Config & set_protocol_config( const ServerProtocol::Config & ) ;
 		Config & set_dnsbl_config( const std::string & ) ;
+		Config & set_dnsbl_allow( std::shared_ptr<const GNet::AddressTree> ) ;
 		Config & set_buffer_config( const ServerBufferIn::Config & ) ;
 		Config & set_domain( const std::string & ) ;
+		Config & set_cut_through( bool = true ) noexcept ;
+		Config & set_rate_limit_config( const RateLimiter::Config & ) ;
+		Config & set_async_content( bool = true ) noexcept ;
 	} ;
 
 	Server( GNet::EventState es , GStore::MessageStore & ,
@@ -110,6 +124,21 @@ public:
 			///<
 			///< The forward-to-family is used if the forward-to address
 			///< is a DNS name that needs to be resolved.
+			///<
+			///< Remote clients are only accepted if 'allow_remote' is set,
+			///< and if 'allow_remote_ranges' is not null then only from
+			///< within those address ranges. Clients within the optional
+			///< 'dnsbl_allow' ranges are not subject to the DNSBL check.
+			///< The address trees are compiled by the caller so that they
+			///< can be shared between servers.
+			///<
+			///< If the 'rate_limit_config' has non-zero limits then new
+			///< connections and messages from each client are rate
+			///< limited using a GSmtp::RateLimiter.
+			///<
+			///< If 'async_content' is set then message content is
+			///< written to the store by a GSmtp::ContentWriterPool
+			///< owned by the server.
 
 	~Server() override ;
 		///< Destructor.
@@ -146,10 +175,11 @@ public:
 
 private:
 	std::unique_ptr<Filter> newFilter( GNet::EventState ) const ;
-	std::unique_ptr<ProtocolMessage> newProtocolMessageStore( std::unique_ptr<Filter> ) ;
+	std::unique_ptr<ProtocolMessage> newProtocolMessageStore( GNet::EventState , std::unique_ptr<Filter> ) ;
 	std::unique_ptr<ProtocolMessage> newProtocolMessageForward( GNet::EventState , std::unique_ptr<ProtocolMessage> ) ;
 	std::unique_ptr<ServerProtocol::Text> newProtocolText( bool , bool , const GNet::Address & , const std::string & domain ) const ;
-	Config serverConfig() const ;
+	Config serverConfig( const GNet::Address & ) const ;
+	static bool cutThroughFilter( const FilterFactoryBase::Spec & ) ;
 
 private:
 	GStore::MessageStore & m_store ;
@@ -166,6 +196,9 @@ private:
 	G::Slot::Signal<const std::string&,const std::string&> m_event_signal ;
 	G::TimerTime m_dnsbl_suspend_time ;
 	bool m_enabled {true} ;
+	bool m_cut_through {false} ;
+	RateLimiter m_rate_limiter ;
+	std::shared_ptr<ContentWriterPool> m_content_writer_pool ;
 } ;
 
 //| \class GSmtp::ServerPeer
@@ -180,8 +213,11 @@ public:
 
 	ServerPeer( GNet::EventStateUnbound , GNet::ServerPeerInfo && peer_info , Server & server ,
 		bool enabled , VerifierFactoryBase & vf , const GAuth::SaslServerSecrets & server_secrets ,
-		const Server::Config & server_config , std::unique_ptr<ServerProtocol::Text> ptext ) ;
-			///< Constructor.
+		const Server::Config & server_config , std::unique_ptr<ServerProtocol::Text> ptext ,
+		RateLimiter * rate_limiter ) ;
+			///< Constructor. The optional rate limiter is shared by all
+			///< the peers; if the new connection is over its connection
+			///< rate then it is refused with a 421 response.
 
 	~ServerPeer() override ;
 		///< Destructor.
@@ -210,7 +246,6 @@ private:
 
 private:
 	Server & m_server ;
-	Server::Config m_server_config ;
 	GNet::Dnsbl m_block ;
 	GNet::Timer<ServerPeer> m_check_timer ;
 	std::unique_ptr<Verifier> m_verifier ;
@@ -220,9 +255,11 @@ private:
 	ServerBufferIn m_input_buffer ;
 	std::string m_output_buffer ;
 	bool m_output_blocked {false} ;
+	bool m_refused {false} ;
 } ;
 
 inline GSmtp::Server::Config & GSmtp::Server::Config::set_allow_remote( bool b ) noexcept { allow_remote = b ; return *this ; }
+inline GSmtp::Server::Config & GSmtp::Server::Config::set_allow_remote_ranges( std::shared_ptr<const GNet::AddressTree> p ) { allow_remote_ranges = std::move(p) ; return *this ; }
 inline GSmtp::Server::Config & GSmtp::Server::Config::set_interfaces( const G::StringArray & a ) { interfaces = a ; return *this ; }
 inline GSmtp::Server::Config & GSmtp::Server::Config::set_port( unsigned int n ) noexcept { port = n ; return *this ; }
 inline GSmtp::Server::Config & GSmtp::Server::Config::set_ident( const std::string & s ) { ident = s ; return *this ; }
@@ -237,7 +274,11 @@ inline GSmtp::Server::Config & GSmtp::Server::Config::set_net_server_peer_config
 inline GSmtp::Server::Config & GSmtp::Server::Config::set_net_server_config( const GNet::Server::Config & c ) { net_server_config = c ; return *this ; }
 inline GSmtp::Server::Config & GSmtp::Server::Config::set_protocol_config( const ServerProtocol::Config & c ) { protocol_config = c ; return *this ; }
 inline GSmtp::Server::Config & GSmtp::Server::Config::set_dnsbl_config( const std::string & s ) { dnsbl_config = s ; return *this ; }
+inline GSmtp::Server::Config & GSmtp::Server::Config::set_dnsbl_allow( std::shared_ptr<const GNet::AddressTree> p ) { dnsbl_allow = std::move(p) ; return *this ; }
 inline GSmtp::Server::Config & GSmtp::Server::Config::set_buffer_config( const ServerBufferIn::Config & c ) { buffer_config = c ; return *this ; }
 inline GSmtp::Server::Config & GSmtp::Server::Config::set_domain( const std::string & s ) { domain = s ; return *this ; }
+inline GSmtp::Server::Config & GSmtp::Server::Config::set_cut_through( bool b ) noexcept { cut_through = b ; return *this ; }
+inline GSmtp::Server::Config & GSmtp::Server::Config::set_rate_limit_config( const RateLimiter::Config & c ) { rate_limit_config = c ; return *this ; }
+inline GSmtp::Server::Config & GSmtp::Server::Config::set_async_content( bool b ) noexcept { async_content = b ; return *this ; }
 
 #endif
@@ -28,6 +28,7 @@
 #include "gdate.h"
 #include "gtime.h"
 #include "gdatetime.h"
+#include "gmetrics.h"
 #include "gscope.h"
 #include "gstr.h"
 #include "gstringfield.h"
@@ -38,6 +39,18 @@
 #include <string>
 #include <tuple>
 
+namespace GSmtp
+{
+	namespace ServerProtocolImp
+	{
+		G::Metrics::Gauge sessions_active( "emailrelay_smtp_server_sessions" , "" , "Current SMTP server sessions" ) ;
+		G::Metrics::Counter sessions_total( "emailrelay_smtp_server_sessions_total" , "" , "SMTP server sessions" ) ;
+		G::Metrics::Counter messages_accepted( "emailrelay_smtp_server_messages_total" , "result=\"accepted\"" , "Messages received by the SMTP server" ) ;
+		G::Metrics::Counter messages_rejected( "emailrelay_smtp_server_messages_total" , "result=\"rejected\"" , "Messages received by the SMTP server" ) ;
+		G::Metrics::Histogram verifier_latency( "emailrelay_verifier_duration_seconds" , "" , "Address verifier latency" ) ;
+	}
+}
+
 std::unique_ptr<GAuth::SaslServer> GSmtp::ServerProtocol::newSaslServer( const GAuth::SaslServerSecrets & secrets ,
 	const std::string & sasl_config , const std::string & challenge_hostname )
 {
@@ -48,7 +61,7 @@ std::unique_ptr<GAuth::SaslServer> GSmtp::ServerProtocol::newSaslServer( const G
 GSmtp::ServerProtocol::ServerProtocol( ServerSender & sender , Verifier & verifier ,
 	ProtocolMessage & pm , const GAuth::SaslServerSecrets & secrets ,
 	Text & text , const GNet::Address & peer_address , const Config & config ,
-	bool enabled ) :
+	bool enabled , RateLimiter * rate_limiter ) :
 		ServerSend(&sender) ,
 		m_sender(&sender) ,
 		m_verifier(verifier) ,
@@ -56,74 +69,107 @@ GSmtp::ServerProtocol::ServerProtocol( ServerSender & sender , Verifier & verifi
 		m_pm(pm) ,
 		m_sasl(newSaslServer(secrets,config.sasl_server_config,config.sasl_server_challenge_hostname)) ,
 		m_config(config) ,
-		m_fsm(State::Start,State::End,State::s_Same,State::s_Any) ,
+		m_fsm(sharedFsm(config)) ,
+		m_with_starttls(config.tls_starttls) ,
 		m_peer_address(peer_address) ,
-		m_enabled(enabled)
-{
-	m_fsm( Event::Quit , State::s_Any , State::End , &ServerProtocol::doQuit ) ;
-	m_fsm( Event::Unknown , State::Processing , State::s_Same , &ServerProtocol::doIgnore ) ;
-	m_fsm( Event::Unknown , State::s_Any , State::s_Same , &ServerProtocol::doUnknown ) ;
-	m_fsm( Event::Rset , State::Start , State::s_Same , &ServerProtocol::doRset ) ;
-	m_fsm( Event::Rset , State::s_Any , State::Idle , &ServerProtocol::doRset ) ;
-	m_fsm( Event::Noop , State::s_Any , State::s_Same , &ServerProtocol::doNoop ) ;
-	m_fsm( Event::Help , State::s_Any , State::s_Same , &ServerProtocol::doHelp ) ;
-	m_fsm( Event::Expn , State::s_Any , State::s_Same , &ServerProtocol::doExpn ) ;
-	m_fsm( Event::Vrfy , State::Start , State::VrfyStart , &ServerProtocol::doVrfy , State::s_Same ) ;
-	m_fsm( Event::VrfyReply , State::VrfyStart , State::Start , &ServerProtocol::doVrfyReply ) ;
-	m_fsm( Event::Vrfy , State::Idle , State::VrfyIdle , &ServerProtocol::doVrfy , State::s_Same ) ;
-	m_fsm( Event::VrfyReply , State::VrfyIdle , State::Idle , &ServerProtocol::doVrfyReply ) ;
-	m_fsm( Event::Vrfy , State::GotMail , State::VrfyGotMail, &ServerProtocol::doVrfy , State::s_Same ) ;
-	m_fsm( Event::VrfyReply , State::VrfyGotMail, State::GotMail , &ServerProtocol::doVrfyReply ) ;
-	m_fsm( Event::Vrfy , State::GotRcpt , State::VrfyGotRcpt, &ServerProtocol::doVrfy , State::s_Same ) ;
-	m_fsm( Event::VrfyReply , State::VrfyGotRcpt, State::GotRcpt , &ServerProtocol::doVrfyReply ) ;
-	m_fsm( Event::Ehlo , State::s_Any , State::Idle , &ServerProtocol::doEhlo , State::s_Same ) ;
-	m_fsm( Event::Helo , State::s_Any , State::Idle , &ServerProtocol::doHelo , State::s_Same ) ;
-	m_fsm( Event::Mail , State::Idle , State::GotMail , &ServerProtocol::doMail , State::Idle ) ;
-	m_fsm( Event::Rcpt , State::GotMail , State::RcptTo1 , &ServerProtocol::doRcpt , State::s_Same ) ;
-	m_fsm( Event::RcptReply , State::RcptTo1 , State::GotRcpt , &ServerProtocol::doRcptToReply , State::GotMail ) ;
-	m_fsm( Event::Rcpt , State::GotRcpt , State::RcptTo2 , &ServerProtocol::doRcpt , State::s_Same ) ;
-	m_fsm( Event::RcptReply , State::RcptTo2 , State::GotRcpt , &ServerProtocol::doRcptToReply ) ;
-	m_fsm( Event::DataFail , State::GotMail , State::MustReset , &ServerProtocol::doBadDataCommand ) ;
-	m_fsm( Event::DataFail , State::GotRcpt , State::MustReset , &ServerProtocol::doBadDataCommand ) ;
-	m_fsm( Event::Data , State::GotMail , State::Idle , &ServerProtocol::doNoRecipients ) ;
-	m_fsm( Event::Data , State::GotRcpt , State::Data , &ServerProtocol::doData ) ;
-	m_fsm( Event::DataContent , State::Data , State::Data , &ServerProtocol::doDataContent ) ;
-	m_fsm( Event::Bdat , State::Idle , State::MustReset , &ServerProtocol::doBdatOutOfSequence ) ;
-	m_fsm( Event::Bdat , State::GotMail , State::Idle , &ServerProtocol::doNoRecipients ) ; // 1
-	m_fsm( Event::BdatLast , State::GotMail , State::Idle , &ServerProtocol::doNoRecipients ) ; // 2
-	m_fsm( Event::BdatLastZero , State::GotMail , State::Idle , &ServerProtocol::doNoRecipients ) ; // 3
-	m_fsm( Event::Bdat , State::GotRcpt , State::BdatData , &ServerProtocol::doBdatFirst , State::MustReset ) ; // 4
-	m_fsm( Event::BdatLast , State::GotRcpt , State::BdatDataLast , &ServerProtocol::doBdatFirstLast , State::MustReset ) ; // 5
-	m_fsm( Event::BdatLastZero , State::GotRcpt , State::BdatChecking , &ServerProtocol::doBdatFirstLastZero ) ; // 6
-	m_fsm( Event::BdatContent , State::BdatData , State::BdatIdle , &ServerProtocol::doBdatContent , State::BdatData ) ; // 7
-	m_fsm( Event::Bdat , State::BdatIdle , State::BdatData , &ServerProtocol::doBdatMore , State::MustReset ) ; // 8
-	m_fsm( Event::BdatLast , State::BdatIdle , State::BdatDataLast , &ServerProtocol::doBdatMoreLast , State::MustReset ) ; // 9
-	m_fsm( Event::BdatLastZero , State::BdatIdle , State::BdatChecking , &ServerProtocol::doBdatMoreLastZero ) ; // 10
-	m_fsm( Event::BdatContent , State::BdatDataLast , State::BdatChecking , &ServerProtocol::doBdatContentLast , State::BdatDataLast ) ;//11
-	m_fsm( Event::BdatCheck , State::BdatChecking , State::BdatProcessing , &ServerProtocol::doBdatCheck , State::Idle ) ; //12
-	m_fsm( Event::Done , State::BdatProcessing , State::Idle , &ServerProtocol::doBdatComplete ) ; // 13
-	m_fsm( Event::Eot , State::Data , State::Processing , &ServerProtocol::doEot , State::Idle ) ;
-	m_fsm( Event::Done , State::Processing , State::Idle , &ServerProtocol::doComplete ) ;
-	m_fsm( Event::Auth , State::Idle , State::Auth , &ServerProtocol::doAuth , State::Idle ) ;
-	m_fsm( Event::AuthData, State::Auth , State::Auth , &ServerProtocol::doAuthData , State::Idle ) ;
-	if( m_config.tls_starttls )
+		m_enabled(enabled) ,
+		m_rate_limiter(rate_limiter)
+{
+	m_verifier.doneSignal().connect( G::Slot::slot(*this,&ServerProtocol::verifyDone) ) ;
+	m_pm.processedSignal().connect( G::Slot::slot(*this,&ServerProtocol::protocolMessageProcessed) ) ;
+	m_pm.changeSignal().connect( G::Slot::slot(*this,&ServerProtocol::protocolMessageChange) ) ;
+	ServerProtocolImp::sessions_active.add() ;
+	ServerProtocolImp::sessions_total.add() ;
+}
+
+const GSmtp::ServerProtocol::Fsm & GSmtp::ServerProtocol::sharedFsm( const Config & config )
+{
+	// the transition table is built once for each tls variant and
+	// then shared by all sessions
+	if( config.tls_starttls )
 	{
-		m_with_starttls = true ;
-		m_fsm( Event::StartTls , State::Idle , State::StartingTls , &ServerProtocol::doStartTls , State::Idle ) ;
-		m_fsm( Event::Secure , State::StartingTls , State::Idle , &ServerProtocol::doSecure ) ;
+		static const Fsm fsm = newFsm( true , false ) ;
+		return fsm ;
 	}
-	else if( m_config.tls_connection )
+	else if( config.tls_connection )
 	{
-		m_fsm.reset( State::StartingTls ) ;
-		m_fsm( Event::Secure , State::StartingTls , State::Start , &ServerProtocol::doSecureGreeting ) ;
+		static const Fsm fsm = newFsm( false , true ) ;
+		return fsm ;
 	}
-	m_verifier.doneSignal().connect( G::Slot::slot(*this,&ServerProtocol::verifyDone) ) ;
-	m_pm.processedSignal().connect( G::Slot::slot(*this,&ServerProtocol::protocolMessageProcessed) ) ;
+	else
+	{
+		static const Fsm fsm = newFsm( false , false ) ;
+		return fsm ;
+	}
+}
+
+GSmtp::ServerProtocol::Fsm GSmtp::ServerProtocol::newFsm( bool starttls , bool tls_connection )
+{
+	Fsm fsm( State::Start , State::End , State::s_Same , State::s_Any ) ;
+	fsm( Event::Quit , State::s_Any , State::End , &ServerProtocol::doQuit ) ;
+	fsm( Event::Unknown , State::Processing , State::s_Same , &ServerProtocol::doIgnore ) ;
+	fsm( Event::Unknown , State::s_Any , State::s_Same , &ServerProtocol::doUnknown ) ;
+	fsm( Event::Rset , State::Start , State::s_Same , &ServerProtocol::doRset ) ;
+	fsm( Event::Rset , State::s_Any , State::Idle , &ServerProtocol::doRset ) ;
+	fsm( Event::Noop , State::s_Any , State::s_Same , &ServerProtocol::doNoop ) ;
+	fsm( Event::Help , State::s_Any , State::s_Same , &ServerProtocol::doHelp ) ;
+	fsm( Event::Expn , State::s_Any , State::s_Same , &ServerProtocol::doExpn ) ;
+	fsm( Event::Vrfy , State::Start , State::VrfyStart , &ServerProtocol::doVrfy , State::s_Same ) ;
+	fsm( Event::VrfyReply , State::VrfyStart , State::Start , &ServerProtocol::doVrfyReply ) ;
+	fsm( Event::Vrfy , State::Idle , State::VrfyIdle , &ServerProtocol::doVrfy , State::s_Same ) ;
+	fsm( Event::VrfyReply , State::VrfyIdle , State::Idle , &ServerProtocol::doVrfyReply ) ;
+	fsm( Event::Vrfy , State::GotMail , State::VrfyGotMail, &ServerProtocol::doVrfy , State::s_Same ) ;
+	fsm( Event::VrfyReply , State::VrfyGotMail, State::GotMail , &ServerProtocol::doVrfyReply ) ;
+	fsm( Event::Vrfy , State::GotRcpt , State::VrfyGotRcpt, &ServerProtocol::doVrfy , State::s_Same ) ;
+	fsm( Event::VrfyReply , State::VrfyGotRcpt, State::GotRcpt , &ServerProtocol::doVrfyReply ) ;
+	fsm( Event::Ehlo , State::s_Any , State::Idle , &ServerProtocol::doEhlo , State::s_Same ) ;
+	fsm( Event::Helo , State::s_Any , State::Idle , &ServerProtocol::doHelo , State::s_Same ) ;
+	fsm( Event::Mail , State::Idle , State::GotMail , &ServerProtocol::doMail , State::Idle ) ;
+	fsm( Event::Rcpt , State::GotMail , State::RcptTo1 , &ServerProtocol::doRcpt , State::s_Same ) ;
+	fsm( Event::RcptReply , State::RcptTo1 , State::GotRcpt , &ServerProtocol::doRcptToReply , State::GotMail ) ;
+	fsm( Event::Rcpt , State::GotRcpt , State::RcptTo2 , &ServerProtocol::doRcpt , State::s_Same ) ;
+	fsm( Event::RcptReply , State::RcptTo2 , State::GotRcpt , &ServerProtocol::doRcptToReply ) ;
+	fsm( Event::DataFail , State::GotMail , State::MustReset , &ServerProtocol::doBadDataCommand ) ;
+	fsm( Event::DataFail , State::GotRcpt , State::MustReset , &ServerProtocol::doBadDataCommand ) ;
+	fsm( Event::Data , State::GotMail , State::Idle , &ServerProtocol::doNoRecipients ) ;
+	fsm( Event::Data , State::GotRcpt , State::Data , &ServerProtocol::doData , State::Idle ) ;
+	fsm( Event::DataContent , State::Data , State::Data , &ServerProtocol::doDataContent ) ;
+	fsm( Event::Bdat , State::Idle , State::MustReset , &ServerProtocol::doBdatOutOfSequence ) ;
+	fsm( Event::Bdat , State::GotMail , State::Idle , &ServerProtocol::doNoRecipients ) ; // 1
+	fsm( Event::BdatLast , State::GotMail , State::Idle , &ServerProtocol::doNoRecipients ) ; // 2
+	fsm( Event::BdatLastZero , State::GotMail , State::Idle , &ServerProtocol::doNoRecipients ) ; // 3
+	fsm( Event::Bdat , State::GotRcpt , State::BdatData , &ServerProtocol::doBdatFirst , State::MustReset ) ; // 4
+	fsm( Event::BdatLast , State::GotRcpt , State::BdatDataLast , &ServerProtocol::doBdatFirstLast , State::MustReset ) ; // 5
+	fsm( Event::BdatLastZero , State::GotRcpt , State::BdatChecking , &ServerProtocol::doBdatFirstLastZero ) ; // 6
+	fsm( Event::BdatContent , State::BdatData , State::BdatIdle , &ServerProtocol::doBdatContent , State::BdatData ) ; // 7
+	fsm( Event::Bdat , State::BdatIdle , State::BdatData , &ServerProtocol::doBdatMore , State::MustReset ) ; // 8
+	fsm( Event::BdatLast , State::BdatIdle , State::BdatDataLast , &ServerProtocol::doBdatMoreLast , State::MustReset ) ; // 9
+	fsm( Event::BdatLastZero , State::BdatIdle , State::BdatChecking , &ServerProtocol::doBdatMoreLastZero ) ; // 10
+	fsm( Event::BdatContent , State::BdatDataLast , State::BdatChecking , &ServerProtocol::doBdatContentLast , State::BdatDataLast ) ;//11
+	fsm( Event::BdatCheck , State::BdatChecking , State::BdatProcessing , &ServerProtocol::doBdatCheck , State::Idle ) ; //12
+	fsm( Event::Done , State::BdatProcessing , State::Idle , &ServerProtocol::doBdatComplete ) ; // 13
+	fsm( Event::Eot , State::Data , State::Processing , &ServerProtocol::doEot , State::Idle ) ;
+	fsm( Event::Done , State::Processing , State::Idle , &ServerProtocol::doComplete ) ;
+	fsm( Event::Auth , State::Idle , State::Auth , &ServerProtocol::doAuth , State::Idle ) ;
+	fsm( Event::AuthData, State::Auth , State::Auth , &ServerProtocol::doAuthData , State::Idle ) ;
+	if( starttls )
+	{
+		fsm( Event::StartTls , State::Idle , State::StartingTls , &ServerProtocol::doStartTls , State::Idle ) ;
+		fsm( Event::Secure , State::StartingTls , State::Idle , &ServerProtocol::doSecure ) ;
+	}
+	else if( tls_connection )
+	{
+		fsm.reset( State::StartingTls ) ;
+		fsm( Event::Secure , State::StartingTls , State::Start , &ServerProtocol::doSecureGreeting ) ;
+	}
+	return fsm ;
 }
 
 GSmtp::ServerProtocol::~ServerProtocol()
 {
+	ServerProtocolImp::sessions_active.sub() ;
 	m_pm.processedSignal().disconnect() ;
+	m_pm.changeSignal().disconnect() ;
 	m_verifier.doneSignal().disconnect() ;
 }
 
@@ -135,8 +181,10 @@ G::Slot::Signal<> & GSmtp::ServerProtocol::changeSignal() noexcept
 bool GSmtp::ServerProtocol::inBusyState() const
 {
 	// return true if waiting for an asynchronous filter
-	// or verifier completion event
+	// or verifier completion event, or for the content
+	// backlog to be written out
 	return
+		m_pm.busy() ||
 		// states expecting Event::Done...
 		m_fsm.state() == State::Processing ||
 		// states expecting Event::VrfyReply...
@@ -207,6 +255,13 @@ void GSmtp::ServerProtocol::init()
 		sendGreeting( m_text.greeting() , m_enabled ) ;
 }
 
+void GSmtp::ServerProtocol::refuse()
+{
+	if( !m_config.tls_connection )
+		sendTooManyConnections() ;
+	m_sender->protocolShutdown( 1 ) ;
+}
+
 void GSmtp::ServerProtocol::applyEvent( Event event , EventData event_data )
 {
 	State new_state = m_fsm.apply( *this , event , event_data ) ;
@@ -362,6 +417,11 @@ void GSmtp::ServerProtocol::protocolMessageProcessed( const ProtocolMessage::Pro
 	G_DEBUG( "GSmtp::ServerProtocol::protocolMessageProcessed: ok=" << (info.success?1:0) << " msgid=" << info.id.str()
 		<< " rc=" << info.response_code << " rsp=[" << info.response << "] reason=[" << info.reason << "]" ) ;
 
+	if( info.success )
+		ServerProtocolImp::messages_accepted.add() ;
+	else
+		ServerProtocolImp::messages_rejected.add() ;
+
 	std::string response = info.response ;
 	G::Str::replace( response , '\n' , ' ' ) ;
 	if( !info.success )
@@ -373,6 +433,12 @@ void GSmtp::ServerProtocol::protocolMessageProcessed( const ProtocolMessage::Pro
 	m_change_signal.emit() ;
 }
 
+void GSmtp::ServerProtocol::protocolMessageChange()
+{
+	// the content backlog has been written out -- see inBusyState()
+	m_change_signal.emit() ;
+}
+
 void GSmtp::ServerProtocol::doComplete( EventData event_data , bool & )
 {
 	clear() ;
@@ -544,17 +610,33 @@ void GSmtp::ServerProtocol::doBdatCheck( EventData , bool & ok )
 		clear() ;
 		sendTooBig() ;
 	}
+	else if( rateLimited() )
+	{
+		ok = false ;
+		clear() ;
+		sendRateLimited() ;
+	}
 	else
 	{
 		m_pm.process( m_sasl->id() , m_peer_address.hostPartString() , m_certificate ) ;
 	}
 }
 
+bool GSmtp::ServerProtocol::rateLimited()
+{
+	// take a message token -- rejects before any filtering or storing
+	return m_rate_limiter && !m_rate_limiter->acceptMessage( m_peer_address ,
+		m_sasl->authenticated() ? m_sasl->id() : std::string() ) ;
+}
+
 bool GSmtp::ServerProtocol::messageAddContentFailed()
 {
 	bool failed = m_pm.addContent( nullptr , 0U ) == GStore::NewMessage::Status::Error ;
 	if( failed )
+	{
 		G_WARNING( "GSmtp::ServerProtocol::messageAddContentFailed: failed to save message content" ) ;
+		ServerProtocolImp::messages_rejected.add() ;
+	}
 	return failed ;
 }
 
@@ -562,7 +644,10 @@ bool GSmtp::ServerProtocol::messageAddContentTooBig()
 {
 	bool too_big = m_pm.addContent( nullptr , 0U ) == GStore::NewMessage::Status::TooBig ;
 	if( too_big )
+	{
 		G_WARNING( "GSmtp::ServerProtocol::messageAddContentTooBig: message content too big" ) ;
+		ServerProtocolImp::messages_rejected.add() ;
+	}
 	return too_big ;
 }
 
@@ -637,12 +722,14 @@ void GSmtp::ServerProtocol::verify( Verifier::Command command , const std::strin
 	request.auth_mechanism = m_sasl->authenticated() ? m_sasl->mechanism() : std::string("NONE") ;
 	request.auth_extra = m_sasl->id() ;
 	m_verifier_raw_address = request.raw_address ;
+	m_verifier_start = G::TimerTime::now() ;
 	m_verifier.verify( request ) ;
 }
 
 void GSmtp::ServerProtocol::verifyDone( Verifier::Command command , const VerifierStatus & status )
 {
 	G_DEBUG( "GSmtp::ServerProtocol::verifyDone: verify done: [" << status.str() << "]" ) ;
+	ServerProtocolImp::verifier_latency.observe( m_verifier_start ) ;
 	if( status.abort )
 		throw Done( "address verifier abort" ) ;
 
@@ -834,6 +921,12 @@ void GSmtp::ServerProtocol::doMail( EventData event_data , bool & predicate )
 		predicate = false ;
 		sendEncryptionRequired( m_with_starttls ) ;
 	}
+	else if( m_rate_limiter && !m_rate_limiter->checkMessage( m_peer_address ,
+		m_sasl->authenticated() ? m_sasl->id() : std::string() ) )
+	{
+		predicate = false ;
+		sendRateLimited() ;
+	}
 	else
 	{
 		auto mail_command = parseMailFrom( mail_line , m_config.parser_config ) ;
@@ -948,15 +1041,24 @@ void GSmtp::ServerProtocol::doNoRecipients( EventData , bool & )
 	sendNoRecipients() ;
 }
 
-void GSmtp::ServerProtocol::doData( EventData , bool & )
+void GSmtp::ServerProtocol::doData( EventData , bool & ok )
 {
-	std::string received_line = m_text.received( m_session_peer_name , m_sasl->authenticated() ,
-		m_secure , m_protocol , m_cipher ) ;
+	if( rateLimited() )
+	{
+		ok = false ;
+		clear() ;
+		sendRateLimited() ;
+	}
+	else
+	{
+		std::string received_line = m_text.received( m_session_peer_name , m_sasl->authenticated() ,
+			m_secure , m_protocol , m_cipher ) ;
 
-	if( !received_line.empty() )
-		m_pm.addReceived( received_line ) ;
+		if( !received_line.empty() )
+			m_pm.addReceived( received_line ) ;
 
-	sendDataReply() ;
+		sendDataReply() ;
+	}
 }
 
 bool GSmtp::ServerProtocol::isEndOfText( const ApplyArgsTuple & args ) const
@@ -26,6 +26,7 @@
 #include "gsmtpserverparser.h"
 #include "gsmtpserversender.h"
 #include "gsmtpserversend.h"
+#include "gratelimiter.h"
 #include "geventhandler.h"
 #include "gaddress.h"
 #include "gverifier.h"
@@ -37,6 +38,7 @@
 #include "gstringview.h"
 #include "gexception.h"
 #include "glimits.h"
+#include "gdatetime.h"
 #include <utility>
 #include <memory>
 #include <tuple>
@@ -141,7 +143,7 @@ public:
 	ServerProtocol( ServerSender & , Verifier & , ProtocolMessage & ,
 		const GAuth::SaslServerSecrets & secrets , Text & text ,
 		const GNet::Address & peer_address , const Config & config ,
-		bool enabled ) ;
+		bool enabled , RateLimiter * rate_limiter ) ;
 			///< Constructor.
 			///<
 			///< The ServerSender interface is used to send protocol responses
@@ -155,6 +157,10 @@ public:
 			///<
 			///< The Text interface is used to get informational text for
 			///< returning to the client.
+			///<
+			///< The optional RateLimiter is used to limit the rate of
+			///< incoming messages, checked at MAIL FROM and consumed
+			///< at DATA or the final BDAT.
 
 	void setSender( ServerSender & ) ;
 		///< Sets the ServerSender interface, overriding the constructor
@@ -166,6 +172,11 @@ public:
 		///< send the plaintext SMTP greeting or start the TLS
 		///< handshake.
 
+	void refuse() ;
+		///< Refuses the session, as an alternative to init(). Sends
+		///< a 421 response in place of the greeting (unless using
+		///< smtps) and shuts down the connection for writing.
+
 	~ServerProtocol() override ;
 		///< Destructor.
 
@@ -179,7 +190,8 @@ public:
 	bool inBusyState() const ;
 		///< Returns true if in a state where the protocol is
 		///< waiting for an asynchronous filter of address-verifier
-		///< to complete. A call to apply() will throw an exception
+		///< to complete, or if the ProtocolMessage is busy() writing
+		///< out content. A call to apply() will throw an exception
 		///< when in this state.
 
 	bool apply( const ApplyArgsTuple & ) ;
@@ -291,6 +303,8 @@ private:
 		std::string auth ;
 	} ;
 	static std::unique_ptr<GAuth::SaslServer> newSaslServer( const GAuth::SaslServerSecrets & , const std::string & , const std::string & ) ;
+	static const Fsm & sharedFsm( const Config & ) ;
+	static Fsm newFsm( bool starttls , bool tls_connection ) ;
 	static int code( EventData ) ;
 	static std::string str( EventData ) ;
 	void applyEvent( Event , EventData = {} ) ;
@@ -304,6 +318,7 @@ private:
 	bool messageAddContentTooBig() ;
 	void badClientEvent() ;
 	void protocolMessageProcessed( const ProtocolMessage::ProcessedInfo & ) ;
+	void protocolMessageChange() ;
 	bool rcptState() const ;
 	bool flush() const ;
 	bool isEndOfText( const ApplyArgsTuple & ) const ;
@@ -351,6 +366,7 @@ private:
 	void verify( Verifier::Command , const std::string & , const std::string & = {} , const std::string & = {} ) ;
 	void warnInvalidSpaces() const ;
 	void warnNoBrackets() const ;
+	bool rateLimited() ;
 	static void warning( const std::string & ) ;
 
 private:
@@ -368,6 +384,7 @@ private:
 	GNet::Address m_peer_address ;
 	bool m_secure {false} ;
 	std::string m_verifier_raw_address ;
+	G::TimerTime m_verifier_start {G::TimerTime::zero()} ;
 	std::string m_certificate ;
 	std::string m_protocol ;
 	std::string m_cipher ;
@@ -377,6 +394,7 @@ private:
 	std::size_t m_bdat_arg {0U} ;
 	std::size_t m_bdat_sum {0U} ;
 	bool m_enabled ;
+	RateLimiter * m_rate_limiter ;
 } ;
 
 inline GSmtp::ServerProtocol::Config & GSmtp::ServerProtocol::Config::set_with_vrfy( bool b ) noexcept { with_vrfy = b ; return *this ; }
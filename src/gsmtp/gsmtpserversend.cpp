@@ -151,6 +151,16 @@ void GSmtp::ServerSend::sendDisabled()
 	send( "421 service not available" ) ;
 }
 
+void GSmtp::ServerSend::sendTooManyConnections()
+{
+	send( "421 too many connections: try again later" ) ;
+}
+
+void GSmtp::ServerSend::sendRateLimited()
+{
+	send( "451 too many messages: try again later" ) ;
+}
+
 void GSmtp::ServerSend::sendEncryptionRequired( bool with_starttls_help )
 {
 	if( with_starttls_help )
@@ -97,6 +97,8 @@ protected:
 	void sendAuthenticationCancelled() ;
 	void sendAuthRequired( bool = false ) ;
 	void sendDisabled() ;
+	void sendTooManyConnections() ;
+	void sendRateLimited() ;
 	void sendNoRecipients() ;
 	void sendMissingParameter() ;
 	void sendVerified( const std::string & ) ;
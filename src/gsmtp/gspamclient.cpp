@@ -26,6 +26,7 @@
 #include "gspamclient.h"
 #include "glog.h"
 #include <sstream>
+#include <algorithm>
 
 std::string GSmtp::SpamClient::m_username ;
 
@@ -37,7 +38,7 @@ GSmtp::SpamClient::SpamClient( GNet::EventState es , const GNet::Location & loca
 				.set_connection_timeout(connection_timeout)
 				.set_response_timeout(response_timeout)) ,
 		m_timer(*this,&SpamClient::onTimeout,es) ,
-		m_request(*this) ,
+		m_request(*this,read_only) ,
 		m_response(read_only)
 {
 	G_LOG( "GSmtp::SpamClient::ctor: spam connection to [" << location << "]" ) ;
@@ -112,8 +113,9 @@ bool GSmtp::SpamClient::onReceive( const char * line_data , std::size_t line_siz
 
 // ==
 
-GSmtp::SpamClient::Request::Request( Client & client ) :
+GSmtp::SpamClient::Request::Request( Client & client , bool read_only ) :
 	m_client(&client) ,
+	m_read_only(read_only) ,
 	m_buffer(10240U)
 {
 }
@@ -121,16 +123,20 @@ GSmtp::SpamClient::Request::Request( Client & client ) :
 void GSmtp::SpamClient::Request::send( const std::string & path , const std::string & username )
 {
 	G_LOG( "GSmtp::SpamClient::Request::send: spam request for [" << path << "]" ) ;
-	G::File::open( m_stream , path ) ;
-	if( !m_stream.good() )
-		throw SpamClient::Error( "cannot read content file" , path ) ;
+	m_mapped_pos = 0U ;
+	if( !m_mapped.map( G::Path(path) ) )
+	{
+		G::File::open( m_stream , path ) ;
+		if( !m_stream.good() )
+			throw SpamClient::Error( "cannot read content file" , path ) ;
+	}
 
 	std::string file_size = G::File::sizeString(path) ;
 	G_DEBUG( "GSmtp::SpamClient::Request::send: spam request file size: " << file_size ) ;
 
 	std::ostringstream ss ;
 	std::string eol = "\r\n" ;
-	ss << "PROCESS SPAMC/1.4" << eol ;
+	ss << (m_read_only?"CHECK":"PROCESS") << " SPAMC/1.4" << eol ; // no content in CHECK responses
 	if( !username.empty() )
 		ss << "User: " << username << eol ;
 	ss << "Content-length: " << file_size << eol ;
@@ -146,6 +152,22 @@ void GSmtp::SpamClient::Request::send( const std::string & path , const std::str
 
 bool GSmtp::SpamClient::Request::sendMore()
 {
+	if( m_mapped.mapped() )
+	{
+		// send from the mapped file in buffer-sized pieces so that
+		// flow-control only ever holds back a small residue
+		std::string_view data = m_mapped.view().substr( std::min(m_mapped_pos,m_mapped.view().size()) , m_buffer.size() ) ;
+		if( data.empty() )
+		{
+			G_LOG( "GSmtp::SpamClient::Request::sendMore: spam request done" ) ;
+			m_mapped.unmap() ;
+			return false ;
+		}
+		G_DEBUG( "GSmtp::SpamClient::Request::sendMore: spam request sending " << data.size() << " mapped bytes" ) ;
+		m_mapped_pos += data.size() ;
+		return m_client->send( data ) ;
+	}
+
 	m_stream.read( m_buffer.data() , m_buffer.size() ) ; // NOLINT narrowing
 	std::streamsize n = m_stream.gcount() ;
 	if( n <= 0 )
@@ -210,6 +232,8 @@ void GSmtp::SpamClient::Response::add( const std::string & path , const std::str
 			m_result = G::Str::trimmed( line.substr(5U) , G::Str::ws() ) ;
 		else if( G::Str::imatch(line.substr(0U,15U),"Content-length:") )
 			m_content_length = G::Str::toUInt( G::Str::trimmed(line.substr(15U),G::Str::ws()) ) ;
+		else if( ( line.empty() || line == "\r" ) && m_read_only )
+			m_state = 3 ;
 		else if( ( line.empty() || line == "\r" ) && m_content_length == 0U )
 			throw SpamClient::Error( "invalid response headers" ) ;
 		else if( line.empty() || line == "\r" )
@@ -27,6 +27,7 @@
 #include "gpath.h"
 #include "gslot.h"
 #include "gexception.h"
+#include "gmappedfile.h"
 #include "geventstate.h"
 #include <fstream>
 #include <vector>
@@ -56,7 +57,8 @@ public:
 		///< Starts sending a request that comprises a few http-like header
 		///< lines followed by the contents of the given file. The response
 		///< is spooled into a temporary file and then committed back to the
-		///< same file.
+		///< same file. In read-only mode the request is a "CHECK" rather
+		///< than a "PROCESS" so the response has no content.
 		///<
 		///< The base class's "event" signal will be emitted when processing
 		///< is complete. In this case the first signal parameter will "spam"
@@ -92,13 +94,16 @@ private:
 private:
 	struct Request
 	{
-		explicit Request( Client & ) ;
+		Request( Client & , bool read_only ) ;
 		void send( const std::string & path , const std::string & username ) ;
 		bool sendMore() ;
 		Client * m_client ;
+		bool m_read_only ;
 		std::ifstream m_stream ;
 		std::string m_size ;
 		std::vector<char> m_buffer ;
+		G::MappedFile m_mapped ;
+		std::size_t m_mapped_pos {0U} ;
 	} ;
 	struct Response
 	{
@@ -27,6 +27,14 @@
 
 GSsl::Library * GSsl::Library::m_this = nullptr ;
 
+namespace GSsl
+{
+	namespace LibraryLog
+	{
+		thread_local Library::LogLines * capture = nullptr ;
+	}
+}
+
 GSsl::Library::Library( bool active , const std::string & library_config , LogFn log_fn , bool verbose )
 {
 	if( m_this == nullptr )
@@ -122,7 +130,9 @@ const GSsl::LibraryImpBase & GSsl::Library::imp() const
 
 void GSsl::Library::log( int level , const std::string & log_line )
 {
-	if( level == 1 )
+	if( LibraryLog::capture != nullptr )
+		LibraryLog::capture->emplace_back( level , log_line ) ;
+	else if( level == 1 )
 		G_DEBUG( "GSsl::Library::log: tls: " << log_line ) ;
 	else if( level == 2 )
 		G_LOG( "GSsl::Library::log: tls: " << log_line ) ;
@@ -130,6 +140,16 @@ void GSsl::Library::log( int level , const std::string & log_line )
 		G_WARNING( "GSsl::Library::log: tls: " << log_line ) ;
 }
 
+void GSsl::Library::capture( LogLines * lines ) noexcept
+{
+	LibraryLog::capture = lines ;
+}
+
+bool GSsl::Library::threadSafe() const
+{
+	return m_imp != nullptr && m_imp->threadSafe() ;
+}
+
 G::StringArray GSsl::Library::digesters( bool require_state )
 {
 	return instance() == nullptr || instance()->m_imp == nullptr ? G::StringArray() : impstance().digesters(require_state) ;
@@ -140,6 +160,11 @@ GSsl::Digester GSsl::Library::digester( const std::string & hash_function , cons
 	return impstance().digester( hash_function , state , need_state ) ;
 }
 
+GSsl::Signer GSsl::Library::signer( const std::string & key_file ) const
+{
+	return impstance().signer( key_file ) ;
+}
+
 // ==
 
 GSsl::Protocol::Protocol( const Profile & profile , const std::string & peer_certificate_name , const std::string & peer_host_name ) :
@@ -252,6 +277,23 @@ std::size_t GSsl::Digester::statesize() const noexcept
 
 // ==
 
+GSsl::Signer::Signer( std::unique_ptr<SignerImpBase> p ) :
+	m_imp(p.release())
+{
+}
+
+std::string GSsl::Signer::algorithm() const
+{
+	return m_imp->algorithm() ;
+}
+
+std::string GSsl::Signer::sign( std::string_view hash , const std::string & hash_name ) const
+{
+	return m_imp->sign( hash , hash_name ) ;
+}
+
+// ==
+
 bool GSsl::LibraryImpBase::consume( G::StringArray & list , std::string_view key )
 {
 	auto p = std::find( list.begin() , list.end() , G::sv_to_string(key) ) ;
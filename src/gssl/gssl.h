@@ -31,6 +31,7 @@
 #include <string>
 #include <memory>
 #include <utility>
+#include <vector>
 
 namespace GSsl
 {
@@ -38,9 +39,11 @@ namespace GSsl
 	class Profile ;
 	class Protocol ;
 	class Digester ;
+	class Signer ;
 	class LibraryImpBase ;
 	class ProtocolImpBase ;
 	class DigesterImpBase ;
+	class SignerImpBase ;
 }
 
 //| \class GSsl::Protocol
@@ -245,6 +248,32 @@ private:
 	std::shared_ptr<DigesterImpBase> m_imp ;
 } ;
 
+//| \class GSsl::Signer
+/// A class for objects that can make a digital signature over a
+/// hash value using a private key. Instances are created by the
+/// Library::signer() factory method and can then be copied around,
+/// with copies sharing the same key. Signing does not modify the key
+/// so copies can be used concurrently if the library is threadSafe().
+///
+class GSsl::Signer
+{
+public:
+	explicit Signer( std::unique_ptr<SignerImpBase> ) ;
+		///< Constructor, used by the Library class.
+
+	std::string algorithm() const ;
+		///< Returns the key's signature algorithm, "rsa" or "ed25519".
+
+	std::string sign( std::string_view hash , const std::string & hash_name ) const ;
+		///< Returns the binary signature of the given hash value,
+		///< where the hash was calculated by the named hash function,
+		///< eg. "SHA256". RSA signatures are PKCS#1 v1.5. For Ed25519
+		///< the hash value itself is signed, as in RFC-8463.
+
+private:
+	std::shared_ptr<SignerImpBase> m_imp ;
+} ;
+
 //| \class GSsl::Library
 /// A singleton class for initialising the underlying TLS library.
 /// The library is configured with one or more named "profiles", and
@@ -257,6 +286,7 @@ public:
 	G_EXCEPTION( NoInstance , tx("no tls library object") )
 	G_EXCEPTION( BadProfileName , tx("invalid tls profile name") )
 	using LogFn = void (*)(int, const std::string &) ;
+	using LogLines = std::vector<std::pair<int,std::string>> ;
 
 	explicit Library( bool active = true , const std::string & library_config = {} ,
 		LogFn = Library::log , bool verbose = true ) ;
@@ -279,6 +309,16 @@ public:
 		///< will be no level 1 logging if the constructor's 'verbose'
 		///< flag was false.
 
+	static void capture( LogLines * ) noexcept ;
+		///< Diverts log() output from the calling thread into the given
+		///< list, or stops diverting if null. This allows Protocol
+		///< methods to be called from a worker thread, with the log
+		///< lines replayed through log() by the main thread.
+
+	bool threadSafe() const ;
+		///< Returns true if separate Protocol objects can be used
+		///< concurrently from different threads.
+
 	static Library * instance() ;
 		///< Returns a pointer to a library object, if any.
 
@@ -361,6 +401,10 @@ public:
 	Digester digester( const std::string & name , const std::string & state = {} , bool need_state = false ) const ;
 		///< Returns a digester object.
 
+	Signer signer( const std::string & key_file ) const ;
+		///< Returns a signer object using the private key in the
+		///< given PEM file. Throws on error.
+
 public:
 	Library( const Library & ) = delete ;
 	Library( Library && ) = delete ;
@@ -406,6 +450,12 @@ public:
 	virtual Digester digester( const std::string & , const std::string & , bool ) const = 0 ;
 		///< Implements Library::digester().
 
+	virtual Signer signer( const std::string & ) const = 0 ;
+		///< Implements Library::signer().
+
+	virtual bool threadSafe() const = 0 ;
+		///< Implements Library::threadSafe().
+
 	static bool consume( G::StringArray & list , std::string_view item ) ;
 		///< A convenience function that removes the item from
 		///< the list and returns true iff is was removed.
@@ -493,4 +543,20 @@ public:
 		///< Implements Digester::statesize().
 } ;
 
+//| \class GSsl::SignerImpBase
+/// A base interface for GSsl::Signer pimple classes.
+///
+class GSsl::SignerImpBase
+{
+public:
+	virtual ~SignerImpBase() = default ;
+		///< Destructor.
+
+	virtual std::string algorithm() const = 0 ;
+		///< Implements Signer::algorithm().
+
+	virtual std::string sign( std::string_view , const std::string & ) const = 0 ;
+		///< Implements Signer::sign().
+} ;
+
 #endif
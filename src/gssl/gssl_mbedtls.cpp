@@ -167,6 +167,16 @@ GSsl::Digester GSsl::MbedTls::LibraryImp::digester( const std::string & hash_typ
 	return Digester( std::make_unique<DigesterImp>(hash_type,state,need_state) ) ;
 }
 
+GSsl::Signer GSsl::MbedTls::LibraryImp::signer( const std::string & key_file ) const
+{
+	return Signer( std::make_unique<SignerImp>(key_file,rng()) ) ;
+}
+
+bool GSsl::MbedTls::LibraryImp::threadSafe() const
+{
+	return false ; // the rng is shared and not locked
+}
+
 // ==
 
 GSsl::MbedTls::Config::Config( G::StringArray & config ) :
@@ -1106,3 +1116,34 @@ std::string GSsl::MbedTls::Error::format( const std::string & fnname , int rc ,
 	return ss.str() ;
 }
 
+// ==
+
+GSsl::MbedTls::SignerImp::SignerImp( const std::string & key_file , const Rng & rng ) :
+	m_rng(rng) ,
+	m_key(std::make_unique<Key>())
+{
+	m_key->load( key_file , rng ) ;
+	if( !mbedtls_pk_can_do( m_key->ptr() , MBEDTLS_PK_RSA ) )
+		throw Error( "unsupported private key type: " + key_file ) ;
+}
+
+std::string GSsl::MbedTls::SignerImp::algorithm() const
+{
+	return "rsa" ;
+}
+
+std::string GSsl::MbedTls::SignerImp::sign( std::string_view hash , const std::string & hash_name ) const
+{
+	const mbedtls_md_info_t * info = mbedtls_md_info_from_string( hash_name.c_str() ) ;
+	if( info == nullptr )
+		throw Error( "unsupported hash function name: " + hash_name ) ;
+
+	std::vector<unsigned char> buffer( MBEDTLS_MPI_MAX_SIZE ) ;
+	std::size_t n = 0U ;
+	int rc = call_fn( mbedtls_pk_sign , m_key->ptr() , mbedtls_md_get_type(info) ,
+		reinterpret_cast<const unsigned char*>(hash.data()) , hash.size() ,
+		buffer.data() , buffer.size() , &n , mbedtls_ctr_drbg_random , m_rng.ptr() ) ;
+	if( rc != 0 )
+		throw Error( "mbedtls_pk_sign" , rc ) ;
+	return { reinterpret_cast<const char*>(buffer.data()) , n } ;
+}
@@ -45,6 +45,7 @@ namespace GSsl
 		class ProfileImp ;
 		class ProtocolImp ;
 		class DigesterImp ;
+		class SignerImp ;
 		class Config ;
 	}
 }
@@ -233,6 +234,8 @@ private: // overrides
 	std::string id() const override ;
 	G::StringArray digesters( bool ) const override ;
 	Digester digester( const std::string & , const std::string & , bool ) const override ;
+	Signer signer( const std::string & ) const override ;
+	bool threadSafe() const override ;
 
 public:
 	LibraryImp( const LibraryImp & ) = delete ;
@@ -388,4 +391,29 @@ private:
 	std::size_t m_state_size{20U} ;
 } ;
 
+//| \class GSsl::MbedTls::SignerImp
+/// An implementation of the GSsl::SignerImpBase interface for MbedTls.
+/// Only RSA keys are supported.
+///
+class GSsl::MbedTls::SignerImp : public GSsl::SignerImpBase
+{
+public:
+	SignerImp( const std::string & key_file , const Rng & ) ;
+
+private: // overrides
+	std::string algorithm() const override ;
+	std::string sign( std::string_view , const std::string & ) const override ;
+
+public:
+	~SignerImp() override = default ;
+	SignerImp( const SignerImp & ) = delete ;
+	SignerImp( SignerImp && ) = delete ;
+	SignerImp & operator=( const SignerImp & ) = delete ;
+	SignerImp & operator=( SignerImp && ) = delete ;
+
+private:
+	const Rng & m_rng ;
+	std::unique_ptr<Key> m_key ;
+} ;
+
 #endif
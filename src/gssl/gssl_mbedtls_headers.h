@@ -69,5 +69,7 @@
 #include <mbedtls/sha1.h>
 #include <mbedtls/sha256.h>
 #include <mbedtls/sha512.h>
+#include <mbedtls/md.h>
+#include <mbedtls/pk.h>
 
 #endif
@@ -105,6 +105,28 @@ namespace GSsl
 			return fn( c , k , ks , p , ps , r , rp ) ;
 		}
 
+		// calls mbedtls_pk_sign() with or without the v3 signature buffer size parameter
+		using old_sign_fn = int (*)( mbedtls_pk_context * c , mbedtls_md_type_t md ,
+			const unsigned char * h , std::size_t hs , unsigned char * s , std::size_t * sn ,
+			int (*r)(void*,unsigned char*,std::size_t) , void * rp ) ;
+		using new_sign_fn = int (*)( mbedtls_pk_context * c , mbedtls_md_type_t md ,
+			const unsigned char * h , std::size_t hs , unsigned char * s , std::size_t ss , std::size_t * sn ,
+			int (*r)(void*,unsigned char*,std::size_t) , void * rp ) ;
+		inline int call_fn( old_sign_fn fn ,
+			mbedtls_pk_context * c , mbedtls_md_type_t md ,
+			const unsigned char * h , std::size_t hs , unsigned char * s , std::size_t , std::size_t * sn ,
+			int (*r)(void*,unsigned char*,std::size_t) , void * rp )
+		{
+			return fn( c , md , h , hs , s , sn , r , rp ) ;
+		}
+		inline int call_fn( new_sign_fn fn ,
+			mbedtls_pk_context * c , mbedtls_md_type_t md ,
+			const unsigned char * h , std::size_t hs , unsigned char * s , std::size_t ss , std::size_t * sn ,
+			int (*r)(void*,unsigned char*,std::size_t) , void * rp )
+		{
+			return fn( c , md , h , hs , s , ss , sn , r , rp ) ;
+		}
+
 		inline void call_mbedtls_ssl_conf_min_version( mbedtls_ssl_config * conf , int major , int minor )
 		{
 			#if GCONFIG_HAVE_MBEDTLS_SSL_CONF_MIN_MAX_TLS_VERSION
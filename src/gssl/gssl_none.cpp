@@ -42,6 +42,15 @@ void GSsl::Library::log( int , const std::string & )
 {
 }
 
+void GSsl::Library::capture( LogLines * ) noexcept
+{
+}
+
+bool GSsl::Library::threadSafe() const
+{
+	return false ;
+}
+
 bool GSsl::Library::real()
 {
 	return false ;
@@ -103,6 +112,11 @@ GSsl::Digester GSsl::Library::digester( const std::string & , const std::string
 	//return Digester( nullptr ) ; // never gets here
 }
 
+GSsl::Signer GSsl::Library::signer( const std::string & ) const
+{
+	throw G::Exception( "no tls library built in" ) ;
+}
+
 // ==
 
 GSsl::Protocol::Protocol( const Profile & , const std::string & , const std::string & )
@@ -203,3 +217,19 @@ std::size_t GSsl::Digester::statesize() const noexcept
 	return 0U ;
 }
 
+// ==
+
+GSsl::Signer::Signer( std::unique_ptr<SignerImpBase> p ) :
+	m_imp(p.release())
+{
+}
+
+std::string GSsl::Signer::algorithm() const
+{
+	return {} ;
+}
+
+std::string GSsl::Signer::sign( std::string_view , const std::string & ) const
+{
+	return {} ;
+}
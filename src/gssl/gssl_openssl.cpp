@@ -31,6 +31,7 @@
 #include "gfile.h"
 #include "groot.h"
 #include "gexception.h"
+#include "gmetrics.h"
 #include "glog.h"
 #include <exception>
 #include <functional>
@@ -40,6 +41,16 @@
 #include <algorithm>
 #include <memory>
 
+namespace GSsl
+{
+	namespace OpenSSLImp
+	{
+		G::Metrics::Counter ktls_send( "emailrelay_tls_ktls_sessions_total" , "offload=\"send\"" , "TLS sessions with kernel TLS enabled" ) ;
+		G::Metrics::Counter ktls_receive( "emailrelay_tls_ktls_sessions_total" , "offload=\"receive\"" , "TLS sessions with kernel TLS enabled" ) ;
+		G::Metrics::Counter ktls_none( "emailrelay_tls_ktls_sessions_total" , "offload=\"none\"" , "TLS sessions with kernel TLS enabled" ) ;
+	}
+}
+
 GSsl::OpenSSL::LibraryImp::LibraryImp( G::StringArray & library_config , Library::LogFn log_fn , bool verbose ) :
 	m_log_fn(log_fn) ,
 	m_verbose(verbose) ,
@@ -149,6 +160,20 @@ GSsl::Digester GSsl::OpenSSL::LibraryImp::digester( const std::string & hash_typ
 	return Digester( std::make_unique<GSsl::OpenSSL::DigesterImp>(hash_type,state,need_state) ) ;
 }
 
+GSsl::Signer GSsl::OpenSSL::LibraryImp::signer( const std::string & key_file ) const
+{
+	return Signer( std::make_unique<GSsl::OpenSSL::SignerImp>(key_file) ) ;
+}
+
+bool GSsl::OpenSSL::LibraryImp::threadSafe() const
+{
+	#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+		return true ; // no locking callbacks needed from v1.1
+	#else
+		return false ;
+	#endif
+}
+
 GSsl::OpenSSL::DigesterImp::DigesterImp( const std::string & hash_type , const std::string & state , bool need_state )
 {
 	bool have_state = !state.empty() ;
@@ -293,6 +318,89 @@ std::string GSsl::OpenSSL::DigesterImp::value()
 
 // ==
 
+GSsl::OpenSSL::SignerImp::SignerImp( const std::string & key_file )
+{
+	{
+		G::Root claim_root ;
+		BIO * bio = BIO_new_file( key_file.c_str() , "r" ) ;
+		if( bio == nullptr )
+			throw Error( "BIO_new_file" , ERR_get_error() , key_file ) ;
+		m_pkey = PEM_read_bio_PrivateKey( bio , nullptr , nullptr , nullptr ) ;
+		BIO_free( bio ) ;
+	}
+	if( m_pkey == nullptr )
+		throw Error( "PEM_read_bio_PrivateKey" , ERR_get_error() , key_file ) ;
+
+	int type = EVP_PKEY_base_id( m_pkey ) ;
+	#ifdef EVP_PKEY_ED25519
+	m_ed25519 = type == EVP_PKEY_ED25519 ;
+	#endif
+	if( type != EVP_PKEY_RSA && !m_ed25519 )
+	{
+		EVP_PKEY_free( m_pkey ) ;
+		throw Error( std::string("unsupported private key type: [").append(key_file).append(1U,']') ) ;
+	}
+}
+
+GSsl::OpenSSL::SignerImp::~SignerImp()
+{
+	EVP_PKEY_free( m_pkey ) ;
+}
+
+std::string GSsl::OpenSSL::SignerImp::algorithm() const
+{
+	return m_ed25519 ? "ed25519" : "rsa" ;
+}
+
+std::string GSsl::OpenSSL::SignerImp::sign( std::string_view hash , const std::string & hash_name ) const
+{
+	return m_ed25519 ? signEd25519( hash ) : signRsa( hash , hash_name ) ;
+}
+
+std::string GSsl::OpenSSL::SignerImp::signRsa( std::string_view hash , const std::string & hash_name ) const
+{
+	const EVP_MD * md = EVP_get_digestbyname( hash_name.c_str() ) ;
+	if( md == nullptr )
+		throw Error( std::string("unsupported hash function name: [").append(hash_name).append(1U,']') ) ;
+
+	std::unique_ptr<EVP_PKEY_CTX,void(*)(EVP_PKEY_CTX*)> ctx( EVP_PKEY_CTX_new(m_pkey,nullptr) , EVP_PKEY_CTX_free ) ;
+	if( ctx == nullptr || EVP_PKEY_sign_init(ctx.get()) <= 0 ||
+		EVP_PKEY_CTX_set_rsa_padding(ctx.get(),RSA_PKCS1_PADDING) <= 0 ||
+		EVP_PKEY_CTX_set_signature_md(ctx.get(),md) <= 0 )
+			throw Error( "EVP_PKEY_sign_init" , ERR_get_error() ) ;
+
+	const auto * p = reinterpret_cast<const unsigned char*>( hash.data() ) ;
+	std::size_t n = 0U ;
+	if( EVP_PKEY_sign( ctx.get() , nullptr , &n , p , hash.size() ) <= 0 )
+		throw Error( "EVP_PKEY_sign" , ERR_get_error() ) ;
+	std::vector<unsigned char> buffer( n ) ;
+	if( EVP_PKEY_sign( ctx.get() , buffer.data() , &n , p , hash.size() ) <= 0 )
+		throw Error( "EVP_PKEY_sign" , ERR_get_error() ) ;
+	return { reinterpret_cast<const char*>(buffer.data()) , n } ;
+}
+
+std::string GSsl::OpenSSL::SignerImp::signEd25519( std::string_view hash ) const
+{
+	#ifdef EVP_PKEY_ED25519
+	std::unique_ptr<EVP_MD_CTX,void(*)(EVP_MD_CTX*)> ctx( EVP_MD_CTX_new() , EVP_MD_CTX_free ) ;
+	if( ctx == nullptr || EVP_DigestSignInit(ctx.get(),nullptr,nullptr,nullptr,m_pkey) <= 0 )
+		throw Error( "EVP_DigestSignInit" , ERR_get_error() ) ;
+
+	const auto * p = reinterpret_cast<const unsigned char*>( hash.data() ) ;
+	std::size_t n = 0U ;
+	if( EVP_DigestSign( ctx.get() , nullptr , &n , p , hash.size() ) <= 0 )
+		throw Error( "EVP_DigestSign" , ERR_get_error() ) ;
+	std::vector<unsigned char> buffer( n ) ;
+	if( EVP_DigestSign( ctx.get() , buffer.data() , &n , p , hash.size() ) <= 0 )
+		throw Error( "EVP_DigestSign" , ERR_get_error() ) ;
+	return { reinterpret_cast<const char*>(buffer.data()) , n } ;
+	#else
+	throw Error( "ed25519 not supported" ) ;
+	#endif
+}
+
+// ==
+
 GSsl::OpenSSL::ProfileImp::ProfileImp( const LibraryImp & library_imp , bool is_server_profile ,
 	const std::string & key_file , const std::string & cert_file , const std::string & ca_path ,
 	const std::string & default_peer_certificate_name , const std::string & default_peer_host_name ,
@@ -615,6 +723,32 @@ void GSsl::OpenSSL::ProtocolImp::saveResult()
 	m_peer_certificate = Certificate(SSL_get_peer_certificate(m_ssl.get()),true).str() ;
 	m_peer_certificate_chain = CertificateChain(SSL_get_peer_cert_chain(m_ssl.get())).str() ;
 	m_verified = !m_peer_certificate.empty() && SSL_get_verify_result(m_ssl.get()) == X509_V_OK ;
+	checkOffload() ;
+}
+
+void GSsl::OpenSSL::ProtocolImp::checkOffload()
+{
+	// kernel tls is only used if the kernel supports the negotiated
+	// cipher, otherwise openssl quietly falls back to user-space
+	// encryption -- so check what actually happened
+	#ifdef SSL_OP_ENABLE_KTLS
+	if( ( SSL_get_options(m_ssl.get()) & SSL_OP_ENABLE_KTLS ) != 0 )
+	{
+		namespace imp = OpenSSLImp ;
+		bool send = BIO_get_ktls_send( SSL_get_wbio(m_ssl.get()) ) != 0 ;
+		bool receive = BIO_get_ktls_recv( SSL_get_rbio(m_ssl.get()) ) != 0 ;
+		if( send ) imp::ktls_send.add() ;
+		if( receive ) imp::ktls_receive.add() ;
+		if( !send && !receive ) imp::ktls_none.add() ;
+		if( m_log_fn != nullptr )
+		{
+			std::ostringstream ss ;
+			ss << "kernel tls offload: " << (send&&receive?"send and receive":(send?"send only":(receive?"receive only":"none")))
+				<< " (" << protocol() << " " << cipher() << ")" ;
+			(*m_log_fn)( 2 , ss.str() ) ; // 2 => verbose
+		}
+	}
+	#endif
 }
 
 GSsl::Protocol::Result GSsl::OpenSSL::ProtocolImp::shutdown()
@@ -867,6 +1001,10 @@ GSsl::OpenSSL::Config::Config( G::StringArray & cfg ) :
 	#ifdef SSL_OP_CIPHER_SERVER_PREFERENCE
 		if( consume(cfg,"op_server_preference") ) m_options_set |= SSL_OP_CIPHER_SERVER_PREFERENCE ;
 	#endif
+
+	#ifdef SSL_OP_ENABLE_KTLS
+		if( consume(cfg,"ktls") ) m_options_set |= SSL_OP_ENABLE_KTLS ;
+	#endif
 }
 
 bool GSsl::OpenSSL::Config::consume( G::StringArray & list , std::string_view item )
@@ -33,6 +33,7 @@
 #include <openssl/md5.h>
 #include <openssl/sha.h>
 #include <openssl/hmac.h>
+#include <openssl/pem.h>
 #include <memory>
 #include <stdexcept>
 #include <functional>
@@ -75,6 +76,7 @@ namespace GSsl
 		class ProfileImp ;
 		class ProtocolImp ;
 		class DigesterImp ;
+		class SignerImp ;
 		class Config ;
 	}
 }
@@ -220,6 +222,8 @@ private: // overrides
 	std::string id() const override ;
 	G::StringArray digesters( bool ) const override ;
 	Digester digester( const std::string & , const std::string & , bool ) const override ;
+	Signer signer( const std::string & ) const override ;
+	bool threadSafe() const override ;
 
 public:
 	LibraryImp( const LibraryImp & ) = delete ;
@@ -282,6 +286,7 @@ private:
 	static void clearErrors() ;
 	void logErrors( const std::string & op , int rc , int e , const std::string & ) const ;
 	void saveResult() ;
+	void checkOffload() ;
 	static void deleter( SSL * ) ;
 
 private:
@@ -332,4 +337,32 @@ private:
 	std::size_t m_state_size {0U} ;
 } ;
 
+//| \class GSsl::OpenSSL::SignerImp
+/// An implementation of the GSsl::SignerImpBase interface for OpenSSL.
+///
+class GSsl::OpenSSL::SignerImp : public GSsl::SignerImpBase
+{
+public:
+	explicit SignerImp( const std::string & key_file ) ;
+	~SignerImp() override ;
+
+private: // overrides
+	std::string algorithm() const override ;
+	std::string sign( std::string_view , const std::string & ) const override ;
+
+public:
+	SignerImp( const SignerImp & ) = delete ;
+	SignerImp( SignerImp && ) = delete ;
+	SignerImp & operator=( const SignerImp & ) = delete ;
+	SignerImp & operator=( SignerImp && ) = delete ;
+
+private:
+	std::string signRsa( std::string_view , const std::string & ) const ;
+	std::string signEd25519( std::string_view ) const ;
+
+private:
+	EVP_PKEY * m_pkey {nullptr} ;
+	bool m_ed25519 {false} ;
+} ;
+
 #endif
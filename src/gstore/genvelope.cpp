@@ -110,6 +110,44 @@ void GStore::Envelope::copyExtra( std::istream & in , std::ostream & out )
 	in.clear( std::ios_base::eofbit ) ; // clear failbit
 }
 
+void GStore::Envelope::readExtra( std::istream & in , Envelope & e )
+{
+	// eg. "X-MailRelay-Retry: 2 1700000000"
+	// eg. "X-MailRelay-Digest: sha256-0123abcd..."
+	const std::string prefix = FileStore::x().append("Retry: ") ;
+	const std::string digest_prefix = FileStore::x().append("Digest: ") ;
+	std::string line ;
+	while( G::Str::readLine( in , line ) )
+	{
+		if( G::Str::headMatch( line , prefix ) )
+		{
+			G::StringArray part = G::Str::splitIntoTokens( line.substr(prefix.size()) , G::Str::ws() ) ;
+			if( part.size() >= 2U && G::Str::isUInt(part[0]) && G::Str::isULong(part[1]) )
+			{
+				e.retry_count = G::Str::toUInt( part[0] ) ;
+				e.retry_time = static_cast<std::time_t>( G::Str::toULong(part[1]) ) ;
+			}
+		}
+		else if( G::Str::headMatch( line , digest_prefix ) )
+		{
+			std::string digest = G::Str::trimmed( line.substr(digest_prefix.size()) , G::Str::ws() ) ;
+			if( !digest.empty() && digest.find_first_not_of("0123456789abcdefghijklmnopqrstuvwxyz-") == std::string::npos )
+				e.digest = digest ;
+		}
+	}
+	in.clear( std::ios_base::eofbit ) ; // clear failbit
+}
+
+void GStore::Envelope::writeRetry( std::ostream & out , const Envelope & e )
+{
+	out << FileStore::x() << "Retry: " << e.retry_count << " " << static_cast<unsigned long>(e.retry_time) << "\r\n" ;
+}
+
+void GStore::Envelope::writeDigest( std::ostream & out , const Envelope & e )
+{
+	out << FileStore::x() << "Digest: " << e.digest << "\r\n" ;
+}
+
 void GStore::Envelope::read( std::istream & stream , GStore::Envelope & e )
 {
 	namespace imp = GStore::EnvelopeImp ;
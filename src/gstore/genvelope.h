@@ -27,6 +27,7 @@
 #include "gstringview.h"
 #include "gexception.h"
 #include <iostream>
+#include <ctime>
 
 namespace GStore
 {
@@ -62,6 +63,20 @@ public:
 		///< can be newline delimited, but output is always CR-LF.
 		///< Throws on input error; output errors are not checked.
 
+	static void readExtra( std::istream & , Envelope & ) ;
+		///< Reads the extra envelope lines that follow the 'End'
+		///< field, picking out the retry fields from the last
+		///< 'Retry' line and the digest from the 'Digest' line,
+		///< if any. Does not throw.
+
+	static void writeRetry( std::ostream & , const Envelope & ) ;
+		///< Writes an extra 'Retry' line containing the retry
+		///< fields, for appending after the 'End' field.
+
+	static void writeDigest( std::ostream & , const Envelope & ) ;
+		///< Writes an extra 'Digest' line containing the content
+		///< de-duplication name, for appending after the 'End' field.
+
 	static MessageStore::BodyType parseSmtpBodyType( const std::string & ,
 		MessageStore::BodyType default_ = MessageStore::BodyType::Unknown ) ;
 			///< Parses an SMTP MAIL-FROM BODY= parameter. Returns
@@ -87,6 +102,9 @@ public:
 	std::string forward_to_address ;
 	std::string client_account_selector ;
 	std::size_t endpos {0U} ;
+	unsigned int retry_count {0U} ; // number of deferred delivery attempts, from the extra lines
+	std::time_t retry_time {0} ; // earliest time for the next delivery attempt, from the extra lines
+	std::string digest ; // content de-duplication name, from the extra lines
 } ;
 
 #endif
@@ -31,6 +31,7 @@
 #include "gassert.h"
 #include "glog.h"
 #include <algorithm>
+#include <atomic>
 #include <sstream>
 
 GStore::FileDelivery::FileDelivery( FileStore & store , const Config & config ) :
@@ -106,7 +107,7 @@ void GStore::FileDelivery::deliverTo( FileStore & /*store*/ , std::string_view p
 	if( FileOp::isdir( dst_dir/"tmp" , dst_dir/"cur" , dst_dir/"new" ) )
 	{
 		// copy content to maildir's "new" sub-directory via "tmp"
-		static int seq {} ;
+		static std::atomic<int> seq {} ;
 		std::ostringstream ss ;
 		ss << G::SystemTime::now() << "." << G::Process::Id().str() << "." << hostname() << "." << seq++ ;
 		G::Path tmp_content_path = dst_dir/"tmp"/ss.str() ;
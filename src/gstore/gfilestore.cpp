@@ -22,6 +22,9 @@
 #include "gfilestore.h"
 #include "gnewfile.h"
 #include "gstoredfile.h"
+#include "gssl.h"
+#include "ghash.h"
+#include "gmetrics.h"
 #include "gprocess.h"
 #include "gdirectory.h"
 #include "gformat.h"
@@ -32,12 +35,19 @@
 #include "gstr.h"
 #include "gtest.h"
 #include "glog.h"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 namespace GStore
 {
 	class FileIterator ;
+	namespace FileStoreImp
+	{
+		constexpr std::time_t index_interval = 300 ; // minimum time between index snapshot updates
+		G::Metrics::Counter deduplicated( "emailrelay_spool_deduplicated_total" , "" , "Content files replaced by a link to identical content" ) ;
+	}
 }
 
 class GStore::FileIterator : public MessageStore::Iterator /// A GStore::MessageStore::Iterator for GStore::FileStore.
@@ -55,30 +65,120 @@ public:
 	FileIterator & operator=( const FileIterator & ) = delete ;
 	FileIterator & operator=( FileIterator && ) = delete ;
 
+private:
+	void readDirectory() ;
+
 private:
 	FileStore & m_store ;
-	G::DirectoryList m_iter ;
+	G::Path m_dir ;
 	bool m_lock ;
+	G::StringArray m_ids ;
+	std::size_t m_pos {0U} ;
+	FileStore::Index m_index ;
+	bool m_from_index {false} ;
+	bool m_index_current {false} ;
 } ;
 
 // ===
 
 GStore::FileIterator::FileIterator( FileStore & store , const G::Path & dir , bool lock ) :
 	m_store(store) ,
+	m_dir(dir) ,
 	m_lock(lock)
 {
-	DirectoryReader claim_reader ;
-	m_iter.readType( dir , ".envelope" ) ;
+	bool use_index = m_store.m_config.index && !m_store.m_index_used ;
+	m_store.m_index_used = true ;
+	if( use_index && m_store.readIndex( m_index , m_index_current ) )
+	{
+		G_LOG( "GStore::FileIterator::ctor: using spool index snapshot: " << m_index.size() << " message(s)"
+			<< (m_index_current?"":": verifying later") ) ;
+		m_from_index = true ;
+		if( m_index_current )
+			m_store.seedIndex( m_index ) ;
+	}
+	else
+	{
+		readDirectory() ;
+	}
 }
 
 GStore::FileIterator::~FileIterator()
 = default;
 
+void GStore::FileIterator::readDirectory()
+{
+	// stat the directory first so that any change during the scan invalidates the index
+	G::DirectoryList list ;
+	G::File::Stat dir_stat ;
+	{
+		DirectoryReader claim_reader ;
+		if( m_store.m_config.index )
+			dir_stat = G::File::stat( m_dir ) ;
+		list.readType( m_dir , ".envelope" ) ;
+	}
+
+	// when verifying a snapshot only keep what was not in the snapshot
+	G::StringArray all_ids ;
+	m_ids.clear() ;
+	m_pos = 0U ;
+	while( list.more() )
+	{
+		std::string id = list.filePath().withoutExtension().basename() ;
+		auto p = std::lower_bound( m_index.begin() , m_index.end() , id ,
+			[](const FileStore::IndexEntry & entry , const std::string & s){ return entry.id < s ; } ) ;
+		if( !m_from_index || p == m_index.end() || p->id != id )
+			m_ids.push_back( id ) ;
+		if( m_store.m_config.index )
+			all_ids.push_back( id ) ;
+	}
+	if( m_from_index )
+		G_LOG( "GStore::FileIterator::readDirectory: spool index snapshot verified: " << m_ids.size() << " more message(s)" ) ;
+	m_from_index = false ;
+
+	if( m_store.m_config.index && !dir_stat.error )
+	{
+		m_store.syncIndex( dir_stat , all_ids ) ;
+		m_store.checkIndex() ;
+	}
+}
+
 std::unique_ptr<GStore::StoredMessage> GStore::FileIterator::next()
 {
-	while( m_iter.more() )
+	for(;;)
 	{
-		GStore::MessageId message_id( m_iter.filePath().withoutExtension().basename() ) ;
+		std::string id ;
+		if( m_from_index && m_pos < m_index.size() )
+		{
+			const FileStore::IndexEntry & entry = m_index[m_pos++] ;
+			G::File::Stat stat ;
+			{
+				FileReader claim_reader ;
+				stat = G::File::stat( m_store.envelopePath(MessageId(entry.id)) ) ;
+			}
+			if( stat.error )
+				continue ; // already gone
+			if( stat.inode != entry.inode || stat.size != entry.size )
+			{
+				G_DEBUG( "GStore::FileIterator::next: spool index snapshot out of date: " << entry.id ) ;
+				m_index_current = false ;
+			}
+			id = entry.id ;
+		}
+		else if( m_from_index && !m_index_current )
+		{
+			readDirectory() ;
+			continue ;
+		}
+		else if( !m_from_index && m_pos < m_ids.size() )
+		{
+			id = m_ids[m_pos++] ;
+		}
+		else
+		{
+			break ;
+		}
+
+		GStore::MessageId message_id( id ) ;
 		if( !message_id.valid() )
 			continue ;
 
@@ -86,7 +186,7 @@ std::unique_ptr<GStore::StoredMessage> GStore::FileIterator::next()
 
 		if( m_lock && !message_ptr->lock() )
 		{
-			G_WARNING( "GStore::MessageStore: cannot lock file: \"" << m_iter.filePath().basename() << "\"" ) ;
+			G_WARNING( "GStore::MessageStore: cannot lock file: \"" << m_store.envelopePath(message_id).basename() << "\"" ) ;
 			continue ;
 		}
 
@@ -95,7 +195,7 @@ std::unique_ptr<GStore::StoredMessage> GStore::FileIterator::next()
 		ok = message_ptr->readEnvelope( reason ) && message_ptr->openContent( reason ) ;
 		if( !ok )
 		{
-			G_WARNING( "GStore::MessageStore: ignoring \"" << m_iter.filePath() << "\": " << reason ) ;
+			G_WARNING( "GStore::MessageStore: ignoring \"" << m_store.envelopePath(message_id) << "\": " << reason ) ;
 			continue ;
 		}
 
@@ -114,6 +214,25 @@ GStore::FileStore::FileStore( const G::Path & dir , const G::Path & delivery_dir
 {
 	checkPath( dir ) ;
 	osinit() ;
+	if( m_config.dedup )
+		sweep() ;
+}
+
+GStore::FileStore::~FileStore()
+{
+	try
+	{
+		if( m_config.index && ( m_index_dirty || !m_index_synced ) )
+		{
+			if( !m_index_synced )
+				scanIndex() ;
+			writeIndex() ;
+		}
+	}
+	catch( std::exception & e ) // NOLINT bugprone-empty-catch
+	{
+		G_WARNING( "GStore::FileStore::dtor: cannot write spool index snapshot: " << e.what() ) ;
+	}
 }
 
 G::Path GStore::FileStore::directory() const
@@ -279,8 +398,11 @@ void GStore::FileStore::unfailAll()
 	}
 	while( list.more() )
 	{
-		FileWriter claim_writer ;
-		FileOp::rename( list.filePath() , list.filePath().withoutExtension() ) ; // ignore errors
+		{
+			FileWriter claim_writer ;
+			FileOp::rename( list.filePath() , list.filePath().withoutExtension() ) ; // ignore errors
+		}
+		indexUpdate( MessageId(list.filePath().withoutExtension().withoutExtension().basename()) ) ;
 	}
 }
 
@@ -314,6 +436,7 @@ GStore::Envelope GStore::FileStore::readEnvelope( const G::Path & envelope_path
 
     GStore::Envelope envelope ;
     GStore::Envelope::read( envelope_stream , envelope ) ;
+    GStore::Envelope::readExtra( envelope_stream , envelope ) ;
     return envelope ;
 }
 
@@ -341,9 +464,428 @@ G::Slot::Signal<> & GStore::FileStore::messageStoreRescanSignal() noexcept
 
 void GStore::FileStore::rescan()
 {
+	m_index_used = true ; // the index snapshot is now stale
 	messageStoreRescanSignal().emit() ;
 }
 
+G::Path GStore::FileStore::dedupDir() const
+{
+	return m_dir / ".dedup" ;
+}
+
+std::unique_ptr<GSsl::Digester> GStore::FileStore::digester() noexcept
+{
+	try
+	{
+		if( !m_config.dedup )
+			return {} ;
+
+		// use the strongest hash function from the tls library
+		if( m_digest_name.empty() )
+		{
+			G::StringArray names = GSsl::Library::digesters() ;
+			if( names.empty() )
+			{
+				G_WARNING_ONCE( "GStore::FileStore::digester: spool de-duplication disabled: no hash functions available from the tls library" ) ;
+				return {} ;
+			}
+			m_digest_name = names.at(0U) ;
+			G_DEBUG( "GStore::FileStore::digester: using " << m_digest_name << " for spool de-duplication" ) ;
+		}
+		return std::make_unique<GSsl::Digester>( GSsl::Library::instance()->digester(m_digest_name) ) ;
+	}
+	catch( std::exception & e )
+	{
+		G_WARNING( "GStore::FileStore::digester: spool de-duplication failed: " << e.what() ) ;
+		return {} ;
+	}
+}
+
+std::string GStore::FileStore::digestName( GSsl::Digester & digester ) const
+{
+	return G::Str::lower(m_digest_name).append(1U,'-').append(G::Hash::printable(digester.value())) ;
+}
+
+std::string GStore::FileStore::digest( const G::Path & content_path )
+{
+	std::unique_ptr<GSsl::Digester> digester = this->digester() ;
+	if( digester == nullptr )
+		return {} ;
+
+	std::ifstream stream ;
+	if( !FileOp::openIn( stream , content_path ) )
+		return {} ;
+
+	std::vector<char> buffer( 65536U ) ;
+	while( stream.good() )
+	{
+		stream.read( buffer.data() , static_cast<std::streamsize>(buffer.size()) ) ; // NOLINT narrowing
+		std::streamsize n = stream.gcount() ;
+		if( n > 0 )
+			digester->add( std::string_view(buffer.data(),static_cast<std::size_t>(n)) ) ;
+	}
+	if( stream.bad() )
+		return {} ;
+	return digestName( *digester ) ;
+}
+
+std::string GStore::FileStore::dedup( const G::Path & content_path , const std::string & digest_name ) noexcept
+{
+	try
+	{
+		if( !m_config.dedup )
+			return {} ;
+
+		std::string name = digest_name.empty() ? digest( content_path ) : digest_name ;
+		if( name.empty() )
+			return {} ;
+
+		G::Path dir = dedupDir() ;
+		if( !FileOp::isdir(dir) && !FileOp::mkdir(dir) && !FileOp::isdir(dir) )
+		{
+			G_WARNING_ONCE( "GStore::FileStore::dedup: cannot create de-duplication directory: " << dir ) ;
+			return {} ;
+		}
+
+		// link the existing content into place, or if none add the new content
+		G::Path blob_path = dir / name ;
+		G::Path tmp_path( content_path.str() + ".dedup" ) ;
+		if( FileOp::link( blob_path , tmp_path ) )
+		{
+			G::File::Stat blob_stat ;
+			G::File::Stat content_stat ;
+			{
+				FileReader claim_reader ;
+				blob_stat = G::File::stat( tmp_path ) ;
+				content_stat = G::File::stat( content_path ) ;
+			}
+			if( !blob_stat.error && !content_stat.error && blob_stat.size == content_stat.size &&
+				FileOp::renameOnto( tmp_path , content_path ) )
+			{
+				G_LOG( "GStore::FileStore::dedup: content file [" << content_path.basename() << "] "
+					<< "linked to [" << name << "]" ) ;
+				FileStoreImp::deduplicated.add() ;
+			}
+			else
+			{
+				FileOp::remove( tmp_path ) ;
+				return {} ;
+			}
+		}
+		else if( !FileOp::link( content_path , blob_path ) )
+		{
+			G_DEBUG( "GStore::FileStore::dedup: cannot link [" << name << "]: " << G::Process::strerror(FileOp::errno_()) ) ;
+			return {} ;
+		}
+		return name ;
+	}
+	catch( std::exception & e )
+	{
+		G_WARNING( "GStore::FileStore::dedup: spool de-duplication failed: " << e.what() ) ;
+		return {} ;
+	}
+}
+
+void GStore::FileStore::release( const G::Path & content_path , const std::string & digest_name ) noexcept
+{
+	try
+	{
+		if( !m_config.dedup )
+			return ;
+
+		// if the only other link is from the dedup directory then delete that too
+		G::File::Stat content_stat ;
+		{
+			FileReader claim_reader ;
+			content_stat = G::File::stat( content_path ) ;
+		}
+		if( content_stat.error || content_stat.links != 2UL )
+			return ;
+
+		std::string name = digest_name.empty() ? digest( content_path ) : digest_name ;
+		if( name.empty() )
+			return ;
+
+		G::Path blob_path = dedupDir() / name ;
+		G::File::Stat blob_stat ;
+		{
+			FileReader claim_reader ;
+			blob_stat = G::File::stat( blob_path ) ;
+		}
+		if( !blob_stat.error && blob_stat.inode == content_stat.inode )
+		{
+			G_DEBUG( "GStore::FileStore::release: deleting [" << name << "]" ) ;
+			FileOp::remove( blob_path ) ;
+		}
+	}
+	catch( std::exception & e )
+	{
+		G_WARNING( "GStore::FileStore::release: " << e.what() ) ;
+	}
+}
+
+void GStore::FileStore::unshare( const G::Path & content_path ) noexcept
+{
+	try
+	{
+		if( !m_config.dedup || !m_config.dedup_unshare )
+			return ;
+
+		G::File::Stat content_stat ;
+		{
+			FileReader claim_reader ;
+			content_stat = G::File::stat( content_path ) ;
+		}
+		if( content_stat.error || content_stat.links < 2UL )
+			return ;
+
+		// copy-on-write -- the dedup directory entry is tidied up by sweep()
+		G::Path tmp_path( content_path.str() + ".unshare" ) ;
+		if( FileOp::copy( content_path , tmp_path ) && FileOp::renameOnto( tmp_path , content_path ) )
+		{
+			G_DEBUG( "GStore::FileStore::unshare: content file [" << content_path.basename() << "] unshared" ) ;
+		}
+		else
+		{
+			G_WARNING( "GStore::FileStore::unshare: cannot copy de-duplicated content file: " << content_path
+				<< ": " << G::Process::strerror(FileOp::errno_()) ) ;
+			FileOp::remove( tmp_path ) ;
+		}
+	}
+	catch( std::exception & e )
+	{
+		G_WARNING( "GStore::FileStore::unshare: " << e.what() ) ;
+	}
+}
+
+void GStore::FileStore::sweep()
+{
+	// remove dedup directory entries that are no longer referenced,
+	// eg. after the content files were deleted by the pop server
+	G::Path dir = dedupDir() ;
+	if( !FileOp::isdir(dir) )
+		return ;
+
+	G::DirectoryList list ;
+	{
+		DirectoryReader claim_reader ;
+		list.readAll( dir ) ;
+	}
+	std::size_t n = 0U ;
+	while( list.more() )
+	{
+		if( list.isDir() )
+			continue ;
+		G::File::Stat stat ;
+		{
+			FileReader claim_reader ;
+			stat = G::File::stat( list.filePath() ) ;
+		}
+		if( !stat.error && stat.links == 1UL && FileOp::remove( list.filePath() ) )
+			n++ ;
+	}
+	G_LOG_IF( n , "GStore::FileStore::sweep: removed " << n << " unused de-duplication file(s)" ) ;
+}
+
+G::Path GStore::FileStore::indexPath() const
+{
+	// in a sub-directory so that rewriting it does not change the spool directory's mtime
+	return m_dir / ".index" / "snapshot" ;
+}
+
+bool GStore::FileStore::readIndex( Index & index , bool & current ) const
+{
+	// format: "emailrelay-spool-index 1 <dir-mtime-s> <dir-mtime-us>" then "<id> <inode> <size>" lines
+	std::ifstream stream ;
+	G::File::Stat dir_stat ;
+	{
+		DirectoryReader claim_reader ;
+		dir_stat = G::File::stat( m_dir ) ;
+	}
+	if( dir_stat.error || !FileOp::exists(indexPath()) || !FileOp::openIn( stream , indexPath() ) )
+		return false ;
+
+	std::string line ;
+	G::StringArray part ;
+	if( !std::getline( stream , line ) ||
+		( part = G::Str::splitIntoTokens(line," ") ).size() != 4U ||
+		part[0] != "emailrelay-spool-index" || part[1] != "1" ||
+		!G::Str::isULong(part[2]) || !G::Str::isUInt(part[3]) )
+	{
+		G_WARNING( "GStore::FileStore::readIndex: ignoring invalid spool index snapshot: " << indexPath() ) ;
+		return false ;
+	}
+	current =
+		static_cast<unsigned long>(dir_stat.mtime_s) == G::Str::toULong(part[2]) &&
+		dir_stat.mtime_us == G::Str::toUInt(part[3]) ;
+
+	index.clear() ;
+	while( std::getline( stream , line ) )
+	{
+		part = G::Str::splitIntoTokens( line , " " ) ;
+		if( part.size() != 3U || !MessageId(part[0]).valid() || !G::Str::isULong(part[1]) || !G::Str::isULong(part[2]) )
+		{
+			G_WARNING( "GStore::FileStore::readIndex: ignoring invalid spool index snapshot: " << indexPath() ) ;
+			return false ;
+		}
+		IndexEntry entry ;
+		entry.id = part[0] ;
+		entry.inode = G::Str::toULong( part[1] ) ;
+		entry.size = G::Str::toULong( part[2] ) ;
+		index.push_back( entry ) ;
+	}
+	if( !std::is_sorted( index.begin() , index.end() , [](const IndexEntry & a , const IndexEntry & b){ return a.id < b.id ; } ) )
+		std::sort( index.begin() , index.end() , [](const IndexEntry & a , const IndexEntry & b){ return a.id < b.id ; } ) ;
+	return true ;
+}
+
+void GStore::FileStore::seedIndex( const Index & index )
+{
+	// the snapshot is current so use it as the in-memory index
+	G::File::Stat dir_stat ;
+	{
+		DirectoryReader claim_reader ;
+		dir_stat = G::File::stat( m_dir ) ;
+	}
+	if( dir_stat.error )
+		return ;
+	m_index.clear() ;
+	for( const auto & entry : index )
+		m_index.insert( {entry.id,entry} ) ;
+	m_index_synced = true ;
+	m_index_dirty = false ;
+	m_index_mtime_s = dir_stat.mtime_s ;
+	m_index_mtime_us = dir_stat.mtime_us ;
+}
+
+void GStore::FileStore::scanIndex()
+{
+	G::DirectoryList list ;
+	G::File::Stat dir_stat ;
+	{
+		DirectoryReader claim_reader ;
+		dir_stat = G::File::stat( m_dir ) ;
+		list.readType( m_dir , ".envelope" ) ;
+	}
+	if( dir_stat.error )
+		return ;
+	G::StringArray ids ;
+	while( list.more() )
+		ids.push_back( list.filePath().withoutExtension().basename() ) ;
+	syncIndex( dir_stat , ids ) ;
+}
+
+void GStore::FileStore::syncIndex( const G::File::Stat & dir_stat , const G::StringArray & ids )
+{
+	// rebuild the in-memory index from a directory listing, only
+	// stat-ing envelope files that are not already indexed
+	IndexMap index ;
+	std::size_t added = 0U ;
+	for( const auto & id : ids )
+	{
+		auto p = m_index_synced ? m_index.find( id ) : m_index.end() ;
+		if( p != m_index.end() )
+		{
+			index.insert( *p ) ;
+		}
+		else
+		{
+			G::File::Stat stat ;
+			{
+				FileReader claim_reader ;
+				stat = G::File::stat( envelopePath(MessageId(id)) ) ;
+			}
+			if( stat.error )
+				continue ;
+			IndexEntry entry ;
+			entry.id = id ;
+			entry.inode = stat.inode ;
+			entry.size = stat.size ;
+			index.insert( {id,entry} ) ;
+			added++ ;
+		}
+	}
+	if( !m_index_synced || added || index.size() != m_index.size() ||
+		m_index_mtime_s != dir_stat.mtime_s || m_index_mtime_us != dir_stat.mtime_us )
+			m_index_dirty = true ;
+	m_index.swap( index ) ;
+	m_index_synced = true ;
+	m_index_mtime_s = dir_stat.mtime_s ;
+	m_index_mtime_us = dir_stat.mtime_us ;
+}
+
+void GStore::FileStore::indexUpdate( const MessageId & id ) noexcept
+{
+	try
+	{
+		if( !m_config.index || !m_index_synced )
+			return ;
+
+		G::File::Stat stat ;
+		{
+			FileReader claim_reader ;
+			stat = G::File::stat( envelopePath(id) ) ;
+		}
+		if( stat.error )
+		{
+			if( m_index.erase( id.str() ) )
+				m_index_dirty = true ;
+		}
+		else
+		{
+			IndexEntry & entry = m_index[id.str()] ;
+			entry.id = id.str() ;
+			entry.inode = stat.inode ;
+			entry.size = stat.size ;
+			m_index_dirty = true ;
+		}
+		checkIndex() ;
+	}
+	catch( std::exception & e )
+	{
+		G_WARNING( "GStore::FileStore::indexUpdate: " << e.what() ) ;
+	}
+}
+
+void GStore::FileStore::checkIndex()
+{
+	// write at a bounded cadence
+	if( m_index_synced && m_index_dirty && G::SystemTime::now().s() >= (m_index_time+FileStoreImp::index_interval) )
+		writeIndex() ;
+}
+
+void GStore::FileStore::writeIndex()
+{
+	m_index_time = G::SystemTime::now().s() ;
+	if( !m_index_synced )
+		return ;
+
+	G::Path dir = indexPath().dirname() ;
+	if( !FileOp::isdir(dir) && !FileOp::mkdir(dir) && !FileOp::isdir(dir) )
+	{
+		G_WARNING( "GStore::FileStore::writeIndex: cannot create spool index directory: " << dir ) ;
+		return ;
+	}
+
+	// the directory mtime is from the last sync so changes made
+	// since then make the snapshot look out of date, which is safe
+	G::Path tmp_path( indexPath().str() + ".tmp" ) ;
+	std::ofstream stream ;
+	FileOp::openOut( stream , tmp_path ) ;
+	stream << "emailrelay-spool-index 1 " << m_index_mtime_s << " " << m_index_mtime_us << "\n" ;
+	for( const auto & item : m_index )
+		stream << item.first << " " << item.second.inode << " " << item.second.size << "\n" ;
+	stream.close() ;
+
+	bool ok = !stream.fail() && FileOp::renameOnto( tmp_path , indexPath() ) ;
+	if( !ok )
+		FileOp::remove( tmp_path ) ;
+	if( !ok )
+		G_WARNING( "GStore::FileStore::writeIndex: cannot write spool index snapshot: " << indexPath() ) ;
+	else
+		m_index_dirty = false ;
+}
+
 // ===
 
 GStore::FileReader::FileReader()
@@ -375,7 +917,7 @@ GStore::FileWriter::~FileWriter()
 
 int & GStore::FileStore::FileOp::errno_() noexcept
 {
-	static int e {} ;
+	static thread_local int e {} ;
 	return e ;
 }
 
@@ -479,6 +1021,15 @@ bool GStore::FileStore::FileOp::hardlink( const G::Path & src , const G::Path &
 	return linked || copied ;
 }
 
+bool GStore::FileStore::FileOp::link( const G::Path & src , const G::Path & dst )
+{
+	FileWriter claim_writer ;
+	errno_() = 0 ;
+	bool ok = G::File::hardlink( src , dst , std::nothrow ) ;
+	errno_() = G::Process::errno_() ;
+	return ok ;
+}
+
 bool GStore::FileStore::FileOp::copy( const G::Path & src , const G::Path & dst , bool use_hardlink )
 {
 	if( use_hardlink )
@@ -26,17 +26,28 @@
 #include "genvelope.h"
 #include "gdatetime.h"
 #include "gexception.h"
+#include "gfile.h"
 #include "gprocess.h"
 #include "gslot.h"
 #include "groot.h"
 #include "gpath.h"
+#include "gstringarray.h"
+#include <ctime>
 #include <fstream>
 #include <memory>
+#include <map>
 #include <string>
+#include <vector>
+
+namespace GSsl
+{
+	class Digester ;
+}
 
 namespace GStore
 {
 	class FileStore ;
+	class FileIterator ;
 	class FileReader ;
 	class FileWriter ;
 	class DirectoryReader ;
@@ -52,6 +63,25 @@ namespace GStore
 /// that the content file is valid and that it has been commited
 /// to the care of the SMTP system for delivery.
 ///
+/// Optionally the content files can be de-duplicated by hard-linking
+/// them to files named by their digest in a ".dedup" sub-directory.
+/// Identical content files then share the same inode, with the
+/// hard-link count acting as a reference count. The sub-directory
+/// entry is removed when the last message using it is deleted,
+/// or by a sweep when the store is constructed.
+///
+/// Optionally the list of envelope files is saved as an index snapshot
+/// file in a ".index" sub-directory. The index is held in memory and
+/// kept up to date as messages are stored, unlocked, failed and deleted,
+/// with each directory scan picking up any external changes, and it is
+/// written out at most every few minutes and when the store is destroyed.
+/// The first iteration after the store is constructed starts from the
+/// snapshot rather than from a full directory listing, skipping
+/// entries that no longer exist, and it only rescans the directory after
+/// the snapshot entries are exhausted if the directory modification time
+/// or some envelope file's inode number or size shows that the snapshot
+/// is out of date. Later iterations use a plain directory scan.
+///
 class GStore::FileStore : public MessageStore
 {
 public:
@@ -69,8 +99,14 @@ public:
 	{
 		std::size_t max_size {0U} ; // zero for unlimited -- passed to GStore::NewFile::ctor
 		unsigned long seq {0UL} ; // sequence number start
+		bool dedup {false} ; // content files hard-linked by digest
+		bool dedup_unshare {false} ; // de-duplicated content copied before filtering
+		bool index {false} ; // first iteration from an index snapshot file
 		Config & set_max_size( std::size_t ) noexcept ;
 		Config & set_seq( unsigned long ) noexcept ;
+		Config & set_dedup( bool = true ) noexcept ;
+		Config & set_dedup_unshare( bool = true ) noexcept ;
+		Config & set_index( bool = true ) noexcept ;
 	} ;
 	struct FileOp /// Low-level file-system operations for GStore::FileStore.
 	{
@@ -82,6 +118,7 @@ public:
 		static bool exists( const G::Path & ) ;
 		static int fdopen( const G::Path & ) ;
 		static bool hardlink( const G::Path & , const G::Path & ) ;
+		static bool link( const G::Path & , const G::Path & ) ;
 		static bool copy( const G::Path & , const G::Path & ) ;
 		static bool copy( const G::Path & , const G::Path & , bool hardlink ) ;
 		static bool mkdir( const G::Path & ) ;
@@ -136,6 +173,50 @@ public:
 		///< Optionally returns the newly-opened stream by reference so
 		///< that any trailing headers can be read. Throws on error.
 
+	std::unique_ptr<GSsl::Digester> digester() noexcept ;
+		///< Used by GStore::NewFile to get a hash function for
+		///< digesting new content as it is added. Returns nullptr
+		///< if not de-duplicating.
+
+	std::string digestName( GSsl::Digester & ) const ;
+		///< Returns the de-duplication directory entry name for
+		///< the final value of a digester().
+
+	std::string dedup( const G::Path & content_path , const std::string & digest_name ) noexcept ;
+		///< Used by GStore::NewFile to de-duplicate a new content file,
+		///< if configured. The content file is replaced by a hard link
+		///< to an identical content file, or it is itself linked
+		///< into the de-duplication directory. The content's
+		///< digestName() is normally passed in, but if empty the
+		///< content file is read and digested here. Returns the
+		///< digest name, or the empty string if not de-duplicated.
+		///< Errors are logged and otherwise ignored.
+
+	void unshare( const G::Path & content_path ) noexcept ;
+		///< Used by GStore::StoredFile before its content is made
+		///< available for external editing by a filter. If the
+		///< content file is hard-linked by de-duplication then it
+		///< is replaced by a private copy so that editing does not
+		///< affect any other message or the de-duplication
+		///< directory entry. Does nothing unless configured
+		///< with Config::dedup_unshare. Errors are logged and
+		///< otherwise ignored.
+
+	void release( const G::Path & content_path , const std::string & digest_name ) noexcept ;
+		///< Used by GStore::StoredFile just before deleting a content
+		///< file so that the matching de-duplication directory entry
+		///< is also deleted if this is the last reference. The
+		///< digest name is normally the one returned by dedup(),
+		///< as saved in the envelope, but if empty the content file
+		///< is read and digested here.
+
+	void indexUpdate( const MessageId & ) noexcept ;
+		///< Used by GStore::NewFile and GStore::StoredFile after an
+		///< envelope file has been created, unlocked, failed or
+		///< deleted so that the in-memory index can be kept up to
+		///< date without a directory scan. Does nothing if not
+		///< configured with Config::index.
+
 private: // overrides
 	bool empty() const override ;
 	std::string location( const MessageId & ) const override ;
@@ -151,13 +232,22 @@ private: // overrides
 	void rescan() override ;
 
 public:
-	~FileStore() override = default ;
+	~FileStore() override ;
 	FileStore( const FileStore & ) = delete ;
 	FileStore( FileStore && ) = delete ;
 	FileStore & operator=( const FileStore & ) = delete ;
 	FileStore & operator=( FileStore && ) = delete ;
 
 private:
+	friend class GStore::FileIterator ;
+	struct IndexEntry /// An entry in the index snapshot file.
+	{
+		std::string id ;
+		unsigned long long inode {0ULL} ;
+		unsigned long long size {0ULL} ;
+	} ;
+	using Index = std::vector<IndexEntry> ;
+	using IndexMap = std::map<std::string,IndexEntry> ;
 	static void checkPath( const G::Path & dir ) ;
 	static void osinit() ;
 	G::Path fullPath( const std::string & filename ) const ;
@@ -167,12 +257,30 @@ private:
 	bool emptyCore() const ;
 	void clearAll() ;
 	static MessageId newId( unsigned long ) ;
+	G::Path dedupDir() const ;
+	std::string digest( const G::Path & ) ;
+	void sweep() ;
+	G::Path indexPath() const ;
+	bool readIndex( Index & , bool & current ) const ;
+	void seedIndex( const Index & ) ;
+	void scanIndex() ;
+	void syncIndex( const G::File::Stat & dir_stat , const G::StringArray & ids ) ;
+	void checkIndex() ;
+	void writeIndex() ;
 
 private:
 	unsigned long m_seq ;
 	G::Path m_dir ;
 	G::Path m_delivery_dir ;
 	const Config m_config ;
+	std::string m_digest_name ;
+	bool m_index_used {false} ;
+	std::time_t m_index_time {0} ;
+	IndexMap m_index ;
+	bool m_index_synced {false} ; // m_index reflects the spool directory
+	bool m_index_dirty {false} ;
+	std::time_t m_index_mtime_s {0} ; // spool directory mtime at the last sync
+	unsigned int m_index_mtime_us {0U} ;
 	G::Slot::Signal<> m_update_signal ;
 	G::Slot::Signal<> m_rescan_signal ;
 } ;
@@ -245,5 +353,8 @@ public:
 
 inline GStore::FileStore::Config & GStore::FileStore::Config::set_max_size( std::size_t n ) noexcept { max_size = n ; return *this ; }
 inline GStore::FileStore::Config & GStore::FileStore::Config::set_seq( unsigned long n ) noexcept { seq = n ; return *this ; }
+inline GStore::FileStore::Config & GStore::FileStore::Config::set_dedup( bool b ) noexcept { dedup = b ; return *this ; }
+inline GStore::FileStore::Config & GStore::FileStore::Config::set_dedup_unshare( bool b ) noexcept { dedup_unshare = b ; return *this ; }
+inline GStore::FileStore::Config & GStore::FileStore::Config::set_index( bool b ) noexcept { index = b ; return *this ; }
 
 #endif
@@ -0,0 +1,698 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gmemorystore.cpp
+///
+
+#include "gdef.h"
+#include "gmemorystore.h"
+#include "gnewmessage.h"
+#include "gstoredmessage.h"
+#include "gnewfile.h"
+#include "gimembuf.h"
+#include "glog.h"
+#include "gassert.h"
+#include <algorithm>
+#include <limits>
+#include <iostream>
+
+namespace GStore
+{
+	namespace MemoryStoreImp
+	{
+		std::string location( const MessageId & id )
+		{
+			return std::string("memory:").append( id.str() ) ;
+		}
+	}
+}
+
+class GStore::MemoryIterator : public MessageStore::Iterator /// A GStore::MessageStore::Iterator for GStore::MemoryStore.
+{
+public:
+	MemoryIterator( MemoryStore & store , FileStore & file_store , bool lock ) ;
+
+private: // overrides
+	std::unique_ptr<StoredMessage> next() override ;
+
+public:
+	~MemoryIterator() override = default ;
+	MemoryIterator( const MemoryIterator & ) = delete ;
+	MemoryIterator( MemoryIterator && ) = delete ;
+	MemoryIterator & operator=( const MemoryIterator & ) = delete ;
+	MemoryIterator & operator=( MemoryIterator && ) = delete ;
+
+private:
+	MemoryStore & m_store ;
+	FileStore & m_file_store ;
+	bool m_lock ;
+	G::StringArray m_ids ;
+	std::size_t m_index {0U} ;
+	std::unique_ptr<MessageStore::Iterator> m_file_iter ;
+} ;
+
+class GStore::NewMemoryMessage : public NewMessage /// A GStore::NewMessage for GStore::MemoryStore.
+{
+public:
+	NewMemoryMessage( MemoryStore & , FileStore & , const std::string & from ,
+		const MessageStore::SmtpInfo & , const std::string & from_auth_out ) ;
+	~NewMemoryMessage() override ;
+
+private: // overrides
+	void commit( bool strict ) override ;
+	MessageId id() const override ;
+	std::string location() const override ;
+	void addTo( const std::string & to , bool local , MessageStore::AddressStyle ) override ;
+	NewMessage::Status addContent( const char * , std::size_t ) override ;
+	std::size_t contentSize() const override ;
+	void prepare( const std::string & auth_id , const std::string & peer_socket_address ,
+		const std::string & peer_certificate ) override ;
+
+public:
+	NewMemoryMessage( const NewMemoryMessage & ) = delete ;
+	NewMemoryMessage( NewMemoryMessage && ) = delete ;
+	NewMemoryMessage & operator=( const NewMemoryMessage & ) = delete ;
+	NewMemoryMessage & operator=( NewMemoryMessage && ) = delete ;
+
+private:
+	void spill() ;
+
+private:
+	MemoryStore & m_store ;
+	FileStore & m_file_store ;
+	MessageId m_id ;
+	MessageStore::SmtpInfo m_smtp_info ;
+	Envelope m_env ;
+	std::string m_content ;
+	std::size_t m_size {0U} ;
+	bool m_committed {false} ;
+	std::unique_ptr<NewMessage> m_file ;
+} ;
+
+class GStore::StoredMemoryMessage : public StoredMessage /// A GStore::StoredMessage for GStore::MemoryStore.
+{
+public:
+	StoredMemoryMessage( MemoryStore & , const MessageId & , const Envelope & ,
+		std::shared_ptr<const std::string> content , bool locked ) ;
+	~StoredMemoryMessage() override ;
+
+private: // overrides
+	MessageId id() const override ;
+	std::string location() const override ;
+	std::string from() const override ;
+	std::string to( std::size_t ) const override ;
+	std::size_t toCount() const override ;
+	std::size_t contentSize() const override ;
+	std::istream & contentStream() override ;
+	std::string_view contentView() override ;
+	void close() override ;
+	std::string reopen() override ;
+	void destroy() override ;
+	void fail( const std::string & reason , int reason_code ) override ;
+	MessageStore::BodyType bodyType() const override ;
+	std::string authentication() const override ;
+	std::string fromAuthIn() const override ;
+	std::string fromAuthOut() const override ;
+	std::string forwardTo() const override ;
+	std::string forwardToAddress() const override ;
+	std::string clientAccountSelector() const override ;
+	bool utf8Mailboxes() const override ;
+	void editRecipients( const G::StringArray & ) override ;
+	unsigned int retryCount() const override ;
+	std::time_t retryTime() const override ;
+	void retry( std::time_t , const std::string & ) override ;
+
+public:
+	StoredMemoryMessage( const StoredMemoryMessage & ) = delete ;
+	StoredMemoryMessage( StoredMemoryMessage && ) = delete ;
+	StoredMemoryMessage & operator=( const StoredMemoryMessage & ) = delete ;
+	StoredMemoryMessage & operator=( StoredMemoryMessage && ) = delete ;
+
+private:
+	MemoryStore & m_store ;
+	MessageId m_id ;
+	Envelope m_env ;
+	std::shared_ptr<const std::string> m_content ;
+	G::imembuf m_buf ;
+	std::istream m_stream ;
+	bool m_locked ;
+} ;
+
+// ===
+
+GStore::MemoryStore::MemoryStore( FileStore & file_store , const Config & config ) :
+	m_file_store(file_store) ,
+	m_config(config)
+{
+	MessageStore & base = m_file_store ;
+	base.messageStoreUpdateSignal().connect( G::Slot::slot(*this,&MemoryStore::onFileStoreUpdate) ) ;
+	base.messageStoreRescanSignal().connect( G::Slot::slot(*this,&MemoryStore::onFileStoreRescan) ) ;
+}
+
+GStore::MemoryStore::~MemoryStore()
+{
+	MessageStore & base = m_file_store ;
+	base.messageStoreUpdateSignal().disconnect() ;
+	base.messageStoreRescanSignal().disconnect() ;
+	try
+	{
+		while( !m_map.empty() )
+			spill( MessageId(m_map.begin()->first) , false , {} , 0 ) ;
+	}
+	catch(...) // dtor
+	{
+	}
+}
+
+std::size_t GStore::MemoryStore::used() const noexcept
+{
+	return m_used ;
+}
+
+bool GStore::MemoryStore::empty() const
+{
+	const MessageStore & base = m_file_store ;
+	return
+		std::none_of( m_map.begin() , m_map.end() , [](const Map::value_type & p){return !p.second.locked;} ) &&
+		base.empty() ;
+}
+
+std::string GStore::MemoryStore::location( const MessageId & id ) const
+{
+	const MessageStore & base = m_file_store ;
+	return m_map.count( id.str() ) ? MemoryStoreImp::location( id ) : base.location( id ) ;
+}
+
+std::unique_ptr<GStore::StoredMessage> GStore::MemoryStore::get( const MessageId & id )
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p == m_map.end() )
+	{
+		MessageStore & base = m_file_store ;
+		return base.get( id ) ;
+	}
+	if( p->second.locked )
+		throw GetError( id.str().append(": message is locked") ) ;
+	return lock( p , true ) ;
+}
+
+std::unique_ptr<GStore::MessageStore::Iterator> GStore::MemoryStore::iterator( bool lock )
+{
+	return std::make_unique<MemoryIterator>( *this , m_file_store , lock ) ;
+}
+
+std::unique_ptr<GStore::NewMessage> GStore::MemoryStore::newMessage( const std::string & from ,
+	const MessageStore::SmtpInfo & smtp_info , const std::string & from_auth_out )
+{
+	return std::make_unique<NewMemoryMessage>( *this , m_file_store , from , smtp_info , from_auth_out ) ;
+}
+
+void GStore::MemoryStore::updated()
+{
+	G_DEBUG( "GStore::MemoryStore::updated" ) ;
+	m_update_signal.emit() ;
+}
+
+G::Slot::Signal<> & GStore::MemoryStore::messageStoreUpdateSignal() noexcept
+{
+	return m_update_signal ;
+}
+
+G::Slot::Signal<> & GStore::MemoryStore::messageStoreRescanSignal() noexcept
+{
+	return m_rescan_signal ;
+}
+
+std::vector<GStore::MessageId> GStore::MemoryStore::ids()
+{
+	std::vector<MessageId> result ;
+	for( const auto & item : m_map )
+	{
+		if( !item.second.locked )
+			result.emplace_back( item.first ) ;
+	}
+	MessageStore & base = m_file_store ;
+	std::vector<MessageId> file_ids = base.ids() ;
+	result.insert( result.end() , file_ids.begin() , file_ids.end() ) ;
+	return result ;
+}
+
+std::vector<GStore::MessageId> GStore::MemoryStore::failures()
+{
+	// failed messages are always moved to the file store
+	MessageStore & base = m_file_store ;
+	return base.failures() ;
+}
+
+void GStore::MemoryStore::unfailAll()
+{
+	MessageStore & base = m_file_store ;
+	base.unfailAll() ;
+}
+
+void GStore::MemoryStore::rescan()
+{
+	messageStoreRescanSignal().emit() ;
+}
+
+void GStore::MemoryStore::onFileStoreUpdate()
+{
+	updated() ;
+}
+
+void GStore::MemoryStore::onFileStoreRescan()
+{
+	rescan() ;
+}
+
+bool GStore::MemoryStore::reserve( std::size_t n )
+{
+	if( n > m_config.max_memory || m_used > ( m_config.max_memory - n ) )
+		return false ;
+	m_used += n ;
+	return true ;
+}
+
+void GStore::MemoryStore::release( std::size_t n ) noexcept
+{
+	m_used -= std::min( n , m_used ) ;
+}
+
+void GStore::MemoryStore::insert( const MessageId & id , const Envelope & envelope , std::string && content )
+{
+	G_LOG( "GStore::MemoryStore::insert: new message [" << id.str() << "] (" << content.size() << " bytes in memory)" ) ;
+	Entry & entry = m_map[id.str()] ;
+	entry.envelope = envelope ;
+	entry.content = std::make_shared<const std::string>( std::move(content) ) ;
+	entry.locked = false ;
+}
+
+std::unique_ptr<GStore::StoredMessage> GStore::MemoryStore::lock( Map::iterator p , bool locked )
+{
+	if( locked )
+		p->second.locked = true ;
+	return std::make_unique<StoredMemoryMessage>( *this , MessageId(p->first) ,
+		p->second.envelope , p->second.content , locked ) ;
+}
+
+void GStore::MemoryStore::unlock( const MessageId & id ) noexcept
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p != m_map.end() )
+		p->second.locked = false ;
+}
+
+void GStore::MemoryStore::edit( const MessageId & id , const G::StringArray & recipients )
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p != m_map.end() )
+		p->second.envelope.to_remote = recipients ;
+}
+
+void GStore::MemoryStore::retry( const MessageId & id , unsigned int retry_count , std::time_t retry_time )
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p != m_map.end() )
+	{
+		p->second.envelope.retry_count = retry_count ;
+		p->second.envelope.retry_time = retry_time ;
+	}
+}
+
+void GStore::MemoryStore::remove( const MessageId & id )
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p != m_map.end() )
+	{
+		G_LOG( "GStore::MemoryStore::remove: deleting message [" << id.str() << "]" ) ;
+		release( p->second.content->size() ) ;
+		m_map.erase( p ) ;
+	}
+}
+
+void GStore::MemoryStore::spill( const MessageId & id , bool fail , const std::string & reason , int reason_code )
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p == m_map.end() )
+		return ;
+
+	Envelope envelope = p->second.envelope ;
+	std::shared_ptr<const std::string> content = p->second.content ;
+	release( content->size() ) ;
+	m_map.erase( p ) ;
+
+	// write the content file and then the envelope file, as in GStore::NewFile
+	G::Path content_path = m_file_store.contentPath( id ) ;
+	G::Path envelope_path = m_file_store.envelopePath( id ) ;
+	G::Path envelope_path_new( envelope_path.str() + ".new" ) ;
+	G_LOG( "GStore::MemoryStore::spill: writing message [" << id.str() << "] to [" << envelope_path.basename() << "]" ) ;
+	bool ok = false ;
+	{
+		auto stream = FileStore::stream( content_path ) ;
+		stream->write( content->data() , static_cast<std::streamsize>(content->size()) ) ;
+		stream->close() ;
+		ok = !stream->fail() ;
+	}
+	if( ok )
+	{
+		auto stream = FileStore::stream( envelope_path_new ) ;
+		ok = Envelope::write( *stream , envelope ) != 0U ;
+		stream->close() ;
+		ok = ok && !stream->fail() ;
+	}
+	ok = ok && FileStore::FileOp::rename( envelope_path_new , envelope_path ) ;
+	if( !ok )
+	{
+		G_ERROR( "GStore::MemoryStore::spill: cannot write message [" << id.str() << "] to the spool directory: message lost" ) ;
+		FileStore::FileOp::remove( envelope_path_new ) ;
+		FileStore::FileOp::remove( content_path ) ;
+		return ;
+	}
+
+	if( fail )
+	{
+		MessageStore & base = m_file_store ;
+		base.get( id )->fail( reason , reason_code ) ;
+	}
+}
+
+// ==
+
+GStore::MemoryIterator::MemoryIterator( MemoryStore & store , FileStore & file_store , bool lock ) :
+	m_store(store) ,
+	m_file_store(file_store) ,
+	m_lock(lock)
+{
+	for( const auto & item : m_store.m_map )
+	{
+		if( !item.second.locked )
+			m_ids.push_back( item.first ) ;
+	}
+}
+
+std::unique_ptr<GStore::StoredMessage> GStore::MemoryIterator::next()
+{
+	while( m_index < m_ids.size() )
+	{
+		auto p = m_store.m_map.find( m_ids[m_index++] ) ;
+		if( p != m_store.m_map.end() && !p->second.locked )
+			return m_store.lock( p , m_lock ) ;
+	}
+	if( !m_file_iter )
+	{
+		MessageStore & base = m_file_store ;
+		m_file_iter = base.iterator( m_lock ) ;
+	}
+	return m_file_iter->next() ;
+}
+
+// ==
+
+GStore::NewMemoryMessage::NewMemoryMessage( MemoryStore & store , FileStore & file_store ,
+	const std::string & from , const MessageStore::SmtpInfo & smtp_info ,
+	const std::string & from_auth_out ) :
+		m_store(store) ,
+		m_file_store(file_store) ,
+		m_id(file_store.newId()) ,
+		m_smtp_info(smtp_info)
+{
+	m_env.from = from ;
+	m_env.from_auth_in = smtp_info.auth ;
+	m_env.from_auth_out = from_auth_out ;
+	m_env.body_type = Envelope::parseSmtpBodyType( smtp_info.body ) ;
+	m_env.utf8_mailboxes =
+		smtp_info.address_style == MessageStore::AddressStyle::Utf8Mailbox ||
+		smtp_info.address_style == MessageStore::AddressStyle::Utf8Both ;
+}
+
+GStore::NewMemoryMessage::~NewMemoryMessage()
+{
+	if( !m_committed && !m_file )
+		m_store.release( m_content.size() ) ;
+}
+
+void GStore::NewMemoryMessage::spill()
+{
+	// move to a new file in the file store, keeping the same id
+	G_LOG( "GStore::NewMemoryMessage::spill: memory limit reached: storing [" << m_id.str() << "] in the spool directory" ) ;
+	m_file = std::make_unique<NewFile>( m_file_store , m_env.from , m_smtp_info , m_env.from_auth_out ,
+		m_store.m_config.max_size , m_id ) ;
+	for( const auto & to : m_env.to_local )
+		m_file->addTo( to , true , MessageStore::AddressStyle::Ascii ) ;
+	for( const auto & to : m_env.to_remote )
+		m_file->addTo( to , false , m_env.utf8_mailboxes ? MessageStore::AddressStyle::Utf8Mailbox : MessageStore::AddressStyle::Ascii ) ;
+	if( !m_content.empty() )
+		m_file->addContent( m_content.data() , m_content.size() ) ;
+	m_store.release( m_content.size() ) ;
+	std::string().swap( m_content ) ;
+}
+
+void GStore::NewMemoryMessage::addTo( const std::string & to , bool local , MessageStore::AddressStyle address_style )
+{
+	if( m_file )
+	{
+		m_file->addTo( to , local , address_style ) ;
+	}
+	else if( local )
+	{
+		m_env.to_local.push_back( to ) ;
+	}
+	else
+	{
+		m_env.to_remote.push_back( to ) ;
+		if( address_style == MessageStore::AddressStyle::Utf8Mailbox ||
+			address_style == MessageStore::AddressStyle::Utf8Both )
+		{
+			m_env.utf8_mailboxes = true ;
+		}
+	}
+}
+
+GStore::NewMessage::Status GStore::NewMemoryMessage::addContent( const char * data , std::size_t data_size )
+{
+	if( m_file )
+		return m_file->addContent( data , data_size ) ;
+
+	std::size_t old_size = m_size ;
+	std::size_t new_size = m_size + data_size ;
+	if( new_size < m_size )
+		new_size = std::numeric_limits<std::size_t>::max() ;
+
+	// truncate to max_size bytes, as in GStore::NewFile
+	std::size_t max_size = m_store.m_config.max_size ;
+	std::size_t store_size = data_size ;
+	if( max_size && new_size >= max_size )
+		store_size = std::max(max_size,old_size) - old_size ;
+
+	if( store_size && !m_store.reserve( store_size ) )
+	{
+		spill() ;
+		return m_file->addContent( data , data_size ) ;
+	}
+
+	m_size = new_size ;
+	m_content.append( data , store_size ) ;
+	return ( max_size && m_size >= max_size ) ? NewMessage::Status::TooBig : NewMessage::Status::Ok ;
+}
+
+std::size_t GStore::NewMemoryMessage::contentSize() const
+{
+	return m_file ? m_file->contentSize() : m_size ;
+}
+
+void GStore::NewMemoryMessage::prepare( const std::string & session_auth_id ,
+	const std::string & peer_socket_address , const std::string & peer_certificate )
+{
+	if( m_file )
+	{
+		m_file->prepare( session_auth_id , peer_socket_address , peer_certificate ) ;
+	}
+	else
+	{
+		m_env.authentication = session_auth_id ;
+		m_env.client_socket_address = peer_socket_address ;
+		m_env.client_certificate = peer_certificate ;
+	}
+}
+
+void GStore::NewMemoryMessage::commit( bool throw_on_error )
+{
+	if( m_file )
+	{
+		m_file->commit( throw_on_error ) ;
+	}
+	else
+	{
+		m_committed = true ;
+		m_store.insert( m_id , m_env , std::move(m_content) ) ;
+		m_store.updated() ;
+	}
+}
+
+GStore::MessageId GStore::NewMemoryMessage::id() const
+{
+	return m_id ;
+}
+
+std::string GStore::NewMemoryMessage::location() const
+{
+	return m_file ? m_file->location() : MemoryStoreImp::location( m_id ) ;
+}
+
+// ==
+
+GStore::StoredMemoryMessage::StoredMemoryMessage( MemoryStore & store , const MessageId & id ,
+	const Envelope & envelope , std::shared_ptr<const std::string> content , bool locked ) :
+		m_store(store) ,
+		m_id(id) ,
+		m_env(envelope) ,
+		m_content(content) ,
+		m_buf(m_content->data(),m_content->size()) ,
+		m_stream(&m_buf) ,
+		m_locked(locked)
+{
+}
+
+GStore::StoredMemoryMessage::~StoredMemoryMessage()
+{
+	if( m_locked )
+		m_store.unlock( m_id ) ;
+}
+
+GStore::MessageId GStore::StoredMemoryMessage::id() const
+{
+	return m_id ;
+}
+
+std::string GStore::StoredMemoryMessage::location() const
+{
+	return MemoryStoreImp::location( m_id ) ;
+}
+
+std::string GStore::StoredMemoryMessage::from() const
+{
+	return m_env.from ;
+}
+
+std::string GStore::StoredMemoryMessage::to( std::size_t i ) const
+{
+	return i < m_env.to_remote.size() ? m_env.to_remote[i] : std::string() ;
+}
+
+std::size_t GStore::StoredMemoryMessage::toCount() const
+{
+	return m_env.to_remote.size() ;
+}
+
+std::size_t GStore::StoredMemoryMessage::contentSize() const
+{
+	return m_content->size() ;
+}
+
+std::istream & GStore::StoredMemoryMessage::contentStream()
+{
+	return m_stream ;
+}
+
+std::string_view GStore::StoredMemoryMessage::contentView()
+{
+	return *m_content ;
+}
+
+void GStore::StoredMemoryMessage::close()
+{
+}
+
+std::string GStore::StoredMemoryMessage::reopen()
+{
+	return {} ;
+}
+
+void GStore::StoredMemoryMessage::destroy()
+{
+	m_locked = false ;
+	m_store.remove( m_id ) ;
+}
+
+void GStore::StoredMemoryMessage::fail( const std::string & reason , int reason_code )
+{
+	m_locked = false ;
+	m_store.spill( m_id , true , reason , reason_code ) ;
+}
+
+GStore::MessageStore::BodyType GStore::StoredMemoryMessage::bodyType() const
+{
+	return m_env.body_type ;
+}
+
+std::string GStore::StoredMemoryMessage::authentication() const
+{
+	return m_env.authentication ;
+}
+
+std::string GStore::StoredMemoryMessage::fromAuthIn() const
+{
+	return m_env.from_auth_in ;
+}
+
+std::string GStore::StoredMemoryMessage::fromAuthOut() const
+{
+	return m_env.from_auth_out ;
+}
+
+std::string GStore::StoredMemoryMessage::forwardTo() const
+{
+	return m_env.forward_to ;
+}
+
+std::string GStore::StoredMemoryMessage::forwardToAddress() const
+{
+	return m_env.forward_to_address ;
+}
+
+std::string GStore::StoredMemoryMessage::clientAccountSelector() const
+{
+	return m_env.client_account_selector ;
+}
+
+bool GStore::StoredMemoryMessage::utf8Mailboxes() const
+{
+	return m_env.utf8_mailboxes ;
+}
+
+void GStore::StoredMemoryMessage::editRecipients( const G::StringArray & recipients )
+{
+	m_env.to_remote = recipients ;
+	m_store.edit( m_id , recipients ) ;
+}
+
+unsigned int GStore::StoredMemoryMessage::retryCount() const
+{
+	return m_env.retry_count ;
+}
+
+std::time_t GStore::StoredMemoryMessage::retryTime() const
+{
+	return m_env.retry_time ;
+}
+
+void GStore::StoredMemoryMessage::retry( std::time_t next , const std::string & )
+{
+	m_env.retry_count++ ;
+	m_env.retry_time = next ;
+	m_store.retry( m_id , m_env.retry_count , m_env.retry_time ) ;
+}
@@ -0,0 +1,136 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gmemorystore.h
+///
+
+#ifndef G_SMTP_MEMORY_STORE_H
+#define G_SMTP_MEMORY_STORE_H
+
+#include "gdef.h"
+#include "gmessagestore.h"
+#include "gfilestore.h"
+#include "genvelope.h"
+#include "gexception.h"
+#include "gslot.h"
+#include <map>
+#include <memory>
+#include <string>
+
+namespace GStore
+{
+	class MemoryStore ;
+	class MemoryIterator ;
+	class NewMemoryMessage ;
+	class StoredMemoryMessage ;
+}
+
+//| \class GStore::MemoryStore
+/// A concrete implementation of the MessageStore interface that keeps
+/// new messages in memory, for pure-relay deployments where messages
+/// are forwarded as soon as they are received and the spool files
+/// are just overhead.
+///
+/// Messages are kept in memory up to a configured total size, beyond
+/// which new messages spill over into the wrapped FileStore. Messages
+/// that fail are also moved into the FileStore so that they can be
+/// inspected and re-tried in the normal way, and any messages still in
+/// memory are written out to the FileStore by the destructor. Messages
+/// held in memory are lost if the process is killed.
+///
+/// Stored messages are listed and retrieved from both stores, with
+/// the in-memory messages first.
+///
+class GStore::MemoryStore : public MessageStore
+{
+public:
+	G_EXCEPTION( GetError , tx("error getting message") )
+	struct Config /// Configuration structure for GStore::MemoryStore.
+	{
+		std::size_t max_memory {0U} ; // total in-memory content size
+		std::size_t max_size {0U} ; // zero for unlimited -- see GStore::FileStore::Config
+		Config & set_max_memory( std::size_t ) noexcept ;
+		Config & set_max_size( std::size_t ) noexcept ;
+	} ;
+
+	MemoryStore( FileStore & , const Config & ) ;
+		///< Constructor.
+
+	~MemoryStore() override ;
+		///< Destructor. Writes any remaining in-memory messages
+		///< to the file store.
+
+	std::size_t used() const noexcept ;
+		///< Returns the total size of the message content currently
+		///< held in memory, including new messages.
+
+public:
+	MemoryStore( const MemoryStore & ) = delete ;
+	MemoryStore( MemoryStore && ) = delete ;
+	MemoryStore & operator=( const MemoryStore & ) = delete ;
+	MemoryStore & operator=( MemoryStore && ) = delete ;
+
+private: // overrides
+	bool empty() const override ;
+	std::string location( const MessageId & ) const override ;
+	std::unique_ptr<StoredMessage> get( const MessageId & ) override ;
+	std::unique_ptr<MessageStore::Iterator> iterator( bool lock ) override ;
+	std::unique_ptr<NewMessage> newMessage( const std::string & , const MessageStore::SmtpInfo & , const std::string & ) override ;
+	void updated() override ;
+	G::Slot::Signal<> & messageStoreUpdateSignal() noexcept override ;
+	G::Slot::Signal<> & messageStoreRescanSignal() noexcept override ;
+	std::vector<MessageId> ids() override ;
+	std::vector<MessageId> failures() override ;
+	void unfailAll() override ;
+	void rescan() override ;
+
+private:
+	friend class GStore::MemoryIterator ;
+	friend class GStore::NewMemoryMessage ;
+	friend class GStore::StoredMemoryMessage ;
+	struct Entry /// An in-memory message.
+	{
+		Envelope envelope ;
+		std::shared_ptr<const std::string> content ;
+		bool locked {false} ;
+	} ;
+	using Map = std::map<std::string,Entry> ;
+	bool reserve( std::size_t ) ;
+	void release( std::size_t ) noexcept ;
+	void insert( const MessageId & , const Envelope & , std::string && ) ;
+	std::unique_ptr<StoredMessage> lock( Map::iterator , bool ) ;
+	void unlock( const MessageId & ) noexcept ;
+	void edit( const MessageId & , const G::StringArray & ) ;
+	void retry( const MessageId & , unsigned int , std::time_t ) ;
+	void remove( const MessageId & ) ;
+	void spill( const MessageId & , bool fail , const std::string & reason , int reason_code ) ;
+	void onFileStoreUpdate() ;
+	void onFileStoreRescan() ;
+
+private:
+	FileStore & m_file_store ;
+	Config m_config ;
+	Map m_map ;
+	std::size_t m_used {0U} ;
+	G::Slot::Signal<> m_update_signal ;
+	G::Slot::Signal<> m_rescan_signal ;
+} ;
+
+inline GStore::MemoryStore::Config & GStore::MemoryStore::Config::set_max_memory( std::size_t n ) noexcept { max_memory = n ; return *this ; }
+inline GStore::MemoryStore::Config & GStore::MemoryStore::Config::set_max_size( std::size_t n ) noexcept { max_size = n ; return *this ; }
+
+#endif
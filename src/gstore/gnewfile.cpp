@@ -21,9 +21,11 @@
 #include "gdef.h"
 #include "gfilestore.h"
 #include "gnewfile.h"
+#include "gssl.h"
 #include "gprocess.h"
 #include "groot.h"
 #include "gfile.h"
+#include "gmetrics.h"
 #include "gstr.h"
 #include "gxtext.h"
 #include "gassert.h"
@@ -34,11 +36,20 @@
 #include <iostream>
 #include <fstream>
 
+namespace GStore
+{
+	namespace NewFileImp
+	{
+		G::Metrics::Counter stored( "emailrelay_spool_messages_total" , "op=\"stored\"" , "Spool operations" ) ;
+		G::Metrics::Counter stored_bytes( "emailrelay_spool_stored_bytes_total" , "" , "Message content bytes stored in the spool" ) ;
+	}
+}
+
 GStore::NewFile::NewFile( FileStore & store , const std::string & from ,
 	const MessageStore::SmtpInfo & smtp_info , const std::string & from_auth_out ,
-	std::size_t max_size ) :
+	std::size_t max_size , const MessageId & id ) :
 		m_store(store) ,
-		m_id(store.newId()) ,
+		m_id(id.valid()?id:store.newId()) ,
 		m_max_size(max_size)
 {
 	m_env.from = from ;
@@ -52,6 +63,9 @@ GStore::NewFile::NewFile( FileStore & store , const std::string & from ,
 	// ask the store for a content stream
 	G_LOG( "GStore::NewFile: new content file [" << cpath().basename() << "]" ) ;
 	m_content = FileStore::stream( cpath() ) ;
+
+	// digest the content as it arrives if de-duplicating
+	m_digester = m_store.digester() ;
 }
 
 GStore::NewFile::~NewFile()
@@ -85,10 +99,18 @@ void GStore::NewFile::prepare( const std::string & session_auth_id ,
 {
 	// flush and close the content file
 	G_ASSERT( m_content != nullptr ) ;
-	m_content->close() ;
+	if( m_deferred )
+		writeContent( true ) ; // no-op if already done
+	else
+		m_content->close() ;
 	if( m_content->fail() )
 		throw FileError( "cannot write content file " + cpath().str() ) ;
 	m_content.reset() ;
+	if( m_digester )
+	{
+		FileReader claim_reader ;
+		m_content_stat = G::File::stat( cpath() ) ;
+	}
 
 	// save the envelope
 	m_env.authentication = session_auth_id ;
@@ -101,10 +123,31 @@ void GStore::NewFile::prepare( const std::string & session_auth_id ,
 
 void GStore::NewFile::commit( bool throw_on_error )
 {
+	// use the content digest from addContent() unless the content has changed
+	if( m_digester )
+	{
+		G::File::Stat content_stat ;
+		{
+			FileReader claim_reader ;
+			content_stat = G::File::stat( cpath() ) ;
+		}
+		std::string digest_name = same( m_content_stat , content_stat ) ? m_store.digestName( *m_digester ) : std::string() ;
+		m_digester.reset() ;
+		digest_name = m_store.dedup( cpath() , digest_name ) ;
+		if( !digest_name.empty() )
+			saveDigest( digest_name , epath(State::New) ) ;
+	}
+
 	m_committed = true ;
 	m_saved = FileOp::rename( epath(State::New) , epath(State::Normal) ) ;
 	if( !m_saved && throw_on_error )
 		throw FileError( "cannot rename envelope file to " + epath(State::Normal).str() ) ;
+	if( m_saved )
+	{
+		m_store.indexUpdate( id() ) ;
+		NewFileImp::stored.add() ;
+		NewFileImp::stored_bytes.add( contentSize() ) ;
+	}
 	static_cast<MessageStore&>(m_store).updated() ;
 }
 
@@ -138,13 +181,31 @@ GStore::NewMessage::Status GStore::NewFile::addContent( const char * data , std:
 	if( m_max_size && new_size >= m_max_size )
 		data_size = std::max(m_max_size,old_size) - old_size ;
 
-	if( data_size )
+	if( m_digester && data_size )
+		m_digester->add( std::string_view(data,data_size) ) ;
+
+	bool failed = false ;
+	if( m_deferred )
+	{
+		G::threading::lock_type lock( m_mutex ) ;
+		if( data_size )
+		{
+			m_queue.append( data , data_size ) ;
+			m_queued += data_size ;
+		}
+		failed = m_write_error ;
+	}
+	else
 	{
-		std::ostream & stream = *m_content ;
-		stream.write( data , data_size ) ; // NOLINT narrowing
+		if( data_size )
+		{
+			std::ostream & stream = *m_content ;
+			stream.write( data , data_size ) ; // NOLINT narrowing
+		}
+		failed = m_content->fail() ;
 	}
 
-	if( m_content->fail() )
+	if( failed )
 		return NewMessage::Status::Error ;
 	else if( m_max_size && m_size >= m_max_size )
 		return NewMessage::Status::TooBig ;
@@ -152,6 +213,40 @@ GStore::NewMessage::Status GStore::NewFile::addContent( const char * data , std:
 		return NewMessage::Status::Ok ;
 }
 
+bool GStore::NewFile::deferContent()
+{
+	G_ASSERT( m_size == 0U ) ;
+	m_deferred = true ;
+	return true ;
+}
+
+std::size_t GStore::NewFile::queuedContent() const
+{
+	G::threading::lock_type lock( m_mutex ) ;
+	return m_queued ;
+}
+
+void GStore::NewFile::writeContent( bool close )
+{
+	// swap the queue into our own buffer so that addContent()
+	// can carry on queueing while we write
+	m_buffer.clear() ;
+	{
+		G::threading::lock_type lock( m_mutex ) ;
+		m_queue.swap( m_buffer ) ;
+	}
+
+	if( !m_buffer.empty() )
+		m_content->write( m_buffer.data() , m_buffer.size() ) ; // NOLINT narrowing
+	if( close && m_content->is_open() )
+		m_content->close() ;
+	bool failed = m_content->fail() ;
+
+	G::threading::lock_type lock( m_mutex ) ;
+	m_queued -= m_buffer.size() ;
+	m_write_error = failed ;
+}
+
 std::size_t GStore::NewFile::contentSize() const
 {
 	// wrt addContent() -- counts beyond max_size -- not valid if stream.fail()
@@ -169,6 +264,20 @@ void GStore::NewFile::saveEnvelope( Envelope & env , const G::Path & path )
 		throw FileError( "cannot write envelope file" , path.str() ) ;
 }
 
+void GStore::NewFile::saveDigest( const std::string & digest_name , const G::Path & path )
+{
+	m_env.digest = digest_name ;
+	std::ofstream stream ;
+	if( FileOp::openAppend( stream , path ) )
+		Envelope::writeDigest( stream , m_env ) ;
+}
+
+bool GStore::NewFile::same( const G::File::Stat & a , const G::File::Stat & b )
+{
+	return !a.error && !b.error && a.inode == b.inode && a.size == b.size &&
+		a.mtime_s == b.mtime_s && a.mtime_us == b.mtime_us ;
+}
+
 GStore::MessageId GStore::NewFile::id() const
 {
 	return m_id ;
@@ -27,6 +27,7 @@
 #include "gstringarray.h"
 #include "gnewmessage.h"
 #include "gexception.h"
+#include <string>
 #include <memory>
 #include <fstream>
 
@@ -45,16 +46,28 @@ namespace GStore
 /// The commit() override renames the envelope file to remove the ".new"
 /// filename extension. This makes it visible to FileStore::iterator().
 ///
+/// Deferred content is queued in memory by addContent() and written
+/// to the content file by writeContent(), with a mutex protecting
+/// the queue so that writeContent() can run on a worker thread.
+///
+/// If the store is de-duplicating then addContent() also digests the
+/// content as it arrives, so that commit() does not need to read the
+/// content file back unless it was changed after prepare(), eg. by a
+/// filter. The digest name is saved in the envelope for use when the
+/// message is deleted.
+///
 class GStore::NewFile : public NewMessage
 {
 public:
 	G_EXCEPTION( FileError , tx("message store error") )
 
 	NewFile( FileStore & store , const std::string & from , const MessageStore::SmtpInfo & ,
-		const std::string & from_auth_out , std::size_t max_size ) ;
+		const std::string & from_auth_out , std::size_t max_size ,
+		const MessageId & id = MessageId::none() ) ;
 			///< Constructor. The max-size is the size limit, as also
 			///< reported by the EHLO response, and is not the size
-			///< estimate from MAIL-FROM.
+			///< estimate from MAIL-FROM. A new message id is obtained
+			///< from the store unless a valid one is supplied.
 
 	~NewFile() override ;
 		///< Destructor. If the new message has not been
@@ -78,6 +91,9 @@ private: // overrides
 	std::size_t contentSize() const override ; // GStore::NewMessage
 	void prepare( const std::string & auth_id , const std::string & peer_socket_address ,
 		const std::string & peer_certificate ) override ; // GStore::NewMessage
+	bool deferContent() override ; // GStore::NewMessage
+	std::size_t queuedContent() const override ; // GStore::NewMessage
+	void writeContent( bool close ) override ; // GStore::NewMessage
 
 private:
 	using FileOp = FileStore::FileOp ;
@@ -86,6 +102,8 @@ private:
 	G::Path epath( State ) const ;
 	void cleanup() ;
 	void saveEnvelope( Envelope & , const G::Path & ) ;
+	void saveDigest( const std::string & , const G::Path & ) ;
+	static bool same( const G::File::Stat & , const G::File::Stat & ) ;
 
 private:
 	FileStore & m_store ;
@@ -96,6 +114,14 @@ private:
 	std::size_t m_size {0U} ;
 	std::size_t m_max_size ;
 	Envelope m_env ;
+	std::unique_ptr<GSsl::Digester> m_digester ;
+	G::File::Stat m_content_stat ;
+	bool m_deferred {false} ;
+	mutable G::threading::mutex_type m_mutex ; // protects the members below
+	std::string m_queue ;
+	std::size_t m_queued {0U} ;
+	bool m_write_error {false} ;
+	std::string m_buffer ; // writeContent() only
 } ;
 
 #endif
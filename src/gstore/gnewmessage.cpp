@@ -29,3 +29,16 @@ void GStore::NewMessage::addContentLine( const std::string & line )
 	addContent( "\r\n" , 2U ) ;
 }
 
+bool GStore::NewMessage::deferContent()
+{
+	return false ;
+}
+
+std::size_t GStore::NewMessage::queuedContent() const
+{
+	return 0U ;
+}
+
+void GStore::NewMessage::writeContent( bool )
+{
+}
@@ -43,6 +43,11 @@ namespace GStore
 /// startFiltering( new_msg ) ;
 /// \endcode
 ///
+/// If deferContent() returns true then addContent() only queues
+/// the content and writeContent() is used, possibly on another
+/// thread, to write it out. Anything still queued is written out
+/// by prepare().
+///
 /// \see GStore::MessageStore
 ///
 class GStore::NewMessage
@@ -89,6 +94,26 @@ public:
 		///< A convenience function that calls addContent() taking
 		///< a string parameter and adding CR-LF.
 
+	virtual bool deferContent() ;
+		///< Requests that subsequent addContent() calls just queue the
+		///< content in memory so that it can be written out separately
+		///< by writeContent(), typically on a worker thread. Returns
+		///< false if not supported. This default implementation
+		///< returns false.
+
+	virtual std::size_t queuedContent() const ;
+		///< Returns the number of deferred content bytes that have
+		///< not yet been written out. Thread-safe with respect to
+		///< writeContent(). This default implementation returns zero.
+
+	virtual void writeContent( bool close ) ;
+		///< Writes out the deferred content, optionally flushing and
+		///< closing the content file as well. Can be called from a
+		///< worker thread as long as the only concurrent calls are
+		///< to addContent() and queuedContent(). Write errors are
+		///< thrown by prepare(). This default implementation does
+		///< nothing.
+
 	virtual ~NewMessage() = default ;
 		///< Destructor. Rolls back any prepare()d storage
 		///< if un-commit()ed.
@@ -0,0 +1,1283 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gsegmentstore.cpp
+///
+
+#include "gdef.h"
+#include "gsegmentstore.h"
+#include "gnewmessage.h"
+#include "gstoredmessage.h"
+#include "gdirectory.h"
+#include "gfile.h"
+#include "gstr.h"
+#include "glog.h"
+#include "gscope.h"
+#include "gassert.h"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <sstream>
+#include <utility>
+#include <iostream>
+
+namespace GStore
+{
+	class SegmentStreamBuf ;
+	namespace SegmentStoreImp
+	{
+		const char * const segment_magic = "emailrelay-segment 1" ;
+		const char * const index_magic = "emailrelay-segment-index 1" ;
+		bool toSize( const std::string & s , std::size_t & n )
+		{
+			if( !G::Str::isULong(s) ) return false ;
+			n = static_cast<std::size_t>( G::Str::toULong(s) ) ;
+			return true ;
+		}
+		bool readPayload( std::istream & in , std::size_t n , std::string & out )
+		{
+			out.resize( n ) ;
+			if( n ) in.read( &out[0] , static_cast<std::streamsize>(n) ) ;
+			return in.good() || ( n == 0U ) || ( in.gcount() == static_cast<std::streamsize>(n) ) ;
+		}
+		std::size_t fileSize( std::istream & in )
+		{
+			in.clear() ;
+			in.seekg( 0 , std::ios_base::end ) ;
+			std::streamoff n = in.tellg() ;
+			in.seekg( 0 ) ;
+			return n > 0 ? static_cast<std::size_t>(n) : 0U ;
+		}
+	}
+}
+
+class GStore::SegmentStreamBuf : public std::streambuf /// A streambuf for message content in a segment file.
+{
+public:
+	SegmentStreamBuf( const G::Path & path , std::streamoff offset , std::size_t size ) ;
+	bool ok() const noexcept ;
+
+protected:
+	int_type underflow() override ;
+
+public:
+	~SegmentStreamBuf() override = default ;
+	SegmentStreamBuf( const SegmentStreamBuf & ) = delete ;
+	SegmentStreamBuf( SegmentStreamBuf && ) = delete ;
+	SegmentStreamBuf & operator=( const SegmentStreamBuf & ) = delete ;
+	SegmentStreamBuf & operator=( SegmentStreamBuf && ) = delete ;
+
+private:
+	std::filebuf m_file ;
+	std::size_t m_remaining ;
+	std::array<char,4096U> m_buffer {} ;
+	bool m_ok {false} ;
+} ;
+
+class GStore::SegmentIterator : public MessageStore::Iterator /// A GStore::MessageStore::Iterator for GStore::SegmentStore.
+{
+public:
+	SegmentIterator( SegmentStore & store , FileStore & file_store , bool lock ) ;
+
+private: // overrides
+	std::unique_ptr<StoredMessage> next() override ;
+
+public:
+	~SegmentIterator() override = default ;
+	SegmentIterator( const SegmentIterator & ) = delete ;
+	SegmentIterator( SegmentIterator && ) = delete ;
+	SegmentIterator & operator=( const SegmentIterator & ) = delete ;
+	SegmentIterator & operator=( SegmentIterator && ) = delete ;
+
+private:
+	SegmentStore & m_store ;
+	FileStore & m_file_store ;
+	bool m_lock ;
+	G::StringArray m_ids ;
+	std::size_t m_index {0U} ;
+	std::unique_ptr<MessageStore::Iterator> m_file_iter ;
+} ;
+
+class GStore::NewSegmentMessage : public NewMessage /// A GStore::NewMessage for GStore::SegmentStore.
+{
+public:
+	NewSegmentMessage( SegmentStore & , const MessageId & , const std::string & from ,
+		const MessageStore::SmtpInfo & , const std::string & from_auth_out ) ;
+	~NewSegmentMessage() override ;
+
+private: // overrides
+	void commit( bool strict ) override ;
+	MessageId id() const override ;
+	std::string location() const override ;
+	void addTo( const std::string & to , bool local , MessageStore::AddressStyle ) override ;
+	NewMessage::Status addContent( const char * , std::size_t ) override ;
+	std::size_t contentSize() const override ;
+	void prepare( const std::string & auth_id , const std::string & peer_socket_address ,
+		const std::string & peer_certificate ) override ;
+
+public:
+	NewSegmentMessage( const NewSegmentMessage & ) = delete ;
+	NewSegmentMessage( NewSegmentMessage && ) = delete ;
+	NewSegmentMessage & operator=( const NewSegmentMessage & ) = delete ;
+	NewSegmentMessage & operator=( NewSegmentMessage && ) = delete ;
+
+private:
+	G::Path tmpPath() const ;
+
+private:
+	SegmentStore & m_store ;
+	MessageId m_id ;
+	Envelope m_env ;
+	std::string m_content ;
+	std::unique_ptr<std::ofstream> m_tmp ;
+	std::size_t m_size {0U} ;
+	bool m_committed {false} ;
+} ;
+
+class GStore::StoredSegmentMessage : public StoredMessage /// A GStore::StoredMessage for GStore::SegmentStore.
+{
+public:
+	StoredSegmentMessage( SegmentStore & , const MessageId & , const Envelope & ,
+		const G::Path & segment , std::streamoff offset , std::size_t size , bool locked ) ;
+	~StoredSegmentMessage() override ;
+	bool ok() const noexcept ;
+
+private: // overrides
+	MessageId id() const override ;
+	std::string location() const override ;
+	std::string from() const override ;
+	std::string to( std::size_t ) const override ;
+	std::size_t toCount() const override ;
+	std::size_t contentSize() const override ;
+	std::istream & contentStream() override ;
+	std::string_view contentView() override ;
+	void close() override ;
+	std::string reopen() override ;
+	void destroy() override ;
+	void fail( const std::string & reason , int reason_code ) override ;
+	MessageStore::BodyType bodyType() const override ;
+	std::string authentication() const override ;
+	std::string fromAuthIn() const override ;
+	std::string fromAuthOut() const override ;
+	std::string forwardTo() const override ;
+	std::string forwardToAddress() const override ;
+	std::string clientAccountSelector() const override ;
+	bool utf8Mailboxes() const override ;
+	void editRecipients( const G::StringArray & ) override ;
+	unsigned int retryCount() const override ;
+	std::time_t retryTime() const override ;
+	void retry( std::time_t , const std::string & ) override ;
+
+public:
+	StoredSegmentMessage( const StoredSegmentMessage & ) = delete ;
+	StoredSegmentMessage( StoredSegmentMessage && ) = delete ;
+	StoredSegmentMessage & operator=( const StoredSegmentMessage & ) = delete ;
+	StoredSegmentMessage & operator=( StoredSegmentMessage && ) = delete ;
+
+private:
+	SegmentStore & m_store ;
+	MessageId m_id ;
+	Envelope m_env ;
+	std::string m_location ;
+	std::size_t m_size ;
+	SegmentStreamBuf m_buf ;
+	std::istream m_stream ;
+	bool m_locked ;
+} ;
+
+// ===
+
+GStore::SegmentStore::SegmentStore( FileStore & file_store , const Config & config ) :
+	m_file_store(file_store) ,
+	m_config(config) ,
+	m_dir(file_store.directory()/".segments")
+{
+	load() ;
+	MessageStore & base = m_file_store ;
+	base.messageStoreUpdateSignal().connect( G::Slot::slot(*this,&SegmentStore::onFileStoreUpdate) ) ;
+	base.messageStoreRescanSignal().connect( G::Slot::slot(*this,&SegmentStore::onFileStoreRescan) ) ;
+}
+
+GStore::SegmentStore::~SegmentStore()
+{
+	MessageStore & base = m_file_store ;
+	base.messageStoreUpdateSignal().disconnect() ;
+	base.messageStoreRescanSignal().disconnect() ;
+	try
+	{
+		m_out.close() ;
+		saveIndex() ;
+	}
+	catch(...) // dtor
+	{
+	}
+}
+
+G::Path GStore::SegmentStore::directory() const
+{
+	return m_dir ;
+}
+
+G::Path GStore::SegmentStore::segmentPath( unsigned int segment ) const
+{
+	std::string name = G::Str::fromUInt( segment ) ;
+	return m_dir / std::string(8U-std::min(std::size_t(8U),name.size()),'0').append(name).append(".log") ;
+}
+
+G::Path GStore::SegmentStore::indexPath() const
+{
+	return m_dir / "index" ;
+}
+
+void GStore::SegmentStore::load()
+{
+	using FileOp = FileStore::FileOp ;
+	if( !FileOp::isdir(m_dir) && !FileOp::mkdir(m_dir) && !FileOp::isdir(m_dir) )
+		throw Error( "cannot create segment directory" , m_dir.str() ) ;
+
+	// list the segment files
+	std::vector<unsigned int> segments ;
+	{
+		G::DirectoryList list ;
+		{
+			DirectoryReader claim_reader ;
+			list.readType( m_dir , ".log" ) ;
+		}
+		while( list.more() )
+		{
+			std::string name = list.filePath().withoutExtension().basename() ;
+			if( G::Str::isUInt(name) )
+				segments.push_back( G::Str::toUInt(name) ) ;
+		}
+		std::sort( segments.begin() , segments.end() ) ;
+	}
+
+	// load the index, or start from scratch
+	unsigned int from_segment = 0U ;
+	std::size_t from_pos = 0U ;
+	if( !loadIndex( from_segment , from_pos ) )
+	{
+		m_map.clear() ;
+		m_segments.clear() ;
+		from_segment = segments.empty() ? 0U : segments.front() ;
+		from_pos = 0U ;
+	}
+
+	// drop anything indexed in a segment that has gone missing
+	for( auto p = m_segments.begin() ; p != m_segments.end() ; )
+	{
+		if( std::binary_search( segments.begin() , segments.end() , p->first ) )
+		{
+			++p ;
+		}
+		else
+		{
+			G_WARNING( "GStore::SegmentStore::load: missing segment file: " << segmentPath(p->first).basename() ) ;
+			for( auto q = m_map.begin() ; q != m_map.end() ; )
+				q = q->second.segment == p->first ? m_map.erase(q) : std::next(q) ;
+			p = m_segments.erase( p ) ;
+		}
+	}
+
+	// replay records written since the index was saved
+	for( unsigned int segment : segments )
+	{
+		if( segment > from_segment || ( segment == from_segment && from_pos != 0U ) || !m_segments.count(segment) )
+		{
+			if( segment >= from_segment )
+				replay( segment , segment == from_segment ? from_pos : 0U ) ;
+			else
+				m_segments[segment] ; // orphan from an interrupted compaction
+		}
+	}
+
+	// the active segment file is not created until it is first written
+	m_active = segments.empty() ? 1U : ( segments.back() + 1U ) ;
+	G_LOG( "GStore::SegmentStore::load: " << m_map.size() << " message(s) in " << m_segments.size() << " segment(s)" ) ;
+	compact() ;
+	saveIndex() ;
+}
+
+bool GStore::SegmentStore::loadIndex( unsigned int & from_segment , std::size_t & from_pos )
+{
+	namespace imp = SegmentStoreImp ;
+	std::ifstream in ;
+	if( !FileStore::FileOp::exists(indexPath()) || !FileStore::FileOp::openIn( in , indexPath() ) )
+		return false ;
+
+	std::string line ;
+	if( !std::getline( in , line ) || line != imp::index_magic )
+	{
+		G_WARNING( "GStore::SegmentStore::loadIndex: invalid index file: " << indexPath() ) ;
+		return false ;
+	}
+
+	bool have_position = false ;
+	while( std::getline( in , line ) )
+	{
+		G::StringArray part = G::Str::splitIntoTokens( line , " " ) ;
+		if( part.size() == 3U && part[0] == "P" && G::Str::isUInt(part[1]) && imp::toSize(part[2],from_pos) )
+		{
+			from_segment = G::Str::toUInt( part[1] ) ;
+			have_position = true ;
+		}
+		else if( part.size() == 4U && part[0] == "S" && G::Str::isUInt(part[1]) )
+		{
+			Segment & segment = m_segments[G::Str::toUInt(part[1])] ;
+			if( !imp::toSize(part[2],segment.size) || !imp::toSize(part[3],segment.live) )
+				return false ;
+		}
+		else if( part.size() == 10U && part[0] == "M" && G::Str::isUInt(part[2]) && G::Str::isULong(part[3]) && G::Str::isInt(part[7]) )
+		{
+			Entry entry ;
+			std::size_t envelope_size = 0U ;
+			std::size_t reason_size = 0U ;
+			entry.segment = G::Str::toUInt( part[2] ) ;
+			entry.offset = static_cast<std::streamoff>( G::Str::toULong(part[3]) ) ;
+			entry.state = part[6] == "1" ? State::Bad : State::Normal ;
+			entry.reason_code = G::Str::toInt( part[7] ) ;
+			std::string envelope ;
+			if( !imp::toSize(part[4],entry.size) || !imp::toSize(part[5],entry.record_size) ||
+				!imp::toSize(part[8],envelope_size) || !imp::toSize(part[9],reason_size) ||
+				!imp::readPayload(in,envelope_size,envelope) || !imp::readPayload(in,reason_size,entry.reason) )
+					return false ;
+			std::istringstream ss( envelope ) ;
+			Envelope::read( ss , entry.envelope ) ;
+			Envelope::readExtra( ss , entry.envelope ) ;
+			m_map[part[1]] = entry ;
+		}
+		else
+		{
+			G_WARNING( "GStore::SegmentStore::loadIndex: invalid index file: " << indexPath() ) ;
+			return false ;
+		}
+	}
+	return have_position ;
+}
+
+void GStore::SegmentStore::saveIndex()
+{
+	namespace imp = SegmentStoreImp ;
+	G::Path tmp_path( indexPath().str() + ".tmp" ) ;
+	std::ofstream out ;
+	if( !FileStore::FileOp::openOut( out , tmp_path ) )
+		throw Error( "cannot create segment index" , tmp_path.str() ) ;
+
+	out << imp::index_magic << "\n" ;
+	auto active = m_segments.find( m_active ) ;
+	out << "P " << m_active << " " << (active==m_segments.end()?std::size_t(0U):active->second.size) << "\n" ;
+	for( const auto & segment : m_segments )
+		out << "S " << segment.first << " " << segment.second.size << " " << segment.second.live << "\n" ;
+	for( const auto & item : m_map )
+	{
+		const Entry & entry = item.second ;
+		std::string envelope = envelopeString( entry.envelope ) ;
+		out << "M " << item.first << " " << entry.segment << " " << entry.offset << " "
+			<< entry.size << " " << entry.record_size << " " << (entry.state==State::Bad?1:0) << " "
+			<< entry.reason_code << " " << envelope.size() << " " << entry.reason.size() << "\n"
+			<< envelope << entry.reason ;
+	}
+	out.close() ;
+	if( out.fail() || !FileStore::FileOp::renameOnto( tmp_path , indexPath() ) )
+	{
+		FileStore::FileOp::remove( tmp_path ) ;
+		throw Error( "cannot write segment index" , indexPath().str() ) ;
+	}
+}
+
+void GStore::SegmentStore::replay( unsigned int segment , std::size_t pos )
+{
+	std::ifstream in ;
+	if( !FileStore::FileOp::openIn( in , segmentPath(segment) ) )
+	{
+		G_WARNING( "GStore::SegmentStore::replay: cannot open segment file: " << segmentPath(segment) ) ;
+		return ;
+	}
+	G_DEBUG( "GStore::SegmentStore::replay: segment " << segment << ": replaying from " << pos ) ;
+	replay( segment , in , pos ) ;
+}
+
+std::size_t GStore::SegmentStore::replay( unsigned int segment_number , std::istream & in , std::size_t pos )
+{
+	namespace imp = SegmentStoreImp ;
+	Segment & segment = m_segments[segment_number] ;
+	segment.size = imp::fileSize( in ) ;
+	in.seekg( static_cast<std::streamoff>(pos) ) ;
+
+	std::string line ;
+	if( pos == 0U )
+	{
+		if( !std::getline( in , line ) || line != imp::segment_magic )
+		{
+			G_WARNING( "GStore::SegmentStore::replay: invalid segment file: " << segmentPath(segment_number) ) ;
+			return 0U ;
+		}
+		pos = static_cast<std::size_t>( in.tellg() ) ;
+	}
+
+	std::string payload ;
+	while( std::getline( in , line ) && !in.eof() )
+	{
+		G::StringArray part = G::Str::splitIntoTokens( line , " " ) ;
+		std::size_t header_size = line.size() + 1U ;
+		std::size_t n1 = 0U ;
+		std::size_t n2 = 0U ;
+		if( part.size() == 4U && part[0] == "M" && imp::toSize(part[2],n1) && imp::toSize(part[3],n2) )
+		{
+			if( !imp::readPayload( in , n1 , payload ) || (pos+header_size+n1+n2) > segment.size )
+				break ;
+			Entry entry ;
+			entry.segment = segment_number ;
+			entry.offset = static_cast<std::streamoff>( pos + header_size + n1 ) ;
+			entry.size = n2 ;
+			entry.record_size = header_size + n1 + n2 ;
+			std::istringstream ss( payload ) ;
+			Envelope::read( ss , entry.envelope ) ;
+			Envelope::readExtra( ss , entry.envelope ) ;
+			auto p = m_map.find( part[1] ) ;
+			if( p != m_map.end() )
+				release( p->second.segment , p->second.record_size ) ;
+			m_map[part[1]] = entry ;
+			segment.live += entry.record_size ;
+			in.seekg( static_cast<std::streamoff>(n2) , std::ios_base::cur ) ;
+		}
+		else if( part.size() == 3U && part[0] == "E" && imp::toSize(part[2],n1) )
+		{
+			if( !imp::readPayload( in , n1 , payload ) )
+				break ;
+			auto p = m_map.find( part[1] ) ;
+			if( p != m_map.end() )
+			{
+				std::istringstream ss( payload ) ;
+				Envelope::read( ss , p->second.envelope ) ;
+				Envelope::readExtra( ss , p->second.envelope ) ;
+			}
+		}
+		else if( part.size() == 4U && part[0] == "F" && G::Str::isInt(part[2]) && imp::toSize(part[3],n1) )
+		{
+			if( !imp::readPayload( in , n1 , payload ) )
+				break ;
+			auto p = m_map.find( part[1] ) ;
+			if( p != m_map.end() )
+			{
+				p->second.state = State::Bad ;
+				p->second.reason = payload ;
+				p->second.reason_code = G::Str::toInt( part[2] ) ;
+			}
+		}
+		else if( part.size() == 2U && part[0] == "U" )
+		{
+			auto p = m_map.find( part[1] ) ;
+			if( p != m_map.end() )
+			{
+				p->second.state = State::Normal ;
+				p->second.reason.clear() ;
+				p->second.reason_code = 0 ;
+			}
+		}
+		else if( part.size() == 2U && part[0] == "D" )
+		{
+			auto p = m_map.find( part[1] ) ;
+			if( p != m_map.end() )
+			{
+				release( p->second.segment , p->second.record_size ) ;
+				m_map.erase( p ) ;
+			}
+		}
+		else
+		{
+			G_WARNING( "GStore::SegmentStore::replay: invalid record in segment file: " << segmentPath(segment_number) ) ;
+			break ;
+		}
+		std::streamoff new_pos = in.tellg() ;
+		if( new_pos < 0 )
+			break ;
+		pos = static_cast<std::size_t>( new_pos ) ;
+	}
+	if( pos < segment.size )
+		G_LOG( "GStore::SegmentStore::replay: ignoring incomplete record at the end of segment " << segmentPath(segment_number).basename() ) ;
+	return pos ;
+}
+
+void GStore::SegmentStore::startSegment()
+{
+	m_out.close() ;
+	m_out.clear() ;
+	G::Path path = segmentPath( m_active ) ;
+	G_LOG( "GStore::SegmentStore::startSegment: new segment file [" << path.basename() << "]" ) ;
+	if( !FileStore::FileOp::openAppend( m_out , path ) )
+		throw Error( "cannot create segment file" , path.str() ) ;
+	std::string magic = std::string(SegmentStoreImp::segment_magic).append(1U,'\n') ;
+	m_out << magic << std::flush ;
+	if( m_out.fail() )
+		throw Error( "cannot write segment file" , path.str() ) ;
+	Segment & segment = m_segments[m_active] ;
+	segment.size = magic.size() ;
+	segment.live = 0U ;
+}
+
+void GStore::SegmentStore::append( const std::string & header , const std::string & payload )
+{
+	if( !m_out.is_open() )
+	{
+		startSegment() ;
+	}
+	else if( m_out.fail() )
+	{
+		m_active++ ;
+		startSegment() ;
+	}
+	m_out << header << "\n" << payload << std::flush ;
+	m_segments[m_active].size += header.size() + 1U + payload.size() ;
+	if( m_out.fail() )
+		throw Error( "cannot write segment file" , segmentPath(m_active).str() ) ;
+}
+
+void GStore::SegmentStore::commit( const MessageId & id , const Envelope & envelope ,
+	const std::string & content , std::istream * content_stream )
+{
+	G_ASSERT( content_stream == nullptr || content.empty() ) ;
+	if( !m_out.is_open() )
+	{
+		startSegment() ;
+		saveIndex() ;
+	}
+	else if( m_out.fail() || m_segments[m_active].size >= m_config.segment_size )
+	{
+		m_active++ ;
+		startSegment() ;
+		saveIndex() ;
+	}
+
+	std::size_t content_size = content.size() ;
+	if( content_stream )
+		content_size = SegmentStoreImp::fileSize( *content_stream ) ;
+
+	std::string envelope_string = envelopeString( envelope ) ;
+	std::string header = std::string("M ").append(id.str()).append(1U,' ')
+		.append(std::to_string(envelope_string.size())).append(1U,' ').append(std::to_string(content_size)) ;
+
+	Segment & segment = m_segments[m_active] ;
+	std::size_t record_size = header.size() + 1U + envelope_string.size() + content_size ;
+	std::streamoff offset = static_cast<std::streamoff>( segment.size + header.size() + 1U + envelope_string.size() ) ;
+	m_out << header << "\n" << envelope_string << content ;
+	if( content_stream )
+		G::File::copy( *content_stream , m_out ) ;
+	m_out << std::flush ;
+	segment.size += record_size ;
+	if( m_out.fail() )
+		throw Error( "cannot write segment file" , segmentPath(m_active).str() ) ;
+
+	// build the new entry before replacing the old one since the
+	// envelope might belong to it, as when compacting
+	Entry entry ;
+	entry.segment = m_active ;
+	entry.offset = offset ;
+	entry.size = content_size ;
+	entry.record_size = record_size ;
+	entry.envelope = envelope ;
+	auto p = m_map.find( id.str() ) ;
+	if( p != m_map.end() )
+		release( p->second.segment , p->second.record_size ) ;
+	m_map[id.str()] = std::move( entry ) ;
+	segment.live += record_size ;
+}
+
+std::string GStore::SegmentStore::envelopeString( const Envelope & envelope )
+{
+	std::ostringstream ss ;
+	Envelope::write( ss , envelope ) ;
+	if( envelope.retry_count )
+		Envelope::writeRetry( ss , envelope ) ;
+	return ss.str() ;
+}
+
+void GStore::SegmentStore::release( unsigned int segment_number , std::size_t record_size )
+{
+	auto p = m_segments.find( segment_number ) ;
+	if( p != m_segments.end() )
+		p->second.live -= std::min( p->second.live , record_size ) ;
+}
+
+void GStore::SegmentStore::compact()
+{
+	if( m_compacting ) return ;
+	m_compacting = true ;
+	G::ScopeExitSetFalse _( m_compacting ) ;
+	std::vector<unsigned int> list ;
+	for( const auto & item : m_segments )
+	{
+		const Segment & segment = item.second ;
+		if( item.first != m_active &&
+			( segment.live == 0U ||
+				static_cast<unsigned long long>(segment.live) * 100ULL <
+				static_cast<unsigned long long>(segment.size) * m_config.compaction ) &&
+			std::none_of( m_map.begin() , m_map.end() ,
+				[&item](const Map::value_type & p){return p.second.segment == item.first && p.second.state == State::Locked;} ) )
+		{
+			list.push_back( item.first ) ;
+		}
+	}
+	for( unsigned int segment : list )
+		compact( segment ) ;
+}
+
+void GStore::SegmentStore::compact( unsigned int segment_number )
+{
+	// copy live messages into the active segment
+	std::size_t n = 0U ;
+	if( m_segments[segment_number].live )
+	{
+		std::ifstream in ;
+		if( !FileStore::FileOp::openIn( in , segmentPath(segment_number) ) )
+			throw Error( "cannot open segment file" , segmentPath(segment_number).str() ) ;
+		for( auto & item : m_map )
+		{
+			Entry & entry = item.second ;
+			if( entry.segment != segment_number )
+				continue ;
+			std::string content( entry.size , '\0' ) ;
+			in.clear() ;
+			in.seekg( entry.offset ) ;
+			if( !SegmentStoreImp::readPayload( in , entry.size , content ) )
+				throw Error( "cannot read segment file" , segmentPath(segment_number).str() ) ;
+			State state = entry.state ;
+			std::string reason = entry.reason ;
+			int reason_code = entry.reason_code ;
+			commit( MessageId(item.first) , entry.envelope , content , nullptr ) ;
+			if( state == State::Bad )
+				fail( MessageId(item.first) , reason , reason_code ) ;
+			n++ ;
+		}
+	}
+
+	// save the index before deleting the old segment file
+	m_segments.erase( segment_number ) ;
+	saveIndex() ;
+	G_LOG( "GStore::SegmentStore::compact: removing segment [" << segmentPath(segment_number).basename() << "]"
+		<< (n?" after copying ":"") << (n?G::Str::fromUInt(static_cast<unsigned int>(n)):std::string()) << (n?" message(s)":"") ) ;
+	FileStore::FileOp::remove( segmentPath(segment_number) ) ;
+}
+
+bool GStore::SegmentStore::empty() const
+{
+	const MessageStore & base = m_file_store ;
+	return
+		std::none_of( m_map.begin() , m_map.end() , [](const Map::value_type & p){return p.second.state == State::Normal;} ) &&
+		base.empty() ;
+}
+
+std::string GStore::SegmentStore::location( const MessageId & id ) const
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p == m_map.end() )
+	{
+		const MessageStore & base = m_file_store ;
+		return base.location( id ) ;
+	}
+	return segmentPath(p->second.segment).str().append(1U,':').append(std::to_string(p->second.offset)) ;
+}
+
+std::unique_ptr<GStore::StoredMessage> GStore::SegmentStore::get( const MessageId & id )
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p == m_map.end() )
+	{
+		MessageStore & base = m_file_store ;
+		return base.get( id ) ;
+	}
+	if( p->second.state != State::Normal )
+		throw GetError( id.str().append(": message is locked or failed") ) ;
+	return lock( p , true ) ;
+}
+
+std::unique_ptr<GStore::MessageStore::Iterator> GStore::SegmentStore::iterator( bool lock )
+{
+	return std::make_unique<SegmentIterator>( *this , m_file_store , lock ) ;
+}
+
+std::unique_ptr<GStore::NewMessage> GStore::SegmentStore::newMessage( const std::string & from ,
+	const MessageStore::SmtpInfo & smtp_info , const std::string & from_auth_out )
+{
+	return std::make_unique<NewSegmentMessage>( *this , m_file_store.newId() , from , smtp_info , from_auth_out ) ;
+}
+
+void GStore::SegmentStore::updated()
+{
+	G_DEBUG( "GStore::SegmentStore::updated" ) ;
+	m_update_signal.emit() ;
+}
+
+G::Slot::Signal<> & GStore::SegmentStore::messageStoreUpdateSignal() noexcept
+{
+	return m_update_signal ;
+}
+
+G::Slot::Signal<> & GStore::SegmentStore::messageStoreRescanSignal() noexcept
+{
+	return m_rescan_signal ;
+}
+
+std::vector<GStore::MessageId> GStore::SegmentStore::ids()
+{
+	std::vector<MessageId> result ;
+	for( const auto & item : m_map )
+	{
+		if( item.second.state == State::Normal )
+			result.emplace_back( item.first ) ;
+	}
+	MessageStore & base = m_file_store ;
+	std::vector<MessageId> file_ids = base.ids() ;
+	result.insert( result.end() , file_ids.begin() , file_ids.end() ) ;
+	return result ;
+}
+
+std::vector<GStore::MessageId> GStore::SegmentStore::failures()
+{
+	std::vector<MessageId> result ;
+	for( const auto & item : m_map )
+	{
+		if( item.second.state == State::Bad )
+			result.emplace_back( item.first ) ;
+	}
+	MessageStore & base = m_file_store ;
+	std::vector<MessageId> file_ids = base.failures() ;
+	result.insert( result.end() , file_ids.begin() , file_ids.end() ) ;
+	return result ;
+}
+
+void GStore::SegmentStore::unfailAll()
+{
+	for( auto & item : m_map )
+	{
+		if( item.second.state == State::Bad )
+		{
+			append( std::string("U ").append(item.first) , {} ) ;
+			item.second.state = State::Normal ;
+			item.second.reason.clear() ;
+			item.second.reason_code = 0 ;
+		}
+	}
+	MessageStore & base = m_file_store ;
+	base.unfailAll() ;
+}
+
+void GStore::SegmentStore::rescan()
+{
+	messageStoreRescanSignal().emit() ;
+}
+
+void GStore::SegmentStore::onFileStoreUpdate()
+{
+	updated() ;
+}
+
+void GStore::SegmentStore::onFileStoreRescan()
+{
+	rescan() ;
+}
+
+std::unique_ptr<GStore::StoredMessage> GStore::SegmentStore::lock( Map::iterator p , bool locked )
+{
+	auto message = std::make_unique<StoredSegmentMessage>( *this , MessageId(p->first) ,
+		p->second.envelope , segmentPath(p->second.segment) , p->second.offset , p->second.size , locked ) ;
+	if( !message->ok() )
+		throw GetError( p->first + ": cannot read the segment file" ) ;
+	if( locked )
+		p->second.state = State::Locked ;
+	return message ;
+}
+
+void GStore::SegmentStore::unlock( const MessageId & id ) noexcept
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p != m_map.end() && p->second.state == State::Locked )
+		p->second.state = State::Normal ;
+}
+
+void GStore::SegmentStore::edit( const MessageId & id , const G::StringArray & recipients )
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p != m_map.end() )
+	{
+		p->second.envelope.to_remote = recipients ;
+		std::string envelope = envelopeString( p->second.envelope ) ;
+		append( std::string("E ").append(id.str()).append(1U,' ').append(std::to_string(envelope.size())) , envelope ) ;
+	}
+}
+
+void GStore::SegmentStore::retry( const MessageId & id , unsigned int retry_count , std::time_t retry_time )
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p != m_map.end() )
+	{
+		p->second.envelope.retry_count = retry_count ;
+		p->second.envelope.retry_time = retry_time ;
+		std::string envelope = envelopeString( p->second.envelope ) ;
+		append( std::string("E ").append(id.str()).append(1U,' ').append(std::to_string(envelope.size())) , envelope ) ;
+	}
+}
+
+void GStore::SegmentStore::remove( const MessageId & id )
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p != m_map.end() )
+	{
+		G_LOG( "GStore::SegmentStore::remove: deleting message [" << id.str() << "]" ) ;
+		append( std::string("D ").append(id.str()) , {} ) ;
+		release( p->second.segment , p->second.record_size ) ;
+		m_map.erase( p ) ;
+		compact() ;
+	}
+}
+
+void GStore::SegmentStore::fail( const MessageId & id , const std::string & reason_in , int reason_code )
+{
+	auto p = m_map.find( id.str() ) ;
+	if( p != m_map.end() )
+	{
+		std::string reason = G::Str::toPrintableAscii( reason_in ) ;
+		G_LOG_S( "GStore::SegmentStore::fail: failing message [" << id.str() << "]" ) ;
+		append( std::string("F ").append(id.str()).append(1U,' ').append(std::to_string(reason_code))
+			.append(1U,' ').append(std::to_string(reason.size())) , reason ) ;
+		p->second.state = State::Bad ;
+		p->second.reason = reason ;
+		p->second.reason_code = reason_code ;
+	}
+}
+
+std::size_t GStore::SegmentStore::exportTo( FileStore & file_store , bool remove_ )
+{
+	std::size_t n = 0U ;
+	G::StringArray ids ;
+	for( const auto & item : m_map )
+	{
+		if( item.second.state != State::Locked )
+			ids.push_back( item.first ) ;
+	}
+	for( const auto & id_string : ids )
+	{
+		MessageId id( id_string ) ;
+		const Entry & entry = m_map.at( id_string ) ;
+
+		std::ifstream in ;
+		if( !FileStore::FileOp::openIn( in , segmentPath(entry.segment) ) )
+			throw Error( "cannot open segment file" , segmentPath(entry.segment).str() ) ;
+		in.seekg( entry.offset ) ;
+		std::string content ;
+		if( !SegmentStoreImp::readPayload( in , entry.size , content ) )
+			throw Error( "cannot read segment file" , segmentPath(entry.segment).str() ) ;
+
+		// write to temporary files and rename, envelope last
+		G::Path content_path = file_store.contentPath( id ) ;
+		G::Path content_path_tmp( content_path.str() + ".new" ) ;
+		G::Path envelope_path = file_store.envelopePath( id , entry.state == State::Bad ? FileStore::State::Bad : FileStore::State::Normal ) ;
+		G::Path envelope_path_tmp = file_store.envelopePath( id , FileStore::State::New ) ;
+		G::ScopeExit file_cleanup( [content_path_tmp,envelope_path_tmp](){FileStore::FileOp::remove(content_path_tmp);FileStore::FileOp::remove(envelope_path_tmp);} ) ;
+		G_LOG( "GStore::SegmentStore::exportTo: exporting message [" << id.str() << "] to [" << envelope_path.basename() << "]" ) ;
+		{
+			auto stream = FileStore::stream( content_path_tmp ) ;
+			*stream << content ;
+			stream->close() ;
+			if( stream->fail() )
+				throw Error( "cannot write content file" , content_path_tmp.str() ) ;
+		}
+		{
+			auto stream = FileStore::stream( envelope_path_tmp ) ;
+			Envelope::write( *stream , entry.envelope ) ;
+			if( entry.envelope.retry_count )
+				Envelope::writeRetry( *stream , entry.envelope ) ;
+			if( entry.state == State::Bad )
+			{
+				*stream << FileStore::x() << "Reason: " << entry.reason << "\r\n" ;
+				*stream << FileStore::x() << "ReasonCode:" ; if( entry.reason_code ) *stream << " " << entry.reason_code ; *stream << "\r\n" ;
+			}
+			stream->close() ;
+			if( stream->fail() )
+				throw Error( "cannot write envelope file" , envelope_path_tmp.str() ) ;
+		}
+		if( !FileStore::FileOp::renameOnto( content_path_tmp , content_path ) )
+			throw Error( "cannot rename content file" , content_path.str() ) ;
+		if( !FileStore::FileOp::rename( envelope_path_tmp , envelope_path ) )
+			throw Error( "cannot rename envelope file" , envelope_path.str() ) ;
+		file_cleanup.release() ;
+		file_store.indexUpdate( id ) ;
+		if( remove_ )
+			remove( id ) ;
+		n++ ;
+	}
+	return n ;
+}
+
+// ==
+
+GStore::SegmentStreamBuf::SegmentStreamBuf( const G::Path & path , std::streamoff offset , std::size_t size ) :
+	m_remaining(size)
+{
+	FileReader claim_reader ;
+	m_ok =
+		G::File::open( m_file , path , G::File::InOut::In ) != nullptr &&
+		m_file.pubseekpos( offset , std::ios_base::in ) == offset ;
+	setg( m_buffer.data() , m_buffer.data() , m_buffer.data() ) ;
+}
+
+bool GStore::SegmentStreamBuf::ok() const noexcept
+{
+	return m_ok ;
+}
+
+GStore::SegmentStreamBuf::int_type GStore::SegmentStreamBuf::underflow()
+{
+	if( gptr() < egptr() )
+		return traits_type::to_int_type( *gptr() ) ;
+	if( !m_ok || m_remaining == 0U )
+		return traits_type::eof() ;
+	std::streamsize n = m_file.sgetn( m_buffer.data() ,
+		static_cast<std::streamsize>( std::min( m_remaining , m_buffer.size() ) ) ) ;
+	if( n <= 0 )
+		return traits_type::eof() ;
+	m_remaining -= static_cast<std::size_t>( n ) ;
+	setg( m_buffer.data() , m_buffer.data() , m_buffer.data() + n ) ;
+	return traits_type::to_int_type( *gptr() ) ;
+}
+
+// ==
+
+GStore::SegmentIterator::SegmentIterator( SegmentStore & store , FileStore & file_store , bool lock ) :
+	m_store(store) ,
+	m_file_store(file_store) ,
+	m_lock(lock)
+{
+	for( const auto & item : m_store.m_map )
+	{
+		if( item.second.state == SegmentStore::State::Normal )
+			m_ids.push_back( item.first ) ;
+	}
+}
+
+std::unique_ptr<GStore::StoredMessage> GStore::SegmentIterator::next()
+{
+	while( m_index < m_ids.size() )
+	{
+		auto p = m_store.m_map.find( m_ids[m_index++] ) ;
+		if( p != m_store.m_map.end() && p->second.state == SegmentStore::State::Normal )
+		{
+			try
+			{
+				return m_store.lock( p , m_lock ) ;
+			}
+			catch( std::exception & e )
+			{
+				G_WARNING( "GStore::MessageStore: ignoring [" << p->first << "]: " << e.what() ) ;
+			}
+		}
+	}
+	if( !m_file_iter )
+	{
+		MessageStore & base = m_file_store ;
+		m_file_iter = base.iterator( m_lock ) ;
+	}
+	return m_file_iter->next() ;
+}
+
+// ==
+
+GStore::NewSegmentMessage::NewSegmentMessage( SegmentStore & store , const MessageId & id ,
+	const std::string & from , const MessageStore::SmtpInfo & smtp_info ,
+	const std::string & from_auth_out ) :
+		m_store(store) ,
+		m_id(id)
+{
+	m_env.from = from ;
+	m_env.from_auth_in = smtp_info.auth ;
+	m_env.from_auth_out = from_auth_out ;
+	m_env.body_type = Envelope::parseSmtpBodyType( smtp_info.body ) ;
+	m_env.utf8_mailboxes =
+		smtp_info.address_style == MessageStore::AddressStyle::Utf8Mailbox ||
+		smtp_info.address_style == MessageStore::AddressStyle::Utf8Both ;
+}
+
+GStore::NewSegmentMessage::~NewSegmentMessage()
+{
+	if( m_tmp )
+	{
+		m_tmp.reset() ;
+		FileStore::FileOp::remove( tmpPath() ) ;
+	}
+}
+
+G::Path GStore::NewSegmentMessage::tmpPath() const
+{
+	return m_store.directory() / m_id.str().append(".tmp") ;
+}
+
+void GStore::NewSegmentMessage::addTo( const std::string & to , bool local , MessageStore::AddressStyle address_style )
+{
+	if( local )
+	{
+		m_env.to_local.push_back( to ) ;
+	}
+	else
+	{
+		m_env.to_remote.push_back( to ) ;
+		if( address_style == MessageStore::AddressStyle::Utf8Mailbox ||
+			address_style == MessageStore::AddressStyle::Utf8Both )
+		{
+			m_env.utf8_mailboxes = true ;
+		}
+	}
+}
+
+GStore::NewMessage::Status GStore::NewSegmentMessage::addContent( const char * data , std::size_t data_size )
+{
+	std::size_t old_size = m_size ;
+	std::size_t new_size = m_size + data_size ;
+	if( new_size < m_size )
+		new_size = std::numeric_limits<std::size_t>::max() ;
+	m_size = new_size ;
+
+	// truncate to max_size bytes, as in GStore::NewFile
+	std::size_t max_size = m_store.m_config.max_size ;
+	if( max_size && new_size >= max_size )
+		data_size = std::max(max_size,old_size) - old_size ;
+
+	// buffer in memory, moving to a temporary file if too big
+	if( !m_tmp && ( m_content.size() + data_size ) > m_store.m_config.buffer_size )
+	{
+		m_tmp = FileStore::stream( tmpPath() ) ;
+		*m_tmp << m_content ;
+		std::string().swap( m_content ) ;
+	}
+	if( m_tmp && data_size )
+		m_tmp->write( data , static_cast<std::streamsize>(data_size) ) ;
+	else if( data_size )
+		m_content.append( data , data_size ) ;
+
+	if( m_tmp && m_tmp->fail() )
+		return NewMessage::Status::Error ;
+	else if( max_size && m_size >= max_size )
+		return NewMessage::Status::TooBig ;
+	else
+		return NewMessage::Status::Ok ;
+}
+
+std::size_t GStore::NewSegmentMessage::contentSize() const
+{
+	return m_size ;
+}
+
+void GStore::NewSegmentMessage::prepare( const std::string & session_auth_id ,
+	const std::string & peer_socket_address , const std::string & peer_certificate )
+{
+	if( m_tmp )
+	{
+		m_tmp->close() ;
+		if( m_tmp->fail() )
+			throw SegmentStore::Error( "cannot write temporary content file" , tmpPath().str() ) ;
+	}
+	m_env.authentication = session_auth_id ;
+	m_env.client_socket_address = peer_socket_address ;
+	m_env.client_certificate = peer_certificate ;
+}
+
+void GStore::NewSegmentMessage::commit( bool throw_on_error )
+{
+	m_committed = true ;
+	try
+	{
+		if( m_tmp )
+		{
+			std::ifstream in ;
+			if( !FileStore::FileOp::openIn( in , tmpPath() ) )
+				throw SegmentStore::Error( "cannot read temporary content file" , tmpPath().str() ) ;
+			m_store.commit( m_id , m_env , {} , &in ) ;
+		}
+		else
+		{
+			m_store.commit( m_id , m_env , m_content , nullptr ) ;
+		}
+		G_LOG( "GStore::NewSegmentMessage::commit: new message [" << m_id.str() << "] in segment [" << m_store.location(m_id) << "]" ) ;
+	}
+	catch( std::exception & e )
+	{
+		G_ERROR( "GStore::NewSegmentMessage::commit: " << e.what() ) ;
+		if( throw_on_error )
+			throw ;
+	}
+	m_store.updated() ;
+}
+
+GStore::MessageId GStore::NewSegmentMessage::id() const
+{
+	return m_id ;
+}
+
+std::string GStore::NewSegmentMessage::location() const
+{
+	return m_committed ? m_store.location( m_id ) : tmpPath().str() ;
+}
+
+// ==
+
+GStore::StoredSegmentMessage::StoredSegmentMessage( SegmentStore & store , const MessageId & id ,
+	const Envelope & envelope , const G::Path & segment , std::streamoff offset ,
+	std::size_t size , bool locked ) :
+		m_store(store) ,
+		m_id(id) ,
+		m_env(envelope) ,
+		m_location(segment.str().append(1U,':').append(std::to_string(offset))) ,
+		m_size(size) ,
+		m_buf(segment,offset,size) ,
+		m_stream(&m_buf) ,
+		m_locked(locked)
+{
+}
+
+GStore::StoredSegmentMessage::~StoredSegmentMessage()
+{
+	if( m_locked )
+		m_store.unlock( m_id ) ;
+}
+
+bool GStore::StoredSegmentMessage::ok() const noexcept
+{
+	return m_buf.ok() ;
+}
+
+GStore::MessageId GStore::StoredSegmentMessage::id() const
+{
+	return m_id ;
+}
+
+std::string GStore::StoredSegmentMessage::location() const
+{
+	return m_location ;
+}
+
+std::string GStore::StoredSegmentMessage::from() const
+{
+	return m_env.from ;
+}
+
+std::string GStore::StoredSegmentMessage::to( std::size_t i ) const
+{
+	return i < m_env.to_remote.size() ? m_env.to_remote[i] : std::string() ;
+}
+
+std::size_t GStore::StoredSegmentMessage::toCount() const
+{
+	return m_env.to_remote.size() ;
+}
+
+std::size_t GStore::StoredSegmentMessage::contentSize() const
+{
+	return m_size ;
+}
+
+std::istream & GStore::StoredSegmentMessage::contentStream()
+{
+	return m_stream ;
+}
+
+std::string_view GStore::StoredSegmentMessage::contentView()
+{
+	return {} ; // not contiguous
+}
+
+void GStore::StoredSegmentMessage::close()
+{
+}
+
+std::string GStore::StoredSegmentMessage::reopen()
+{
+	return {} ;
+}
+
+void GStore::StoredSegmentMessage::destroy()
+{
+	m_locked = false ;
+	m_store.remove( m_id ) ;
+}
+
+void GStore::StoredSegmentMessage::fail( const std::string & reason , int reason_code )
+{
+	m_locked = false ;
+	m_store.fail( m_id , reason , reason_code ) ;
+}
+
+GStore::MessageStore::BodyType GStore::StoredSegmentMessage::bodyType() const
+{
+	return m_env.body_type ;
+}
+
+std::string GStore::StoredSegmentMessage::authentication() const
+{
+	return m_env.authentication ;
+}
+
+std::string GStore::StoredSegmentMessage::fromAuthIn() const
+{
+	return m_env.from_auth_in ;
+}
+
+std::string GStore::StoredSegmentMessage::fromAuthOut() const
+{
+	return m_env.from_auth_out ;
+}
+
+std::string GStore::StoredSegmentMessage::forwardTo() const
+{
+	return m_env.forward_to ;
+}
+
+std::string GStore::StoredSegmentMessage::forwardToAddress() const
+{
+	return m_env.forward_to_address ;
+}
+
+std::string GStore::StoredSegmentMessage::clientAccountSelector() const
+{
+	return m_env.client_account_selector ;
+}
+
+bool GStore::StoredSegmentMessage::utf8Mailboxes() const
+{
+	return m_env.utf8_mailboxes ;
+}
+
+void GStore::StoredSegmentMessage::editRecipients( const G::StringArray & recipients )
+{
+	m_env.to_remote = recipients ;
+	m_store.edit( m_id , recipients ) ;
+}
+
+unsigned int GStore::StoredSegmentMessage::retryCount() const
+{
+	return m_env.retry_count ;
+}
+
+std::time_t GStore::StoredSegmentMessage::retryTime() const
+{
+	return m_env.retry_time ;
+}
+
+void GStore::StoredSegmentMessage::retry( std::time_t next , const std::string & )
+{
+	m_env.retry_count++ ;
+	m_env.retry_time = next ;
+	m_store.retry( m_id , m_env.retry_count , m_env.retry_time ) ;
+}
@@ -0,0 +1,188 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gsegmentstore.h
+///
+
+#ifndef G_SMTP_SEGMENT_STORE_H
+#define G_SMTP_SEGMENT_STORE_H
+
+#include "gdef.h"
+#include "gmessagestore.h"
+#include "gfilestore.h"
+#include "genvelope.h"
+#include "gexception.h"
+#include "gslot.h"
+#include "gpath.h"
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace GStore
+{
+	class SegmentStore ;
+	class SegmentIterator ;
+	class NewSegmentMessage ;
+	class StoredSegmentMessage ;
+}
+
+//| \class GStore::SegmentStore
+/// A concrete implementation of the MessageStore interface that appends
+/// messages to large segment files rather than creating separate
+/// envelope and content files for each message, and so avoids most of
+/// the per-message filesystem metadata operations.
+///
+/// Segment files live in a ".segments" sub-directory of the spool
+/// directory. Each segment is a log of records that add a message,
+/// edit its envelope, fail it, unfail it or delete it. The current
+/// state of every message is held in memory and is periodically
+/// written to an index file so that it can be reloaded quickly. After
+/// a crash the index is brought up to date by replaying the segment
+/// records written since the index was saved; any incomplete record
+/// at the end of a segment is ignored.
+///
+/// A new segment is started when the current one gets too big and
+/// after the store is constructed, but the segment file is not created
+/// until something is written to it. Older segments are compacted
+/// by copying any live messages into the current segment once enough
+/// of their content has been deleted, and they are then removed.
+///
+/// The wrapped FileStore provides message ids, and any messages in the
+/// classic per-file layout are also visible through this interface.
+/// exportTo() copies messages back into the per-file layout, writing
+/// temporary files and renaming them into place, envelope last.
+///
+class GStore::SegmentStore : public MessageStore
+{
+public:
+	G_EXCEPTION( Error , tx("segment store error") )
+	G_EXCEPTION( GetError , tx("error getting message") )
+	struct Config /// Configuration structure for GStore::SegmentStore.
+	{
+		std::size_t max_size {0U} ; // zero for unlimited -- see GStore::FileStore::Config
+		std::size_t segment_size {64U*1024U*1024U} ; // segment file size that triggers a new segment
+		std::size_t buffer_size {1024U*1024U} ; // new message content buffered in memory
+		unsigned int compaction {50U} ; // compaction threshold as a percentage of live content
+		Config & set_max_size( std::size_t ) noexcept ;
+		Config & set_segment_size( std::size_t ) noexcept ;
+		Config & set_buffer_size( std::size_t ) noexcept ;
+		Config & set_compaction( unsigned int ) noexcept ;
+	} ;
+
+	SegmentStore( FileStore & , const Config & ) ;
+		///< Constructor. Loads the index and replays any more recent
+		///< segment records. Throws on error.
+
+	~SegmentStore() override ;
+		///< Destructor. Saves the index.
+
+	G::Path directory() const ;
+		///< Returns the segment directory.
+
+	std::size_t exportTo( FileStore & , bool remove ) ;
+		///< Writes every unlocked message to the given file store
+		///< as a pair of envelope and content files, keeping the
+		///< message id and any failed state. Optionally deletes
+		///< exported messages from this store. Returns the number
+		///< of messages exported.
+
+public:
+	SegmentStore( const SegmentStore & ) = delete ;
+	SegmentStore( SegmentStore && ) = delete ;
+	SegmentStore & operator=( const SegmentStore & ) = delete ;
+	SegmentStore & operator=( SegmentStore && ) = delete ;
+
+private: // overrides
+	bool empty() const override ;
+	std::string location( const MessageId & ) const override ;
+	std::unique_ptr<StoredMessage> get( const MessageId & ) override ;
+	std::unique_ptr<MessageStore::Iterator> iterator( bool lock ) override ;
+	std::unique_ptr<NewMessage> newMessage( const std::string & , const MessageStore::SmtpInfo & , const std::string & ) override ;
+	void updated() override ;
+	G::Slot::Signal<> & messageStoreUpdateSignal() noexcept override ;
+	G::Slot::Signal<> & messageStoreRescanSignal() noexcept override ;
+	std::vector<MessageId> ids() override ;
+	std::vector<MessageId> failures() override ;
+	void unfailAll() override ;
+	void rescan() override ;
+
+private:
+	friend class GStore::SegmentIterator ;
+	friend class GStore::NewSegmentMessage ;
+	friend class GStore::StoredSegmentMessage ;
+	enum class State { Normal , Locked , Bad } ;
+	struct Entry /// A message's location and state.
+	{
+		unsigned int segment {0U} ;
+		std::streamoff offset {0} ; // content offset
+		std::size_t size {0U} ; // content size
+		std::size_t record_size {0U} ; // size of the add-message record
+		Envelope envelope ;
+		State state {State::Normal} ;
+		std::string reason ;
+		int reason_code {0} ;
+	} ;
+	struct Segment /// A segment's size and live content size.
+	{
+		std::size_t size {0U} ;
+		std::size_t live {0U} ;
+	} ;
+	using Map = std::map<std::string,Entry> ;
+	using SegmentMap = std::map<unsigned int,Segment> ;
+	G::Path segmentPath( unsigned int ) const ;
+	G::Path indexPath() const ;
+	void load() ;
+	bool loadIndex( unsigned int & , std::size_t & ) ;
+	void replay( unsigned int , std::size_t ) ;
+	std::size_t replay( unsigned int , std::istream & , std::size_t ) ;
+	void saveIndex() ;
+	void startSegment() ;
+	void append( const std::string & header , const std::string & payload ) ;
+	void commit( const MessageId & , const Envelope & , const std::string & content , std::istream * ) ;
+	std::unique_ptr<StoredMessage> lock( Map::iterator , bool ) ;
+	void unlock( const MessageId & ) noexcept ;
+	void edit( const MessageId & , const G::StringArray & ) ;
+	void retry( const MessageId & , unsigned int , std::time_t ) ;
+	void remove( const MessageId & ) ;
+	void fail( const MessageId & , const std::string & , int ) ;
+	void release( unsigned int segment , std::size_t record_size ) ;
+	void compact() ;
+	void compact( unsigned int ) ;
+	static std::string envelopeString( const Envelope & ) ;
+	void onFileStoreUpdate() ;
+	void onFileStoreRescan() ;
+
+private:
+	FileStore & m_file_store ;
+	Config m_config ;
+	G::Path m_dir ;
+	Map m_map ;
+	SegmentMap m_segments ;
+	unsigned int m_active {0U} ;
+	bool m_compacting {false} ;
+	std::ofstream m_out ;
+	G::Slot::Signal<> m_update_signal ;
+	G::Slot::Signal<> m_rescan_signal ;
+} ;
+
+inline GStore::SegmentStore::Config & GStore::SegmentStore::Config::set_max_size( std::size_t n ) noexcept { max_size = n ; return *this ; }
+inline GStore::SegmentStore::Config & GStore::SegmentStore::Config::set_segment_size( std::size_t n ) noexcept { segment_size = n ; return *this ; }
+inline GStore::SegmentStore::Config & GStore::SegmentStore::Config::set_buffer_size( std::size_t n ) noexcept { buffer_size = n ; return *this ; }
+inline GStore::SegmentStore::Config & GStore::SegmentStore::Config::set_compaction( unsigned int n ) noexcept { compaction = n ; return *this ; }
+
+#endif
@@ -24,6 +24,7 @@
 #include "gscope.h"
 #include "gfile.h"
 #include "gfbuf.h"
+#include "gmetrics.h"
 #include "gstr.h"
 #include "glog.h"
 #include "gassert.h"
@@ -32,6 +33,15 @@
 #include <limits>
 #include <utility>
 
+namespace GStore
+{
+	namespace StoredFileImp
+	{
+		G::Metrics::Counter failed( "emailrelay_spool_messages_total" , "op=\"failed\"" , "Spool operations" ) ;
+		G::Metrics::Counter deleted( "emailrelay_spool_messages_total" , "op=\"deleted\"" , "Spool operations" ) ;
+	}
+}
+
 GStore::StoredFile::StoredFile( FileStore & store , const MessageId & id , State state ) :
 	m_store(store) ,
 	m_id(id) ,
@@ -47,6 +57,7 @@ GStore::StoredFile::~StoredFile()
 		{
 			G_DEBUG( "GStore::StoredFile::dtor: unlocking envelope [" << epath(State::Locked).basename() << "]" ) ;
 			FileOp::rename( epath(State::Locked) , epath(State::Normal) ) ;
+			m_store.indexUpdate( m_id ) ;
 			static_cast<MessageStore&>(m_store).updated() ;
 		}
 	}
@@ -88,6 +99,7 @@ GStore::MessageStore::BodyType GStore::StoredFile::bodyType() const
 void GStore::StoredFile::close()
 {
 	m_content.reset() ;
+	m_store.unshare( cpath() ) ; // in case the content is edited
 }
 
 std::string GStore::StoredFile::reopen()
@@ -238,15 +250,33 @@ void GStore::StoredFile::fail( const std::string & reason , int reason_code )
 
 		FileOp::rename( epath(m_state) , bad_path ) ;
 		m_state = State::Bad ;
+		StoredFileImp::failed.add() ;
 	}
 	else
 	{
 		G_DEBUG( "GStore::StoredFile::fail: cannot fail envelope [" << epath(m_state).basename() << "]" ) ;
 	}
 	m_unlock = false ;
+	m_store.indexUpdate( m_id ) ;
 	static_cast<MessageStore&>(m_store).updated() ;
 }
 
+void GStore::StoredFile::retry( std::time_t next , const std::string & reason )
+{
+	m_env.retry_count++ ;
+	m_env.retry_time = next ;
+
+	std::ofstream stream ;
+	if( !FileOp::openAppend( stream , epath(m_state) ) )
+	{
+		G_ERROR( "GStore::StoredFile::retry: cannot re-open envelope file to append the retry time: "
+			<< "[" << epath(m_state).basename() << "] (" << G::Process::strerror(FileOp::errno_()) << ")" ) ;
+		return ;
+	}
+	stream << FileStore::x() << "Reason: " << G::Str::toPrintableAscii(reason) << eol() ;
+	Envelope::writeRetry( stream , m_env ) ;
+}
+
 void GStore::StoredFile::addReason( const G::Path & path , const std::string & reason , int reason_code ) const
 {
 	std::ofstream stream ;
@@ -267,11 +297,14 @@ void GStore::StoredFile::destroy()
 
 	G_LOG( "GStore::StoredFile::destroy: deleting content [" << cpath().basename() << "]" ) ;
 	m_content.reset() ; // close it before deleting
+	StoredFileImp::deleted.add() ;
+	m_store.release( cpath() , m_env.digest ) ;
 	if( !FileOp::remove( cpath() ) )
 		G_WARNING( "GStore::StoredFile::destroy: failed to delete content file "
 			<< "[" << cpath().basename() << "] (" << G::Process::strerror(FileOp::errno_()) << "]" ) ;
 
 	m_unlock = false ;
+	m_store.indexUpdate( m_id ) ;
 	static_cast<MessageStore&>(m_store).updated() ;
 }
 
@@ -305,6 +338,11 @@ std::istream & GStore::StoredFile::contentStream()
 	return *m_content ;
 }
 
+std::string_view GStore::StoredFile::contentView()
+{
+	return m_content ? m_content->view() : std::string_view() ;
+}
+
 std::string GStore::StoredFile::authentication() const
 {
 	return m_env.authentication ;
@@ -335,6 +373,16 @@ bool GStore::StoredFile::utf8Mailboxes() const
 	return m_env.utf8_mailboxes ;
 }
 
+unsigned int GStore::StoredFile::retryCount() const
+{
+	return m_env.retry_count ;
+}
+
+std::time_t GStore::StoredFile::retryTime() const
+{
+	return m_env.retry_time ;
+}
+
 std::string GStore::StoredFile::fromAuthOut() const
 {
 	return m_env.from_auth_out ;
@@ -382,3 +430,18 @@ std::streamoff GStore::StoredFile::Stream::size() const
 	return end_ ;
 }
 
+std::string_view GStore::StoredFile::Stream::view()
+{
+	// map on first use -- a failure to map is not an error since
+	// the caller falls back to the stream
+	if( !m_map_tried )
+	{
+		m_map_tried = true ;
+		if( m_mapped.map( file() ) )
+		{
+			G_DEBUG( "GStore::StoredFile::Stream::view: content mapped: " << m_mapped.view().size() << " bytes" ) ;
+		}
+	}
+	return m_mapped.view() ;
+}
+
@@ -27,6 +27,7 @@
 #include "genvelope.h"
 #include "gexception.h"
 #include "gfbuf.h"
+#include "gmappedfile.h"
 #include "gpath.h"
 #include "gstringarray.h"
 #include <iostream>
@@ -103,7 +104,11 @@ private: // overrides
 	void destroy() override ; // GStore::StoredMessage
 	std::size_t contentSize() const override ; // GStore::StoredMessage
 	std::istream & contentStream() override ; // GStore::StoredMessage
+	std::string_view contentView() override ; // GStore::StoredMessage
 	void editRecipients( const G::StringArray & ) override ; // GStore::StoredMessage
+	unsigned int retryCount() const override ; // GStore::StoredMessage
+	std::time_t retryTime() const override ; // GStore::StoredMessage
+	void retry( std::time_t , const std::string & ) override ; // GStore::StoredMessage
 
 public:
 	StoredFile( const StoredFile & ) = delete ;
@@ -120,6 +125,9 @@ private:
 		explicit Stream( const G::Path & ) ;
 		void open( const G::Path & ) ;
 		std::streamoff size() const ;
+		std::string_view view() ;
+		G::MappedFile m_mapped ;
+		bool m_map_tried {false} ;
 	} ;
 
 private:
@@ -26,9 +26,11 @@
 #include "gmessagestore.h"
 #include "genvelope.h"
 #include "gpath.h"
+#include "gstringview.h"
 #include <functional>
 #include <iostream>
 #include <fstream>
+#include <ctime>
 
 namespace GStore
 {
@@ -64,6 +66,13 @@ public:
 	virtual std::istream & contentStream() = 0 ;
 		///< Returns a reference to the content stream.
 
+	virtual std::string_view contentView() = 0 ;
+		///< Returns the whole of the content as a contiguous block
+		///< of memory, if available, or an empty view if the
+		///< contentStream() should be used instead. The view is
+		///< independent of the stream position and it remains
+		///< valid until close(), reopen() or destroy().
+
 	virtual void close() = 0 ;
 		///< Releases the message to allow external editing.
 
@@ -108,6 +117,19 @@ public:
 		///< Updates the message's remote recipients, typically to
 		///< the sub-set that have not received it successfully.
 
+	virtual unsigned int retryCount() const = 0 ;
+		///< Returns the number of deferred delivery attempts
+		///< recorded by retry().
+
+	virtual std::time_t retryTime() const = 0 ;
+		///< Returns the earliest time for the next delivery attempt
+		///< as recorded by retry(), or zero.
+
+	virtual void retry( std::time_t next , const std::string & reason ) = 0 ;
+		///< Records a deferred delivery attempt within the store,
+		///< incrementing the retryCount() and setting the
+		///< retryTime().
+
 	virtual ~StoredMessage() = default ;
 		///< Destructor.
 } ;
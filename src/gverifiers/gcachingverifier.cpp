@@ -0,0 +1,77 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gcachingverifier.cpp
+///
+
+#include "gdef.h"
+#include "gcachingverifier.h"
+#include "gstr.h"
+#include "glog.h"
+#include "gassert.h"
+
+GVerifiers::CachingVerifier::CachingVerifier( VerifierCache & cache , std::unique_ptr<GSmtp::Verifier> verifier ) :
+	m_cache(cache) ,
+	m_verifier(std::move(verifier))
+{
+	G_ASSERT( m_verifier != nullptr ) ;
+	m_verifier->doneSignal().connect( G::Slot::slot(*this,&GVerifiers::CachingVerifier::onDone) ) ;
+}
+
+GVerifiers::CachingVerifier::~CachingVerifier()
+{
+	m_verifier->doneSignal().disconnect() ;
+}
+
+void GVerifiers::CachingVerifier::verify( const GSmtp::Verifier::Request & request )
+{
+	const GSmtp::VerifierStatus * cached = m_cache.find( request ) ;
+	if( cached )
+	{
+		G_LOG( "GVerifiers::CachingVerifier: cached verification result: ["
+			<< G::Str::printable(request.address) << "]" ) ;
+		GSmtp::VerifierStatus status = *cached ;
+		doneSignal().emit( request.command , status ) ;
+	}
+	else
+	{
+		m_request = request ;
+		m_busy = true ;
+		m_verifier->verify( request ) ;
+	}
+}
+
+void GVerifiers::CachingVerifier::onDone( GSmtp::Verifier::Command command , const GSmtp::VerifierStatus & status )
+{
+	if( m_busy )
+	{
+		m_busy = false ;
+		m_cache.store( m_request , status ) ;
+	}
+	doneSignal().emit( command , status ) ;
+}
+
+G::Slot::Signal<GSmtp::Verifier::Command,const GSmtp::VerifierStatus&> & GVerifiers::CachingVerifier::doneSignal()
+{
+	return m_done_signal ;
+}
+
+void GVerifiers::CachingVerifier::cancel()
+{
+	m_busy = false ;
+	m_verifier->cancel() ;
+}
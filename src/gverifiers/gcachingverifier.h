@@ -0,0 +1,70 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gcachingverifier.h
+///
+
+#ifndef G_CACHING_VERIFIER_H
+#define G_CACHING_VERIFIER_H
+
+#include "gdef.h"
+#include "gverifier.h"
+#include "gverifiercache.h"
+#include <memory>
+
+namespace GVerifiers
+{
+	class CachingVerifier ;
+}
+
+//| \class GVerifiers::CachingVerifier
+/// A Verifier decorator that consults a VerifierCache before
+/// delegating to another Verifier. Cache hits are reported
+/// synchronously from within verify().
+///
+class GVerifiers::CachingVerifier : public GSmtp::Verifier
+{
+public:
+	CachingVerifier( VerifierCache & , std::unique_ptr<GSmtp::Verifier> ) ;
+		///< Constructor. The cache reference is kept.
+
+	~CachingVerifier() override ;
+		///< Destructor.
+
+private: // overrides
+	void verify( const GSmtp::Verifier::Request & ) override ; // GSmtp::Verifier
+	G::Slot::Signal<GSmtp::Verifier::Command,const GSmtp::VerifierStatus&> & doneSignal() override ; // GSmtp::Verifier
+	void cancel() override ; // GSmtp::Verifier
+
+public:
+	CachingVerifier( const CachingVerifier & ) = delete ;
+	CachingVerifier( CachingVerifier && ) = delete ;
+	CachingVerifier & operator=( const CachingVerifier & ) = delete ;
+	CachingVerifier & operator=( CachingVerifier && ) = delete ;
+
+private:
+	void onDone( GSmtp::Verifier::Command , const GSmtp::VerifierStatus & ) ;
+
+private:
+	VerifierCache & m_cache ;
+	std::unique_ptr<GSmtp::Verifier> m_verifier ;
+	G::Slot::Signal<GSmtp::Verifier::Command,const GSmtp::VerifierStatus&> m_done_signal ;
+	GSmtp::Verifier::Request m_request ;
+	bool m_busy {false} ;
+} ;
+
+#endif
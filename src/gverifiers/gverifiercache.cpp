@@ -0,0 +1,119 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gverifiercache.cpp
+///
+
+#include "gdef.h"
+#include "gverifiercache.h"
+#include "gaddress.h"
+#include "gmetrics.h"
+#include <sstream>
+
+namespace GVerifiers
+{
+	namespace VerifierCacheImp
+	{
+		G::Metrics::Counter hits( "emailrelay_verifier_cache_total" , "result=\"hit\"" , "Address verifier cache lookups" ) ;
+		G::Metrics::Counter misses( "emailrelay_verifier_cache_total" , "result=\"miss\"" , "Address verifier cache lookups" ) ;
+	}
+}
+
+GVerifiers::VerifierCache::VerifierCache( const Config & config ) :
+	m_config(config) ,
+	m_table(config.size)
+{
+	m_config.size = m_table.maxSize() ;
+}
+
+bool GVerifiers::VerifierCache::enabled() const noexcept
+{
+	return m_config.positive_ttl != 0U || m_config.negative_ttl != 0U ;
+}
+
+const GSmtp::VerifierStatus * GVerifiers::VerifierCache::find( const GSmtp::Verifier::Request & request )
+{
+	// expired entries are left in place to be refreshed by store()
+	// or eventually evicted
+	const GSmtp::VerifierStatus * result = nullptr ;
+	const Entry * entry = m_table.find( key(request) ) ;
+	if( entry && G::TimerTime::now() <= entry->expiry )
+		result = &entry->status ;
+	if( result )
+	{
+		m_hits++ ;
+		VerifierCacheImp::hits.add() ;
+	}
+	else
+	{
+		m_misses++ ;
+		VerifierCacheImp::misses.add() ;
+	}
+	return result ;
+}
+
+void GVerifiers::VerifierCache::store( const GSmtp::Verifier::Request & request , const GSmtp::VerifierStatus & status )
+{
+	unsigned int entry_ttl = ttl( status ) ;
+	if( entry_ttl == 0U )
+		return ;
+
+	Entry & entry = *m_table.insert( key(request) ).first ;
+	entry.status = status ;
+	entry.expiry = G::TimerTime::now() + G::TimeInterval(entry_ttl) ;
+}
+
+unsigned int GVerifiers::VerifierCache::ttl( const GSmtp::VerifierStatus & status ) const noexcept
+{
+	if( status.abort || status.temporary )
+		return 0U ;
+	else if( status.is_valid )
+		return m_config.positive_ttl ;
+	else
+		return m_config.negative_ttl ;
+}
+
+std::string GVerifiers::VerifierCache::key( const GSmtp::Verifier::Request & request )
+{
+	// verifiers are given the client address and authentication
+	// details and they often make decisions based on them, so they
+	// are part of the key -- but not the client's port number
+	std::string client = request.client_ip.displayString() ;
+	if( GNet::Address::validString( client ) )
+		client = GNet::Address::parse( client ).hostPartString() ;
+
+	std::string result ;
+	result.reserve( request.address.size() + request.from_address.size() + client.size() +
+		request.auth_mechanism.size() + request.auth_extra.size() + 8U ) ;
+	result.append( 1U , request.command == GSmtp::Verifier::Command::VRFY ? 'v' : 'r' )
+		.append( request.address ).append( 1U , '\0' )
+		.append( request.from_address ).append( 1U , '\0' )
+		.append( client ).append( 1U , '\0' )
+		.append( request.auth_mechanism ).append( 1U , '\0' )
+		.append( request.auth_extra ) ;
+	return result ;
+}
+
+std::string GVerifiers::VerifierCache::info() const
+{
+	std::ostringstream ss ;
+	ss << "entries=" << m_table.size() << " max=" << m_config.size
+		<< " hits=" << m_hits << " misses=" << m_misses
+		<< " positive-ttl=" << m_config.positive_ttl
+		<< " negative-ttl=" << m_config.negative_ttl ;
+	return ss.str() ;
+}
@@ -0,0 +1,108 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file gverifiercache.h
+///
+
+#ifndef G_VERIFIER_CACHE_H
+#define G_VERIFIER_CACHE_H
+
+#include "gdef.h"
+#include "gverifier.h"
+#include "gverifierstatus.h"
+#include "gdatetime.h"
+#include "glrutable.h"
+#include <string>
+
+namespace GVerifiers
+{
+	class VerifierCache ;
+}
+
+//| \class GVerifiers::VerifierCache
+/// A bounded cache of address verification results, keyed on the
+/// command, the recipient address, the envelope-from address, the
+/// client's network address, and the authentication mechanism and
+/// id. The key therefore covers everything that the verifiers are
+/// given, apart from the client's port number.
+///
+/// Positive and negative results have separate time-to-live values.
+/// Temporary failures and aborts are never cached. The table has
+/// a fixed maximum size with least-recently-used eviction.
+///
+/// \see GVerifiers::CachingVerifier
+///
+class GVerifiers::VerifierCache
+{
+public:
+	struct Config /// A configuration structure for GVerifiers::VerifierCache.
+	{
+		unsigned int positive_ttl {0U} ; // seconds, zero to disable
+		unsigned int negative_ttl {0U} ; // seconds, zero to disable
+		std::size_t size {10000U} ;
+
+		Config & set_positive_ttl( unsigned int ) noexcept ;
+		Config & set_negative_ttl( unsigned int ) noexcept ;
+		Config & set_size( std::size_t ) noexcept ;
+	} ;
+
+	explicit VerifierCache( const Config & ) ;
+		///< Constructor.
+
+	bool enabled() const noexcept ;
+		///< Returns true if either time-to-live is non-zero.
+
+	const GSmtp::VerifierStatus * find( const GSmtp::Verifier::Request & ) ;
+		///< Returns a pointer to an unexpired cached result, or
+		///< nullptr. The pointer is invalidated by the next call
+		///< to find() or store(). Updates the hit and miss counts.
+
+	void store( const GSmtp::Verifier::Request & , const GSmtp::VerifierStatus & ) ;
+		///< Adds a verification result to the cache, if cacheable.
+
+	std::string info() const ;
+		///< Returns a one-line summary of the cache size and
+		///< the hit and miss counts.
+
+public:
+	~VerifierCache() = default ;
+	VerifierCache( const VerifierCache & ) = delete ;
+	VerifierCache( VerifierCache && ) = delete ;
+	VerifierCache & operator=( const VerifierCache & ) = delete ;
+	VerifierCache & operator=( VerifierCache && ) = delete ;
+
+private:
+	struct Entry
+	{
+		GSmtp::VerifierStatus status {GSmtp::VerifierStatus::invalid({})} ;
+		G::TimerTime expiry {G::TimerTime::zero()} ;
+	} ;
+	static std::string key( const GSmtp::Verifier::Request & ) ;
+	unsigned int ttl( const GSmtp::VerifierStatus & ) const noexcept ;
+
+private:
+	Config m_config ;
+	G::LruTable<Entry> m_table ;
+	unsigned long long m_hits {0U} ;
+	unsigned long long m_misses {0U} ;
+} ;
+
+inline GVerifiers::VerifierCache::Config & GVerifiers::VerifierCache::Config::set_positive_ttl( unsigned int s ) noexcept { positive_ttl = s ; return *this ; }
+inline GVerifiers::VerifierCache::Config & GVerifiers::VerifierCache::Config::set_negative_ttl( unsigned int s ) noexcept { negative_ttl = s ; return *this ; }
+inline GVerifiers::VerifierCache::Config & GVerifiers::VerifierCache::Config::set_size( std::size_t n ) noexcept { size = n ; return *this ; }
+
+#endif
@@ -24,14 +24,27 @@
 #include "gexecutableverifier.h"
 #include "gnetworkverifier.h"
 #include "guserverifier.h"
+#include "gcachingverifier.h"
 #include "gfile.h"
 #include "gstr.h"
 #include "gstringtoken.h"
 #include "grange.h"
 #include "gexception.h"
 
-GVerifiers::VerifierFactory::VerifierFactory()
-= default ;
+GVerifiers::VerifierFactory::VerifierFactory( const VerifierCache::Config & cache_config ) :
+	m_cache(cache_config)
+{
+}
+
+bool GVerifiers::VerifierFactory::cacheEnabled() const noexcept
+{
+	return m_cache.enabled() ;
+}
+
+std::string GVerifiers::VerifierFactory::cacheInfo() const
+{
+	return m_cache.info() ;
+}
 
 GVerifiers::VerifierFactory::Spec GVerifiers::VerifierFactory::parse( std::string_view spec_in ,
 	const G::Path & base_dir , const G::Path & app_dir , G::StringArray * warnings_p )
@@ -75,6 +88,15 @@ GVerifiers::VerifierFactory::Spec GVerifiers::VerifierFactory::parse( std::strin
 
 std::unique_ptr<GSmtp::Verifier> GVerifiers::VerifierFactory::newVerifier( GNet::EventState es ,
 	const GSmtp::Verifier::Config & config , const Spec & spec )
+{
+	if( m_cache.enabled() && spec.first != "exit" )
+		return std::make_unique<CachingVerifier>( m_cache , newVerifierImp(es,config,spec) ) ;
+	else
+		return newVerifierImp( es , config , spec ) ;
+}
+
+std::unique_ptr<GSmtp::Verifier> GVerifiers::VerifierFactory::newVerifierImp( GNet::EventState es ,
+	const GSmtp::Verifier::Config & config , const Spec & spec )
 {
 	if( spec.first == "exit" )
 	{
@@ -24,6 +24,7 @@
 #include "gdef.h"
 #include "gverifierfactorybase.h"
 #include "gverifier.h"
+#include "gverifiercache.h"
 #include "geventstate.h"
 #include "gstringview.h"
 #include "gstringarray.h"
@@ -39,12 +40,21 @@ namespace GVerifiers
 //| \class GVerifiers::VerifierFactory
 /// A VerifierFactory implementation.
 ///
+/// If the cache is enabled then the external verifiers are wrapped
+/// in a CachingVerifier that shares the factory's VerifierCache.
+///
 class GVerifiers::VerifierFactory : public GSmtp::VerifierFactoryBase
 {
 public:
-	VerifierFactory() ;
+	explicit VerifierFactory( const VerifierCache::Config & = {} ) ;
 		///< Constructor.
 
+	bool cacheEnabled() const noexcept ;
+		///< Returns true if verification results are cached.
+
+	std::string cacheInfo() const ;
+		///< Returns a summary of the cache state for diagnostics.
+
 	static Spec parse( std::string_view spec , const G::Path & base_dir = {} ,
 		const G::Path & app_dir = {} , G::StringArray * warnings_p = nullptr ) ;
 			///< Parses a verifier specification string like "/usr/bin/foo" or
@@ -76,6 +86,11 @@ private:
 	static void checkNet( Spec & result ) ;
 	static void checkRange( Spec & result ) ;
 	static void checkExit( Spec & result ) ;
+	std::unique_ptr<GSmtp::Verifier> newVerifierImp( GNet::EventState ,
+		const GSmtp::Verifier::Config & , const GSmtp::VerifierFactoryBase::Spec & ) ;
+
+private:
+	VerifierCache m_cache ;
 } ;
 
 #endif
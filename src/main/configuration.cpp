@@ -29,6 +29,8 @@
 #include "gtest.h"
 #include "gpop.h"
 #include "gaddress.h"
+#include "gaddresstree.h"
+#include "gdnsbl.h"
 #include "gidn.h"
 #include "gprocess.h"
 #include "gassert.h"
@@ -55,6 +57,8 @@ Main::Configuration::Configuration( const G::OptionMap & map , const std::string
 		m_pid_file_warning = true ;
 		m_map.replace( "pid-file" , (*m_map.find("pid-file")).second.value() ) ;
 	}
+	m_remote_ranges = _addressTree( _allowRemoteRanges() ) ;
+	m_dnsbl_allow = _addressTree( GNet::Dnsbl::allowList(dnsbl()) ) ;
 	if( G::Test::enabled("configuration-dump") )
 	{
 		for( const auto & p : map )
@@ -101,6 +105,27 @@ G::LogOutput::SyslogFacility Main::Configuration::_syslogFacility() const
 	return G::LogOutput::SyslogFacility::Mail ;
 }
 
+G::StringArray Main::Configuration::_allowRemoteRanges() const
+{
+	std::string s = stringValue( "remote-clients" ) ;
+	if( s == G::Str::positive() ) // eg. "-r"
+		return {} ;
+	return G::Str::splitIntoTokens( s , "," ) ;
+}
+
+std::shared_ptr<const GNet::AddressTree> Main::Configuration::_addressTree( const G::StringArray & ranges )
+{
+	// compiled once per configuration and shared by its servers --
+	// invalid ranges are ignored here and reported by semanticError()
+	if( ranges.empty() )
+		return {} ;
+	auto tree = std::make_shared<GNet::AddressTree>() ;
+	std::size_t value = 0U ;
+	for( const auto & range : ranges )
+		tree->add( range , value++ ) ;
+	return tree ;
+}
+
 bool Main::Configuration::validSyslogFacility() const
 {
 	std::string s = stringValue( "syslog" ) ;
@@ -170,6 +195,42 @@ G::Path Main::Configuration::spoolDir() const
 	return contains( "spool-dir" ) ? pathValue( "spool-dir" ) : GStore::FileStore::defaultDirectory() ;
 }
 
+bool Main::Configuration::memoryStore() const
+{
+	return contains( "spool-memory" ) && !_filterFiles() ;
+}
+
+bool Main::Configuration::segmentStore() const
+{
+	return contains( "spool-log" ) && !_filterFiles() ;
+}
+
+bool Main::Configuration::_filterFiles() const
+{
+	// only exit-code and delay filters do not look at the spool files
+	auto file_filter = [](const GSmtp::FilterFactoryBase::Spec & spec){ return spec.first != "exit" && spec.first != "sleep" ; } ;
+	return file_filter( _filter() ) || file_filter( _clientFilter() ) ;
+}
+
+bool Main::Configuration::filterSigning() const
+{
+	// "dkim:" filters use the tls library to sign messages
+	auto dkim_filter = [](const GSmtp::FilterFactoryBase::Spec & spec){
+		return spec.first == "dkim" ||
+			( spec.first == "chain" && std::string(1U,',').append(spec.second).find(",dkim:") != std::string::npos ) ; } ;
+	return dkim_filter( _filter() ) || dkim_filter( _clientFilter() ) ;
+}
+
+GSmtp::FilterFactoryBase::Spec Main::Configuration::filter() const
+{
+	return _filter() ;
+}
+
+GSmtp::FilterFactoryBase::Spec Main::Configuration::clientFilter() const
+{
+	return _clientFilter() ;
+}
+
 std::string Main::Configuration::serverAddress() const
 {
 	const char * key = "forward-to" ;
@@ -180,6 +241,11 @@ std::string Main::Configuration::serverAddress() const
 	return stringValue( key ) ;
 }
 
+bool Main::Configuration::scheduler() const
+{
+	return contains( "forward-concurrency" ) ;
+}
+
 bool Main::Configuration::closeFiles() const
 {
 	return daemon() && stringValue("interface").find("fd#") == std::string::npos ;
@@ -236,6 +302,35 @@ const char * Main::Configuration::semanticError1() const
 		return tx("invalid --poll period: try --forward-on-disconnect") ;
 	}
 
+	if( contains("spool-memory") && numberValue("spool-memory",0U) == 0U )
+	{
+		return tx("invalid --spool-memory size") ;
+	}
+
+	const std::vector<unsigned int> forward_concurrency = numberList( "forward-concurrency" ) ;
+	if( contains("forward-concurrency") && ( forward_concurrency.empty() || forward_concurrency.size() > 2U || forward_concurrency[0] == 0U ) )
+	{
+		return tx("invalid --forward-concurrency value") ;
+	}
+
+	const std::vector<unsigned int> forward_retry = numberList( "forward-retry" ) ;
+	if( contains("forward-retry") && ( forward_retry.empty() || forward_retry.size() > 2U || forward_retry[0] == 0U ) )
+	{
+		return tx("invalid --forward-retry value") ;
+	}
+
+	const std::vector<unsigned int> rate_limit = numberList( "rate-limit" , "auth" ) ;
+	if( contains("rate-limit") && ( rate_limit.size() < 2U || rate_limit.size() > 3U || ( rate_limit.size() == 3U && rate_limit[2] == 0U ) ) )
+	{
+		return tx("invalid --rate-limit value") ;
+	}
+
+	const std::vector<unsigned int> verifier_cache = numberList( "verifier-cache" ) ;
+	if( contains("verifier-cache") && ( verifier_cache.empty() || verifier_cache.size() > 3U || ( verifier_cache.size() == 3U && verifier_cache[2] == 0U ) ) )
+	{
+		return tx("invalid --verifier-cache value") ;
+	}
+
 	const bool contains_pop = contains( "pop" ) ;
 	if( contains_pop && !GPop::enabled() )
 	{
@@ -257,6 +352,21 @@ const char * Main::Configuration::semanticError1() const
 		return tx("the --pop option requires --pop-auth") ;
 	}
 
+	if( contains_pop && contains("spool-memory") )
+	{
+		return tx("the --spool-memory option cannot be used with --pop") ;
+	}
+
+	if( contains_pop && contains("spool-log") )
+	{
+		return tx("the --spool-log option cannot be used with --pop") ;
+	}
+
+	if( contains("spool-log") && ( contains("spool-memory") || contains("spool-dedup") ) )
+	{
+		return tx("the --spool-log option cannot be used with --spool-memory or --spool-dedup") ;
+	}
+
 	const bool contains_admin = contains( "admin" ) ;
 	if( contains_admin && !GSmtp::AdminServer::enabled() )
 	{
@@ -284,6 +394,8 @@ const char * Main::Configuration::semanticError1() const
 	{
 		if( contains("forward") ) return tx("--forward requires --forward-to") ;
 		if( contains("forward-on-disconnect") ) return tx("--forward-on-disconnect requires --forward-to") ;
+		if( contains("cut-through") ) return tx("--cut-through requires --forward-to") ;
+		if( contains("spool-memory") ) return tx("--spool-memory requires --forward-to") ;
 		if( contains("client-filter") ) return tx("--client-filter requires --forward-to") ;
 	}
 
@@ -422,6 +534,13 @@ const char * Main::Configuration::semanticError1() const
 		return tx("--dnsbl requires --remote-clients or -r") ;
 	}
 
+	if( contains("remote-clients") )
+	{
+		G::StringArray ranges = _allowRemoteRanges() ;
+		if( !std::all_of( ranges.begin() , ranges.end() , [](const std::string & r){return GNet::AddressTree::validRange(r);} ) )
+			return tx("invalid --remote-clients address range") ;
+	}
+
 	if( contains("client-interface") && GNet::Address::isFamilyLocal(serverAddress()) )
 	{
 		return tx("the --client-interface option cannot be used with a unix-domain forwarding address") ;
@@ -512,6 +631,24 @@ G::StringArray Main::Configuration::semanticWarnings() const
 				G::Idn::encode(domain) ) ) ;
 	}
 
+	if( contains("spool-memory") && !memoryStore() )
+	{
+		warnings.emplace_back(
+			txt("the --spool-memory option is ignored when using filters that need spool files") ) ;
+	}
+
+	if( contains("forward-retry") && !scheduler() )
+	{
+		warnings.emplace_back(
+			txt("the --forward-retry option is ignored without --forward-concurrency") ) ;
+	}
+
+	if( contains("spool-log") && !segmentStore() )
+	{
+		warnings.emplace_back(
+			txt("the --spool-log option is ignored when using filters that need spool files") ) ;
+	}
+
 	filterValue( "filter" , &warnings ) ;
 	filterValue( "client-filter" , &warnings ) ;
 	verifierValue( "address-verifier" , &warnings ) ;
@@ -558,6 +695,22 @@ G::Path Main::Configuration::pathValue( std::string_view option_name ) const
 	}
 }
 
+std::vector<unsigned int> Main::Configuration::numberList( std::string_view option_name , std::string_view keyword ) const
+{
+	// eg. "--forward-concurrency=2,10" -- returns an empty list on error -- any
+	// field matching the keyword is skipped
+	std::vector<unsigned int> result ;
+	for( const auto & s : G::Str::splitIntoFields( stringValue(option_name) , ',' ) )
+	{
+		if( !keyword.empty() && s == keyword )
+			continue ;
+		if( !G::Str::isUInt(s) )
+			return {} ;
+		result.push_back( G::Str::toUInt(s) ) ;
+	}
+	return result ;
+}
+
 G::Path Main::Configuration::pathValueImp( const std::string & value ) const
 {
 	G::Path path( value ) ;
@@ -680,7 +833,37 @@ GStore::FileStore::Config Main::Configuration::fileStoreConfig() const
 {
 	return
 		GStore::FileStore::Config()
-			.set_max_size( _maxSize() ) ; // see also ServerProtocol::Config
+			.set_max_size( _maxSize() ) // see also ServerProtocol::Config
+			.set_dedup( contains("spool-dedup") )
+			.set_dedup_unshare( _filterFiles() ) // filters might edit content files
+			.set_index( contains("spool-index") ) ;
+}
+
+GStore::MemoryStore::Config Main::Configuration::memoryStoreConfig() const
+{
+	return
+		GStore::MemoryStore::Config()
+			.set_max_memory( numberValue( "spool-memory" , 0U ) )
+			.set_max_size( _maxSize() ) ; // see also FileStore::Config
+}
+
+GStore::SegmentStore::Config Main::Configuration::segmentStoreConfig() const
+{
+	return
+		GStore::SegmentStore::Config()
+			.set_max_size( _maxSize() ) ; // see also FileStore::Config
+}
+
+GSmtp::Scheduler::Config Main::Configuration::schedulerConfig() const
+{
+	std::vector<unsigned int> concurrency = numberList( "forward-concurrency" ) ;
+	std::vector<unsigned int> retry = numberList( "forward-retry" ) ;
+	GSmtp::Scheduler::Config config ;
+	if( !concurrency.empty() ) config.set_concurrency( concurrency[0] ) ;
+	if( concurrency.size() > 1U ) config.set_connections( concurrency[1] ) ;
+	if( !retry.empty() ) config.set_retry_base( retry[0] ) ;
+	if( retry.size() > 1U ) config.set_retry_max( retry[1] ) ;
+	return config ;
 }
 
 std::pair<int,int> Main::Configuration::_smtpServerSocketLinger() const
@@ -746,6 +929,7 @@ GSmtp::Server::Config Main::Configuration::smtpServerConfig( const std::string &
 	return
 		GSmtp::Server::Config()
 			.set_allow_remote( _allowRemoteClients() )
+			.set_allow_remote_ranges( m_remote_ranges )
 			.set_interfaces( listeningNames("smtp") )
 			.set_port( _port() )
 			.set_ident( smtp_ident )
@@ -770,8 +954,35 @@ GSmtp::Server::Config Main::Configuration::smtpServerConfig( const std::string &
 			.set_net_server_config( _netServerConfig(_smtpServerSocketLinger()) )
 			.set_protocol_config( _smtpServerProtocolConfig(server_secrets_valid,domain) )
 			.set_dnsbl_config( dnsbl() )
+			.set_dnsbl_allow( m_dnsbl_allow )
 			.set_buffer_config( GSmtp::ServerBufferIn::Config() )
-			.set_domain( domain ) ;
+			.set_domain( domain )
+			.set_cut_through( cutThrough() )
+			.set_rate_limit_config( _rateLimitConfig() )
+			.set_async_content( contains("spool-async") ) ;
+}
+
+GSmtp::RateLimiter::Config Main::Configuration::_rateLimitConfig() const
+{
+	// eg. "--rate-limit=10,100,60,auth"
+	std::vector<unsigned int> rate_limit = numberList( "rate-limit" , "auth" ) ;
+	GSmtp::RateLimiter::Config config ;
+	if( rate_limit.size() > 0U ) config.set_connections( rate_limit[0] ) ;
+	if( rate_limit.size() > 1U ) config.set_messages( rate_limit[1] ) ;
+	if( rate_limit.size() > 2U ) config.set_period( rate_limit[2] ) ;
+	config.set_by_auth( G::Str::tailMatch( stringValue("rate-limit") , ",auth" ) ) ;
+	return config ;
+}
+
+GVerifiers::VerifierCache::Config Main::Configuration::verifierCacheConfig() const
+{
+	// eg. "--verifier-cache=3600,60,50000"
+	std::vector<unsigned int> verifier_cache = numberList( "verifier-cache" ) ;
+	GVerifiers::VerifierCache::Config config ;
+	if( verifier_cache.size() > 0U ) config.set_positive_ttl( verifier_cache[0] ) ;
+	if( verifier_cache.size() > 1U ) config.set_negative_ttl( verifier_cache[1] ) ;
+	if( verifier_cache.size() > 2U ) config.set_size( verifier_cache[2] ) ;
+	return config ;
 }
 
 GPop::Store::Config Main::Configuration::popStoreConfig() const
@@ -789,6 +1000,7 @@ GPop::Server::Config Main::Configuration::popServerConfig( const std::string & s
 	return
 		GPop::Server::Config()
 			.set_allow_remote( _allowRemoteClients() )
+			.set_allow_remote_ranges( m_remote_ranges )
 			.set_port( _popPort() )
 			.set_addresses( listeningNames("pop") )
 			.set_net_server_peer_config(
@@ -849,7 +1061,8 @@ GSmtp::Client::Config Main::Configuration::smtpClientConfig( const std::string &
 					.set_socket_protocol_config(
 						GNet::SocketProtocol::Config()
 							.set_client_tls_profile( client_tls_profile )
-							.set_secure_connection_timeout( _secureConnectionTimeout() ) ) )
+							.set_secure_connection_timeout( _secureConnectionTimeout() )
+							.set_handshake_threads( _tlsHandshakeThreads() ) ) )
 			.set_filter_config(
 				GSmtp::Filter::Config()
 					.set_domain( filter_domain )
@@ -870,6 +1083,7 @@ GSmtp::AdminServer::Config Main::Configuration::adminServerConfig( const G::Stri
 			.set_port( _adminPort() )
 			.set_with_terminate( contains("admin-terminate") )
 			.set_allow_remote( _allowRemoteClients() )
+			.set_allow_remote_ranges( m_remote_ranges )
 			.set_remote_address( serverAddress() )
 			.set_info_commands( info_map )
 			.set_smtp_client_config( smtpClientConfig(client_tls_profile,filter_domain,client_domain) )
@@ -887,7 +1101,8 @@ GNet::SocketProtocol::Config Main::Configuration::_socketProtocolConfig( const s
 	return
 		GNet::SocketProtocol::Config()
 			.set_server_tls_profile( server_tls_profile )
-			.set_secure_connection_timeout( _connectionTimeout() ) ;
+			.set_secure_connection_timeout( _connectionTimeout() )
+			.set_handshake_threads( _tlsHandshakeThreads() ) ;
 }
 
 // ==
@@ -971,6 +1186,7 @@ std::string Main::Configuration::_show() const { return stringValue( "show" ) ;
 int Main::Configuration::_shutdownHowOnQuit() const noexcept { return 1 ; }
 std::string Main::Configuration::_smtpSaslClientConfig() const { return stringValue( "client-auth-config" ) ; }
 std::string Main::Configuration::_smtpSaslServerConfig() const { return stringValue( "server-auth-config" ) ; }
+unsigned int Main::Configuration::_tlsHandshakeThreads() const noexcept { return numberValue( "tls-handshake-threads" , 0U ) ; }
 GSmtp::VerifierFactoryBase::Spec Main::Configuration::_verifier() const { return verifierValue( "address-verifier" ) ; }
 bool Main::Configuration::_nodaemon() const noexcept { return contains( "no-daemon" ) || contains( "as-client" ) ; }
 
@@ -988,6 +1204,7 @@ bool Main::Configuration::daemon() const noexcept { return !_nodaemon() ; }
 bool Main::Configuration::debug() const noexcept { return contains( "debug" ) ; }
 std::string Main::Configuration::dnsbl() const { return stringValue( "dnsbl" ) ; }
 std::string Main::Configuration::domain( std::function<std::string()> default_domain_fn ) const { return stringValue( "domain" , default_domain_fn ) ; }
+bool Main::Configuration::cutThrough() const noexcept { return contains( "cut-through" ) ; }
 bool Main::Configuration::doAdmin() const noexcept { return contains( "admin" ) ; }
 bool Main::Configuration::doPolling() const noexcept { return contains( "poll" ) && pollingTimeout() > 0U ; }
 bool Main::Configuration::doPop() const noexcept { return contains( "pop" ) ; }
@@ -996,7 +1213,7 @@ bool Main::Configuration::doSmtp() const noexcept { return !contains( "no-smtp"
 bool Main::Configuration::forwardOnDisconnect() const noexcept { return contains( "forward-on-disconnect" ) || contains( "as-proxy" ) ; }
 bool Main::Configuration::forwardOnStartup() const noexcept { return contains( "forward" ) || contains( "as-client" ) ; }
 bool Main::Configuration::hidden() const noexcept { return contains( "hidden" ) ; }
-bool Main::Configuration::immediate() const noexcept { return contains( "immediate" ) ; }
+bool Main::Configuration::immediate() const noexcept { return contains( "immediate" ) || contains( "cut-through" ) ; }
 G::Path Main::Configuration::deliveryDir() const { return contains("delivery-dir") ? pathValue("delivery-dir") : spoolDir() ; }
 bool Main::Configuration::log() const noexcept { return contains( "log" ) || contains( "as-client" ) || contains( "as-proxy" ) || contains( "as-server" ) ; }
 std::string Main::Configuration::logFile() const { return contains("log-file") ? pathValue("log-file").str() : std::string() ; }
@@ -1012,5 +1229,6 @@ bool Main::Configuration::serverTls() const noexcept { return contains( "server-
 G::Path Main::Configuration::serverTlsPrivateKey() const { return keyFile( "server-tls-certificate" ) ; }
 std::string Main::Configuration::tlsConfig() const { return stringValue( "tls-config" ) ; }
 bool Main::Configuration::usePidFile() const noexcept { return contains( "pid-file" ) ; }
+bool Main::Configuration::unitThreads() const noexcept { return contains( "unit-threads" ) ; }
 std::string Main::Configuration::user() const { return stringValue( "user" , "daemon" ) ; }
 
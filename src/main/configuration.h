@@ -32,14 +32,19 @@
 #include "gsmtpserver.h"
 #include "gadminserver.h"
 #include "gsmtpclient.h"
+#include "gsmtpscheduler.h"
 #include "gfilestore.h"
+#include "gmemorystore.h"
+#include "gsegmentstore.h"
 #include "gfilterfactory.h"
 #include "gverifierfactory.h"
 #include "gpopserver.h"
 #include "gsaslserversecrets.h"
 #include "glocal.h"
 #include "glogoutput.h"
+#include "gaddresstree.h"
 #include <string>
+#include <memory>
 #include <functional>
 
 namespace Main
@@ -128,12 +133,41 @@ public:
 	G::Path spoolDir() const ;
 		///< Returns the spool directory.
 
+	bool memoryStore() const ;
+		///< Returns true if new messages should be kept in memory
+		///< rather than in the spool directory. Returns false if
+		///< the filters need spool files.
+
+	bool segmentStore() const ;
+		///< Returns true if new messages should be appended to
+		///< segment files rather than stored as separate envelope
+		///< and content files. Returns false if the filters need
+		///< spool files.
+
+	bool filterSigning() const ;
+		///< Returns true if the server or client filters include
+		///< a signing filter that needs the TLS library.
+
+	GSmtp::FilterFactoryBase::Spec filter() const ;
+		///< Returns the server filter specification.
+
+	GSmtp::FilterFactoryBase::Spec clientFilter() const ;
+		///< Returns the client filter specification.
+
 	std::string serverAddress() const ;
 		///< Returns the downstream server's address string.
 
+	bool scheduler() const ;
+		///< Returns true if forwarding should use per-destination
+		///< queues with retry backoff.
+
 	bool usePidFile() const noexcept ;
 		///< Returns true if writing a pid file.
 
+	bool unitThreads() const noexcept ;
+		///< Returns true if units other than the first should run
+		///< on their own event-loop threads.
+
 	G::Path pidFile() const ;
 		///< Returns the pid file's path.
 
@@ -170,6 +204,11 @@ public:
 		///< message body is received and before receipt is
 		///< acknowledged.
 
+	bool cutThrough() const noexcept ;
+		///< Returns true if immediate forwarding should stream each
+		///< message body upstream as it is received. Implies
+		///< immediate().
+
 	bool forwardOnDisconnect() const noexcept ;
 		///< Returns true if forwarding should occur when the
 		///< submitter's network connection disconnects.
@@ -236,6 +275,9 @@ public:
 		const std::string & domain ) const ;
 			///< Returns the smtp server configuration structure.
 
+	GVerifiers::VerifierCache::Config verifierCacheConfig() const ;
+		///< Returns the address verifier cache configuration structure.
+
 	GPop::Store::Config popStoreConfig() const ;
 		///< Returns the pop store configuration structure.
 
@@ -249,6 +291,15 @@ public:
 	GStore::FileStore::Config fileStoreConfig() const ;
 		///< Returns the file-store configuration structure.
 
+	GStore::MemoryStore::Config memoryStoreConfig() const ;
+		///< Returns the memory-store configuration structure.
+
+	GStore::SegmentStore::Config segmentStoreConfig() const ;
+		///< Returns the segment-store configuration structure.
+
+	GSmtp::Scheduler::Config schedulerConfig() const ;
+		///< Returns the forwarding scheduler configuration structure.
+
 	GSmtp::AdminServer::Config adminServerConfig( const G::StringMap & info_map ,
 		const std::string & client_tls_profile_for_flush ,
 		const std::string & filter_domain , const std::string & client_domain ) const ;
@@ -273,6 +324,7 @@ private:
 	G::Path pathValueImp( const std::string & ) const ;
 	GSmtp::FilterFactoryBase::Spec filterValue( std::string_view , G::StringArray * = nullptr ) const ;
 	GSmtp::VerifierFactoryBase::Spec verifierValue( std::string_view , G::StringArray * = nullptr ) const ;
+	std::vector<unsigned int> numberList( std::string_view key , std::string_view keyword = {} ) const ;
 	static bool pathlike( std::string_view ) ;
 	//
 	const char * semanticError1() const ;
@@ -293,10 +345,13 @@ private:
 	unsigned int _adminPort() const noexcept ;
 	std::pair<int,int> _adminServerSocketLinger() const noexcept ;
 	bool _allowRemoteClients() const noexcept ;
+	G::StringArray _allowRemoteRanges() const ;
+	static std::shared_ptr<const GNet::AddressTree> _addressTree( const G::StringArray & ) ;
 	GSmtp::FilterFactoryBase::Spec _clientFilter() const ;
 	std::pair<int,int> _clientSocketLinger() const ;
 	unsigned int _connectionTimeout() const noexcept ;
 	GSmtp::FilterFactoryBase::Spec _filter() const ;
+	bool _filterFiles() const ;
 	unsigned int _filterTimeout() const noexcept ;
 	unsigned int _idleTimeout() const noexcept ;
 	unsigned int _maxSize() const noexcept ;
@@ -314,7 +369,9 @@ private:
 	std::string _smtpSaslClientConfig() const ;
 	std::string _smtpSaslServerConfig() const ;
 	std::pair<int,int> _smtpServerSocketLinger() const ;
+	GSmtp::RateLimiter::Config _rateLimitConfig() const ;
 	G::LogOutput::SyslogFacility _syslogFacility() const ;
+	unsigned int _tlsHandshakeThreads() const noexcept ;
 	GSmtp::VerifierFactoryBase::Spec _verifier() const ;
 
 private:
@@ -343,6 +400,8 @@ private:
 	G::Path m_app_dir ;
 	G::Path m_base_dir ;
 	bool m_pid_file_warning {false} ;
+	std::shared_ptr<const GNet::AddressTree> m_remote_ranges ;
+	std::shared_ptr<const GNet::AddressTree> m_dnsbl_allow ;
 } ;
 
 inline
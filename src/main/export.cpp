@@ -0,0 +1,145 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file export.cpp
+///
+// A utility that copies messages out of the segment files used
+// by "emailrelay --spool-log" and writes them into the spool
+// directory as separate envelope and content files, so that they
+// can be processed by external filters and scripts.
+//
+// The emailrelay server should not be running on the same spool
+// directory at the same time.
+//
+// usage: emailrelay-export [--spool-dir <dir>] [--output-dir <dir>] [--remove]
+//
+
+#include "gdef.h"
+#include "garg.h"
+#include "ggetopt.h"
+#include "goptions.h"
+#include "goptionsusage.h"
+#include "glogoutput.h"
+#include "gprocess.h"
+#include "gfilestore.h"
+#include "gsegmentstore.h"
+#include "ggettext.h"
+#include "legal.h"
+#include <iostream>
+#include <cstdlib>
+
+static G::Options options()
+{
+	using G::tx ;
+	using M = G::Option::Multiplicity ;
+	G::Options opt ;
+	unsigned int t_undef = 0U ;
+
+	G::Options::add( opt , 'h' , "help" ,
+		tx("show usage help") , "" ,
+		M::zero , "" , 1 , t_undef ) ;
+			// Shows help text and exits.
+
+	G::Options::add( opt , 's' , "spool-dir" ,
+		tx("specifies the spool directory") , "" ,
+		M::one , "dir" , 1 , t_undef ) ;
+			// Specifies the spool directory containing the ".segments"
+			// sub-directory.
+
+	G::Options::add( opt , 'o' , "output-dir" ,
+		tx("specifies the output directory! for the exported files") , "" ,
+		M::one , "dir" , 1 , t_undef ) ;
+			// Specifies the directory where the envelope and content
+			// files are written. Defaults to the spool directory.
+
+	G::Options::add( opt , 'r' , "remove" ,
+		tx("deletes exported messages from the segment files") , "" ,
+		M::zero , "" , 1 , t_undef ) ;
+			// Deletes the exported messages from the segment files so
+			// that they are not forwarded twice.
+
+	G::Options::add( opt , 'v' , "verbose" ,
+		tx("generates more verbose output") , "" ,
+		M::zero , "" , 1 , t_undef ) ;
+			// Logs each exported message.
+
+	return opt ;
+}
+
+int main( int argc , char * argv [] )
+{
+	G::Arg arg( argc , argv ) ;
+	try
+	{
+		G::GetOpt opt( arg , options() ) ;
+		if( opt.hasErrors() )
+		{
+			opt.showErrors( std::cerr ) ;
+			return EXIT_FAILURE ;
+		}
+		if( opt.contains("help") )
+		{
+			G::OptionsUsage(opt.options()).output( {} , std::cout , arg.prefix() ) ;
+			std::cout
+				<< "\n"
+				<< Main::Legal::warranty("","\n")
+				<< Main::Legal::copyright() << std::endl ;
+			return EXIT_SUCCESS ;
+		}
+		if( opt.args().c() != 1U )
+		{
+			std::cerr
+				<< arg.prefix() << ": too many command-line arguments" << std::endl
+				<< "usage: " << arg.prefix() << " [--spool-dir <dir>] [--output-dir <dir>] [--remove]" << std::endl ;
+			return EXIT_FAILURE ;
+		}
+
+		G::LogOutput log_output( arg.prefix() , G::LogOutput::Config(true,opt.contains("verbose")).set_strip() ) ;
+		G::Process::Umask set_umask( G::Process::Umask::Mode::Tighter ) ;
+
+		G::Path spool_dir = opt.value( "spool-dir" , GStore::FileStore::defaultDirectory().str() ) ;
+		G::Path output_dir = opt.value( "output-dir" , spool_dir.str() ) ;
+
+		GStore::FileStore file_store( spool_dir , "" , {} ) ;
+		if( !GStore::FileStore::FileOp::isdir( spool_dir/".segments" ) )
+			throw std::runtime_error( "no segment files in " + spool_dir.str() ) ;
+
+		GStore::SegmentStore segment_store( file_store , {} ) ;
+		std::size_t n = 0U ;
+		if( output_dir == spool_dir )
+		{
+			n = segment_store.exportTo( file_store , opt.contains("remove") ) ;
+		}
+		else
+		{
+			GStore::FileStore output_store( output_dir , "" , {} ) ;
+			n = segment_store.exportTo( output_store , opt.contains("remove") ) ;
+		}
+
+		std::cout << arg.prefix() << ": " << n << " message" << (n==1U?"":"s") << " exported" << std::endl ;
+		return EXIT_SUCCESS ;
+	}
+	catch( std::exception & e )
+	{
+		std::cerr << arg.prefix() << ": exception: " << e.what() << std::endl ;
+	}
+	catch(...)
+	{
+		std::cerr << arg.prefix() << ": unknown exception" << std::endl ;
+	}
+	return EXIT_FAILURE ;
+}
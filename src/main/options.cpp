@@ -229,13 +229,19 @@ G::Options Main::Options::spec()
 
 	G::Options::add( opt , 'r' , "remote-clients" ,
 		tx("allows remote clients to connect") , "" ,
-		M::zero , "" , 20 ,
+		M::zero_or_one , "address-range-list" , 20 ,
 		t_smtpserver ) ;
+			//example: 192.0.2.0/24,2001:db8::/32
 			// Allows incoming connections from addresses that are not local. The
 			// default behaviour is to reject connections that are not local in
 			// order to prevent accidental exposure to the public internet,
 			// although a firewall should also be used. Local address ranges are
-			// defined in RFC-1918, RFC-6890 etc.
+			// defined in RFC-1918, RFC-6890 etc. An optional comma-separated
+			// list of address ranges (eg. "192.0.2.0/24" or "192.0.2.*")
+			// restricts remote clients to those ranges. The list must be
+			// attached with "=", as in "--remote-clients=192.0.2.0/24",
+			// because "-r" and "--remote-clients" on their own do not take
+			// a value.
 
 	G::Options::add( opt , 's' , "spool-dir" ,
 		tx("specifies the spool directory") , "" ,
@@ -398,6 +404,17 @@ G::Options Main::Options::spec()
 			// "tlsv1.0" can be used to set a minimum TLS protocol version, or
 			// "-tlsv1.2" to set a maximum version.
 
+	G::Options::add( opt , '\0' , "tls-handshake-threads" ,
+		tx("runs TLS handshakes on up to the given number of worker threads") , "" ,
+		M::one , "count" , 30 ,
+		t_tls ) ;
+			//example: 4
+			// Runs the expensive public-key steps of TLS handshakes on up to the given
+			// number of worker threads so that a burst of new TLS connections does
+			// not hold up other sessions. Handshake steps are run on the main thread
+			// when all the workers are busy. This only applies to the OpenSSL TLS
+			// library in a multi-threaded build.
+
 	G::Options::add( opt , 'g' , "debug" ,
 		tx("generates debug-level logging if built in") , "" ,
 		M::zero , "" , 30 ,
@@ -566,6 +583,17 @@ G::Options Main::Options::spec()
 		t_process ) ;
 			// Disables listening for incoming SMTP connections.
 
+	G::Options::add( opt , '\0' , "unit-threads" ,
+		tx("runs each configuration unit after the first on its own thread") , "" ,
+		M::zero , "" , 30 ,
+		t_process ) ;
+			// When using a configuration file with multiple named configurations
+			// this option runs the event loop of each unit other than the first
+			// on its own thread so that the units can make use of multiple cores.
+			// The first unit runs on the main thread and delivers any admin
+			// notifications. This has no effect if the TLS library is not
+			// thread-safe, as with mbedTLS, or if the build is single-threaded.
+
 	G::Options::add( opt , 'z' , "filter" ,
 		tx("specifies an external program to process messages as they are stored") , "" ,
 		M::many , "program" , 30 ,
@@ -700,6 +728,48 @@ G::Options Main::Options::spec()
 			// store-and-forward, but in practice clients tend to to time out
 			// while waiting for their mail message to be accepted.
 
+	G::Options::add( opt , '\0' , "cut-through" ,
+		tx("enables immediate forwarding with message content streamed to the "
+			"next-hop server as it is received (requires --forward-to)") , "" ,
+		M::zero , "" , 32 ,
+		t_smtpclient , t_smtpserver ) ;
+			// Like --immediate, but the next-hop SMTP transaction is started as
+			// soon as the submitting client sends its DATA command and the message
+			// content is passed on as it arrives. A copy of each message is still
+			// stored in the spool directory and the final response to the
+			// submitting client is the next-hop server's response. If the next-hop
+			// transaction fails early then the stored copy is forwarded instead.
+			// Cut-through forwarding is disabled if there are filters that could
+			// edit the message content.
+
+	G::Options::add( opt , '\0' , "forward-concurrency" ,
+		tx("forwards spooled messages using per-destination queues with the given number "
+			"of connections per destination and an optional overall limit") , "" ,
+		M::one , "count[,total]" , 32 ,
+		t_smtpclient ) ;
+			//example: 2,10
+			// Forwards spooled messages using separate queues for each routing
+			// destination, with up to the given number of concurrent connections
+			// per destination. An overall limit on the number of connections can
+			// be given after a comma, in which case connections are shared out
+			// between the destinations in turn. If a connection to a destination
+			// fails then its messages are deferred, with the retry time recorded
+			// in the envelope file and doubling after each failure (see
+			// --forward-retry).
+
+	G::Options::add( opt , '\0' , "forward-retry" ,
+		tx("sets the initial and maximum retry times (in seconds) for messages "
+			"deferred by --forward-concurrency (default is 60,14400)") , "" ,
+		M::one , "time[,max]" , 32 ,
+		t_smtpclient ) ;
+			//default: 60,14400
+			//example: 300,86400
+			// Sets the time (in seconds) before the first retry of a message that
+			// could not be forwarded because of a connection failure, and
+			// optionally the maximum retry time after a comma. The retry time
+			// doubles after each failure. The default is 60 seconds rising to four
+			// hours. Used with --forward-concurrency.
+
 	G::Options::add( opt , 'I' , "interface" ,
 		tx("defines the listening network addresses used for incoming connections! "
 			"(comma-separated list with optional smtp=,pop=,admin= qualifiers)") , "" ,
@@ -769,6 +839,21 @@ G::Options Main::Options::spec()
 			// "account:" built-in address verifier can be used to check recipient
 			// addresses against the list of local system account names.
 
+	G::Options::add( opt , '\0' , "verifier-cache" ,
+		tx("caches address verification results for the given time") , "" ,
+		M::one , "positive-ttl[,negative-ttl[,size]]" , 30 ,
+		t_smtpserver ) ;
+			//example: 300
+			//example: 3600,60,50000
+			// Caches the results from the --address-verifier so that repeated
+			// verification of the same recipient and envelope-from address,
+			// from the same client address with the same authentication, is
+			// answered from memory. Valid addresses are cached for the first
+			// time period in seconds and invalid addresses for the optional
+			// second period (default zero, ie. not cached). Temporary failures
+			// are never cached. The optional third field limits the number of
+			// cached results (default 10000).
+
 	G::Options::add( opt , 'Y' , "client-filter" ,
 		tx("specifies an external program to process messages when they are forwarded") , "" ,
 		M::many , "program" , 31 ,
@@ -859,6 +944,77 @@ G::Options Main::Options::spec()
 			//example: 10000000
 			// Limits the size of mail messages that can be submitted over SMTP.
 
+	G::Options::add( opt , '\0' , "spool-dedup" ,
+		tx("stores identical message content only once") , "" ,
+		M::zero , "" , 30 ,
+		t_smtpserver ) ;
+			// Stores identical message content files only once by hard-linking
+			// them to a file named by the content's digest in a ".dedup"
+			// sub-directory of the spool directory. This saves disk space and
+			// i/o for mailing-list traffic. A de-duplicated content file is
+			// copied before a client filter or a re-run of the server filter
+			// can edit it, so any edits only affect the one message. The
+			// digest is calculated using a hash function from the TLS library.
+
+	G::Options::add( opt , '\0' , "spool-memory" ,
+		tx("keeps new messages in memory rather than in the spool directory") , "" ,
+		M::one , "bytes" , 30 ,
+		t_smtpserver ) ;
+			//example: 100000000
+			// Keeps new messages in memory rather than writing them to the spool
+			// directory, up to the given total content size. Messages that
+			// would exceed the limit are written to the spool directory as
+			// normal. This is intended for pure relay deployments using
+			// --forward-to with --immediate, --cut-through or --poll, where
+			// spool files are just overhead. Messages that fail to be forwarded
+			// are moved into the spool directory, and any messages remaining
+			// in memory are written to the spool directory by an orderly
+			// shutdown, but they are lost if the program is killed. This option
+			// is ignored if the --filter or --client-filter options specify
+			// anything other than exit codes or delays.
+
+	G::Options::add( opt , '\0' , "spool-log" ,
+		tx("appends new messages to large segment files in the spool directory") , "" ,
+		M::zero , "" , 30 ,
+		t_smtpserver ) ;
+			// Appends new messages to large segment files in a ".segments"
+			// sub-directory of the spool directory rather than creating separate
+			// envelope and content files for each message. This avoids most of
+			// the per-message file-system overhead on busy relays. Message state
+			// is kept in an index file that is brought up to date after a crash
+			// by replaying the segment files, and old segments are compacted
+			// once most of their messages have been forwarded. The
+			// "emailrelay-export" utility can be used to copy messages back
+			// into separate envelope and content files. This option is ignored
+			// if the --filter or --client-filter options specify anything other
+			// than exit codes or delays.
+
+	G::Options::add( opt , '\0' , "spool-index" ,
+		tx("keeps an index snapshot of the spool directory for fast startup") , "" ,
+		M::zero , "" , 30 ,
+		t_smtpserver ) ;
+			// Keeps a list of queued messages that is updated as messages
+			// are stored and deleted, and saves it in an index snapshot file
+			// (".index/snapshot") in the spool directory at most every five
+			// minutes and on shutdown. When
+			// forwarding first starts after a restart the snapshot is used
+			// instead of a full directory scan, so that forwarding can start
+			// immediately even with a very large queue. The spool directory is
+			// scanned later if its modification time, or the inode number or
+			// size of any envelope file, shows that the snapshot is out of
+			// date. Later forwarding uses a plain directory scan.
+
+	G::Options::add( opt , '\0' , "spool-async" ,
+		tx("writes message content to the spool directory on worker threads") , "" ,
+		M::zero , "" , 30 ,
+		t_smtpserver ) ;
+			// Writes the content of incoming messages to the spool directory on
+			// a small pool of worker threads rather than on the main thread, so
+			// that a slow spool disk does not hold up other SMTP sessions.
+			// Submitting clients are slowed down if too much content is waiting
+			// to be written. This option has no effect with --spool-memory or
+			// --spool-log, or if multi-threading is not available.
+
 	G::Options::add( opt , '\0' , "dnsbl" ,
 		tx("configuration for DNSBL blocking of remote SMTP client addresses") , "" ,
 		M::many , "config" , 30 ,
@@ -869,7 +1025,23 @@ G::Options Main::Options::spec()
 			// is made up of comma-separated fields: the list of DNSBL servers,
 			// an optional rejection threshold, an optional timeout in
 			// milliseconds, and optionally the transport address of the
-			// DNS server.
+			// DNS server. Fields with a leading "!" are allowlisted address
+			// ranges that are not checked (eg. "!192.0.2.0/24").
+
+	G::Options::add( opt , '\0' , "rate-limit" ,
+		tx("limits the rate of connections and messages from each remote SMTP client") , "" ,
+		M::one , "connections,messages[,period][,auth]" , 30 ,
+		t_smtpserver ) ;
+			//example: 10,100
+			//example: 30,500,3600,auth
+			// Limits the number of SMTP connections and messages that each
+			// client address can submit over the given period in seconds
+			// (default 60). A limit of zero means no limit. Connections over
+			// the limit get a 421 response and messages get a 451 response
+			// at MAIL-FROM or DATA, before any filtering or storing. With
+			// "auth" the message limit applies to authenticated clients by
+			// their authentication id. IPv6 clients are limited by their
+			// /64 prefix.
 
 	G::Options::add( opt , '\0' , "test" , "testing" , "" , M::one , "x" , 0 , 0 ) ;
 
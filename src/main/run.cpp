@@ -20,6 +20,7 @@
 
 #include "gdef.h"
 #include "run.h"
+#include "unitthread.h"
 #include "options.h"
 #include "gssl.h"
 #include "gpop.h"
@@ -78,6 +79,9 @@ Main::Run::Run( Main::Output & output , const G::Arg & arg , bool has_gui ) :
 
 Main::Run::~Run()
 {
+	m_unit_threads.clear() ;
+	if( m_inbox_armed )
+		GNet::FutureEvent::send( m_inbox_handle ) ; // just to close it
 	if( m_monitor )
 		m_monitor->signal().disconnect() ;
 	for( auto & unit_ptr : m_units )
@@ -275,9 +279,11 @@ void Main::Run::run()
 	m_monitor = std::make_unique<GNet::Monitor>() ;
 	m_monitor->signal().connect( G::Slot::slot(*this,&Run::onNetworkEvent) ) ;
 
-	// create the active units
+	// create the active units -- optionally just the first one here
+	// and the others later on their own threads
 	//
-	for( std::size_t i = 0U ; i < configurations() ; i++ )
+	const bool unit_threads = unitThreads() ;
+	for( std::size_t i = 0U ; i < (unit_threads?1U:configurations()) ; i++ )
 	{
 		m_units.push_back( std::make_unique<Unit>( *this , static_cast<unsigned>(i) , versionNumber() ) ) ;
 		m_units.back()->clientDoneSignal().connect( G::Slot::slot(*this,&Run::onUnitDone) ) ;
@@ -311,6 +317,20 @@ void Main::Run::run()
 		if( configuration().daemon() )
 			G::Daemon::detach( pid_file.path() ) ;
 		commit( pid_file ) ;
+
+		// create the other units on their own threads, after any fork()
+		//
+		if( unit_threads )
+		{
+			armInbox() ;
+			for( std::size_t i = 1U ; i < configurations() ; i++ )
+			{
+				m_unit_threads.push_back( std::make_unique<UnitThread>( *this ,
+					static_cast<unsigned>(i) , versionNumber() , m_arg.prefix() ,
+					m_log_output->config() , configuration().logFile() ) ) ;
+			}
+		}
+
 		if( configuration().closeStderr() )
 			G::Process::closeStderr() ;
 
@@ -331,6 +351,7 @@ void Main::Run::run()
 
 std::string Main::Run::defaultDomain() const
 {
+	G::threading::lock_type lock( m_mutex ) ;
 	if( m_default_domain.empty() )
 	{
 		m_default_domain = GNet::Local::canonicalName() ;
@@ -443,6 +464,73 @@ void Main::Run::onQueueTimeout()
 	}
 }
 
+bool Main::Run::unitThreads() const
+{
+	using G::txt ;
+	if( configurations() < 2U || !configuration().unitThreads() )
+	{
+		return false ;
+	}
+	else if( !G::threading::works() )
+	{
+		G_WARNING( "Main::Run::unitThreads: " << txt("multi-threading not available: running all units on the main thread") ) ;
+		return false ;
+	}
+	else if( m_tls_library->enabled() && !m_tls_library->threadSafe() )
+	{
+		G_WARNING( "Main::Run::unitThreads: " << txt("tls library is not thread-safe: running all units on the main thread") ) ;
+		return false ;
+	}
+	return true ;
+}
+
+void Main::Run::post( Post post , const std::string & s0 , const std::string & s1 ,
+	const std::string & s2 , const std::string & s3 )
+{
+	G::threading::lock_type lock( m_mutex ) ;
+	if( post == Post::quit )
+		m_inbox.emplace_back( 3 , s0 , s1 , s2 , s3 ) ;
+	else if( m_inbox.size() < 100U )
+		m_inbox.emplace_back( 0 , s0 , s1 , s2 , s3 ) ;
+	if( m_inbox_armed )
+	{
+		m_inbox_armed = false ;
+		GNet::FutureEvent::send( m_inbox_handle ) ;
+	}
+}
+
+void Main::Run::armInbox()
+{
+	// a FutureEvent is one-shot so use a new one each time
+	G::threading::lock_type lock( m_mutex ) ;
+	m_inbox_event = std::make_unique<GNet::FutureEvent>( static_cast<GNet::FutureEventHandler&>(*this) ,
+		GNet::EventState::create(std::nothrow) ) ;
+	m_inbox_handle = m_inbox_event->handle() ;
+	m_inbox_armed = true ;
+}
+
+void Main::Run::onFutureEvent()
+{
+	std::deque<QueueItem> items ;
+	{
+		G::threading::lock_type lock( m_mutex ) ;
+		items.swap( m_inbox ) ;
+	}
+	armInbox() ; // deletes the current FutureEvent, our caller
+	for( const auto & item : items )
+	{
+		if( item.target == 3 )
+		{
+			if( m_event_loop )
+				m_event_loop->quit( item.s0 ) ;
+		}
+		else
+		{
+			addToSignalQueue( item.s0 , item.s1 , item.s2 , item.s3 ) ;
+		}
+	}
+}
+
 void Main::Run::checkThreading() const
 {
 	if( G::threading::using_std_thread )
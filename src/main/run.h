@@ -29,6 +29,7 @@
 #include "output.h"
 #include "geventloop.h"
 #include "gtimerlist.h"
+#include "gfutureevent.h"
 #include "glogoutput.h"
 #include "gmonitor.h"
 #include "gdaemon.h"
@@ -43,6 +44,7 @@
 namespace Main
 {
 	class Run ;
+	class UnitThread ;
 }
 
 //| \class Main::Run
@@ -61,13 +63,19 @@ namespace Main
 /// }
 /// \endcode
 ///
-class Main::Run
+class Main::Run : private GNet::FutureEventHandler
 {
 public:
+	enum class Post
+	{
+		event , // a notification event for the gui or admin interface
+		quit // a fatal error on a unit thread
+	} ;
+
 	Run( Output & output , const G::Arg & arg , bool has_gui = false ) ;
 		///< Constructor. Tries not to throw.
 
-	~Run() ;
+	~Run() override ;
 		///< Destructor.
 
 	void configure( const G::Options & ) ;
@@ -107,10 +115,17 @@ public:
 	G::Slot::Signal<std::string,std::string,std::string,std::string> & signal() noexcept ;
 		///< Provides a signal which is activated when something changes.
 
+	void post( Post , const std::string & s0 , const std::string & s1 = {} ,
+		const std::string & s2 = {} , const std::string & s3 = {} ) ;
+			///< A thread-safe method used by units running on their
+			///< own threads (see Main::UnitThread) to pass back a
+			///< notification event or a fatal error to the main
+			///< thread.
+
 private:
 	struct QueueItem
 	{
-		int target ; // 1=gui, 2=admin
+		int target ; // 0=unrouted, 1=gui, 2=admin, 3=quit
 		std::string s0 ;
 		std::string s1 ;
 		std::string s2 ;
@@ -141,6 +156,9 @@ private:
 	void addToSignalQueue( const std::string & , const std::string & , const std::string & = {} , const std::string & = {} ) ;
 	void onQueueTimeout() ;
 	void checkThreading() const ;
+	bool unitThreads() const ;
+	void onFutureEvent() override ; // GNet::FutureEventHandler
+	void armInbox() ;
 	G::Path appDir() const ;
 
 private:
@@ -159,6 +177,12 @@ private:
 	std::deque<QueueItem> m_queue ;
 	std::vector<Configuration> m_configurations ;
 	std::vector<std::unique_ptr<Unit>> m_units ;
+	mutable G::threading::mutex_type m_mutex ; // protects the inbox and default domain
+	std::deque<QueueItem> m_inbox ; // from unit threads
+	std::unique_ptr<GNet::FutureEvent> m_inbox_event ;
+	HANDLE m_inbox_handle {} ;
+	bool m_inbox_armed {false} ;
+	std::vector<std::unique_ptr<UnitThread>> m_unit_threads ; // last
 } ;
 
 #endif
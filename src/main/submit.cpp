@@ -33,10 +33,17 @@
 // If there are multiple BCC addressees then more than one message will be
 // submitted.
 //
+// In bulk mode ("--bulk") the input is a stream of messages, either in mbox
+// format or each one preceded by a line giving its length in bytes, and each
+// message is submitted as above. The new files are synced to disk in batches
+// before being committed. The emailrelay server can be told to rescan its
+// spool directory at the end by using "--admin" with its admin port.
+//
 // usage: submit [options] [--spool-dir <spool-dir>] [--from <envelope-from>] [<envelope-to> [<envelope-to> ...]]
 //
 // Eg:
 //  submit -d -F -t --content `echo Subject: motd | base64` --content = --from me@here you@there < /etc/motd
+//  submit --bulk=mbox --admin=10025 --spool-dir=/var/spool/emailrelay < messages.mbox
 //
 
 #include "gdef.h"
@@ -67,6 +74,7 @@
 #include <iostream>
 #include <sstream>
 #include <memory>
+#include <vector>
 #include <cstdlib>
 
 #ifdef G_WINDOWS
@@ -103,6 +111,101 @@ struct SubmitMessage
 	G::StringArray m_content ;
 } ;
 
+// Splits up a bulk input stream into separate messages.
+//
+class BulkReader
+{
+public:
+	enum class Format { Mbox , Length } ;
+	BulkReader( std::istream & , Format ) ;
+	bool next( std::string & text ) ;
+
+private:
+	bool nextMbox( std::string & ) ;
+	bool nextLength( std::string & ) ;
+	static bool isFromLine( std::string_view ) ;
+	static bool isQuotedFromLine( std::string_view ) ;
+
+private:
+	std::istream & m_stream ;
+	Format m_format ;
+	std::string m_line ;
+	bool m_pending {false} ;
+} ;
+
+BulkReader::BulkReader( std::istream & stream , Format format ) :
+	m_stream(stream) ,
+	m_format(format)
+{
+}
+
+bool BulkReader::next( std::string & text )
+{
+	return m_format == Format::Mbox ? nextMbox( text ) : nextLength( text ) ;
+}
+
+bool BulkReader::nextMbox( std::string & text )
+{
+	// mboxrd -- messages start with a "From " line, and any body
+	// lines starting with ">From ", ">>From " etc. are unquoted
+	text.clear() ;
+	while( !m_pending || !isFromLine(m_line) )
+	{
+		if( !std::getline( m_stream , m_line ) )
+			return false ;
+		m_pending = true ; // anything before the first "From " line is ignored
+	}
+	m_pending = false ;
+	while( std::getline( m_stream , m_line ) )
+	{
+		G::Str::trimRight( m_line , {"\r",1U} , 1U ) ;
+		if( isFromLine( m_line ) )
+		{
+			m_pending = true ;
+			break ;
+		}
+		if( isQuotedFromLine( m_line ) )
+			m_line.erase( 0U , 1U ) ;
+		text.append( m_line ).append( 1U , '\n' ) ;
+	}
+	if( text.size() >= 2U && text.compare( text.size()-2U , 2U , "\n\n" ) == 0 )
+		text.pop_back() ; // blank separator line
+	return true ;
+}
+
+bool BulkReader::nextLength( std::string & text )
+{
+	// a line with the message size followed by that many bytes
+	std::string line ;
+	while( std::getline( m_stream , line ) )
+	{
+		G::Str::trim( line , G::Str::ws() ) ;
+		if( !line.empty() )
+			break ;
+	}
+	if( line.empty() )
+		return false ;
+	if( !G::Str::isULong(line) )
+		throw std::runtime_error( "invalid message length in bulk input: [" + G::Str::printable(line) + "]" ) ;
+
+	text.resize( G::Str::toULong(line) ) ;
+	m_stream.read( text.data() , static_cast<std::streamsize>(text.size()) ) ;
+	if( static_cast<std::size_t>(m_stream.gcount()) != text.size() )
+		throw std::runtime_error( "truncated message in bulk input" ) ;
+	return true ;
+}
+
+bool BulkReader::isFromLine( std::string_view line )
+{
+	return line.size() >= 5U && line.substr(0U,5U) == "From "_sv ;
+}
+
+bool BulkReader::isQuotedFromLine( std::string_view line )
+{
+	std::size_t pos = line.find_first_not_of( '>' ) ;
+	return pos != 0U && pos != std::string::npos && isFromLine( line.substr(pos) ) ;
+}
+
 GStore::MessageStore::AddressStyle addressStyle( std::string_view address , std::string_view type )
 {
 	auto address_style = GStore::MessageStore::addressStyle( address ) ;
@@ -266,7 +369,54 @@ G::Path pathValue( const std::string & s )
 	return path ;
 }
 
-void submit( const G::GetOpt & opt )
+void syncFile( const G::Path & path )
+{
+	if( !G::File::sync( path , std::nothrow ) )
+		throw std::runtime_error( "cannot sync [" + path.str() + "] to disk" ) ;
+}
+
+void commitMessages( GStore::FileStore & file_store , const G::GetOpt & opt ,
+	std::vector<std::unique_ptr<GStore::NewMessage>> & store_messages , bool sync )
+{
+	// make the prepare()d files permanent before they are committed
+	if( sync && !store_messages.empty() )
+	{
+		for( auto & store_message : store_messages )
+		{
+			syncFile( file_store.contentPath( store_message->id() ) ) ;
+			syncFile( file_store.envelopePath( store_message->id() , GStore::FileStore::State::New ) ) ;
+		}
+		syncFile( file_store.directory() ) ;
+	}
+
+	// commit the message files
+	for( auto & store_message : store_messages )
+	{
+		store_message->commit( true ) ;
+		G::Path new_content = file_store.contentPath( store_message->id() ) ;
+		G::Path new_envelope = file_store.envelopePath( store_message->id() ) ;
+
+		// copy into spool-dir subdirectories (cf. emailrelay-filter-copy)
+		if( opt.contains("copy") )
+			copyIntoSubDirectories( new_envelope ) ;
+
+		// print the content filename
+		if( opt.contains("verbose") )
+			std::cout << new_content << std::endl ;
+		else if( opt.contains("filename") )
+			std::cout << new_content.basename() << std::endl ;
+	}
+
+	// make the renames permanent
+	if( sync && !store_messages.empty() )
+		syncFile( file_store.directory() ) ;
+
+	store_messages.clear() ;
+}
+
+void submitMessage( const G::GetOpt & opt , GStore::FileStore & file_store , std::istream & stream ,
+	bool read_stream , bool interactive , unsigned long bulk_number ,
+	std::vector<std::unique_ptr<GStore::NewMessage>> & prepared_messages )
 {
 	// unpack the command-line options
 	SubmitMessage message ;
@@ -277,18 +427,14 @@ void submit( const G::GetOpt & opt )
 	message.m_from_auth_out = opt.contains("from-auth-out") ?
 		( opt.value("from-auth-out","").empty() ? std::string("<>") : G::Xtext::encode(opt.value("from-auth-out","")) ) :
 		std::string() ;
-	G::Path opt_input_file = pathValue( opt.value("input-file") ) ;
 	auto opt_content_base64 = G::Str::splitIntoFields( opt.value("content") , ',' ) ;
-	bool opt_read_stdin = !opt.contains( "no-stdin" ) ;
 	bool opt_body = opt.contains( "body" ) ;
-	bool opt_copy = opt.contains( "copy" ) ;
 	bool opt_bcc_split = opt.contains( "bcc-split" ) ;
 	bool add_date_header = opt.contains( "content-date" ) ;
 	bool opt_add_from_header = opt.contains( "content-from" ) ;
 	bool opt_add_to_header = opt.contains( "content-to" ) ;
 	bool opt_add_content_message_id = opt.contains( "content-message-id" ) ;
 	std::string opt_message_id_domain = opt.value( "content-message-id" , "local" ) ;
-	G::Path opt_spool_dir = pathValue( opt.value( "spool-dir" , GStore::FileStore::defaultDirectory().str() ) ) ;
 
 	// take the command-line arguments as envelope-to addresses
 	message.m_envelope_to_list = G::Str::splitIntoTokens( opt.value("to") , "," ) ;
@@ -298,16 +444,6 @@ void submit( const G::GetOpt & opt )
 	std::for_each( message.m_envelope_to_list.begin() , message.m_envelope_to_list.end() ,
 		[](std::string &to){if(!to.empty()&&to[0]=='\\')to=to.substr(1U);} ) ;
 
-	// open the input file
-	std::ifstream input_file ;
-	if( !opt_input_file.empty() )
-	{
-		input_file.open( opt_input_file.iopath() ) ;
-		if( !input_file.good() )
-			throw std::runtime_error( "cannot open input file [" + opt_input_file.str() + "]" ) ;
-	}
-	std::istream & stream = opt_input_file.empty() ? std::cin : input_file ;
-
 	// read in headers from the command-line
 	auto content_p = opt_content_base64.cbegin() ;
 	for( ; content_p != opt_content_base64.cend() ; ++content_p )
@@ -318,9 +454,10 @@ void submit( const G::GetOpt & opt )
 	}
 
 	// read in headers from file
-	if( ( opt_read_stdin || !opt_input_file.empty() ) && !opt_body )
+	if( read_stream && !opt_body )
 	{
-		showInputHelp() ;
+		if( interactive )
+			showInputHelp() ;
 		while( stream.good() )
 		{
 			std::string line = G::Str::readLineFrom( stream ) ;
@@ -406,7 +543,10 @@ void submit( const G::GetOpt & opt )
 	if( opt_add_content_message_id && !have_id_header )
 	{
 		std::ostringstream ss ;
-		ss << "Message-ID: <" << G::SystemTime::now() << "." << G::Process::Id() << "@" << opt_message_id_domain << ">" ;
+		ss << "Message-ID: <" << G::SystemTime::now() << "." << G::Process::Id() ;
+		if( bulk_number )
+			ss << "." << bulk_number ;
+		ss << "@" << opt_message_id_domain << ">" ;
 		message.m_content.insert( message.m_content.begin() , ss.str() ) ;
 		G_LOG_S( "submit: added: message-id: [" << ss.str() << "]" ) ;
 	}
@@ -440,7 +580,6 @@ void submit( const G::GetOpt & opt )
 	}
 
 	// create new message files
-	GStore::FileStore file_store( opt_spool_dir , "" , {} ) ;
 	std::vector<std::unique_ptr<GStore::NewMessage>> store_messages ;
 	if( !opt_bcc_split || message.m_envelope_bcc_list.size() <= 1U )
 	{
@@ -459,38 +598,128 @@ void submit( const G::GetOpt & opt )
 	}
 
 	// read the message body/bodies from the input stream
-	if( opt_read_stdin || !opt_input_file.empty() )
+	if( read_stream )
 	{
-		showInputHelp() ;
+		if( interactive )
+			showInputHelp() ;
 		std::string line ;
 		while( std::getline(stream,line) )
 		{
 			G::Str::trimRight( line , {"\r",1U} , 1U ) ;
-			if( isatty_(0) && line == "." )
+			if( interactive && line == "." )
 				break ;
 			for( auto & store_message : store_messages )
 				store_message->addContentLine( line ) ;
 		}
 	}
 
-	// commit the message files
+	// prepare the message files
 	for( auto & store_message : store_messages )
 	{
 		store_message->prepare( {} , "127.0.0.1" , {} ) ;
-		store_message->commit( true ) ;
-		G::Path new_content = file_store.contentPath( store_message->id() ) ;
-		G::Path new_envelope = file_store.envelopePath( store_message->id() ) ;
+		prepared_messages.push_back( std::move(store_message) ) ;
+	}
+}
 
-		// copy into spool-dir subdirectories (cf. emailrelay-filter-copy)
-		if( opt_copy )
-			copyIntoSubDirectories( new_envelope ) ;
+void notifyServer( unsigned int port )
+{
+	// send a "rescan" command to the emailrelay admin interface
+	// on the local machine so that it picks up the new messages
+	#ifdef G_WINDOWS
+		WSADATA wsa_data {} ;
+		if( ::WSAStartup( MAKEWORD(2,2) , &wsa_data ) != 0 )
+			throw std::runtime_error( "cannot initialise winsock" ) ;
+		const SOCKET invalid_fd = INVALID_SOCKET ;
+		auto close_ = [](SOCKET fd){ ::closesocket(fd) ; } ;
+	#else
+		const SOCKET invalid_fd = -1 ;
+		auto close_ = [](SOCKET fd){ ::close(fd) ; } ;
+	#endif
 
-		// print the content filename
-		if( opt.contains("verbose") )
-			std::cout << new_content << std::endl ;
-		else if( opt.contains("filename") )
-			std::cout << new_content.basename() << std::endl ;
+	sockaddr_in address {} ;
+	address.sin_family = AF_INET ;
+	address.sin_port = htons( static_cast<unsigned short>(port) ) ;
+	address.sin_addr.s_addr = htonl( INADDR_LOOPBACK ) ;
+
+	SOCKET fd = ::socket( AF_INET , SOCK_STREAM , 0 ) ;
+	if( fd == invalid_fd ||
+		::connect( fd , reinterpret_cast<const sockaddr*>(&address) , sizeof(address) ) != 0 ) // NOLINT
+	{
+		if( fd != invalid_fd ) close_( fd ) ;
+		throw std::runtime_error( "cannot connect to the admin port " + std::to_string(port) ) ;
+	}
+
+	std::string reply ;
+	const std::string command = "rescan\r\n" ;
+	if( ::send( fd , command.data() , static_cast<int>(command.size()) , 0 ) == static_cast<ssize_t>(command.size()) )
+	{
+		std::array<char,200U> buffer {} ;
+		while( reply.find('\n') == std::string::npos && reply.size() < 1000U )
+		{
+			ssize_t n = ::recv( fd , buffer.data() , static_cast<int>(buffer.size()) , 0 ) ;
+			if( n <= 0 ) break ;
+			reply.append( buffer.data() , static_cast<std::size_t>(n) ) ;
+		}
+	}
+	close_( fd ) ;
+
+	reply = G::Str::trimmed( G::Str::head( reply , "\n" , false ) , G::Str::ws() ) ;
+	if( reply != "OK" )
+		std::cerr << G::Arg::exe().withoutExtension().basename() << ": admin notification: " << (reply.empty()?std::string("no response"):G::Str::printable(reply)) << std::endl ;
+}
+
+void submit( const G::GetOpt & opt )
+{
+	G::Path opt_input_file = pathValue( opt.value("input-file") ) ;
+	G::Path opt_spool_dir = pathValue( opt.value( "spool-dir" , GStore::FileStore::defaultDirectory().str() ) ) ;
+	bool opt_read_stdin = !opt.contains( "no-stdin" ) ;
+	std::string opt_bulk = opt.value( "bulk" ) ;
+	std::size_t opt_bulk_sync = opt.contains("bulk-sync") ? G::Str::toUInt( opt.value("bulk-sync") ) : 1000U ;
+	bool bulk = opt.contains( "bulk" ) ;
+	if( bulk && opt_bulk != "mbox" && opt_bulk != "length" )
+		throw std::runtime_error( "invalid bulk format: use \"mbox\" or \"length\"" ) ;
+	if( bulk && !opt_read_stdin && opt_input_file.empty() )
+		throw std::runtime_error( "the bulk option requires an input file or the standard input" ) ;
+
+	// open the input file
+	std::ifstream input_file ;
+	if( !opt_input_file.empty() )
+	{
+		input_file.open( opt_input_file.iopath() ) ;
+		if( !input_file.good() )
+			throw std::runtime_error( "cannot open input file [" + opt_input_file.str() + "]" ) ;
+	}
+	std::istream & stream = opt_input_file.empty() ? std::cin : input_file ;
+
+	GStore::FileStore file_store( opt_spool_dir , "" , {} ) ;
+	std::vector<std::unique_ptr<GStore::NewMessage>> prepared_messages ;
+	if( bulk )
+	{
+		// submit each message from the bulk input, syncing and committing in batches
+		BulkReader reader( stream , opt_bulk == "mbox" ? BulkReader::Format::Mbox : BulkReader::Format::Length ) ;
+		std::string text ;
+		unsigned long count = 0UL ;
+		while( reader.next( text ) )
+		{
+			std::istringstream message_stream( text ) ;
+			submitMessage( opt , file_store , message_stream , true , false , ++count , prepared_messages ) ;
+			if( prepared_messages.size() >= std::max(std::size_t(1U),opt_bulk_sync) )
+				commitMessages( file_store , opt , prepared_messages , opt_bulk_sync != 0U ) ;
+		}
+		commitMessages( file_store , opt , prepared_messages , opt_bulk_sync != 0U ) ;
+		G_LOG_S( "submit: bulk: submitted " << count << " message(s)" ) ;
+	}
+	else
+	{
+		bool read_stream = opt_read_stdin || !opt_input_file.empty() ;
+		bool interactive = isatty_(0) ;
+		submitMessage( opt , file_store , stream , read_stream , interactive , 0UL , prepared_messages ) ;
+		commitMessages( file_store , opt , prepared_messages , false ) ;
 	}
+
+	// tell the server to rescan the spool directory
+	if( opt.contains("admin") )
+		notifyServer( G::Str::toUInt( opt.value("admin") ) ) ;
 }
 
 G::Options options()
@@ -573,6 +802,28 @@ G::Options options()
 		M::zero , "" , 2 , t_undef ) ;
 			// Prints the name of the content file.
 
+	G::Options::add( opt , '\0' , "bulk" ,
+		tx("reads a stream of messages in 'mbox' or 'length' format") , "" ,
+		M::one , "format" , 2 , t_undef ) ;
+			// Reads multiple messages from the standard input or --input-file.
+			// Use "mbox" for an mbox file with ">From" quoting, or "length" for
+			// messages that are each preceded by a line giving their size in
+			// bytes.
+
+	G::Options::add( opt , '\0' , "bulk-sync" ,
+		tx("sets the number of messages synced to disk together in bulk mode") , "" ,
+		M::one , "count" , 3 , t_undef ) ;
+			// Sets the number of new messages that are synced to disk
+			// before being committed in bulk mode. The default is 1000.
+			// Use zero to disable syncing.
+
+	G::Options::add( opt , '\0' , "admin" ,
+		tx("asks the server on the admin port to rescan the spool directory") , "" ,
+		M::one , "port" , 2 , t_undef ) ;
+			// Connects to the emailrelay server's admin port on the local
+			// machine once the messages have been submitted and asks it
+			// to forward from the spool directory.
+
 	G::Options::add( opt , 'C' , "content" ,
 		tx("adds a line of content") , "" ,
 		M::many , "base64" , 3 , t_undef ) ;
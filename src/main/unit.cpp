@@ -114,8 +114,14 @@ Main::Unit::Unit( Run & run , unsigned int unit_id , const std::string & version
 	// create message store stuff
 	//
 	m_file_store = std::make_unique<GStore::FileStore>( m_configuration.spoolDir() , m_configuration.deliveryDir() , m_configuration.fileStoreConfig() ) ;
+	if( m_configuration.memoryStore() )
+		m_memory_store = std::make_unique<GStore::MemoryStore>( *m_file_store , m_configuration.memoryStoreConfig() ) ;
+	if( m_configuration.segmentStore() )
+		m_segment_store = std::make_unique<GStore::SegmentStore>( *m_file_store , m_configuration.segmentStoreConfig() ) ;
 	m_filter_factory = std::make_unique<GFilters::FilterFactory>( *m_file_store ) ;
-	m_verifier_factory = std::make_unique<GVerifiers::VerifierFactory>() ;
+	GFilters::FilterFactory::load( m_configuration.filter() ) ; // eg. signing keys
+	GFilters::FilterFactory::load( m_configuration.clientFilter() ) ;
+	m_verifier_factory = std::make_unique<GVerifiers::VerifierFactory>( m_configuration.verifierCacheConfig() ) ;
 	if( do_pop )
 	{
 		m_pop_store = GPop::newStore( m_configuration.spoolDir() , m_configuration.popStoreConfig() ) ;
@@ -133,7 +139,7 @@ Main::Unit::Unit( Run & run , unsigned int unit_id , const std::string & version
 	//
 	if( do_smtp )
 	{
-		if( m_configuration.immediate() )
+		if( m_configuration.immediate() && !m_configuration.cutThrough() )
 			G_WARNING( "Unit::ctor: " << txt("using --immediate can result in client timeout errors: "
 				"try --forward-on-disconnect instead") ) ;
 
@@ -142,7 +148,7 @@ Main::Unit::Unit( Run & run , unsigned int unit_id , const std::string & version
 		G_ASSERT( m_server_secrets != nullptr ) ;
 		m_smtp_server = std::make_unique<GSmtp::Server>(
 			m_es_rethrow ,
-			*m_file_store ,
+			store() ,
 			*m_filter_factory ,
 			*m_verifier_factory ,
 			*m_client_secrets ,
@@ -179,13 +185,18 @@ Main::Unit::Unit( Run & run , unsigned int unit_id , const std::string & version
 		info_map["credit"] = GSsl::Library::credit("","\n","") ;
 		info_map["copyright"] = Legal::copyright() ;
 
+		GSmtp::AdminServer::Config admin_config =
+			m_configuration.adminServerConfig( info_map , clientTlsProfile() , domain() , clientDomain() ) ;
+		if( m_verifier_factory->cacheEnabled() )
+			admin_config.set_info_function( "verifier-cache" , [this](){ return m_verifier_factory->cacheInfo() ; } ) ;
+
 		m_admin_server = std::make_unique<GSmtp::AdminServer>(
 			m_es_rethrow ,
-			*m_file_store ,
+			store() ,
 			*m_filter_factory ,
 			*m_client_secrets ,
 			m_configuration.listeningNames("admin") ,
-			m_configuration.adminServerConfig( info_map , clientTlsProfile() , domain() , clientDomain() ) ) ;
+			admin_config ) ;
 	}
 
 	if( GSmtp::AdminServer::enabled() && m_admin_server ) m_admin_server->commandSignal().connect( G::Slot::slot(*this,&Unit::onAdminCommand) ) ;
@@ -193,10 +204,14 @@ Main::Unit::Unit( Run & run , unsigned int unit_id , const std::string & version
 	store().messageStoreRescanSignal().connect( G::Slot::slot(*this,&Unit::onStoreRescanEvent) ) ;
 	m_client_ptr.deletedSignal().connect( G::Slot::slot(*this,&Unit::onClientDone) ) ;
 	m_client_ptr.eventSignal().connect( G::Slot::slot(*this,&Unit::onClientEvent) ) ;
+	m_scheduler_ptr.deletedSignal().connect( G::Slot::slot(*this,&Unit::onClientDone) ) ;
+	m_scheduler_ptr.eventSignal().connect( G::Slot::slot(*this,&Unit::onClientEvent) ) ;
 }
 
 Main::Unit::~Unit()
 {
+	m_scheduler_ptr.eventSignal().disconnect() ;
+	m_scheduler_ptr.deletedSignal().disconnect() ;
 	m_client_ptr.eventSignal().disconnect() ;
 	m_client_ptr.deletedSignal().disconnect() ;
 	store().messageStoreRescanSignal().disconnect() ;
@@ -277,12 +292,12 @@ void Main::Unit::onRequestForwardingTimeout()
 	using G::format ;
 	using G::txt ;
 
-	if( m_client_ptr.busy() )
+	if( forwardingBusy() )
 	{
 		G_LOG( "Main::Unit::onRequestForwardingTimeout: "
 			<< format(txt("forwarding: [%1%]: still busy from last time")) % m_forwarding_reason
-			<< (m_client_ptr->peerAddressString().empty() ? "" : ": connected to ")
-			<< m_client_ptr->peerAddressString() ) ;
+			<< (forwardingPeer().empty() ? "" : ": connected to ")
+			<< forwardingPeer() ) ;
 		m_forwarding_pending = true ;
 	}
 	else
@@ -315,13 +330,27 @@ std::string Main::Unit::startForwarding()
 	try
 	{
 		G_ASSERT( m_client_secrets != nullptr ) ;
-		m_client_ptr.reset( std::make_unique<GSmtp::Forward>(
-			m_es_rethrow.eh(m_client_ptr) ,
-			*m_file_store ,
-			*m_filter_factory ,
-			GNet::Location(m_configuration.serverAddress(),m_resolver_family) ,
-			*m_client_secrets ,
-			m_configuration.smtpClientConfig( clientTlsProfile() , domain() , clientDomain() ) ) ) ;
+		if( m_configuration.scheduler() )
+		{
+			m_scheduler_ptr.reset( std::make_unique<GSmtp::Scheduler>(
+				m_es_rethrow.eh(m_scheduler_ptr) ,
+				store() ,
+				*m_filter_factory ,
+				GNet::Location(m_configuration.serverAddress(),m_resolver_family) ,
+				*m_client_secrets ,
+				m_configuration.smtpClientConfig( clientTlsProfile() , domain() , clientDomain() ) ,
+				m_configuration.schedulerConfig() ) ) ;
+		}
+		else
+		{
+			m_client_ptr.reset( std::make_unique<GSmtp::Forward>(
+				m_es_rethrow.eh(m_client_ptr) ,
+				store() ,
+				*m_filter_factory ,
+				GNet::Location(m_configuration.serverAddress(),m_resolver_family) ,
+				*m_client_secrets ,
+				m_configuration.smtpClientConfig( clientTlsProfile() , domain() , clientDomain() ) ) ) ;
+		}
 		return {} ;
 	}
 	catch( std::exception & e )
@@ -331,13 +360,26 @@ std::string Main::Unit::startForwarding()
 	}
 }
 
+bool Main::Unit::forwardingBusy() const
+{
+	return m_client_ptr.busy() || m_scheduler_ptr.busy() ;
+}
+
+std::string Main::Unit::forwardingPeer() const
+{
+	return
+		m_client_ptr.busy() ? m_client_ptr->peerAddressString() :
+		( m_scheduler_ptr.busy() ? m_scheduler_ptr->peerAddressString() : std::string() ) ;
+}
+
 bool Main::Unit::needsTls( const Configuration & configuration )
 {
 	return
 		configuration.clientTls() ||
 		configuration.clientOverTls() ||
 		configuration.serverTls() ||
-		configuration.serverTlsConnection() ;
+		configuration.serverTlsConnection() ||
+		configuration.filterSigning() ;
 }
 
 bool Main::Unit::prefersTls( const Configuration & configuration )
@@ -345,7 +387,8 @@ bool Main::Unit::prefersTls( const Configuration & configuration )
 	return
 		!configuration.clientSecretsFile().empty() ||
 		!configuration.serverSecretsFile().empty() ||
-		!configuration.popSecretsFile().empty() ;
+		!configuration.popSecretsFile().empty() ||
+		configuration.fileStoreConfig().dedup ; // hash function for de-duplication
 }
 
 bool Main::Unit::nothingToDo() const
@@ -443,12 +486,20 @@ bool Main::Unit::quitWhenSent() const
 GStore::MessageStore & Main::Unit::store()
 {
 	G_ASSERT( m_file_store.get() != nullptr ) ;
+	if( m_memory_store )
+		return *(static_cast<GStore::MessageStore*>(m_memory_store.get())) ;
+	if( m_segment_store )
+		return *(static_cast<GStore::MessageStore*>(m_segment_store.get())) ;
 	return *(static_cast<GStore::MessageStore*>(m_file_store.get())) ;
 }
 
 const GStore::MessageStore & Main::Unit::store() const
 {
 	G_ASSERT( m_file_store.get() != nullptr ) ;
+	if( m_memory_store )
+		return *(static_cast<const GStore::MessageStore*>(m_memory_store.get())) ;
+	if( m_segment_store )
+		return *(static_cast<const GStore::MessageStore*>(m_segment_store.get())) ;
 	return *(static_cast<const GStore::MessageStore*>(m_file_store.get())) ;
 }
 
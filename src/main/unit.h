@@ -28,10 +28,14 @@
 #include "gslot.h"
 #include "gsecrets.h"
 #include "gfilestore.h"
+#include "gmemorystore.h"
+#include "gsegmentstore.h"
 #include "gfiledelivery.h"
 #include "gsmtpforward.h"
+#include "gsmtpscheduler.h"
 #include "gsmtpserver.h"
 #include "gadminserver.h"
+#include "gverifierfactory.h"
 #include "gpopserver.h"
 #include "gpopstore.h"
 #include <memory>
@@ -117,6 +121,8 @@ private:
 	void onRequestForwardingTimeout() ;
 	bool logForwarding() const ;
 	std::string startForwarding() ;
+	bool forwardingBusy() const ;
+	std::string forwardingPeer() const ;
 	void requestForwarding( const std::string & reason = {} ) ;
 	void onAdminCommand( GSmtp::AdminServer::Command , unsigned int ) ;
 	void onServerEvent( const std::string & s1 , const std::string & ) ;
@@ -152,9 +158,11 @@ private:
 	std::unique_ptr<GNet::Timer<Unit>> m_forwarding_timer ;
 	std::unique_ptr<GNet::Timer<Unit>> m_poll_timer ;
 	std::unique_ptr<GStore::FileStore> m_file_store ;
+	std::unique_ptr<GStore::MemoryStore> m_memory_store ;
+	std::unique_ptr<GStore::SegmentStore> m_segment_store ;
 	std::unique_ptr<GStore::FileDelivery> m_file_delivery ;
 	std::unique_ptr<GSmtp::FilterFactoryBase> m_filter_factory ;
-	std::unique_ptr<GSmtp::VerifierFactoryBase> m_verifier_factory ;
+	std::unique_ptr<GVerifiers::VerifierFactory> m_verifier_factory ;
 	std::unique_ptr<GAuth::SaslClientSecrets> m_client_secrets ;
 	std::unique_ptr<GAuth::SaslServerSecrets> m_server_secrets ;
 	std::unique_ptr<GAuth::SaslServerSecrets> m_pop_secrets ;
@@ -163,6 +171,7 @@ private:
 	std::unique_ptr<GPop::Server> m_pop_server ;
 	std::unique_ptr<GSmtp::AdminServer> m_admin_server ;
 	GNet::ClientPtr<GSmtp::Forward> m_client_ptr ;
+	GNet::ClientPtr<GSmtp::Scheduler> m_scheduler_ptr ;
 } ;
 
 #endif
@@ -0,0 +1,258 @@
+// 
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file unitthread.cpp
+///
+
+#include "gdef.h"
+#include "unitthread.h"
+#include "unit.h"
+#include "run.h"
+#include "geventloop.h"
+#include "gtimerlist.h"
+#include "gmonitor.h"
+#include "gfutureevent.h"
+#include "geventstate.h"
+#include "gcleanup.h"
+#include "gslot.h"
+#include "gformat.h"
+#include "ggettext.h"
+#include "glog.h"
+#include <memory>
+
+namespace Main
+{
+	namespace UnitThreadImp
+	{
+		class Stopper ;
+	}
+}
+
+// A future-event handler that quits the current thread's event loop.
+//
+class Main::UnitThreadImp::Stopper : private GNet::FutureEventHandler
+{
+public:
+	explicit Stopper( GNet::EventState es ) :
+		m_future_event(*this,es)
+	{
+	}
+	HANDLE handle() noexcept
+	{
+		return m_future_event.handle() ;
+	}
+
+private:
+	void onFutureEvent() override
+	{
+		GNet::EventLoop::instance().quit( std::string() ) ;
+	}
+
+private:
+	GNet::FutureEvent m_future_event ;
+} ;
+
+Main::UnitThread::UnitThread( Run & run , unsigned int unit_id , const std::string & version ,
+	const std::string & log_exename , const G::LogOutput::Config & log_config ,
+	const G::Path & log_file ) :
+		m_run(run) ,
+		m_unit_id(unit_id) ,
+		m_version(version) ,
+		m_log_exename(log_exename) ,
+		m_log_config(log_config) ,
+		m_log_file(log_file)
+{
+	{
+		G::Cleanup::Block block_signals ; // signals are delivered to the main thread
+		m_thread = G::threading::thread_type( UnitThread::run , this ) ;
+	}
+
+	// wait for the thread to construct the unit
+	{
+		G::threading::unique_lock_type lock( m_mutex ) ;
+		m_cond.wait( lock , [this](){return m_state != State::starting && m_state != State::constructing;} ) ;
+	}
+
+	if( state() == State::failed )
+	{
+		if( m_thread.joinable() )
+			m_thread.join() ;
+		std::rethrow_exception( m_exception ) ;
+	}
+}
+
+Main::UnitThread::~UnitThread()
+{
+	try
+	{
+		{
+			G::threading::lock_type lock( m_mutex ) ;
+			if( m_stop_handle_valid )
+			{
+				m_stop_handle_valid = false ;
+				GNet::FutureEvent::send( m_stop_handle ) ;
+			}
+		}
+		if( m_thread.joinable() )
+			m_thread.join() ;
+	}
+	catch(...)
+	{
+	}
+}
+
+unsigned int Main::UnitThread::id() const noexcept
+{
+	return m_unit_id ;
+}
+
+Main::UnitThread::State Main::UnitThread::state()
+{
+	G::threading::lock_type lock( m_mutex ) ;
+	return m_state ;
+}
+
+void Main::UnitThread::run( UnitThread * This ) noexcept
+{
+	// thread function, spawned from ctor and join()ed from dtor
+	try
+	{
+		This->runImp() ;
+	}
+	catch(...) // worker thread outer function
+	{
+		{
+			G::threading::lock_type lock( This->m_mutex ) ;
+			if( This->m_state == State::starting || This->m_state == State::constructing )
+			{
+				This->m_exception = std::current_exception() ;
+				This->m_state = State::failed ;
+			}
+			else
+			{
+				This->m_state = State::finished ;
+			}
+		}
+		This->m_cond.notify_all() ;
+	}
+}
+
+void Main::UnitThread::runImp()
+{
+	std::unique_ptr<G::LogOutput> log_output ;
+	std::unique_ptr<GNet::EventLoop> event_loop ;
+	std::unique_ptr<GNet::TimerList> timer_list ;
+	std::unique_ptr<GNet::Monitor> monitor ;
+	std::unique_ptr<UnitThreadImp::Stopper> stopper ;
+	std::unique_ptr<Unit> unit ;
+	{
+		{
+			G::threading::lock_type lock( m_mutex ) ;
+			m_state = State::constructing ;
+		}
+		try
+		{
+			// thread-local singletons
+			log_output = std::make_unique<G::LogOutput>( m_log_exename , m_log_config , m_log_file ) ;
+			event_loop = GNet::EventLoop::create() ;
+			timer_list = std::make_unique<GNet::TimerList>() ;
+			monitor = std::make_unique<GNet::Monitor>() ;
+			monitor->signal().connect( G::Slot::slot(*this,&UnitThread::onNetworkEvent) ) ;
+			stopper = std::make_unique<UnitThreadImp::Stopper>( GNet::EventState::create(std::nothrow) ) ;
+
+			unit = std::make_unique<Unit>( m_run , m_unit_id , m_version ) ;
+			unit->clientDoneSignal().connect( G::Slot::slot(*this,&UnitThread::onUnitDone) ) ;
+			unit->eventSignal().connect( G::Slot::slot(*this,&UnitThread::onUnitEvent) ) ;
+
+			{
+				G::threading::lock_type lock( m_mutex ) ;
+				m_stop_handle = stopper->handle() ;
+				m_stop_handle_valid = true ;
+				m_state = State::running ;
+			}
+			m_cond.notify_all() ;
+		}
+		catch(...)
+		{
+			if( monitor )
+				monitor->signal().disconnect() ;
+			{
+				G::threading::lock_type lock( m_mutex ) ;
+				m_exception = std::current_exception() ;
+				m_state = State::failed ;
+			}
+			m_cond.notify_all() ;
+			return ;
+		}
+	}
+
+	std::string reason ;
+	try
+	{
+		unit->start() ;
+		reason = event_loop->run() ;
+	}
+	catch( std::exception & e )
+	{
+		reason = e.what() ;
+	}
+
+	if( !reason.empty() )
+	{
+		G_ERROR( "Main::UnitThread::run: " << reason ) ;
+		m_run.post( Run::Post::quit , reason ) ;
+	}
+
+	unit->clientDoneSignal().disconnect() ;
+	unit->eventSignal().disconnect() ;
+	monitor->signal().disconnect() ;
+
+	G::threading::lock_type lock( m_mutex ) ;
+	m_state = State::finished ;
+	if( m_stop_handle_valid )
+	{
+		m_stop_handle_valid = false ;
+		GNet::FutureEvent::send( m_stop_handle ) ; // just to close it
+	}
+}
+
+void Main::UnitThread::onUnitDone( unsigned int /*unit_id*/ , std::string reason , bool quit_when_sent )
+{
+	// see Run::onUnitDone() -- a forward-and-quit unit just
+	// finishes its own thread rather than the whole process
+	if( !reason.empty() )
+	{
+		using G::txt ;
+		using G::format ;
+		G_ERROR( "Main::UnitThread::onUnitDone: " << format(txt("forwarding: %1%")) % reason ) ;
+	}
+	if( quit_when_sent )
+	{
+		G_DEBUG( "Main::UnitThread::onUnitDone: unit " << m_unit_id << " finished" ) ;
+		GNet::EventLoop::instance().quit( std::string() ) ;
+	}
+}
+
+void Main::UnitThread::onUnitEvent( unsigned int /*unit_id*/ , std::string s1 , std::string s2 , std::string s3 )
+{
+	m_run.post( Run::Post::event , "client" , s1 , s2 , s3 ) ;
+}
+
+void Main::UnitThread::onNetworkEvent( const std::string & s1 , const std::string & s2 )
+{
+	m_run.post( Run::Post::event , "network" , s1 , s2 ) ;
+}
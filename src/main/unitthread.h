@@ -0,0 +1,101 @@
+// 
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file unitthread.h
+///
+
+#ifndef G_MAIN_UNIT_THREAD_H
+#define G_MAIN_UNIT_THREAD_H
+
+#include "gdef.h"
+#include "glogoutput.h"
+#include "gpath.h"
+#include <string>
+#include <exception>
+
+namespace Main
+{
+	class UnitThread ;
+	class Run ;
+}
+
+//| \class Main::UnitThread
+/// Runs a Main::Unit on its own thread, with its own GNet::EventLoop,
+/// GNet::TimerList, GNet::Monitor and G::LogOutput.
+///
+/// The unit is constructed on the new thread and the constructor
+/// here waits for that to complete, so units are still constructed
+/// one at a time and any construction error is rethrown on the
+/// calling thread. The unit's event signals are passed back to the
+/// Main::Run object via its thread-safe post() method.
+///
+/// A unit that only forwards and then quits, ie. one that would
+/// terminate the program if it were the first unit, just finishes
+/// its own thread once its forwarding is done.
+///
+/// The destructor stops the unit's event loop and joins the thread.
+///
+class Main::UnitThread
+{
+public:
+	UnitThread( Run & , unsigned int unit_id , const std::string & version ,
+		const std::string & log_exename , const G::LogOutput::Config & log_config ,
+		const G::Path & log_file ) ;
+			///< Constructor. Starts the thread and waits for the unit
+			///< to be constructed. Throws if the unit cannot be
+			///< constructed. The unit is start()ed as soon as its
+			///< event loop is running.
+
+	~UnitThread() ;
+		///< Destructor. Stops the unit's event loop and waits for
+		///< the thread to finish.
+
+	unsigned int id() const noexcept ;
+		///< Returns the unit id.
+
+public:
+	UnitThread( const UnitThread & ) = delete ;
+	UnitThread( UnitThread && ) = delete ;
+	UnitThread & operator=( const UnitThread & ) = delete ;
+	UnitThread & operator=( UnitThread && ) = delete ;
+
+private:
+	enum class State { starting , constructing , running , failed , finished } ;
+	static void run( UnitThread * ) noexcept ;
+	void runImp() ;
+	void onUnitDone( unsigned int , std::string , bool ) ;
+	void onUnitEvent( unsigned int , std::string , std::string , std::string ) ;
+	void onNetworkEvent( const std::string & , const std::string & ) ;
+	State state() ;
+
+private:
+	Run & m_run ;
+	unsigned int m_unit_id ;
+	std::string m_version ;
+	std::string m_log_exename ;
+	G::LogOutput::Config m_log_config ;
+	G::Path m_log_file ;
+	G::threading::mutex_type m_mutex ; // protects the members below
+	G::threading::cond_type m_cond ; // signalled when construction is done
+	State m_state {State::starting} ;
+	std::exception_ptr m_exception ;
+	HANDLE m_stop_handle {} ;
+	bool m_stop_handle_valid {false} ;
+	G::threading::thread_type m_thread ;
+} ;
+
+#endif
@@ -60,6 +60,7 @@ sub doHelp { return $_[0]->{m_nc}->cmd( "help" ) }
 sub doTerminate { $_[0]->{m_nc}->send( "terminate\r\n" ) }
 sub doFlush { $_[0]->{m_nc}->send( "flush\r\n") }
 sub doForward { $_[0]->{m_nc}->cmd( "forward") }
+sub doMetrics { return $_[0]->{m_nc}->cmd( "metrics" ) }
 
 sub open
 {
@@ -48,6 +48,26 @@ our $tls_config = "x" ;
 our $with_valgrind = undef ;
 my $exe_name = "emailrelay" ;
 
+# Switches that map directly onto a command-line option, with any "%s"
+# taking the switch value, eg. run( { RateLimit => "2,1" } ).
+our %option_switches = (
+	Anonymous => "--anonymous" ,
+	CutThrough => "--cut-through" ,
+	Dnsbl => "--dnsbl=%s" ,
+	FilterSpec => "--filter=%s" ,
+	ForwardConcurrency => "--forward-concurrency=%s" ,
+	ForwardRetry => "--forward-retry=%s" ,
+	RateLimit => "--rate-limit=%s" ,
+	RemoteClients => "--remote-clients=%s" ,
+	SpoolAsync => "--spool-async" ,
+	SpoolDedup => "--spool-dedup" ,
+	SpoolIndex => "--spool-index" ,
+	SpoolLog => "--spool-log" ,
+	SpoolMemory => "--spool-memory=%s" ,
+	UnitThreads => "--unit-threads" ,
+	VerifierCache => "--verifier-cache=%s" ,
+) ;
+
 sub _exe
 {
 	my $exe = System::exe( $bin_dir , $exe_name ) ;
@@ -264,9 +284,21 @@ sub _switches
 		( (exists($sw{ClientTlsVerifyName}) && $sw{ClientTlsVerifyName}) ? "--client-tls-verify-name __TLS_VERIFY_NAME__ " : "" ) .
 		( exists($sw{TlsConfig}) ? "--tls-config=__TLS_CONFIG__ " : "" ) .
 		( exists($sw{ServerSmtpConfig}) ? "--server-smtp-config __SERVER_SMTP_CONFIG__ " : "" ) .
+		join( "" , map { _optionSwitch($_,$sw{$_}) } grep { exists($option_switches{$_}) } sort(keys(%sw)) ) .
+		( exists($sw{ConfigFile}) ? "$sw{ConfigFile} " : "" ) .
 		"" ;
 }
 
+sub _optionSwitch
+{
+	# Returns the option for a switch in the %option_switches table,
+	# with any "%s" replaced by the quoted switch value.
+	my ( $switch , $value ) = @_ ;
+	my $option = $option_switches{$switch} ;
+	$option =~ s/%s/'$value'/ ;
+	return "$option " ;
+}
+
 sub _set_all
 {
 	# Substitutes the value markers like __LOG_FILE__ with values from methods like $this->log().
@@ -111,11 +111,13 @@ sub mail
 sub submit_start
 {
 	# Starts message submission. See also submit_line()
-	# and submit_end().
+	# and submit_end(). The optional "headers"
+	# list replaces the default header lines.
 	my ( $this , $to , $opt ) = @_ ;
 
 	if( !defined($to) ) { $to = 'you@there' }
 	my $expect_rcpt_to_failure = $opt->{expect_rcpt_to_failure} ;
+	my $headers = $opt->{headers} || [ "From: me\@here" , "To: you\@there" , "Subject: test message" ] ;
 
 	my @to_list = ref($to) ? @$to : ($to) ;
 	$this->{m_nc}->cmd( "ehlo here" ) ;
@@ -132,14 +134,31 @@ sub submit_start
 			$this->{m_nc}->cmd( "rcpt to:<$rcpt_to>" ) ;
 		}
 		$this->{m_nc}->cmd( "data" , qr/354 [^\n]+\n/ ) ;
-		$this->{m_nc}->send( "From: me\@here\r\n" ) ;
-		$this->{m_nc}->send( "To: you\@there\r\n" ) ;
-		$this->{m_nc}->send( "Subject: test message\r\n" ) ;
+		for my $header ( @$headers )
+		{
+			$this->{m_nc}->send( "$header\r\n" ) ;
+		}
 		$this->{m_nc}->send( "\r\n" ) ;
 	}
 	return $this ;
 }
 
+sub greeting
+{
+	# Reads the initial greeting after an open() that did
+	# not wait for it. Returns the response line or undef.
+	my ( $this ) = @_ ;
+	return $this->{m_nc}->read( qr/[^\n]*\n/ ) ;
+}
+
+sub doMailFrom
+{
+	# Sends mail-from after an ehlo().
+	# Returns the response line or undef.
+	my ( $this ) = @_ ;
+	return $this->{m_nc}->cmd( "mail from:<me\@here>" , qr/[^\n]*\n/ ) ;
+}
+
 sub submit_end
 {
 	# Ends message submission by sending a dot.
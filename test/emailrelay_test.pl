@@ -201,6 +201,80 @@ sub createCerts
 	exit( 0 ) ;
 }
 
+sub _runServer
+{
+	# Runs the server with the usual logging, spool-directory and
+	# pid-file switches plus the given ones, and checks that it
+	# is running.
+	my ( $server , %switches ) = @_ ;
+	my %args = (
+		Log => 1 ,
+		LogFile => 1 ,
+		Verbose => 1 ,
+		Domain => 1 ,
+		Port => 1 ,
+		SpoolDir => 1 ,
+		PidFile => 1 ,
+		%switches ,
+	) ;
+	Check::ok( $server->run(\%args) , "failed to run" , $server->message() ) ;
+	Check::running( $server->pid() , $server->message() ) ;
+}
+
+sub _runForwarding
+{
+	# Runs the server in the foreground to forward the spooled
+	# messages, with the given extra switches.
+	my ( $server , %switches ) = @_ ;
+	my %args = (
+		Log => 1 ,
+		LogFile => 1 ,
+		Verbose => 1 ,
+		Domain => 1 ,
+		SpoolDir => 1 ,
+		ForwardTo => 1 ,
+		Forward => 1 ,
+		DontServe => 1 ,
+		NoDaemon => 1 ,
+		%switches ,
+	) ;
+	Check::ok( $server->run(\%args) , "failed to run as client" ) ;
+}
+
+sub _checkStartupError
+{
+	# Runs the server in the foreground with the given extra
+	# switches and checks that it fails with the given error.
+	my ( $server , $error , %switches ) = @_ ;
+	my %args = (
+		Log => 1 ,
+		Domain => 1 ,
+		Port => 1 ,
+		SpoolDir => 1 ,
+		NoDaemon => 1 ,
+		%switches ,
+	) ;
+	$server->run( \%args ) ;
+	Check::that( $server->rc() != 0 , "server started" , $error ) ;
+	Check::fileContains( $server->stderr() , $error ) ;
+}
+
+sub _submit
+{
+	# Submits one or more test messages over one connection
+	# and returns the last response.
+	my ( $server , $count ) = @_ ;
+	my $smtp_client = new SmtpClient( $server->smtpPort() ) ;
+	Check::ok( $smtp_client->open() ) ;
+	my $response ;
+	for my $i ( 1 .. ($count||1) )
+	{
+		$response = $smtp_client->submit() ;
+	}
+	$smtp_client->close() ;
+	return $response ;
+}
+
 # ===
 
 sub testServerShowsHelp
@@ -320,6 +394,30 @@ sub testServerAdminTerminate
 	$server->cleanup() ;
 }
 
+sub testServerAdminMetrics
+{
+	# setup
+	requireAdmin() ;
+	my $server = new Server() ;
+	_runServer( $server , Admin => 1 ) ;
+	_submit( $server , 2 ) ;
+	my $admin_client = new AdminClient( $server->adminPort() ) ;
+	Check::ok( $admin_client->open() , "cannot connect for admin" , $server->adminPort() ) ;
+	$admin_client->doHelp() ;
+	my $metrics = $admin_client->doMetrics() ;
+
+	# test that the metrics report counts the submitted messages
+	Check::that( defined($metrics) , "no metrics response" ) ;
+	Check::that( !!($metrics =~ m/^# TYPE emailrelay_smtp_server_messages_total counter\r?$/m) , "no metric type" , $metrics ) ;
+	Check::that( !!($metrics =~ m/^emailrelay_smtp_server_messages_total\{result="accepted"\} 2\r?$/m) , "invalid accepted count" , $metrics ) ;
+	Check::that( !!($metrics =~ m/^emailrelay_spool_messages_total\{op="stored"\} 2\r?$/m) , "invalid stored count" , $metrics ) ;
+	Check::that( !!($metrics =~ m/^emailrelay_spool_messages\{state="pending"\} 2\r?$/m) , "invalid spool depth" , $metrics ) ;
+
+	# tear down
+	$server->kill() ;
+	$server->cleanup() ;
+}
+
 sub testSubmit
 {
 	# setup
@@ -341,6 +439,87 @@ sub testSubmit
 	System::unlink( $path ) ;
 }
 
+sub testSubmitBulk
+{
+	# setup
+	my $spool_dir = System::createSpoolDir() ;
+	my $mbox = System::tempfile( "mbox" ) ;
+	System::createFile( $mbox , [
+		"From me\@here Mon Jan  1 00:00:00 2024" ,
+		"Subject: bulk 1" ,
+		"" ,
+		"one" ,
+		">From here" ,
+		"" ,
+		"From me\@here Mon Jan  1 00:00:01 2024" ,
+		"Subject: bulk 2" ,
+		"" ,
+		"two" ,
+		"" ,
+		"From me\@here Mon Jan  1 00:00:02 2024" ,
+		"Subject: bulk 3" ,
+		"" ,
+		"three" ,
+	] ) ;
+	my $exe = System::sanepath( System::exe( $opt_bin_dir , "emailrelay-submit" ) ) ;
+
+	# test that each message in an mbox file is submitted, with ">From" lines unquoted
+	my $cmd = System::commandline( "$exe --from me\@here.localnet --spool-dir $spool_dir " .
+		"--bulk=mbox --bulk-sync=2 --input-file=$mbox me\@there.localnet" , {background=>0} ) ;
+	my $rc = system( $cmd ) ;
+	Check::that( $rc == 0 , "failed to submit" ) ;
+	Check::fileMatchCount( $spool_dir."/emailrelay.*.content" , 3 ) ;
+	Check::fileMatchCount( $spool_dir."/emailrelay.*.envelope" , 3 ) ;
+	Check::allFilesContain( $spool_dir."/emailrelay.*.content" , "^Subject: bulk [123]" ) ;
+	Check::noFileContains( $spool_dir."/emailrelay.*.content" , "^>From " ) ;
+	my $content = join( "" , map { local $/ ; my $fh = new FileHandle( $_ ) or die ; <$fh> } System::glob_( $spool_dir."/emailrelay.*.content" ) ) ;
+	Check::that( !!($content =~ m/^From here\r?$/m) , "quoted from line not unquoted" ) ;
+
+	# tear down
+	System::deleteSpoolDir( $spool_dir ) ;
+	System::unlink( $mbox ) ;
+}
+
+sub testSubmitBulkRescan
+{
+	# setup
+	requireAdmin() ;
+	my $server = new Server() ;
+	my $test_server = new TestServer( System::nextPort() ) ;
+	$server->set_forwardToPort( $test_server->port() ) ;
+	my $mbox = System::tempfile( "mbox" ) ;
+	System::createFile( $mbox , [
+		"From me\@here Mon Jan  1 00:00:00 2024" ,
+		"Subject: bulk 1" ,
+		"" ,
+		"one" ,
+		"" ,
+		"From me\@here Mon Jan  1 00:00:01 2024" ,
+		"Subject: bulk 2" ,
+		"" ,
+		"two" ,
+	] ) ;
+	my $exe = System::sanepath( System::exe( $opt_bin_dir , "emailrelay-submit" ) ) ;
+	$test_server->run() ;
+	_runServer( $server , Admin => 1 , ForwardTo => 1 ) ;
+
+	# test that the submit tool tells the server to rescan and that the new messages are forwarded
+	my $cmd = System::commandline( "$exe --from me\@here.localnet --spool-dir " . $server->spoolDir() . " " .
+		"--bulk=mbox --admin=" . $server->adminPort() . " --input-file=$mbox me\@there.localnet" , {background=>0} ) ;
+	my $rc = system( $cmd ) ;
+	Check::that( $rc == 0 , "failed to submit" ) ;
+	System::waitForFiles( $server->spoolDir()."/emailrelay.*.envelope*" , 0 ) ;
+	Check::fileLineCount( $test_server->log() , 2 , "rx<<: \\[Subject: bulk [12]\\]" ) ;
+	Check::fileContains( $server->log() , "forwarding: \\[rescan\\]" ) ;
+
+	# tear down
+	$server->kill() ;
+	$test_server->kill() ;
+	$test_server->cleanup() ;
+	$server->cleanup() ;
+	System::unlink( $mbox ) ;
+}
+
 sub testPasswd
 {
 	# test that the password utility works
@@ -859,6 +1038,539 @@ sub testServerPolling
 	System::deleteSpoolDir($spool_dir_2) ;
 }
 
+sub _deleteSegments
+{
+	my ( $spool_dir ) = @_ ;
+	for my $path ( System::glob_( "$spool_dir/.segments/*" ) )
+	{
+		System::unlink( $path ) ;
+	}
+	System::rmdir_( "$spool_dir/.segments" ) ;
+}
+
+sub testServerForwardConcurrency
+{
+	# setup
+	my $server = new Server() ;
+	my $test_server = new TestServer( System::nextPort() ) ;
+	$server->set_forwardToPort( $test_server->port() ) ;
+	System::submitMessageText( $server->spoolDir() , "one" ) ;
+	System::submitMessageText( $server->spoolDir() , "two" ) ;
+	System::submitMessageText( $server->spoolDir() , "three" ) ;
+	_runServer( $server , ForwardTo => 1 , Poll => 1 , ForwardConcurrency => "2,4" , ForwardRetry => "1,2" ) ;
+
+	# test that messages are deferred with a retry time when the destination is down
+	System::waitForFileLine( $server->log() , "connection failed" ) ;
+	System::waitForFileLine( $server->log() , "3 deferred" ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope" , 3 ) ;
+	Check::allFilesContain( $server->spoolDir()."/emailrelay.*.envelope" , "X-MailRelay-Retry: " ) ;
+
+	# test that deferred messages are forwarded once the destination is up
+	$test_server->run() ;
+	System::waitForFiles( $server->spoolDir()."/emailrelay.*.envelope*" , 0 ) ;
+	Check::fileLineCount( $test_server->log() , 3 , "rx<<: \\[Subject: test\\]" ) ;
+
+	# tear down
+	$server->kill() ;
+	$test_server->kill() ;
+	$test_server->cleanup() ;
+	$server->cleanup() ;
+}
+
+sub testServerUnitThreads
+{
+	# setup
+	requireThreads() ;
+	my $server = new Server() ;
+	my $test_server = new TestServer( System::nextPort() ) ;
+	$server->set_forwardToPort( $test_server->port() ) ;
+	my $out_spool_dir = System::createSpoolDir( "out" ) ;
+	System::submitMessageText( $out_spool_dir , "out" ) ;
+	my $config_file = System::tempfile( "config" ) ;
+	System::createFile( $config_file , [
+		"out-spool-dir $out_spool_dir" ,
+		"out-forward" ,
+		"out-forward-to " . $server->forwardTo() ,
+		"out-dont-serve" ,
+	] ) ;
+	$test_server->run() ;
+	_runServer( $server , ForwardTo => 1 , Immediate => 1 , UnitThreads => 1 , ConfigFile => $config_file ) ;
+
+	# test that the forward-and-quit unit forwards its message from its own thread
+	System::waitForFiles( "$out_spool_dir/emailrelay.*.envelope*" , 0 ) ;
+	System::waitForFileLine( $test_server->log() , "rx<<: \\[out\\]" ) ;
+
+	# test that the unit's thread finishes once it has forwarded
+	if( System::linux() )
+	{
+		my $pid = $server->pid() ;
+		System::waitFor( sub { scalar(System::glob_("/proc/$pid/task/*")) == 1 } , "unit thread to finish" ) ;
+	}
+
+	# test that the main unit is still running and forwards its own mail
+	Check::running( $server->pid() , $server->message() ) ;
+	_submit( $server ) ;
+	System::waitForFileLine( $test_server->log() , "rx<<: \\[Subject: test message\\]" ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope*" , 0 ) ;
+
+	# tear down
+	$server->kill() ;
+	$test_server->kill() ;
+	$test_server->cleanup() ;
+	$server->cleanup() ;
+	System::deleteSpoolDir( $out_spool_dir , 1 ) ;
+	System::unlink( $config_file ) ;
+}
+
+sub testSpoolLogReplay
+{
+	# setup
+	my $server = new Server() ;
+	my $segments = $server->spoolDir() . "/.segments" ;
+	_runServer( $server , SpoolLog => 1 ) ;
+	_submit( $server , 2 ) ;
+	$server->kill() ;
+
+	# test that messages go into a segment file rather than separate files
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.content" , 0 ) ;
+	Check::fileMatchCount( "$segments/*.log" , 1 ) ;
+	Check::fileExists( "$segments/index" ) ;
+
+	# test that a truncated last record is ignored when the segment is
+	# replayed on top of the index saved at startup
+	my $segment = (System::glob_("$segments/*.log"))[0] ;
+	truncate( $segment , (-s $segment) - 5 ) or die ;
+	System::unlink( $server->log() ) ;
+	_runServer( $server , SpoolLog => 1 ) ;
+	$server->kill() ;
+	Check::fileContains( $server->log() , "ignoring incomplete record" ) ;
+	Check::fileContains( $server->log() , "1 message\\(s\\) in " ) ;
+
+	# test that a torn record at the end of the newest segment is ignored
+	# and that older messages are recovered from the index
+	my @segment_list = sort( System::glob_("$segments/*.log") ) ;
+	my $fh = new FileHandle( $segment_list[-1] , "a" ) or die ;
+	print $fh "M emailrelay.1.2.3 500 500\nX-MailRelay-Format: " ;
+	$fh->close() ;
+	System::unlink( $server->log() ) ;
+	_runServer( $server , SpoolLog => 1 ) ;
+	$server->kill() ;
+	Check::fileContains( $server->log() , "ignoring incomplete record" ) ;
+	Check::fileContains( $server->log() , "1 message\\(s\\) in " ) ;
+
+	# test that a corrupt index is rebuilt by replaying all the segments
+	System::createFile( "$segments/index" , "garbage" ) ;
+	System::unlink( $server->log() ) ;
+	_runServer( $server , SpoolLog => 1 ) ;
+	$server->kill() ;
+	Check::fileContains( $server->log() , "invalid index file" ) ;
+	Check::fileContains( $server->log() , "1 message\\(s\\) in " ) ;
+
+	# test that a restart with nothing to write does not start a new segment file
+	my @segments_before = sort( System::glob_("$segments/*.log") ) ;
+	System::unlink( $server->log() ) ;
+	_runServer( $server , SpoolLog => 1 ) ;
+	$server->kill() ;
+	my @segments_after = sort( System::glob_("$segments/*.log") ) ;
+	Check::that( "@segments_before" eq "@segments_after" , "new segment file on restart" , "@segments_after" ) ;
+	Check::fileDoesNotContain( $server->log() , "new segment file" ) ;
+
+	# tear down
+	_deleteSegments( $server->spoolDir() ) ;
+	$server->cleanup() ;
+}
+
+sub testSpoolLogExport
+{
+	# setup
+	my $server = new Server() ;
+	my $exe = System::sanepath( System::exe( $opt_bin_dir , "emailrelay-export" ) ) ;
+	_runServer( $server , SpoolLog => 1 ) ;
+	_submit( $server , 2 ) ;
+	$server->kill() ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope" , 0 ) ;
+
+	# test that the export utility writes the messages back out as envelope and content files
+	my $spool_dir = $server->spoolDir() ;
+	my $output = `$exe --spool-dir $spool_dir --remove 2>&1` ;
+	Check::that( $? == 0 && !!($output =~ m/2 messages exported/) , "export failed" , $output ) ;
+	Check::fileMatchCount( "$spool_dir/emailrelay.*.envelope" , 2 ) ;
+	Check::fileMatchCount( "$spool_dir/emailrelay.*.content" , 2 ) ;
+	Check::fileMatchCount( "$spool_dir/emailrelay.*.new" , 0 ) ;
+	Check::allFilesContain( "$spool_dir/emailrelay.*.content" , "Subject: test message" ) ;
+
+	# test that the exported messages are removed from the segment files
+	$output = `$exe --spool-dir $spool_dir 2>&1` ;
+	Check::that( $? == 0 && !!($output =~ m/0 messages exported/) , "export failed" , $output ) ;
+
+	# tear down
+	_deleteSegments( $server->spoolDir() ) ;
+	$server->cleanup() ;
+}
+
+sub testSpoolLogCompaction
+{
+	# setup
+	my $server = new Server() ;
+	my $segments = $server->spoolDir() . "/.segments" ;
+	my $test_server = new TestServer( System::nextPort() ) ;
+	$server->set_forwardToPort( $test_server->port() ) ;
+	_runServer( $server , SpoolLog => 1 ) ;
+	_submit( $server , 2 ) ;
+	$server->kill() ;
+	Check::fileExists( "$segments/00000001.log" ) ;
+
+	# test that forwarding the messages empties the first segment
+	# so that it is compacted away
+	$test_server->run() ;
+	System::unlink( $server->log() ) ;
+	_runForwarding( $server , SpoolLog => 1 ) ;
+	Check::fileContains( $server->log() , "2 message\\(s\\) in " ) ;
+	Check::fileContains( $server->log() , "removing segment \\[00000001.log\\]" ) ;
+	Check::that( ! -f "$segments/00000001.log" , "segment file not removed" ) ;
+	Check::fileDoesNotContain( $server->log() , "failing message" ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.content" , 0 ) ;
+
+	# tear down
+	$test_server->kill() ;
+	$test_server->cleanup() ;
+	_deleteSegments( $server->spoolDir() ) ;
+	$server->cleanup() ;
+}
+
+sub testSpoolDedup
+{
+	# setup
+	requireUnix() ;
+	my $server = new Server() ;
+	my $dedup_dir = $server->spoolDir() . "/.dedup" ;
+	my $test_server = new TestServer( System::nextPort() ) ;
+	$server->set_forwardToPort( $test_server->port() ) ;
+	_runServer( $server , SpoolDedup => 1 , Anonymous => 1 ) ;
+	_submit( $server , 2 ) ;
+	$server->kill() ;
+
+	# test that identical content is stored once, with the digest in each envelope
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.content" , 2 ) ;
+	Check::fileMatchCount( "$dedup_dir/*" , 1 ) ;
+	my @content = System::glob_( $server->spoolDir()."/emailrelay.*.content" ) ;
+	my ( $dev_1 , $ino_1 , $mode_1 , $nlink_1 ) = stat( $content[0] ) ;
+	my ( $dev_2 , $ino_2 ) = stat( $content[1] ) ;
+	Check::that( $ino_1 == $ino_2 , "content files not linked" ) ;
+	Check::that( $nlink_1 == 3 , "unexpected content link count" , $nlink_1 ) ;
+	Check::allFilesContain( $server->spoolDir()."/emailrelay.*.envelope" , "X-MailRelay-Digest: " ) ;
+
+	# test that the shared content is removed once both messages are forwarded
+	$test_server->run() ;
+	System::unlink( $server->log() ) ;
+	_runForwarding( $server , SpoolDedup => 1 ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.content" , 0 ) ;
+	Check::fileMatchCount( "$dedup_dir/*" , 0 ) ;
+
+	# tear down
+	$test_server->kill() ;
+	$test_server->cleanup() ;
+	System::rmdir_( $dedup_dir ) ;
+	$server->cleanup() ;
+}
+
+sub testSpoolDedupClientFilter
+{
+	# setup
+	requireUnix() ;
+	my $server = new Server() ;
+	my $dedup_dir = $server->spoolDir() . "/.dedup" ;
+	my $test_server = new TestServer( System::nextPort() ) ;
+	$server->set_forwardToPort( $test_server->port() ) ;
+	Filter::create( $server->clientFilter() , {} , {
+			unix => [
+				'echo "X-Edited: yes" >> "$content"' ,
+				"exit 1" ,
+			] ,
+		} ) ;
+	_runServer( $server , SpoolDedup => 1 , Anonymous => 1 ) ;
+	_submit( $server , 2 ) ;
+	$server->kill() ;
+	Check::fileMatchCount( "$dedup_dir/*" , 1 ) ;
+
+	# test that a client filter that edits the content only edits its own message
+	$test_server->run() ;
+	_runForwarding( $server , SpoolDedup => 1 , ClientFilter => 1 ) ;
+	my @content = System::glob_( $server->spoolDir()."/emailrelay.*.content" ) ;
+	Check::that( scalar(@content) == 2 , "unexpected content file count" ) ;
+	Check::fileLineCount( $content[0] , 1 , "X-Edited" ) ;
+	Check::fileLineCount( $content[1] , 1 , "X-Edited" ) ;
+	Check::noFileContains( "$dedup_dir/*" , "X-Edited" ) ;
+	my ( $dev_1 , $ino_1 ) = stat( $content[0] ) ;
+	my ( $dev_2 , $ino_2 ) = stat( $content[1] ) ;
+	Check::that( $ino_1 != $ino_2 , "edited content files still linked" ) ;
+
+	# tear down
+	$test_server->kill() ;
+	$test_server->cleanup() ;
+	System::unlink( $_ ) for System::glob_( "$dedup_dir/*" ) ;
+	System::rmdir_( $dedup_dir ) ;
+	$server->cleanup() ;
+}
+
+sub testSpoolMemory
+{
+	# setup
+	my $server = new Server() ;
+	my $test_server = new TestServer( System::nextPort() ) ;
+	$server->set_forwardToPort( $test_server->port() ) ;
+	_runServer( $server , ForwardTo => 1 , SpoolMemory => 1000000 ) ;
+	_submit( $server ) ;
+
+	# test that the message is not written to the spool directory
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope*" , 0 ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.content" , 0 ) ;
+	$server->kill() ;
+
+	# test that in-memory messages are forwarded
+	$test_server->run() ;
+	_runServer( $server , ForwardTo => 1 , SpoolMemory => 1000000 , Immediate => 1 ) ;
+	_submit( $server ) ;
+	System::waitForFileLine( $test_server->log() , "rx<<: \\[Subject: test message\\]" ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope*" , 0 ) ;
+	$server->kill() ;
+
+	# test that a message too big for the memory limit goes into the spool directory
+	_runServer( $server , ForwardTo => 1 , SpoolMemory => 10 ) ;
+	_submit( $server ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope" , 1 ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.content" , 1 ) ;
+
+	# tear down
+	$server->kill() ;
+	$test_server->kill() ;
+	$test_server->cleanup() ;
+	$server->cleanup() ;
+}
+
+sub testSpoolIndex
+{
+	# setup
+	requireAdmin() ;
+	my $server = new Server() ;
+	my $test_server = new TestServer( System::nextPort() ) ;
+	$server->set_forwardToPort( $test_server->port() ) ;
+	my $index = $server->spoolDir() . "/.index/snapshot" ;
+	_runServer( $server , Admin => 1 , AdminTerminate => 1 , SpoolIndex => 1 ) ;
+	_submit( $server , 2 ) ;
+
+	# test that an index snapshot of the queued messages is saved on shutdown
+	my $admin_client = new AdminClient( $server->adminPort() ) ;
+	Check::ok( $admin_client->open() , "cannot connect for admin" , $server->adminPort() ) ;
+	$admin_client->doHelp() ;
+	$admin_client->doTerminate() ;
+	$server->wait() ;
+	Check::notRunning( $server->pid() ) ;
+	Check::fileExists( $index ) ;
+	Check::fileLineCount( $index , 1 , "^emailrelay-spool-index 1 " ) ;
+	Check::fileLineCount( $index , 2 , "^emailrelay\\." ) ;
+
+	# test that forwarding on restart uses the index snapshot
+	System::unlink( $server->log() ) ;
+	$test_server->run() ;
+	_runServer( $server , SpoolIndex => 1 , ForwardTo => 1 , Forward => 1 ) ;
+	System::waitForFileLineCount( $test_server->log() , "rx<<: \\[Subject: test message\\]" , 2 ) ;
+	Check::fileContains( $server->log() , "using spool index snapshot: 2 message\\(s\\)" ) ;
+	System::waitForFiles( $server->spoolDir()."/emailrelay.*.envelope*" , 0 ) ;
+
+	# test that the index snapshot is kept up to date as messages are deleted
+	$server->kill() ;
+	Check::fileLineCount( $index , 1 , "^emailrelay-spool-index 1 " ) ;
+	Check::fileLineCount( $index , 0 , "^emailrelay\\." ) ;
+
+	# tear down
+	$test_server->kill() ;
+	$test_server->cleanup() ;
+	System::unlink( $index ) ;
+	System::rmdir_( $server->spoolDir() . "/.index" ) ;
+	$server->cleanup() ;
+}
+
+sub testSpoolAsync
+{
+	# setup
+	my $server = new Server() ;
+	_runServer( $server , SpoolAsync => 1 ) ;
+	my @headers = ( "From: me\@here" , "To: you\@there" , "Subject: large test message" ) ;
+	my @lines = map { sprintf( "%06d %s" , $_ , "x" x 90 ) } ( 1 .. 50000 ) ;
+	my $expected = join( "" , map { "$_\r\n" } ( @headers , "" , @lines ) ) ;
+
+	# test that a large message is written to the spool directory intact
+	my $smtp_client = new SmtpClient( $server->smtpPort() ) ;
+	Check::ok( $smtp_client->open() ) ;
+	$smtp_client->submit_start( undef , { headers => \@headers } ) ;
+	$smtp_client->submit_line( $_ ) for @lines ;
+	my $response = $smtp_client->submit_end() ;
+	Check::that( !!($response =~ m/^250 /) , "unexpected response" , $response ) ;
+	my @content = System::glob_( $server->spoolDir()."/emailrelay.*.content" ) ;
+	Check::that( scalar(@content) == 1 , "unexpected content file count" , scalar(@content) ) ;
+	my $fh = new FileHandle( $content[0] , "r" ) or die ;
+	binmode $fh ;
+	my $content = do { local $/ ; <$fh> } ;
+	$fh->close() ;
+	my $received = substr( $content , 0 , length($content) - length($expected) ) ;
+	Check::that( substr($content,length($received)) eq $expected , "content mismatch" ) ;
+	Check::that( !!($received =~ m/^Received: [^\r]*\r\n(?:[ \t][^\r]*\r\n)*$/) , "unexpected content prefix" ) ;
+
+	# test that a message abandoned part way through is cleaned up
+	$smtp_client->submit_start( undef , { headers => \@headers } ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.content" , 2 ) ;
+	$smtp_client->submit_line( $_ ) for @lines[0..20000] ;
+	$smtp_client->close() ;
+	System::waitForFiles( $server->spoolDir()."/emailrelay.*.content" , 1 ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope*" , 1 ) ;
+
+	# tear down
+	$server->kill() ;
+	$server->cleanup() ;
+}
+
+sub testServerRemoteClientRanges
+{
+	# setup
+	my $server = new Server() ;
+
+	# test that an invalid address range stops the server starting
+	_checkStartupError( $server , "invalid --remote-clients address range" ,
+		RemoteClients => "192.0.2.0/24,10.0.0.0/33" ) ;
+
+	# test that a range with host bits set stops the server starting
+	_checkStartupError( $server , "invalid --remote-clients address range" ,
+		RemoteClients => "192.0.2.1/24" ) ;
+
+	# test that an invalid dnsbl allowlist range stops the server starting
+	_checkStartupError( $server , "invalid allowlist address range" ,
+		RemoteClients => "192.0.2.0/24" ,
+		Dnsbl => "dnsbl.example.com,!10.0.0.0/33" ) ;
+
+	# test that local clients are still accepted with a list of
+	# remote ranges, and that allowlisted clients skip the dnsbl check
+	_runServer( $server ,
+		RemoteClients => "192.0.2.0/24,198.51.100.*,2001:db8::/32" ,
+		Dnsbl => "dnsbl.example.com,1,1000,127.0.0.1:" . System::nextPort() . ",!127.0.0.0/8" ) ;
+	_submit( $server ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope" , 1 ) ;
+	Check::fileContains( $server->log() , "dnsbl check skipped for allowlisted address 127.0.0.1" ) ;
+
+	# tear down
+	$server->kill() ;
+	$server->cleanup() ;
+}
+
+sub testServerTrustedClients
+{
+	# setup
+	my $server = new Server() ;
+	System::createFile( $server->serverSecrets() , [
+		"server plain alice secret" ,
+		"server none 127.0.0.1/8 typo" ,
+		"server none 127.0.0.0/8 localnet" ,
+		"server none 10.0.0.0/8 other" ,
+	] ) ;
+	_runServer( $server , ServerAuth => 1 ) ;
+
+	# test that a client in a trusted address range can submit without authenticating
+	my $response = _submit( $server ) ;
+	Check::that( !!($response =~ m/^250 /) , "unexpected response" , $response ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope" , 1 ) ;
+	Check::fileContains( $server->log() , "trusting \\[127.0.0.1\\]: .* \\[127.0.0.0/8\\]" ) ;
+
+	# test that a trust range with host bits set is warned about
+	Check::fileContains( $server->log() , "invalid server trust address range: \\[127.0.0.1/8\\]" ) ;
+
+	# tear down
+	$server->kill() ;
+	$server->cleanup() ;
+}
+
+sub testAddressTreeLookup
+{
+	# setup
+	my $exe = System::sanepath( System::exe( $opt_test_bin_dir , "emailrelay_test_addresstree" ) ) ;
+	my $output = `$exe --ranges 100000 --lookups 100000 2>&1` ;
+	my $rc = $? ;
+
+	# test that address tree lookups over 100k ranges agree with a linear search and are faster
+	Check::that( $rc == 0 && !!($output =~ m/^ok$/m) , "address tree lookup failed" , $output ) ;
+	my ( $tree_ns ) = ( $output =~ m/^tree: (\d+) ns/m ) ;
+	my ( $linear_ns ) = ( $output =~ m/^linear: (\d+) ns/m ) ;
+	Check::that( defined($tree_ns) && defined($linear_ns) && $tree_ns < $linear_ns , "address tree lookup too slow" , $output ) ;
+}
+
+sub testServerCutThrough
+{
+	# setup
+	my $server = new Server() ;
+	my $test_server = new TestServer( System::nextPort() ) ;
+	$server->set_forwardToPort( $test_server->port() ) ;
+	$test_server->run() ;
+	_runServer( $server , ForwardTo => 1 , CutThrough => 1 ) ;
+	my $smtp_client = new SmtpClient( $server->smtpPort() ) ;
+	Check::ok( $smtp_client->open() ) ;
+
+	# test that the content reaches the next-hop server before the submission is complete
+	$smtp_client->submit_start() ;
+	$smtp_client->submit_line( "first line" ) ;
+	System::waitForFileLine( $test_server->log() , "rx<<: \\[first line\\]" ) ;
+	my $response = $smtp_client->submit_end() ;
+	Check::that( !!($response =~ m/^250 /) , "unexpected response" , $response ) ;
+	$smtp_client->close() ;
+
+	# test that the stored copy is removed once forwarded
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope*" , 0 ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.content" , 0 ) ;
+	$server->kill() ;
+	$test_server->kill() ;
+
+	# test that a next-hop rejection is passed back to the submitting client
+	$test_server->run( "--fail-at 0" ) ;
+	_runServer( $server , ForwardTo => 1 , CutThrough => 1 ) ;
+	$response = _submit( $server ) ;
+	Check::that( !!($response =~ m/^[45]\d\d /) , "next-hop rejection not passed back" , $response ) ;
+
+	# tear down
+	$server->kill() ;
+	$test_server->kill() ;
+	$test_server->cleanup() ;
+	$server->cleanup() ;
+}
+
+sub testServerRateLimit
+{
+	# setup
+	my $server = new Server() ;
+	_runServer( $server , RateLimit => "2,1" ) ;
+
+	# test that the first message is accepted
+	my $response = _submit( $server ) ;
+	Check::that( !!($response =~ m/^250 /) , "unexpected response" , $response ) ;
+
+	# test that a message over the limit is rejected at mail-from
+	my $smtp_client_2 = new SmtpClient( $server->smtpPort() ) ;
+	Check::ok( $smtp_client_2->open() ) ;
+	$smtp_client_2->ehlo() ;
+	$response = $smtp_client_2->doMailFrom() ;
+	Check::that( !!($response =~ m/^451 too many messages/) , "message not rate limited" , $response ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope" , 1 ) ;
+
+	# test that a connection over the limit is refused
+	my $smtp_client_3 = new SmtpClient( $server->smtpPort() ) ;
+	Check::ok( $smtp_client_3->open({wait220=>0}) ) ;
+	$response = $smtp_client_3->greeting() ;
+	Check::that( !!($response =~ m/^421 too many connections/) , "connection not rate limited" , $response ) ;
+	Check::fileContains( $server->log() , "connection rate exceeded" ) ;
+
+	# tear down
+	$smtp_client_2->close() ;
+	$server->kill() ;
+	$server->cleanup() ;
+}
+
 sub testServerWithBadClient
 {
 	# setup
@@ -1488,6 +2200,130 @@ sub testFilterParallelism
 	$server->cleanup() ;
 }
 
+sub testFilterGroup
+{
+	# setup
+	my $server = new Server() ;
+
+	# test that a filter that can edit the message is not allowed in a group
+	_checkStartupError( $server , "invalid filter in parallel group: deliver" ,
+		FilterSpec => "exit:0&deliver:" ) ;
+
+	# test that the group fails as soon as one of its filters fails
+	_runServer( $server , FilterSpec => "sleepms:5000&exit:1" ) ;
+	my $t0 = time() ;
+	my $response = _submit( $server ) ;
+	Check::that( (time()-$t0) < 3 , "filter group did not fail fast" ) ;
+	Check::that( !!($response =~ m/^[45]\d\d /) , "unexpected response" , $response ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope*" , 0 ) ;
+	$server->kill() ;
+
+	# test that the group succeeds once all of its filters succeed
+	System::unlink( $server->log() ) ;
+	_runServer( $server , FilterSpec => "sleepms:100&exit:0&sleepms:200" ) ;
+	$response = _submit( $server ) ;
+	Check::that( !!($response =~ m/^250 /) , "unexpected response" , $response ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope" , 1 ) ;
+	$server->kill() ;
+
+	# test that a network filter can be grouped and that its rejection fails the group
+	my $scanner = new Scanner( $server->scannerAddress() ) ;
+	$scanner->run() ;
+	System::unlink( $server->log() ) ;
+	_runServer( $server , FilterSpec => "net:".$server->scannerAddress()."&sleepms:100" ) ;
+	my $smtp_client = new SmtpClient( $server->smtpPort() ) ;
+	Check::ok( $smtp_client->open() ) ;
+	$smtp_client->submit_start() ;
+	$smtp_client->submit_line( "send foobar" ) ; # (the test scanner treats the message body as a script)
+	$response = $smtp_client->submit_end() ;
+	Check::that( !!($response =~ m/^452 foobar/) , "unexpected response" , $response ) ;
+	Check::fileContains( $scanner->logfile() , "send foobar" ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope" , 1 ) ;
+
+	# tear down
+	$server->kill() ;
+	$scanner->kill() ;
+	$scanner->cleanup() ;
+	$server->cleanup() ;
+}
+
+sub testFilterDkim
+{
+	# setup
+	requireTls() ;
+	requireOpensslTool() ;
+	my $key_file = System::tempfile( "key" ) ;
+	my $data_file = System::tempfile( "data" ) ;
+	my $signature_file = System::tempfile( "sig" ) ;
+	system( "$Openssl::openssl genrsa -out $key_file 2048 2>/dev/null" ) ;
+	Check::fileExists( $key_file ) ;
+	chmod 0644 , $key_file ;
+	my $server = new Server() ;
+	_runServer( $server , FilterSpec => "dkim:example.com;sel;$key_file;From:Subject" ) ;
+	my $smtp_client = new SmtpClient( $server->smtpPort() ) ;
+	Check::ok( $smtp_client->open() ) ;
+	$smtp_client->submit_start( undef , { headers => [
+		"From: Me <me\@here>" ,
+		"To: you\@there" ,
+		"Subject:  hello \t world" ,
+		"\t again  " ] } ) ;
+	$smtp_client->submit_line( "one  two \t three  " ) ;
+	$smtp_client->submit_line( "" ) ;
+	$smtp_client->submit_line( "" ) ;
+	$smtp_client->submit_line( "end" ) ;
+	$smtp_client->submit_line( "" ) ;
+	$smtp_client->submit_line( "" ) ;
+	$smtp_client->submit_end() ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope" , 1 ) ;
+	my $content = System::match( $server->spoolDir()."/emailrelay.*.content" ) ;
+
+	# extract the new header, unfolded but keeping its line breaks
+	my $fh = new FileHandle( $content ) or die ;
+	my $header = <$fh> ;
+	while( my $line = <$fh> )
+	{
+		last if $line !~ m/^[ \t]/ ;
+		$header .= $line ;
+	}
+	$fh->close() ;
+	$header =~ s/\r?\n$// ;
+	my ( $bh ) = ( $header =~ m/bh=([^;]*);/ ) ;
+	my ( $b ) = ( $header =~ m/[ \t;]b=([^;]*)$/ ) ;
+	$b =~ s/[ \t\r\n]//g ;
+
+	# test that the message has a dkim signature with the expected tags
+	Check::that( !!($header =~ m/^DKIM-Signature: v=1; a=rsa-sha256; c=relaxed\/relaxed;/) , "no dkim signature" ) ;
+	Check::that( !!($header =~ m/d=example\.com; s=sel;/) , "invalid dkim domain or selector" ) ;
+	Check::that( !!($header =~ m/h=from:subject;/) , "invalid dkim header list" ) ;
+
+	# test that the body hash is of the relaxed canonical body, ie. "one two three\r\n\r\n\r\nend\r\n"
+	Check::that( $bh eq "Dny81QibRseJ8TRTqP1mhogyRIfs6eUDGN8Ij2d1Zrk=" , "unexpected dkim body hash" , $bh ) ;
+
+	# test that the signature verifies against the relaxed canonical headers
+	my $signature_header = $header ;
+	$signature_header =~ s/\r?\n//g ;
+	$signature_header =~ s/[ \t]+/ /g ;
+	$signature_header =~ s/^DKIM-Signature: /dkim-signature:/ ;
+	$signature_header =~ s/([ ;]b=)[^;]*$/$1/ ;
+	my $data = "from:Me <me\@here>\r\n" . "subject:hello world again\r\n" . $signature_header ;
+	$fh = new FileHandle( $data_file , "w" ) or die ; binmode $fh ; print $fh $data ; $fh->close() ;
+	require MIME::Base64 ;
+	$fh = new FileHandle( $signature_file , "w" ) or die ; binmode $fh ; print $fh MIME::Base64::decode_base64($b) ; $fh->close() ;
+	my $verify = `$Openssl::openssl dgst -sha256 -prverify $key_file -signature $signature_file $data_file 2>&1` ;
+	Check::that( !!($verify =~ m/Verified OK/) , "dkim signature does not verify" , $verify ) ;
+	$server->kill() ;
+
+	# test that an invalid key file stops the server from starting
+	System::createFile( $key_file , [ "not a key" ] ) ;
+	_checkStartupError( $server , "PEM_read_bio_PrivateKey" , FilterSpec => "dkim:example.com;sel;$key_file" ) ;
+
+	# tear down
+	$server->cleanup() ;
+	System::unlink( $key_file ) ;
+	System::unlink( $data_file ) ;
+	System::unlink( $signature_file ) ;
+}
+
 sub testScannerPass
 {
 	# setup
@@ -1745,6 +2581,46 @@ sub testNetworkVerifierFail
 	$server->cleanup() ;
 }
 
+sub testNetworkVerifierCache
+{
+	# setup
+	my $server = new Server() ;
+	my $verifier = new Verifier( $server->verifierPort() ) ;
+	_runServer( $server , Verifier => 1 , VerifierCache => 300 ) ;
+	$verifier->run() ;
+
+	# test that a repeated valid recipient is only verified once
+	for my $i ( 1 , 2 )
+	{
+		my $smtp_client = new SmtpClient( $server->smtpPort() ) ;
+		Check::ok( $smtp_client->open() ) ;
+		$smtp_client->submit_start( 'OK.A@here' ) ; # (the test verifier interprets the recipient string)
+		$smtp_client->submit_line( "just testing" ) ;
+		$smtp_client->submit_end() ;
+		$smtp_client->close() ;
+	}
+	Check::fileLineCount( $verifier->logfile() , 1 , "sending valid remote" ) ;
+	Check::fileContains( $server->log() , "cached verification result" ) ;
+	Check::fileMatchCount( $server->spoolDir()."/emailrelay.*.envelope" , 2 ) ;
+	Check::allFilesContain( $server->spoolDir()."/emailrelay.*.envelope" , "To-Remote: alice.here" ) ;
+
+	# test that an invalid recipient is not cached by default
+	for my $i ( 1 , 2 )
+	{
+		my $smtp_client = new SmtpClient( $server->smtpPort() ) ;
+		Check::ok( $smtp_client->open() ) ;
+		$smtp_client->submit_start( 'nobody@here' , {expect_rcpt_to_failure=>1} ) ;
+		$smtp_client->close() ;
+	}
+	Check::fileLineCount( $verifier->logfile() , 2 , "sending error response" ) ;
+
+	# tear down
+	$server->kill() ;
+	$verifier->kill() ;
+	$verifier->cleanup() ;
+	$server->cleanup() ;
+}
+
 sub testProxyConnectsOnce
 {
 	# setup
@@ -0,0 +1,248 @@
+//
+// Copyright (C) 2001-2024 Graeme Walker <graeme_walker@users.sourceforge.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// ===
+///
+/// \file emailrelay_test_addresstree.cpp
+///
+// A micro-benchmark for GNet::AddressTree.
+//
+// Compiles a set of random IPv4 and IPv6 address ranges into an address
+// tree and times lookups of random addresses, comparing the results and
+// the timings against a linear search through the ranges.
+//
+// usage: emailrelay_test_addresstree [--ranges <count>] [--lookups <count>] [--seed <seed>]
+//
+// Prints the timings followed by "ok", or exits with a non-zero exit code
+// if the tree and the linear search disagree.
+//
+
+#include "gdef.h"
+#include "gaddresstree.h"
+#include "gaddress.h"
+#include "ggetopt.h"
+#include "goptionsusage.h"
+#include "garg.h"
+#include "gstr.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace AddressTreeTest
+{
+	using Key = std::array<unsigned char,16U> ;
+	struct Range
+	{
+		bool is6 {false} ;
+		Key key {} ;
+		unsigned int bits {0U} ;
+		std::string str ;
+	} ;
+
+	void mask( Key & key , unsigned int bits )
+	{
+		for( unsigned int i = 0U ; i < 16U ; i++ )
+		{
+			if( bits >= (i+1U)*8U )
+				continue ;
+			else if( bits <= i*8U )
+				key[i] = 0U ;
+			else
+				key[i] &= static_cast<unsigned char>( 0xffU << (8U-(bits-i*8U)) ) ;
+		}
+	}
+
+	bool contains( const Range & range , bool is6 , const Key & key )
+	{
+		if( range.is6 != is6 )
+			return false ;
+		Key masked = key ;
+		mask( masked , range.bits ) ;
+		return masked == range.key ;
+	}
+
+	std::string str( bool is6 , const Key & key )
+	{
+		std::ostringstream ss ;
+		if( is6 )
+		{
+			ss << std::hex ;
+			for( std::size_t i = 0U ; i < 16U ; i += 2U )
+				ss << (i?":":"") << ((static_cast<unsigned int>(key[i])<<8U)|key[i+1U]) ;
+		}
+		else
+		{
+			ss << static_cast<unsigned int>(key[0]) << "." << static_cast<unsigned int>(key[1]) << "."
+				<< static_cast<unsigned int>(key[2]) << "." << static_cast<unsigned int>(key[3]) ;
+		}
+		return ss.str() ;
+	}
+
+	Key randomKey( std::mt19937 & rng , bool is6 )
+	{
+		Key key {} ;
+		std::uniform_int_distribution<unsigned int> byte( 0U , 255U ) ;
+		for( std::size_t i = 0U ; i < (is6?16U:4U) ; i++ )
+			key[i] = static_cast<unsigned char>( byte(rng) ) ;
+		if( is6 )
+		{
+			key[0] = 0x20 ; // 2000::/8, so that lookups have a chance of matching
+		}
+		else
+		{
+			key[0] = static_cast<unsigned char>( 10U + (key[0]%4U) ) ; // 10-13
+		}
+		return key ;
+	}
+
+	Range randomRange( std::mt19937 & rng )
+	{
+		Range range ;
+		range.is6 = std::uniform_int_distribution<unsigned int>(0U,9U)(rng) == 0U ;
+		range.key = randomKey( rng , range.is6 ) ;
+		range.bits = range.is6 ?
+			std::uniform_int_distribution<unsigned int>(16U,64U)(rng) :
+			std::uniform_int_distribution<unsigned int>(8U,32U)(rng) ;
+		mask( range.key , range.bits ) ;
+		range.str = str(range.is6,range.key).append(1U,'/').append(std::to_string(range.bits)) ;
+		return range ;
+	}
+
+	std::size_t linearFind( const std::vector<Range> & ranges , bool is6 , const Key & key )
+	{
+		// most specific match, or the first of equally-specific matches
+		std::size_t result = GNet::AddressTree::npos ;
+		for( std::size_t i = 0U ; i < ranges.size() ; i++ )
+		{
+			if( contains( ranges[i] , is6 , key ) &&
+				( result == GNet::AddressTree::npos || ranges[i].bits > ranges[result].bits ) )
+					result = i ;
+		}
+		return result ;
+	}
+
+	double nanoseconds( std::chrono::steady_clock::time_point start , std::size_t count )
+	{
+		auto elapsed = std::chrono::steady_clock::now() - start ;
+		return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+			static_cast<double>(count?count:1U) ;
+	}
+}
+
+int main( int argc , char * argv [] )
+{
+	namespace imp = AddressTreeTest ;
+	try
+	{
+		G::Arg arg( argc , argv ) ;
+		G::Options options ;
+		using M = G::Option::Multiplicity ;
+		G::Options::add( options , 'h' , "help" , "show help" , "" , M::zero , "" , 1 , 0 ) ;
+		G::Options::add( options , 'r' , "ranges" , "number of ranges" , "" , M::one , "count" , 1 , 0 ) ;
+		G::Options::add( options , 'l' , "lookups" , "number of lookups" , "" , M::one , "count" , 1 , 0 ) ;
+		G::Options::add( options , 's' , "seed" , "random number seed" , "" , M::one , "seed" , 1 , 0 ) ;
+		G::GetOpt opt( arg , options ) ;
+		if( opt.hasErrors() )
+		{
+			opt.showErrors(std::cerr) ;
+			return 2 ;
+		}
+		if( opt.contains("help") )
+		{
+			G::OptionsUsage(opt.options()).output( {} , std::cout , arg.prefix() ) ;
+			return 0 ;
+		}
+		std::size_t range_count = G::Str::toUInt( opt.value("ranges","100000") ) ;
+		std::size_t lookup_count = G::Str::toUInt( opt.value("lookups","100000") ) ;
+		std::size_t linear_count = std::min( lookup_count , std::size_t(100U) ) ; // slow
+		std::mt19937 rng( G::Str::toUInt( opt.value("seed","1") ) ) ;
+
+		std::vector<imp::Range> ranges ;
+		G::StringArray range_strings ;
+		ranges.reserve( range_count ) ;
+		for( std::size_t i = 0U ; i < range_count ; i++ )
+		{
+			ranges.push_back( imp::randomRange(rng) ) ;
+			range_strings.push_back( ranges.back().str ) ;
+		}
+
+		std::vector<GNet::Address> addresses ;
+		std::vector<std::pair<bool,imp::Key>> keys ;
+		addresses.reserve( lookup_count ) ;
+		for( std::size_t i = 0U ; i < lookup_count ; i++ )
+		{
+			bool is6 = std::uniform_int_distribution<unsigned int>(0U,9U)(rng) == 0U ;
+			imp::Key key = imp::randomKey( rng , is6 ) ;
+			addresses.push_back( GNet::Address::parse( imp::str(is6,key) , 0U ) ) ;
+			keys.emplace_back( is6 , key ) ;
+		}
+
+		auto start = std::chrono::steady_clock::now() ;
+		GNet::AddressTree tree( range_strings ) ;
+		double build_ns = imp::nanoseconds( start , range_count ) ;
+
+		start = std::chrono::steady_clock::now() ;
+		std::size_t matches = 0U ;
+		std::vector<std::size_t> results ;
+		results.reserve( lookup_count ) ;
+		for( const auto & address : addresses )
+		{
+			results.push_back( tree.find(address) ) ;
+			if( results.back() != GNet::AddressTree::npos )
+				matches++ ;
+		}
+		double tree_ns = imp::nanoseconds( start , lookup_count ) ;
+
+		start = std::chrono::steady_clock::now() ;
+		std::size_t errors = 0U ;
+		for( std::size_t i = 0U ; i < linear_count ; i++ )
+		{
+			std::size_t expected = imp::linearFind( ranges , keys[i].first , keys[i].second ) ;
+			if( results[i] != expected &&
+				!( results[i] != GNet::AddressTree::npos && expected != GNet::AddressTree::npos &&
+					ranges[results[i]].str == ranges[expected].str ) )
+			{
+				std::cerr << "mismatch: " << addresses[i].hostPartString() << ": "
+					<< (results[i]==GNet::AddressTree::npos?std::string("none"):ranges[results[i]].str) << " != "
+					<< (expected==GNet::AddressTree::npos?std::string("none"):ranges[expected].str) << "\n" ;
+				errors++ ;
+			}
+		}
+		double linear_ns = imp::nanoseconds( start , linear_count ) ;
+
+		std::cout
+			<< "ranges: " << range_count << " (" << tree.size() << " distinct)\n"
+			<< "build: " << static_cast<unsigned long>(build_ns) << " ns per range\n"
+			<< "lookups: " << lookup_count << " (" << matches << " matched)\n"
+			<< "tree: " << static_cast<unsigned long>(tree_ns) << " ns per lookup\n"
+			<< "linear: " << static_cast<unsigned long>(linear_ns) << " ns per lookup\n"
+			<< (errors?"failed":"ok") << std::endl ;
+		return errors ? 1 : 0 ;
+	}
+	catch( std::exception & e )
+	{
+		std::cerr << G::Arg::prefix(argv) << ": error: " << e.what() << std::endl ;
+	}
+	catch(...)
+	{
+		std::cerr << G::Arg::prefix(argv) << ": error\n" ;
+	}
+	return 11 ;
+}
@@ -36,6 +36,7 @@
 //         --lines <n>        : number of lines per message (default 1000)
 //         --line-length <n>  : message line length (default 998)
 //         --timeout <s>      : overall timeout (default none)
+//         --idle <s>         : hold all connections idle after EHLO (default 0)
 //         --utf8-domain      : use a UTF-8 domain name in e-mail addresses
 //         --smtputf8         : use UTF-8 mailbox names and use SMTPUTF8 MAIL-FROM
 //
@@ -79,6 +80,7 @@ struct Config
 	bool smtputf8 {false} ;
 	std::string domain {"example.com"} ;
 	int timeout {0} ; // seconds until exit()
+	int idle {0} ; // seconds to hold connections idle after EHLO
 } ;
 
 #ifdef G_WINDOWS
@@ -130,6 +132,7 @@ public:
 	Test( Address , Config ) ;
 	bool runSome() ;
 	bool done() const ;
+	bool greeted() const ;
 	void close() ;
 
 private:
@@ -166,6 +169,11 @@ bool Test::done() const
 	return m_done ;
 }
 
+bool Test::greeted() const
+{
+	return m_state > 1 ;
+}
+
 void Test::connect( const Address & a )
 {
 	if( m_config.verbosity ) std::cout << "connect: fd=" << m_fd << std::endl ;
@@ -351,6 +359,7 @@ std::string usage( const char * argv0 )
 		<< "[--lines <lines-per-message>] "
 		<< "[--line-length <line-length>] "
 		<< "[--timeout <seconds>] "
+		<< "[--idle <seconds>] "
 		<< "[--utf8-domain] [--smtputf8] "
 		<< "[<ipaddress>] <port>" ;
 	return ss.str() ;
@@ -383,6 +392,7 @@ int main( int argc , char * argv [] )
 		if( arg == "--utf8-domain" ) config.utf8_domain = true , remove = 1 ;
 		if( arg == "--smtputf8" ) config.smtputf8 = true , remove = 1 ;
 		if( arg == "--timeout" ) config.timeout = to_int(value) , remove = 2 ;
+		if( arg == "--idle" ) config.idle = to_int(value) , remove = 2 ;
 		if( remove == 0 ) break ;
 		while( remove-- && argc > 1 )
 		{
@@ -461,6 +471,16 @@ int main( int argc , char * argv [] )
 			std::vector<std::shared_ptr<Test>> tests ;
 			for( int t = 0 ; t < config.connections ; t++ )
 				tests.push_back( std::make_shared<Test>(address,config) ) ;
+			if( config.idle )
+			{
+				for( auto & t : tests )
+				{
+					while( !t->greeted() )
+						t->runSome() ;
+				}
+				if( config.verbosity ) *log_stream << "idle: " << tests.size() << " connections" << std::endl ;
+				sleep( config.idle ) ;
+			}
 			for( unsigned done_count = 0 ; done_count < tests.size() ; )
 			{
 				for( auto & t : tests )